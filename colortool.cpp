@@ -6,24 +6,64 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <thread>
+
+#if !defined(_WIN32)
+#  include <signal.h>
+#endif
 
 // openimageio
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagebufalgo_util.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
 
 using namespace OIIO;
 
 // eigen
 #include <Eigen/Dense>
 
-// boost
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
+// colortool
+#include "libcolortool/adaptation.h"
+#include "libcolortool/analysis.h"
+#include "libcolortool/builtin.h"
+#include "libcolortool/cct.h"
+#include "libcolortool/chain.h"
+#include "libcolortool/colormath.h"
+#include "libcolortool/dependency.h"
+#include "libcolortool/format.h"
+#include "libcolortool/gamut.h"
+#include "libcolortool/jsonreader.h"
+#include "libcolortool/lut.h"
+#include "libcolortool/ocio.h"
+#include "libcolortool/pairwise.h"
+#include "libcolortool/pipeline.h"
+#include "libcolortool/pixelkernel.h"
+#include "libcolortool/precision.h"
+#include "libcolortool/registry.h"
+#include "libcolortool/server.h"
+#include "libcolortool/spectral.h"
+#include "libcolortool/transfer.h"
+#include "libcolortool/transformcache.h"
+#include "libcolortool/whitebalance.h"
+
+using namespace colortool;
 
-using namespace boost::property_tree;
+// prints, info lines are buffered and only printed for the text format, structured
+// formats are written at once
+static bool printinfo = true;
 
-// prints
 void
 print_precision(int precision) {
     std::cout << std::fixed << std::setprecision(precision);
@@ -32,7 +72,10 @@ print_precision(int precision) {
 template <typename T>
 static void
 print_info(std::string param, const T& value = T()) {
-    std::cout << "info: " << param << value << std::endl;
+    if (!printinfo) {
+        return;
+    }
+    std::cout << "info: " << param << value << '\n';
 }
 
 static void
@@ -42,6 +85,9 @@ print_info(std::string param) {
 
 template <typename Derived>
 static void print_value(const std::string& param, const Eigen::MatrixBase<Derived>& value) {
+    if (!printinfo) {
+        return;
+    }
     std::cout << "info: " << param;
     if (value.cols() == 1 || value.rows() == 1) {
         for (int i = 0; i < value.size(); ++i) {
@@ -51,7 +97,7 @@ static void print_value(const std::string& param, const Eigen::MatrixBase<Derive
             }
         }
     } else {
-        std::cout << std::endl << "info:     ";
+        std::cout << '\n' << "info:     ";
         for (int i = 0; i < value.rows(); ++i) {
             for (int j = 0; j < value.cols(); ++j) {
                 std::cout << value(i, j);
@@ -60,15 +106,18 @@ static void print_value(const std::string& param, const Eigen::MatrixBase<Derive
                 }
             }
             if (i < value.rows() - 1) {
-                std::cout << std::endl << "info:     ";
+                std::cout << '\n' << "info:     ";
             }
         }
     }
-    std::cout << std::endl;  // Final newline at the end of output
+    std::cout << '\n';  // Final newline at the end of output
 }
 
 template <typename Derived>
 static void print_script(const std::string& param, const Eigen::MatrixBase<Derived>& value) {
+    if (!printinfo) {
+        return;
+    }
     std::cout << "info: " << param << " { ";
     if (value.cols() == 1 || value.rows() == 1) {
         for (int i = 0; i < value.size(); ++i) {
@@ -87,13 +136,13 @@ static void print_script(const std::string& param, const Eigen::MatrixBase<Deriv
             }
         }
     }
-    std::cout << " }" << std::endl;
+    std::cout << " }" << '\n';
 }
 
 template <typename T>
 static void
 print_warning(std::string param, const T& value = T()) {
-    std::cout << "warning: " << param << value << std::endl;
+    (printinfo ? std::cout : std::cerr) << "warning: " << param << value << '\n';
 }
 
 static void
@@ -112,115 +161,229 @@ print_error(std::string param) {
     print_error<std::string>(param);
 }
 
-// adaptation methods
-enum
-AdaptationMethod {
-    None,
-    XYZScaling,
-    Bradford,
-    Cat02,
-    VonKries
-};
-
 // color tool
 struct ColorTool
 {
     bool help = false;
     bool verbose = false;
+    bool stats = false;
     bool colorspaces = false;
     bool illuminants = false;
     AdaptationMethod adaptationmethod = Cat02;
+    std::string adaptation; // custom adaptation method by name
+    std::string adaptations;
+    float adaptationdegree = 1.0f;
+    float adaptationluminance = 0.0f;
+    std::string whitemap;
     std::string inputilluminant;
     std::string outputilluminant;
+    std::string inputcct;
+    float tint = 0.0f;
+    Locus locus = Locus::Planckian;
     std::string inputcolorspace;
     std::string outputcolorspace;
+    std::string chain;
+    std::string inputfilename;
+    std::string outputfilename;
+    std::string inputtrc;
+    std::string outputtrc;
+    bool trc = false;
+    Precision precision = Precision::Double;
+    bool precisionreport = false;
+    int threads = 0;
+    std::string frames;
+    int buffers = 3;
+    int memorylimit = 0;
+    std::string lutfile;
+    int lutsize = 33;
+    std::string applylut;
+    std::string ocioconfig;
+    bool ocio = false;
+    std::string all;
+    bool awb = false;
+    WhiteBalanceMethod awbmethod = WhiteBalanceMethod::GrayWorld;
+    float awbpercentile = 0.95f;
+    int awbstep = 8;
+    float awbsmoothing = 8.0f;
+    std::string awbsidecar;
+    std::string spectral;
+    std::string blackbody;
+    std::string observer = "cie1931";
+    std::string camera;
+    std::string patches;
+    bool gamutcompress = false;
+    float gamutthreshold = 0.8f;
+    float gamutpower = 1.2f;
+    bool analyze = false;
+    std::string compare;
+    std::string gamuttarget;
+    int histogrambins = 16;
+    float deltaethreshold = 1.0f;
+    float analysisnits = 100.0f;
+    std::string cachefile;
+    bool nocache = false;
+    std::string batchfile;
+    std::string batchoutput;
+    OutputFormat format = OutputFormat::Text;
+    std::string formatoutput;
+    std::string serve;
+    bool watch = false;
+    int watchinterval = 250;
     int code = EXIT_SUCCESS;
 };
 
 static ColorTool tool;
 
-static int
-set_adaptationmethod(int argc, const char* argv[])
+static bool
+parse_adaptationmethod(const std::string& str, AdaptationMethod& method)
 {
-    OIIO_DASSERT(argc == 2);
-    std::string str(argv[1]);
     if (str == "xyzscaling") {
-        tool.adaptationmethod = AdaptationMethod::XYZScaling;
+        method = AdaptationMethod::XYZScaling;
     }
     else if (str == "bradford") {
-        tool.adaptationmethod = AdaptationMethod::Bradford;
+        method = AdaptationMethod::Bradford;
     }
     else if (str == "cat02") {
-        tool.adaptationmethod = AdaptationMethod::Cat02;
+        method = AdaptationMethod::Cat02;
     }
     else if (str == "vonkries") {
-        tool.adaptationmethod = AdaptationMethod::VonKries;
+        method = AdaptationMethod::VonKries;
+    }
+    else if (str == "cat16") {
+        method = AdaptationMethod::Cat16;
     }
     else {
-        print_error("could not parse adaptation method: ", str);
-        return 1;
+        return false;
     }
-    return 0;
+    return true;
 }
 
-static void
-print_help(ArgParse& ap)
+static int
+set_adaptationmethod(int argc, const char* argv[])
 {
-    ap.print_help();
+    OIIO_DASSERT(argc == 2);
+    std::string str(argv[1]);
+    if (parse_adaptationmethod(str, tool.adaptationmethod)) {
+        tool.adaptation.clear();
+    } else {
+        tool.adaptation = str; // resolved with --adaptations
+    }
+    return 0;
 }
 
-// utils - colorspaces
-Eigen::Vector3d xy_to_xyz(const Eigen::Vector2d& xy)
+static int
+set_locus(int argc, const char* argv[])
 {
-    return Eigen::Vector3d(xy.x() / xy.y(), 1.0, (1.0 - xy.x() - xy.y()) / xy.y());
+    OIIO_DASSERT(argc == 2);
+    std::string str(argv[1]);
+    if (!parse_locus(str, tool.locus)) {
+        print_error("could not parse locus: ", str);
+        return 1;
+    }
+    return 0;
 }
 
-Eigen::Matrix3d rgb_to_xyz(const Eigen::Vector3d& r, const Eigen::Vector3d& g, const Eigen::Vector3d& b, const Eigen::Vector3d& whitepoint)
+static int
+set_format(int argc, const char* argv[])
 {
-    Eigen::Matrix3d m; // matrix from primaries
-    m.col(0) = r;
-    m.col(1) = g;
-    m.col(2) = b;
-    Eigen::Vector3d s = m.inverse() * whitepoint; // scaling factors S using whitepoint
-    Eigen::Matrix3d xyz;
-    xyz.col(0) = s(0) * m.col(0);
-    xyz.col(1) = s(1) * m.col(1);
-    xyz.col(2) = s(2) * m.col(2);
-    return xyz;
+    OIIO_DASSERT(argc == 2);
+    std::string str(argv[1]);
+    if (!parse_format(str, tool.format)) {
+        print_error("could not parse format: ", str);
+        return 1;
+    }
+    return 0;
 }
 
-Eigen::Matrix3d adaptation_matrix(AdaptationMethod method) {
-    Eigen::Matrix3d m;
-    if (method == XYZScaling) {
-        m <<  1.0, 0.0, 0.0,
-              0.0, 1.0, 0.0,
-              0.0, 0.0, 1.0;
+static int
+set_precision(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    std::string str(argv[1]);
+    if (!parse_precision(str, tool.precision)) {
+        print_error("could not parse precision: ", str);
+        return 1;
     }
-    else if (method == Bradford) {
-        m <<  0.8951,  0.2664, -0.1614,
-             -0.7502,  1.7135,  0.0367,
-              0.0389, -0.0685,  1.0296;
+    tool.precisionreport = true;
+    return 0;
+}
+
+static int
+set_whitebalance(int argc, const char* argv[])
+{
+    OIIO_DASSERT(argc == 2);
+    std::string str(argv[1]);
+    if (!parse_whitebalance(str, tool.awbmethod)) {
+        print_error("could not parse white balance method: ", str);
+        return 1;
     }
-    else if (method == Cat02) {
-        m <<  0.7328,  0.4296, -0.1624,
-             -0.7036,  1.6975,  0.0061,
-              0.0030,  0.0136,  0.9834;
+    tool.awb = true;
+    return 0;
+}
+
+static void
+print_help(ArgParse& ap)
+{
+    ap.print_help();
+}
+
+// utils - stats
+// wall time of the run per phase, the main thread is in one phase at a time and a
+// scope restores the enclosing phase when it ends
+enum Phase {
+    PhaseLoad,
+    PhaseCompute,
+    PhaseIO,
+    PhaseOutput,
+    PhaseCount
+};
+
+struct PhaseStats
+{
+    Timer timer;
+    Phase phase = PhaseLoad;
+    double seconds[PhaseCount] = { 0.0, 0.0, 0.0, 0.0 };
+    
+    // end current phase and begin next, returns the ended phase
+    Phase begin(Phase next)
+    {
+        Phase previous = phase;
+        seconds[previous] += timer.lap();
+        phase = next;
+        return previous;
     }
-    else if (method == VonKries) {
-        m <<  0.40024,  0.70760, -0.08081,
-             -0.22630,  1.16532,  0.04570,
-              0.00000,  0.00000,  0.91822;
+    
+    // pipelined stages overlap, time since the last phase change is replaced by the
+    // busy time of the stages
+    void overlap(double io, double compute)
+    {
+        timer.lap();
+        seconds[PhaseIO] += io;
+        seconds[PhaseCompute] += compute;
     }
-    return m;
-}
+};
+
+static PhaseStats phasestats;
 
-Eigen::Matrix3d adaptation_matrix(const Eigen::Vector3d& source, const Eigen::Vector3d& target, AdaptationMethod method) {
-    Eigen::Matrix3d m = adaptation_matrix(method);
-    Eigen::Vector3d sourcelms = m * source;
-    Eigen::Vector3d targetlms = m * target;
-    Eigen::Matrix3d scale = targetlms.cwiseQuotient(sourcelms).asDiagonal(); // compute scaling factors
-    Eigen::Matrix3d adaptationMatrix = m.inverse() * scale * m; // compute final adaptation
-    return adaptationMatrix;
+struct PhaseScope
+{
+    Phase previous;
+    PhaseScope(Phase phase) : previous(phasestats.begin(phase)) {}
+    ~PhaseScope() { phasestats.begin(previous); }
+};
+
+// print phases, on stderr when info is off so formats on stdout are kept
+static void
+print_stats()
+{
+    phasestats.begin(phasestats.phase);
+    const char* names[PhaseCount] = { "load", "compute", "io", "output" };
+    const double total = phasestats.timer();
+    std::ostream& stream = printinfo ? std::cout : std::cerr;
+    for (int i = 0; i < PhaseCount; ++i) {
+        stream << "stats: " << Strutil::sprintf("%-8s %10.3f ms %6.1f%%", names[i], 1e3 * phasestats.seconds[i], 100.0 * phasestats.seconds[i] / std::max(total, 1e-9)) << '\n';
+    }
+    stream << "stats: " << Strutil::sprintf("%-8s %10.3f ms", "total", 1e3 * total) << '\n';
 }
 
 // utils - filesystem
@@ -234,72 +397,1964 @@ std::string resources_path(const std::string& resource)
     return Filesystem::parent_path(Sysutil::this_program_path()) + "/resources/" + resource;
 }
 
-// colorspace
-struct Colorspace
+std::string cache_path(const std::string& filename)
+{
+    std::string path;
+#if defined(_WIN32)
+    if (const char* localappdata = getenv("LOCALAPPDATA")) {
+        path = std::string(localappdata) + "/colortool";
+    }
+#elif defined(__APPLE__)
+    if (const char* home = getenv("HOME")) {
+        path = std::string(home) + "/Library/Caches/colortool";
+    }
+#else
+    if (const char* cachehome = getenv("XDG_CACHE_HOME")) {
+        path = std::string(cachehome) + "/colortool";
+    } else if (const char* home = getenv("HOME")) {
+        path = std::string(home) + "/.cache/colortool";
+    }
+#endif
+    return path.size() ? path + "/" + filename : std::string();
+}
+
+// utils - images
+// pixel conversion, transforms with colortool kernels, a lut or an ocio processor.
+// transforms of a chain are applied one after another to a row while it is in cache,
+// so the image is converted in one pass
+struct AutoWhiteBalance;
+struct QualityCheck;
+
+// white map, a white per pixel in linear rgb of the input color space read as float,
+// pixels are adapted to the output whitepoint by their own white
+struct WhiteMap
 {
-    std::string name;
-    std::string description;
-    std::string trc;
-    Eigen::Vector2d r;
-    Eigen::Vector2d g;
-    Eigen::Vector2d b;
-    Eigen::Vector2d whitepoint;
+    PixelAdaptation adaptation;
+    ImageBuf whites;
+    
+    bool read(const std::string& filename)
+    {
+        whites.reset(filename);
+        if (!whites.read(0, 0, true, TypeDesc::FLOAT)) {
+            print_error("could not read white map: ", whites.geterror());
+            return false;
+        }
+        if (whites.spec().nchannels < 3) {
+            print_error("white map needs at least 3 channels: ", filename);
+            return false;
+        }
+        return true;
+    }
+    
+    int nchannels() const { return whites.spec().nchannels; }
+    
+    const float* row(int x, int y, int z) const
+    {
+        return static_cast<const float*>(whites.pixeladdr(x, y, z));
+    }
 };
 
-// illuminant
-struct Illuminant
+struct PixelConversion
 {
-    std::string name;
-    std::string description;
-    Eigen::Vector2d whitepoint;
+    std::vector<PixelTransform> transforms;
+    const Lut3D* lut = nullptr;
+    const OcioProcessor* ocio = nullptr;
+    AutoWhiteBalance* whitebalance = nullptr; // per frame transform, frames in order
+    QualityCheck* analysis = nullptr; // output compared with input, frames in order
+    const WhiteMap* whitemap = nullptr; // per pixel adaptation instead of transforms
+    
+    const char* name() const
+    {
+        return lut ? "lut" : ocio ? "ocio" : pixel_kernel()->name;
+    }
+    
+    // a row of pixels, half or float, with a row of the white map if set
+    template <typename T>
+    void apply(T* pixels, size_t count, int nchannels, const float* whites = nullptr) const
+    {
+        if (whites) {
+            adapt_pixels(pixels, whites, count, nchannels, whitemap->nchannels(), whitemap->adaptation);
+        } else if (lut) {
+            apply_lut(pixels, count, nchannels, *lut);
+        } else if (ocio) {
+            ocio->apply(pixels, count, nchannels);
+        } else {
+            for (const PixelTransform& transform : transforms) {
+                apply_transform(pixels, count, nchannels, transform);
+            }
+        }
+    }
+    
+    void apply(void* pixels, TypeDesc format, size_t count, int nchannels, const float* whites = nullptr) const
+    {
+        if (format == TypeDesc::HALF) {
+            apply(static_cast<half*>(pixels), count, nchannels, whites);
+        } else {
+            apply(static_cast<float*>(pixels), count, nchannels, whites);
+        }
+    }
 };
 
-// main
-int
-main( int argc, const char * argv[])
+// auto white balance, the transform of every frame adapts the estimated scene white
+// to the target whitepoint. estimates are smoothed in frame order and kept in a
+// sidecar so reruns skip the analysis.
+struct AutoWhiteBalance
 {
-    // Helpful for debugging to make sure that any crashes dump a stack
-    // trace.
-    Sysutil::setup_crash_stacktrace("stdout");
+    WhiteBalanceSettings settings;
+    WhiteBalanceSmoothing smoothing;
+    WhiteBalanceCache cache;
+    std::string sidecar;
+    PixelTransform transform;
+    double rgbxyz[9];
+    double xyzrgb[9];
+    double target[2];
+    const AdaptationTransform* adaptation = nullptr;
+    double degree = 1.0;
+    int estimated = 0;
+    int cached = 0;
+    double time = 0.0;
+    
+    // read sidecar, estimates are kept if computed for the same key
+    void open(const std::string& key)
+    {
+        WhiteBalanceCache previous;
+        std::string error;
+        if (read_whitebalance_cache(sidecar, previous, error) && previous.key == key) {
+            cache = previous;
+        }
+        cache.key = key;
+    }
+    
+    // transforms of frame from its pixels, before conversion
+    void frame(int frame, const void* pixels, TypeDesc format, int width, int height, int nchannels, int threads, PixelConversion& conversion)
+    {
+        auto entry = cache.whites.find(frame);
+        const double* white = nullptr;
+        if (entry != cache.whites.end()) {
+            white = entry->second.data();
+            cached++;
+        } else {
+            Timer timer;
+            std::array<double, 3> estimate;
+            bool valid = format == TypeDesc::HALF
+                ? estimate_white(static_cast<const half*>(pixels), width, height, nchannels, settings, estimate.data(), threads)
+                : estimate_white(static_cast<const float*>(pixels), width, height, nchannels, settings, estimate.data(), threads);
+            if (valid) {
+                white = cache.whites.emplace(frame, estimate).first->second.data();
+            }
+            estimated++;
+            time += timer();
+        }
+        PixelTransform balanced = transform;
+        double smoothed[3], matrix[9];
+        if (smoothing.add(white, smoothed)) {
+            whitebalance_matrix(smoothed, rgbxyz, xyzrgb, target, *adaptation, degree, matrix);
+            std::copy(matrix, matrix + 9, balanced.matrix);
+        }
+        conversion.transforms = { balanced };
+    }
+    
+    // write sidecar if frames were estimated
+    bool close()
+    {
+        print_info("auto white balance: ", whitebalance_name(settings.method));
+        print_info("  frames: ", Strutil::sprintf("%d estimated, %d from sidecar", estimated, cached));
+        print_info("  estimate time: ", time);
+        if (estimated) {
+            std::string error;
+            if (!write_whitebalance_cache(sidecar, cache, error)) {
+                print_error(error);
+                return false;
+            }
+            print_info("  sidecar: ", sidecar);
+        }
+        return true;
+    }
+};
 
-    Filesystem::convert_native_arguments(argc, (const char**)argv);
-    ArgParse ap;
+// quality check, test pixels compared with reference pixels in cielab and ictcp with
+// gamut and histograms of both. for conversions the reference is the input and the test
+// the converted output, statistics of all frames are accumulated.
+struct QualityCheck
+{
+    AnalysisSettings settings;
+    AnalysisStats stats;
+    std::string reference;
+    std::string test;
+    std::string gamut;
+    int frames = 0;
+    double time = 0.0;
+    
+    void frame(const void* referencepixels, const void* testpixels, TypeDesc format, int width, int height, int nchannels, int threads)
+    {
+        Timer timer;
+        if (format == TypeDesc::HALF) {
+            analyze_images(static_cast<const half*>(referencepixels), static_cast<const half*>(testpixels), width, height, nchannels, settings, stats, threads);
+        } else {
+            analyze_images(static_cast<const float*>(referencepixels), static_cast<const float*>(testpixels), width, height, nchannels, settings, stats, threads);
+        }
+        frames++;
+        time += timer();
+    }
+    
+    void close() const
+    {
+        print_info("analysis: ", test);
+        print_info("  reference: ", reference);
+        print_info("  frames: ", frames);
+        print_info("  pixels: ", stats.pixels);
+        print_info("  delta e 2000: ", Strutil::sprintf("mean %.4f, p50 %.2f, p95 %.2f, p99 %.2f, max %.4f", stats.deltae_mean(),
+                   stats.deltae_percentile(0.5), stats.deltae_percentile(0.95), stats.deltae_percentile(0.99), stats.deltaemax));
+        print_info("  delta e itp: ", Strutil::sprintf("mean %.4f, max %.4f at %g cd/m2", stats.deltaitp_mean(), stats.deltaitpmax, settings.luminance));
+        print_info("  above threshold: ", Strutil::sprintf("%.3f%% above %g", 100.0 * stats.visible_fraction(), settings.threshold));
+        print_info("  out of gamut: ", Strutil::sprintf("%s, reference %.3f%%, test %.3f%%", gamut, 100.0 * stats.outofgamut_fraction(0), 100.0 * stats.outofgamut_fraction(1)));
+        if (stats.bins > 0) {
+            print_info("  histograms: ", Strutil::sprintf("%d bins in %g-%g, below and above counted at the ends", stats.bins, settings.low, settings.high));
+            for (int n = 0; n < 2; ++n) {
+                for (int c = 0; c < 3; ++c) {
+                    const uint64_t* counts = stats.histograms[n].data() + c * (stats.bins + 2);
+                    std::string line;
+                    for (int i = 0; i < stats.bins + 2; ++i) {
+                        line += (i ? " " : "") + std::to_string(counts[i]);
+                    }
+                    print_info(Strutil::sprintf("    %s %c: ", n ? "test" : "reference", "rgb"[c]), line);
+                }
+            }
+        }
+        print_info("  analysis time: ", time);
+    }
+    
+    // entries of the statistics, histograms are channels x bins + 2 counts
+    void format(FormatDocument& document) const
+    {
+        const double deltae[5] = { stats.deltae_mean(), stats.deltae_percentile(0.5), stats.deltae_percentile(0.95), stats.deltae_percentile(0.99), stats.deltaemax };
+        const double deltaitp[2] = { stats.deltaitp_mean(), stats.deltaitpmax };
+        const double visible = stats.visible_fraction();
+        const double outofgamut[2] = { stats.outofgamut_fraction(0), stats.outofgamut_fraction(1) };
+        document.add_vector("analysis_deltae2000", deltae, 5);
+        document.add_vector("analysis_deltaitp", deltaitp, 2);
+        document.add_vector("analysis_visible", &visible, 1);
+        document.add_vector("analysis_outofgamut", outofgamut, 2);
+        if (stats.bins > 0) {
+            for (int n = 0; n < 2; ++n) {
+                std::vector<double> counts(stats.histograms[n].begin(), stats.histograms[n].end());
+                document.add(n ? "analysis_histogram_test" : "analysis_histogram_reference", 3, stats.bins + 2, counts.data());
+            }
+        }
+    }
+};
 
-    ap.intro("colortool -- a utility set for color space conversions, with support for white point adaptation\n");
-    ap.usage("colortool [options] filename...")
-      .add_help(false)
-      .exit_on_error(true);
+// default sidecar next to input, frame pattern and extension removed
+std::string whitebalance_sidecar(const std::string& input)
+{
+    std::string path = input;
+    size_t percent = path.find('%');
+    if (percent != std::string::npos) {
+        path.erase(percent, path.find('d', percent) - percent + 1);
+    }
+    path = Filesystem::replace_extension(path, "");
+    while (path.size() && (path.back() == '.' || path.back() == '_')) {
+        path.pop_back();
+    }
+    return path + ".awb.json";
+}
+
+bool convert_image(const std::string& inputfilename, const std::string& outputfilename, const std::string& outputcolorspace, const PixelConversion& conversion, int threads)
+{
+    Timer timer;
+    PhaseScope scope(PhaseIO);
+    ImageBuf imagebuf(inputfilename);
+    if (!imagebuf.init_spec(inputfilename, 0, 0)) {
+        print_error("could not open input image: ", imagebuf.geterror());
+        return false;
+    }
+    // half is transformed in place, other formats through a float working copy
+    TypeDesc format = imagebuf.nativespec().format == TypeDesc::HALF ? TypeDesc::HALF : TypeDesc::FLOAT;
+    if (!imagebuf.read(0, 0, true, format)) {
+        print_error("could not read input image: ", imagebuf.geterror());
+        return false;
+    }
+    const ImageSpec& spec = imagebuf.spec();
+    if (spec.nchannels < 3) {
+        print_error("input image needs at least 3 channels: ", inputfilename);
+        return false;
+    }
+    print_info("input image: ", inputfilename);
+    print_info("  resolution: ", Strutil::sprintf("%dx%d, %d channels, %s", spec.width, spec.height, spec.nchannels, imagebuf.nativespec().format.c_str()));
+    print_info("  kernel: ", conversion.name());
+    print_info("  read time: ", timer.lap());
+    if (conversion.whitemap) {
+        const ImageSpec& whitespec = conversion.whitemap->whites.spec();
+        if (whitespec.width != spec.width || whitespec.height != spec.height || whitespec.depth != spec.depth) {
+            print_error("white map must have the resolution of input image: ", Strutil::sprintf("%dx%d", whitespec.width, whitespec.height));
+            return false;
+        }
+    }
     
-    ap.separator("General flags:");
-    ap.arg("--help", &tool.help)
-      .help("Print help message");
+    PixelConversion imageconversion = conversion;
+    if (conversion.whitebalance) {
+        conversion.whitebalance->frame(0, imagebuf.localpixels(), format, spec.width, spec.height * std::max(spec.depth, 1), spec.nchannels, threads, imageconversion);
+    }
+    std::vector<char> before;
+    if (conversion.analysis) { // input kept for the comparison
+        const char* pixels = static_cast<const char*>(imagebuf.localpixels());
+        before.assign(pixels, pixels + spec.image_bytes());
+    }
     
-    ap.arg("-v", &tool.verbose)
-      .help("Verbose status messages");
+    // transform, rgb channels only and alpha is left as is
+    phasestats.begin(PhaseCompute);
+    ImageBufAlgo::parallel_image(imagebuf.roi(), paropt(threads), [&](ROI roi) {
+        for (int z = roi.zbegin; z < roi.zend; ++z) {
+            for (int y = roi.ybegin; y < roi.yend; ++y) {
+                const float* whites = conversion.whitemap ? conversion.whitemap->row(roi.xbegin, y, z) : nullptr;
+                imageconversion.apply(imagebuf.pixeladdr(roi.xbegin, y, z), format, roi.width(), spec.nchannels, whites);
+            }
+        }
+    });
+    print_info("  transform time: ", timer.lap());
+    if (conversion.analysis) {
+        conversion.analysis->frame(before.data(), imagebuf.localpixels(), format, spec.width, spec.height * std::max(spec.depth, 1), spec.nchannels, threads);
+    }
+    phasestats.begin(PhaseIO);
     
-    ap.arg("--colorspaces", &tool.colorspaces)
-      .help("List all colorspaces");
+    if (outputcolorspace.size()) {
+        imagebuf.specmod().attribute("oiio:ColorSpace", outputcolorspace);
+    }
+    imagebuf.set_write_format(imagebuf.nativespec().format); // keep file data format, e.g half
+    if (!imagebuf.write(outputfilename)) {
+        print_error("could not write output image: ", imagebuf.geterror());
+        return false;
+    }
+    print_info("output image: ", outputfilename);
+    print_info("  write time: ", timer.lap());
+    return true;
+}
+
+// utils - sequences
+bool parse_frames(const std::string& range, int& first, int& last)
+{
+    char end;
+    int count = std::sscanf(range.c_str(), "%d-%d%c", &first, &last, &end);
+    if (count == 1) {
+        last = first;
+    }
+    return (count == 1 || count == 2) && first <= last;
+}
+
+// frame in a recycled buffer, data grows to the largest frame and is kept
+struct FrameBuffer
+{
+    ImageSpec spec;
+    TypeDesc format;
+    std::vector<char> data;
+    std::vector<char> before; // input of analyzed frames
+};
+
+bool convert_sequence(const std::string& inputpattern, const std::string& outputpattern, int first, int last, const std::string& outputcolorspace, const PixelConversion& conversion, int threads, int buffers)
+{
+    std::vector<FrameBuffer> pool(std::max(buffers, 1));
+    print_info("input sequence: ", inputpattern);
+    print_info("  frames: ", Strutil::sprintf("%d-%d, %d buffers", first, last, int(pool.size())));
+    print_info("  kernel: ", conversion.name());
     
-    ap.arg("--illuminants", &tool.illuminants)
-      .help("List all illuminants");
+    // read, half is kept as half and other formats are read as float
+    auto read = [&](size_t frame, size_t buffer) {
+        std::string filename = Strutil::sprintf(inputpattern.c_str(), first + int(frame));
+        auto input = ImageInput::open(filename);
+        if (!input) {
+            print_error("could not open input image: ", OIIO::geterror());
+            return false;
+        }
+        FrameBuffer& framebuffer = pool[buffer];
+        framebuffer.spec = input->spec();
+        if (framebuffer.spec.nchannels < 3) {
+            print_error("input image needs at least 3 channels: ", filename);
+            return false;
+        }
+        framebuffer.format = framebuffer.spec.format == TypeDesc::HALF ? TypeDesc::HALF : TypeDesc::FLOAT;
+        size_t bytes = framebuffer.spec.image_pixels() * framebuffer.spec.nchannels * framebuffer.format.size();
+        if (framebuffer.data.size() < bytes) {
+            framebuffer.data.resize(bytes);
+        }
+        if (!input->read_image(0, 0, 0, framebuffer.spec.nchannels, framebuffer.format, framebuffer.data.data())) {
+            print_error("could not read input image: ", input->geterror());
+            return false;
+        }
+        return true;
+    };
+    
+    // transform, rgb channels only and alpha is left as is
+    auto compute = [&](size_t frame, size_t buffer) {
+        FrameBuffer& framebuffer = pool[buffer];
+        const ImageSpec& spec = framebuffer.spec;
+        size_t rowbytes = size_t(spec.width) * spec.nchannels * framebuffer.format.size();
+        PixelConversion frameconversion = conversion;
+        if (conversion.whitebalance) { // frames are computed in order
+            conversion.whitebalance->frame(first + int(frame), framebuffer.data.data(), framebuffer.format, spec.width, spec.height * std::max(spec.depth, 1), spec.nchannels, threads, frameconversion);
+        }
+        if (conversion.analysis) {
+            framebuffer.before.assign(framebuffer.data.begin(), framebuffer.data.begin() + spec.image_pixels() * spec.nchannels * framebuffer.format.size());
+        }
+        ImageBufAlgo::parallel_image(ROI(0, spec.width, 0, spec.height, 0, std::max(spec.depth, 1)), paropt(threads), [&](ROI roi) {
+            for (int z = roi.zbegin; z < roi.zend; ++z) {
+                for (int y = roi.ybegin; y < roi.yend; ++y) {
+                    void* pixels = framebuffer.data.data() + (size_t(z) * spec.height + y) * rowbytes;
+                    frameconversion.apply(pixels, framebuffer.format, spec.width, spec.nchannels);
+                }
+            }
+        });
+        if (conversion.analysis) { // frames are computed in order
+            conversion.analysis->frame(framebuffer.before.data(), framebuffer.data.data(), framebuffer.format, spec.width, spec.height * std::max(spec.depth, 1), spec.nchannels, threads);
+        }
+        return true;
+    };
+    
+    // write, in the data format of the input image
+    auto write = [&](size_t frame, size_t buffer) {
+        std::string filename = Strutil::sprintf(outputpattern.c_str(), first + int(frame));
+        FrameBuffer& framebuffer = pool[buffer];
+        ImageSpec spec = framebuffer.spec;
+        if (outputcolorspace.size()) {
+            spec.attribute("oiio:ColorSpace", outputcolorspace);
+        }
+        auto output = ImageOutput::create(filename);
+        if (!output || !output->open(filename, spec)) {
+            print_error("could not open output image: ", output ? output->geterror() : OIIO::geterror());
+            return false;
+        }
+        if (!output->write_image(framebuffer.format, framebuffer.data.data()) || !output->close()) {
+            print_error("could not write output image: ", output->geterror());
+            return false;
+        }
+        return true;
+    };
+    
+    PipelineStats stats;
+    bool valid = Pipeline::run(size_t(last - first + 1), pool.size(), read, compute, write, stats);
+    phasestats.overlap(stats.read + stats.write, stats.compute);
+    double elapsed = std::max(stats.elapsed, 1e-9);
+    print_info("output sequence: ", outputpattern);
+    print_info("  frames written: ", stats.frames);
+    print_info("  time: ", Strutil::sprintf("%.3fs, %.2f fps", stats.elapsed, stats.frames / elapsed));
+    print_info("  read utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.read / elapsed));
+    print_info("  compute utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.compute / elapsed));
+    print_info("  write utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.write / elapsed));
+    return valid;
+}
+
+// utils - bands
+// image converted in bands of rows by the sequence stages, the next bands are read
+// while the current one is computed and only the recycled band buffers are resident,
+// so memory is bounded by the limit whatever the image size. bands of tiled images
+// are whole rows of tiles.
+bool convert_banded(const std::string& inputfilename, const std::string& outputfilename, const std::string& outputcolorspace, const PixelConversion& conversion, int threads, int buffers, size_t memorylimit)
+{
+    auto input = ImageInput::open(inputfilename);
+    if (!input) {
+        print_error("could not open input image: ", OIIO::geterror());
+        return false;
+    }
+    const ImageSpec spec = input->spec();
+    if (spec.nchannels < 3 || spec.depth > 1) {
+        print_error("input image needs at least 3 channels and no depth for banded conversion: ", inputfilename);
+        return false;
+    }
+    
+    // rows per band from the limit, at least one row or row of tiles
+    const TypeDesc format = spec.format == TypeDesc::HALF ? TypeDesc::HALF : TypeDesc::FLOAT;
+    const size_t rowbytes = size_t(spec.width) * spec.nchannels * format.size();
+    const int align = spec.tile_width > 0 ? std::max(spec.tile_height, 1) : 1;
+    const size_t count = size_t(std::max(buffers, 1));
+    const int height = (spec.height + align - 1) / align * align;
+    const int rows = std::min(std::max(int(std::min<size_t>(memorylimit / count / (rowbytes * align), size_t(height))), 1) * align, height);
+    const size_t bands = size_t((spec.height + rows - 1) / rows);
+    const size_t bandbytes = size_t(rows) * rowbytes;
+    if (bandbytes * count > memorylimit) {
+        print_warning("memory limit is below one band per buffer, band: ", Strutil::sprintf("%d rows, %.1f MB", rows, bandbytes / 1048576.0));
+    }
+    print_info("input image: ", inputfilename);
+    print_info("  resolution: ", Strutil::sprintf("%dx%d, %d channels, %s%s", spec.width, spec.height, spec.nchannels, spec.format.c_str(), spec.tile_width > 0 ? ", tiled" : ""));
+    print_info("  kernel: ", conversion.name());
+    print_info("  bands: ", Strutil::sprintf("%d of %d rows, %d buffers, %.1f MB", int(bands), rows, int(count), bandbytes * count / 1048576.0));
+    
+    // output in the data format of the input image, tiled if both support tiles
+    ImageSpec outputspec = spec;
+    if (outputcolorspace.size()) {
+        outputspec.attribute("oiio:ColorSpace", outputcolorspace);
+    }
+    auto output = ImageOutput::create(outputfilename);
+    const bool tiled = spec.tile_width > 0 && output && output->supports("tiles");
+    if (!tiled) {
+        outputspec.tile_width = outputspec.tile_height = outputspec.tile_depth = 0;
+    }
+    if (!output || !output->open(outputfilename, outputspec)) {
+        print_error("could not open output image: ", output ? output->geterror() : OIIO::geterror());
+        return false;
+    }
+    
+    std::vector<std::vector<char>> pool(count, std::vector<char>(bandbytes));
+    auto band = [&](size_t index, int& ybegin, int& yend) {
+        ybegin = spec.y + int(index) * rows;
+        yend = std::min(ybegin + rows, spec.y + spec.height);
+    };
+    auto read = [&](size_t index, size_t buffer) {
+        int ybegin, yend;
+        band(index, ybegin, yend);
+        bool valid = spec.tile_width > 0
+            ? input->read_tiles(0, 0, spec.x, spec.x + spec.width, ybegin, yend, spec.z, spec.z + 1, 0, spec.nchannels, format, pool[buffer].data())
+            : input->read_scanlines(0, 0, ybegin, yend, spec.z, 0, spec.nchannels, format, pool[buffer].data());
+        if (!valid) {
+            print_error("could not read input image: ", input->geterror());
+        }
+        return valid;
+    };
+    
+    // transform, rgb channels only and alpha is left as is
+    auto compute = [&](size_t index, size_t buffer) {
+        int ybegin, yend;
+        band(index, ybegin, yend);
+        ImageBufAlgo::parallel_image(ROI(0, spec.width, 0, yend - ybegin), paropt(threads), [&](ROI roi) {
+            for (int y = roi.ybegin; y < roi.yend; ++y) {
+                conversion.apply(pool[buffer].data() + size_t(y) * rowbytes, format, spec.width, spec.nchannels);
+            }
+        });
+        return true;
+    };
+    
+    auto write = [&](size_t index, size_t buffer) {
+        int ybegin, yend;
+        band(index, ybegin, yend);
+        bool valid = tiled
+            ? output->write_tiles(spec.x, spec.x + spec.width, ybegin, yend, spec.z, spec.z + 1, format, pool[buffer].data())
+            : output->write_scanlines(ybegin, yend, spec.z, format, pool[buffer].data());
+        if (!valid) {
+            print_error("could not write output image: ", output->geterror());
+        }
+        return valid;
+    };
+    
+    PipelineStats stats;
+    bool valid = Pipeline::run(bands, count, read, compute, write, stats);
+    phasestats.overlap(stats.read + stats.write, stats.compute);
+    if (!output->close()) {
+        print_error("could not write output image: ", output->geterror());
+        valid = false;
+    }
+    double elapsed = std::max(stats.elapsed, 1e-9);
+    print_info("output image: ", outputfilename);
+    print_info("  time: ", Strutil::sprintf("%.3fs, %.1f Mpixels/s", stats.elapsed, double(spec.image_pixels()) / elapsed / 1e6));
+    print_info("  read utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.read / elapsed));
+    print_info("  compute utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.compute / elapsed));
+    print_info("  write utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.write / elapsed));
+    return valid;
+}
+
+// convert input image or sequence of tool, with an ocio processor for the transform
+// if set. with a memory limit images and frames are converted one after another in
+// bands.
+bool convert_input(const PixelConversion& conversion, const std::string& outputcolorspace)
+{
+    attribute("threads", tool.threads);
+    PixelConversion converter = conversion;
+    OcioProcessor processor;
+    if (tool.ocio) { // one processor shared by all threads and frames
+        if (converter.transforms.size() != 1) {
+            print_error("ocio needs a single transform, chain is fused into: ", converter.transforms.size());
+            return false;
+        }
+        if (!processor.create(converter.transforms.front())) {
+            print_error(processor.geterror());
+            return false;
+        }
+        converter.ocio = &processor;
+    }
+    bool converted = true;
+    if (tool.memorylimit > 0) {
+        const size_t memorylimit = size_t(tool.memorylimit) << 20;
+        int first = 0, last = 0;
+        if (tool.frames.size()) {
+            parse_frames(tool.frames, first, last);
+        }
+        for (int frame = first; frame <= last && converted; ++frame) {
+            std::string inputfilename = tool.frames.size() ? Strutil::sprintf(tool.inputfilename.c_str(), frame) : tool.inputfilename;
+            std::string outputfilename = tool.frames.size() ? Strutil::sprintf(tool.outputfilename.c_str(), frame) : tool.outputfilename;
+            converted = convert_banded(inputfilename, outputfilename, outputcolorspace, converter, tool.threads, tool.buffers, memorylimit);
+        }
+    } else if (tool.frames.size()) {
+        int first, last;
+        parse_frames(tool.frames, first, last);
+        converted = convert_sequence(tool.inputfilename, tool.outputfilename, first, last, outputcolorspace, converter, tool.threads, tool.buffers);
+    } else {
+        converted = convert_image(tool.inputfilename, tool.outputfilename, outputcolorspace, converter, tool.threads);
+    }
+    if (converted && converter.whitebalance) {
+        converted = converter.whitebalance->close();
+    }
+    if (converted && converter.analysis) {
+        converter.analysis->close();
+    }
+    return converted;
+}
+
+// utils - luts
+// bake transform into lut file of tool
+bool bake_lutfile(const PixelTransform& transform, const std::string& title)
+{
+    Timer timer;
+    PhaseScope scope(PhaseCompute);
+    Lut3D lut;
+    std::string error;
+    bake_lut(transform, tool.lutsize, lut, tool.threads);
+    phasestats.begin(PhaseIO);
+    if (!write_lut(tool.lutfile, lut, title, error)) {
+        print_error(error);
+        return false;
+    }
+    print_info("lut: ", tool.lutfile);
+    print_info("  size: ", lut.size);
+    print_info("  bake time: ", timer.lap());
+    return true;
+}
+
+// utils - cache
+typedef Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> CacheMatrix;
+
+const size_t cache_methods = Cat16 - XYZScaling + 1;
+
+// method index in cache
+size_t cache_method(AdaptationMethod method)
+{
+    return method - XYZScaling;
+}
+
+// methods in cache order
+std::vector<AdaptationMethod> cache_adaptationmethods()
+{
+    std::vector<AdaptationMethod> methods;
+    for (size_t method = 0; method < cache_methods; ++method) {
+        methods.push_back(AdaptationMethod(XYZScaling + method));
+    }
+    return methods;
+}
+
+// utils - adaptation
+// adaptation of the run, builtin methods are read from cache. custom transforms, partial
+// degrees and white maps are computed from the transform and degree instead.
+struct RunAdaptation
+{
+    AdaptationTransforms transforms; // builtin and custom, query methods resolve here
+    const AdaptationTransform* transform = nullptr; // of --adaptationmethod
+    double degree = 1.0;
+    bool custom = false;
+    std::string name; // as printed, e.g Bradford
+    std::string suffix; // of matrix names, e.g bradford or sharp_d0.8
+};
+static RunAdaptation runadaptation;
+
+// true if matrices of tool can not be read from cache
+bool custom_adaptation()
+{
+    return tool.adaptation.size() || tool.adaptations.size() || tool.adaptationdegree != 1.0f || tool.adaptationluminance > 0.0f || tool.whitemap.size();
+}
+
+// suffix of matrix names, name with degree when partial
+std::string adaptation_suffix(const std::string& name, double degree)
+{
+    return degree < 1.0 ? name + Strutil::sprintf("_d%g", degree) : name;
+}
+
+// resolve adaptation of tool, custom transforms are read from --adaptations
+bool open_adaptation(bool quiet)
+{
+    RunAdaptation& adaptation = runadaptation;
+    adaptation.custom = custom_adaptation();
+    adaptation.degree = tool.adaptationluminance > 0.0f ? adaptation_degree(tool.adaptationluminance) : tool.adaptationdegree;
+    if (tool.adaptations.size()) {
+        PhaseScope scope(PhaseIO);
+        if (!adaptation.transforms.read(tool.adaptations)) {
+            print_error(adaptation.transforms.geterror());
+            return false;
+        }
+    }
+    adaptation.transform = adaptation.transforms.find(tool.adaptation.size() ? tool.adaptation : Strutil::lower(adaptationmethod_name(tool.adaptationmethod)));
+    if (!adaptation.transform) {
+        print_error("unknown adaptation method: ", tool.adaptation);
+        print_error("supported adaptation methods: ", Strutil::join(adaptation.transforms.names(), ", "));
+        return false;
+    }
+    adaptation.name = adaptation.custom ? adaptation.transform->name : std::string(adaptationmethod_name(tool.adaptationmethod));
+    adaptation.suffix = adaptation_suffix(adaptation.transform->name, adaptation.degree);
+    if (adaptation.custom && !quiet) {
+        print_info("adaptation: ", adaptation.name);
+        print_info("  description: ", adaptation.transform->description);
+        print_info("  degree: ", Strutil::sprintf("%g", adaptation.degree));
+        if (tool.verbose) {
+            print_value("  cone matrix: ", CacheMatrix(adaptation.transform->cone));
+            print_value("  inverse: ", CacheMatrix(adaptation.transform->inverse));
+        }
+    }
+    return true;
+}
+
+// adaptation between whitepoints of cached colorspaces, computed into values for custom
+// or partial adaptation
+const double* cache_adaptation(const TransformCache& cache, const CacheColorspace& source, const CacheColorspace& target, double* values)
+{
+    if (runadaptation.custom) {
+        adaptation_matrix(*runadaptation.transform, source.whitepointxyz, target.whitepointxyz, runadaptation.degree, values);
+        return values;
+    }
+    return cache.adaptation(source.whitepoint, target.whitepoint, cache_method(tool.adaptationmethod));
+}
+
+// hash of resources content, a changed json file invalidates the cache
+bool cache_hash(const std::vector<std::string>& jsonfiles, uint64_t& hash)
+{
+    hash = TransformCache::hash(&cache_methods, sizeof(cache_methods));
+    for (const std::string& jsonfile : jsonfiles) {
+        if (jsonfile.empty()) { // builtin tables
+            uint64_t builtin = builtin_hash();
+            hash = TransformCache::hash(&builtin, sizeof(builtin), hash);
+            continue;
+        }
+        std::string content;
+        if (!Filesystem::read_text_file(jsonfile, content)) {
+            print_error("could not read resources file: ", jsonfile);
+            return false;
+        }
+        hash = TransformCache::hash(content.data(), content.size(), hash);
+    }
+    return true;
+}
+
+// parse json files and compute all transforms
+bool build_cache(Registry& registry, uint64_t hash, std::vector<char>& data)
+{
+    if (!registry.load_colorspaces() || !registry.load_illuminants()) {
+        print_error(registry.geterror());
+        return false;
+    }
+    TransformCacheBuilder builder;
+    for (const RegistryColorspace& cs : registry.colorspaces()) {
+        Eigen::Vector3d whitepoint = xy_to_xyz(Eigen::Vector2d(cs.whitepoint));
+        Eigen::Vector3d r = xy_to_xyz(Eigen::Vector2d(cs.r));
+        Eigen::Vector3d g = xy_to_xyz(Eigen::Vector2d(cs.g));
+        Eigen::Vector3d b = xy_to_xyz(Eigen::Vector2d(cs.b));
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> rgbxyz = rgb_to_xyz(r, g, b, whitepoint);
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> xyzrgb = rgbxyz.inverse();
+        builder.add_colorspace(cs.name, cs.description, cs.trc, cs.r, cs.g, cs.b,
+                               cs.whitepoint, whitepoint.data(), rgbxyz.data(), xyzrgb.data());
+    }
+    for (const RegistryIlluminant& im : registry.illuminants()) {
+        Eigen::Vector3d whitepoint = xy_to_xyz(Eigen::Vector2d(im.whitepoint));
+        builder.add_illuminant(im.name, im.description, im.whitepoint, whitepoint.data());
+    }
+    data = builder.build(hash, cache_methods, [](const double* source, const double* target, size_t method, double* matrix) {
+        Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> adaptation(matrix);
+        adaptation = adaptation_matrix(Eigen::Vector3d(source), Eigen::Vector3d(target), AdaptationMethod(XYZScaling + method));
+    });
+    return true;
+}
+
+// open cache file, rebuilt and written when missing or out of date
+bool open_cache(const std::string& cachefile, Registry& registry, TransformCache& cache)
+{
+    uint64_t hash;
+    if (!cache_hash({ registry.colorspacesfile(), registry.illuminantsfile() }, hash)) {
+        return false;
+    }
+    if (cachefile.size() && cache.open(cachefile, hash)) {
+        return true;
+    }
+    std::vector<char> data;
+    if (!build_cache(registry, hash, data)) {
+        return false;
+    }
+    if (cachefile.size()) {
+        std::string err;
+        if (!Filesystem::create_directories(Filesystem::parent_path(cachefile), err)
+            || !TransformCacheBuilder::write(cachefile, data)) {
+            print_warning("could not write cache file: ", cachefile);
+        }
+    }
+    return cache.open(std::move(data), hash);
+}
+
+Colorspace cache_colorspace(const TransformCache& cache, size_t index)
+{
+    const CacheColorspace& record = cache.colorspace(index);
+    Colorspace cs;
+    cs.name = cache.string(record.name);
+    cs.description = cache.string(record.description);
+    cs.trc = cache.string(record.trc);
+    cs.r = Eigen::Vector2d(record.r);
+    cs.g = Eigen::Vector2d(record.g);
+    cs.b = Eigen::Vector2d(record.b);
+    cs.whitepoint = Eigen::Vector2d(record.whitepointxy);
+    return cs;
+}
+
+Illuminant cache_illuminant(const TransformCache& cache, size_t index)
+{
+    const CacheIlluminant& record = cache.illuminant(index);
+    Illuminant im;
+    im.name = cache.string(record.name);
+    im.description = cache.string(record.description);
+    im.whitepoint = Eigen::Vector2d(record.whitepointxy);
+    return im;
+}
+
+// utils - analysis
+// quality check of tool between the input colorspace at inputindex and the colorspace
+// of the test pixels at testindex, test xyz is adapted to the input white. the gamut
+// target is the named colorspace or the test colorspace.
+bool analysis_settings(const TransformCache& cache, int inputindex, int testindex, const Transfer& decode, const Transfer& testdecode, QualityCheck& analysis)
+{
+    int gamutindex = tool.gamuttarget.size() ? cache.find_colorspace(tool.gamuttarget) : testindex;
+    if (gamutindex < 0) {
+        print_error("unknown gamut target colorspace: ", tool.gamuttarget);
+        return false;
+    }
+    const CacheColorspace& input = cache.colorspace(inputindex);
+    const CacheColorspace& test = cache.colorspace(testindex);
+    const CacheColorspace& gamut = cache.colorspace(gamutindex);
+    AnalysisSettings& settings = analysis.settings;
+    settings.reference.decode = decode;
+    settings.test.decode = testdecode;
+    std::copy(input.rgbxyz, input.rgbxyz + 9, settings.reference.rgbxyz);
+    Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> testxyz(settings.test.rgbxyz);
+    Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> xyzgamut(settings.xyzgamut);
+    double testadaptation[9], gamutadaptation[9];
+    testxyz = CacheMatrix(cache_adaptation(cache, test, input, testadaptation)) * CacheMatrix(test.rgbxyz);
+    xyzgamut = CacheMatrix(gamut.xyzrgb) * CacheMatrix(cache_adaptation(cache, input, gamut, gamutadaptation));
+    std::copy(input.whitepointxyz, input.whitepointxyz + 3, settings.white);
+    settings.luminance = tool.analysisnits;
+    settings.threshold = tool.deltaethreshold;
+    settings.gamut = true;
+    settings.bins = tool.histogrambins;
+    analysis.gamut = cache.string(gamut.name);
+    return true;
+}
+
+// compare input image or sequence of tool with the compare image or sequence, pairs
+// are read while the previous pair is analyzed
+bool compare_input(QualityCheck& analysis)
+{
+    int first = 0, last = 0;
+    if (tool.frames.size()) {
+        parse_frames(tool.frames, first, last);
+    }
+    struct ComparePair
+    {
+        FrameBuffer images[2];
+    };
+    std::vector<ComparePair> pool(std::max(tool.buffers, 1));
+    const std::string patterns[2] = { tool.inputfilename, tool.compare };
+    
+    // read, half if both images are half and float otherwise
+    auto read = [&](size_t frame, size_t buffer) {
+        std::unique_ptr<ImageInput> inputs[2];
+        for (int n = 0; n < 2; ++n) {
+            std::string filename = tool.frames.size() ? Strutil::sprintf(patterns[n].c_str(), first + int(frame)) : patterns[n];
+            inputs[n] = ImageInput::open(filename);
+            if (!inputs[n]) {
+                print_error("could not open input image: ", OIIO::geterror());
+                return false;
+            }
+        }
+        const ImageSpec& spec = inputs[0]->spec();
+        const ImageSpec& comparespec = inputs[1]->spec();
+        if (spec.nchannels < 3 || spec.width != comparespec.width || spec.height != comparespec.height || spec.depth != comparespec.depth || spec.nchannels != comparespec.nchannels) {
+            print_error("compared images need the same resolution and at least 3 channels, frame: ", first + int(frame));
+            return false;
+        }
+        const TypeDesc format = spec.format == TypeDesc::HALF && comparespec.format == TypeDesc::HALF ? TypeDesc::HALF : TypeDesc::FLOAT;
+        for (int n = 0; n < 2; ++n) {
+            FrameBuffer& framebuffer = pool[buffer].images[n];
+            framebuffer.spec = inputs[n]->spec();
+            framebuffer.format = format;
+            size_t bytes = framebuffer.spec.image_pixels() * framebuffer.spec.nchannels * format.size();
+            if (framebuffer.data.size() < bytes) {
+                framebuffer.data.resize(bytes);
+            }
+            if (!inputs[n]->read_image(0, 0, 0, framebuffer.spec.nchannels, format, framebuffer.data.data())) {
+                print_error("could not read input image: ", inputs[n]->geterror());
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    auto compute = [&](size_t, size_t buffer) {
+        const FrameBuffer& reference = pool[buffer].images[0];
+        const FrameBuffer& test = pool[buffer].images[1];
+        const ImageSpec& spec = reference.spec;
+        analysis.frame(reference.data.data(), test.data.data(), reference.format, spec.width, spec.height * std::max(spec.depth, 1), spec.nchannels, tool.threads);
+        return true;
+    };
+    
+    auto write = [&](size_t, size_t) {
+        return true;
+    };
+    
+    PipelineStats stats;
+    bool valid = Pipeline::run(size_t(last - first + 1), pool.size(), read, compute, write, stats);
+    phasestats.overlap(stats.read, stats.compute);
+    if (valid) {
+        double elapsed = std::max(stats.elapsed, 1e-9);
+        analysis.close();
+        print_info("  time: ", Strutil::sprintf("%.3fs, %.2f fps", stats.elapsed, stats.frames / elapsed));
+        print_info("  read utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.read / elapsed));
+        print_info("  compute utilization: ", Strutil::sprintf("%.1f%%", 100.0 * stats.compute / elapsed));
+    }
+    return valid;
+}
+
+// utils - batch
+std::string json_string(const std::string& str)
+{
+    std::string json = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+            json += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            json += Strutil::sprintf("\\u%04x", int(c));
+        } else {
+            json += c;
+        }
+    }
+    return json + "\"";
+}
+
+// query as 'input output [method]' or {"input": .., "output": .., "method": ..}
+bool parse_batch_query(const std::string& line, std::string& input, std::string& output, std::string& method, std::string& error)
+{
+    string_view str = Strutil::strip(line);
+    if (str.size() && str[0] == '{') {
+        JsonReader reader(str.data(), str.size());
+        bool valid = reader.read_object([&](const std::string& key) {
+            std::string* value = key == "input" ? &input : key == "output" ? &output : key == "method" ? &method : nullptr;
+            return value ? reader.read_scalar(*value) : reader.skip_value();
+        });
+        if (!valid) {
+            error = "could not parse query: " + reader.error;
+            return false;
+        }
+    } else {
+        std::vector<std::string> values = Strutil::splits(str);
+        if (values.size() < 2 || values.size() > 3) {
+            error = "expected input, output and optional method";
+            return false;
+        }
+        input = values[0];
+        output = values[1];
+        method = values.size() > 2 ? values[2] : std::string();
+    }
+    if (input.empty() || output.empty()) {
+        error = "input and output must be set";
+        return false;
+    }
+    return true;
+}
+
+// adaptation method of a query, transform is set for custom or partial adaptation and
+// matrices are computed from it instead of read from cache
+struct QueryMethod
+{
+    AdaptationMethod method = Cat02;
+    const AdaptationTransform* transform = nullptr;
+    std::string name; // as in results
+};
+
+// method of a query by name, the adaptation of tool if empty
+bool parse_query_method(const std::string& methodname, QueryMethod& method, std::string& error)
+{
+    if (runadaptation.custom) {
+        method.transform = methodname.empty() ? runadaptation.transform : runadaptation.transforms.find(methodname);
+        if (!method.transform) {
+            method.transform = runadaptation.transforms.find(Strutil::lower(methodname));
+        }
+        if (!method.transform) {
+            error = "unknown adaptation method: " + methodname;
+            return false;
+        }
+        method.name = method.transform->name;
+        return true;
+    }
+    method.method = tool.adaptationmethod;
+    if (methodname.size() && !parse_adaptationmethod(Strutil::lower(methodname), method.method)) {
+        error = "unknown adaptation method: " + methodname;
+        return false;
+    }
+    method.name = Strutil::lower(adaptationmethod_name(method.method));
+    return true;
+}
+
+// matrix of a query, colorspace pairs give the transform and illuminant pairs the
+// whitepoint adaptation, computed into values for a transform. nullptr and error if
+// input or output is unknown
+const double* batch_matrix(const TransformCache& cache, const std::string& input, const std::string& output, const QueryMethod& method, double* values, std::string& type, std::string& error)
+{
+    int inputindex = cache.find_colorspace(input);
+    int outputindex = cache.find_colorspace(output);
+    if (inputindex >= 0 && outputindex >= 0) {
+        type = "colorspace";
+        if (method.transform) {
+            const CacheColorspace& inputcolorspace = cache.colorspace(inputindex);
+            const CacheColorspace& outputcolorspace = cache.colorspace(outputindex);
+            double adaptation[9];
+            adaptation_matrix(*method.transform, inputcolorspace.whitepointxyz, outputcolorspace.whitepointxyz, runadaptation.degree, adaptation);
+            Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> matrix(values);
+            matrix = CacheMatrix(outputcolorspace.xyzrgb) * CacheMatrix(adaptation) * CacheMatrix(inputcolorspace.rgbxyz);
+            return values;
+        }
+        return cache.transform(inputindex, outputindex, cache_method(method.method));
+    }
+    int inputilluminant = cache.find_illuminant(input);
+    int outputilluminant = cache.find_illuminant(output);
+    if (inputilluminant >= 0 && outputilluminant >= 0) {
+        type = "illuminant";
+        const CacheIlluminant& inputwhite = cache.illuminant(inputilluminant);
+        const CacheIlluminant& outputwhite = cache.illuminant(outputilluminant);
+        if (method.transform) {
+            adaptation_matrix(*method.transform, inputwhite.whitepointxyz, outputwhite.whitepointxyz, runadaptation.degree, values);
+            return values;
+        }
+        return cache.adaptation(inputwhite.whitepoint, outputwhite.whitepoint, cache_method(method.method));
+    }
+    error = inputindex < 0 && inputilluminant < 0 ? "unknown input: " + input : "unknown output: " + output;
+    return nullptr;
+}
+
+// watched transforms are builtin methods only, values are not used
+const double* batch_matrix(const DependencyGraph& graph, const std::string& input, const std::string& output, const QueryMethod& method, double*, std::string& type, std::string& error)
+{
+    int inputindex = graph.find_colorspace(input);
+    int outputindex = graph.find_colorspace(output);
+    if (inputindex >= 0 && outputindex >= 0) {
+        type = "colorspace";
+        return graph.transform(inputindex, outputindex, cache_method(method.method));
+    }
+    int inputilluminant = graph.find_illuminant(input);
+    int outputilluminant = graph.find_illuminant(output);
+    if (inputilluminant >= 0 && outputilluminant >= 0) {
+        type = "illuminant";
+        return graph.adaptation(inputilluminant, outputilluminant, cache_method(method.method));
+    }
+    error = inputindex < 0 && inputilluminant < 0 ? "unknown input: " + input : "unknown output: " + output;
+    return nullptr;
+}
+
+// result of a query as a json line, transforms of the cache or a watched graph
+template <typename T>
+std::string batch_query(const T& transforms, const std::string& line, size_t linenumber)
+{
+    std::string input, output, methodname, type, error;
+    std::string result = Strutil::sprintf("{\"line\": %d", linenumber);
+    if (!parse_batch_query(line, input, output, methodname, error)) {
+        return result + ", \"error\": " + json_string(error) + "}\n";
+    }
+    result += ", \"input\": " + json_string(input) + ", \"output\": " + json_string(output);
+    QueryMethod method;
+    if (!parse_query_method(methodname, method, error)) {
+        return result + ", \"error\": " + json_string(error) + "}\n";
+    }
+    result += ", \"method\": " + json_string(method.name);
+    if (method.transform && runadaptation.degree < 1.0) {
+        result += Strutil::sprintf(", \"degree\": %.17g", runadaptation.degree);
+    }
+    double values[9];
+    const double* matrix = batch_matrix(transforms, input, output, method, values, type, error);
+    if (!matrix) {
+        return result + ", \"error\": " + json_string(error) + "}\n";
+    }
+    result += ", \"type\": \"" + type + "\", \"matrix\": [";
+    for (int i = 0; i < 9; ++i) {
+        result += Strutil::sprintf(i ? ", %.17g" : "%.17g", matrix[i]);
+    }
+    return result + "]}\n";
+}
+
+// json lines to batch output file or stdout
+bool write_results(const std::vector<std::string>& results, const std::string& batchoutput)
+{
+    PhaseScope scope(PhaseOutput);
+    std::ofstream file;
+    if (batchoutput.size() && batchoutput != "-") {
+        file.open(batchoutput);
+        if (!file.is_open()) {
+            print_error("could not open batch output file: ", batchoutput);
+            return false;
+        }
+    }
+    std::ostream& stream = file.is_open() ? file : std::cout;
+    for (const std::string& result : results) {
+        stream << result;
+    }
+    stream.flush();
+    if (!stream) {
+        print_error("could not write batch results: ", batchoutput);
+        return false;
+    }
+    return true;
+}
+
+// utils - format
+// entries of the run collected in one document, written at once in the output format
+static FormatDocument document;
+
+std::string format_method(AdaptationMethod method)
+{
+    return Strutil::lower(adaptationmethod_name(method));
+}
+
+// write document unless the format is text
+bool write_format()
+{
+    if (tool.format == OutputFormat::Text) {
+        return true;
+    }
+    PhaseScope scope(PhaseOutput);
+    std::string error;
+    if (!write_document(tool.formatoutput, document, tool.format, error)) {
+        print_error(error);
+        return false;
+    }
+    return true;
+}
+
+// entries of colorspace, rgb to xyz and xyz to rgb matrices, luminance coeff and
+// whitepoint in xy and xyz
+void format_colorspace(const Colorspace& colorspace, const double* rgbxyz, const double* xyzrgb)
+{
+    Eigen::Vector3d whitepoint = xy_to_xyz(colorspace.whitepoint);
+    document.add_matrix(colorspace.name + "_rgb_to_xyz", rgbxyz);
+    document.add_matrix(colorspace.name + "_xyz_to_rgb", xyzrgb);
+    document.add_vector(colorspace.name + "_luminance", rgbxyz + 3, 3);
+    document.add_vector(colorspace.name + "_whitepoint", colorspace.whitepoint.data(), 2);
+    document.add_vector(colorspace.name + "_whitepoint_xyz", whitepoint.data(), 3);
+}
+
+// entries of illuminant, whitepoint in xy and xyz
+void format_illuminant(const Illuminant& illuminant)
+{
+    Eigen::Vector3d whitepoint = xy_to_xyz(illuminant.whitepoint);
+    document.add_vector(illuminant.name + "_whitepoint", illuminant.whitepoint.data(), 2);
+    document.add_vector(illuminant.name + "_whitepoint_xyz", whitepoint.data(), 3);
+}
+
+// answer queries as document entries named <input>_to_<output>_<method>, unanswered
+// queries are reported as errors and skipped
+bool run_batch_format(const TransformCache& cache, const std::vector<std::string>& lines, int threads)
+{
+    std::vector<const double*> matrices(lines.size(), nullptr);
+    std::vector<double> values(lines.size() * 9);
+    std::vector<std::string> names(lines.size()), errors(lines.size());
+    parallel_for_chunked(0, int64_t(lines.size()), 0, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            string_view line = Strutil::strip(lines[i]);
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::string input, output, methodname, type;
+            QueryMethod method;
+            if (!parse_batch_query(lines[i], input, output, methodname, errors[i]) || !parse_query_method(methodname, method, errors[i])) {
+                continue;
+            }
+            matrices[i] = batch_matrix(cache, input, output, method, values.data() + i * 9, type, errors[i]);
+            names[i] = input + "_to_" + output + "_" + (method.transform ? adaptation_suffix(method.name, runadaptation.degree) : method.name);
+        }
+    }, paropt(threads));
+    document.entries.reserve(document.entries.size() + lines.size());
+    document.values.reserve(document.values.size() + lines.size() * 9);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (matrices[i]) {
+            document.add_matrix(names[i], matrices[i]);
+        } else if (errors[i].size()) {
+            print_error(Strutil::sprintf("line %d: ", i + 1), errors[i]);
+        }
+    }
+    return write_format();
+}
+
+// answer all queries, spread across threads and written in query order
+bool run_batch(const TransformCache& cache, const std::string& batchfile, const std::string& batchoutput, int threads)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream file;
+        if (batchfile != "-") {
+            file.open(batchfile);
+            if (!file.is_open()) {
+                print_error("could not open batch file: ", batchfile);
+                return false;
+            }
+        }
+        std::istream& stream = batchfile == "-" ? std::cin : file;
+        std::string line;
+        while (std::getline(stream, line)) {
+            lines.push_back(line);
+        }
+    }
+    if (tool.format != OutputFormat::Text) {
+        return run_batch_format(cache, lines, threads);
+    }
+    std::vector<std::string> results(lines.size());
+    parallel_for_chunked(0, int64_t(lines.size()), 0, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            string_view line = Strutil::strip(lines[i]);
+            if (line.size() && line[0] != '#') {
+                results[i] = batch_query(cache, lines[i], i + 1);
+            }
+        }
+    }, paropt(threads));
+    
+    return write_results(results, batchoutput);
+}
+
+// utils - server
+static Server* server = nullptr;
+static std::atomic<bool> watching(false);
+
+#if !defined(_WIN32)
+static void
+stop_server(int)
+{
+    watching = false;
+    if (server) {
+        server->stop();
+    }
+}
+#endif
+
+// stop server and watch on interrupt
+void handle_signals()
+{
+#if !defined(_WIN32)
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_server;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+// list of names as a json line
+std::string json_list(const std::string& key, const std::vector<std::string>& names)
+{
+    std::string json = "{" + json_string(key) + ": [";
+    for (size_t i = 0; i < names.size(); ++i) {
+        json += (i ? ", " : "") + json_string(names[i]);
+    }
+    return json + "]}\n";
+}
+
+// serve requests on socket until interrupted
+bool serve_socket(const std::string& socket, int threads, const Server::Handler& handler)
+{
+    Server instance;
+    if (!instance.listen(socket)) {
+        print_error(instance.geterror());
+        return false;
+    }
+    if (threads <= 0) {
+        threads = std::max(1u, std::min(Sysutil::hardware_concurrency(), 8u));
+    }
+    handle_signals();
+    server = &instance;
+    print_info("serving on socket: ", socket);
+    print_info("  threads: ", threads);
+    std::cout.flush();
+    bool valid = instance.serve(handler, threads);
+    server = nullptr;
+    if (!valid) {
+        print_error(instance.geterror());
+        return false;
+    }
+    print_info("server stopped");
+    return true;
+}
+
+// serve queries as batch lines and colorspaces or illuminants for lists of names
+bool run_server(const TransformCache& cache, const std::string& socket, int threads)
+{
+    std::vector<std::string> names;
+    for (size_t i = 0; i < cache.colorspaces(); ++i) {
+        names.push_back(cache.string(cache.colorspace(i).name));
+    }
+    const std::string colorspaces = json_list("colorspaces", names);
+    names.clear();
+    for (size_t i = 0; i < cache.illuminants(); ++i) {
+        names.push_back(cache.string(cache.illuminant(i).name));
+    }
+    const std::string illuminants = json_list("illuminants", names);
+    
+    return serve_socket(socket, threads, [&](const std::string& request, size_t number) {
+        string_view str = Strutil::strip(request);
+        if (Strutil::iequals(str, "colorspaces")) {
+            return colorspaces;
+        }
+        if (Strutil::iequals(str, "illuminants")) {
+            return illuminants;
+        }
+        return batch_query(cache, request, number);
+    });
+}
+
+// utils - exports
+// transforms of all pairs as one table in format, json for text. transform of input,
+// output and method index, methods are suffixes of matrix names
+bool write_pairwise(const std::vector<std::string>& names, const std::vector<std::string>& methods,
+                    const std::function<const double*(size_t input, size_t output, size_t method)>& transform)
+{
+    const size_t count = names.size();
+    FormatDocument table;
+    table.entries.reserve(count * count * methods.size());
+    table.values.reserve(count * count * methods.size() * 9);
+    for (size_t input = 0; input < count; ++input) {
+        for (size_t output = 0; output < count; ++output) {
+            for (size_t method = 0; method < methods.size(); ++method) {
+                table.add_matrix(names[input] + "_to_" + names[output] + "_" + methods[method], transform(input, output, method));
+            }
+        }
+    }
+    std::string error;
+    OutputFormat format = tool.format == OutputFormat::Text ? OutputFormat::Json : tool.format;
+    phasestats.begin(PhaseOutput);
+    if (!write_document(tool.all, table, format, error)) {
+        print_error(error);
+        return false;
+    }
+    print_info("pairwise transforms: ", tool.all);
+    print_info("  colorspaces: ", count);
+    print_info("  methods: ", methods.size());
+    print_info("  transforms: ", table.entries.size());
+    print_info("  format: ", format_name(format));
+    return true;
+}
+
+// opencolorio config of colorspaces
+bool write_ocioconfig(const std::vector<RegistryColorspace>& colorspaces)
+{
+    std::string config, error;
+    if (!ocio_config(colorspaces, *runadaptation.transform, config, error)) {
+        print_error(error);
+        return false;
+    }
+    phasestats.begin(PhaseOutput);
+    std::ofstream file(tool.ocioconfig);
+    if (!(file << config)) {
+        print_error("could not write ocio config: ", tool.ocioconfig);
+        return false;
+    }
+    print_info("ocio config: ", tool.ocioconfig);
+    print_info("  colorspaces: ", colorspaces.size());
+    print_info("  reference: ", ocio_reference);
+    return true;
+}
+
+// utils - watch
+// registry entries and their transforms. queries of server threads share the lock and
+// updates are exclusive, artifacts are rebuilt without the lock by the watch thread as
+// the only writer.
+struct WatchState
+{
+    WatchState()
+    : graph(cache_adaptationmethods())
+    {
+    }
+    DependencyGraph graph;
+    std::shared_timed_mutex mutex;
+    std::string colorspaces; // json lists of server
+    std::string illuminants;
+};
+
+// update transforms to the entries of registry
+DependencyUpdate watch_update(const Registry& registry, WatchState& state)
+{
+    std::unique_lock<std::shared_timed_mutex> lock(state.mutex);
+    DependencyUpdate update = state.graph.update(registry.colorspaces(), registry.illuminants(), tool.threads);
+    if (update.colorspaces.size()) {
+        state.colorspaces = json_list("colorspaces", state.graph.colorspace_names());
+    }
+    if (update.illuminants.size()) {
+        state.illuminants = json_list("illuminants", state.graph.illuminant_names());
+    }
+    return update;
+}
+
+// bake lut of input and output colorspace of tool, as the convert path without an image
+bool watch_lut(const DependencyGraph& graph)
+{
+    int inputindex = graph.find_colorspace(tool.inputcolorspace);
+    int outputindex = graph.find_colorspace(tool.outputcolorspace);
+    if (inputindex < 0 || outputindex < 0) {
+        print_error("unknown color space: ", inputindex < 0 ? tool.inputcolorspace : tool.outputcolorspace);
+        return false;
+    }
+    const RegistryColorspace& inputcolorspace = graph.colorspace(inputindex);
+    const RegistryColorspace& outputcolorspace = graph.colorspace(outputindex);
+    const double* matrix = graph.transform(inputindex, outputindex, cache_method(tool.adaptationmethod));
+    PixelTransform pixeltransform;
+    {
+        long double values[9], rounded[9];
+        std::copy(matrix, matrix + 9, values);
+        round_matrix(values, Precision::Float, rounded);
+        std::copy(rounded, rounded + 9, pixeltransform.matrix);
+    }
+    std::string inputtrc = tool.inputtrc.size() ? tool.inputtrc : tool.trc ? inputcolorspace.trc : "Linear";
+    std::string outputtrc = tool.outputtrc.size() ? tool.outputtrc : tool.trc ? outputcolorspace.trc : "Linear";
+    if (!parse_transfer(inputtrc, pixeltransform.decode) || !parse_transfer(outputtrc, pixeltransform.encode)) {
+        print_error("unknown transfer: ", parse_transfer(inputtrc, pixeltransform.decode) ? outputtrc : inputtrc);
+        return false;
+    }
+    if (tool.gamutcompress) {
+        pixeltransform.gamut = gamut_compression(matrix, tool.gamutthreshold, tool.gamutpower);
+    }
+    std::string title = Strutil::sprintf("colortool %s %s to %s %s", inputcolorspace.name, transfer_name(pixeltransform.decode), outputcolorspace.name, transfer_name(pixeltransform.encode));
+    return bake_lutfile(pixeltransform, title);
+}
+
+// check resource files at the interval until interrupted, changed entries update their
+// transforms and rebuild the artifacts that depend on them
+void watch_registry(Registry& registry, WatchState& state, uint64_t hash)
+{
+    const std::vector<std::string> jsonfiles = { registry.colorspacesfile(), registry.illuminantsfile() };
+    while (watching) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(tool.watchinterval));
+        uint64_t changed;
+        if (!watching || !cache_hash(jsonfiles, changed) || changed == hash) {
+            continue;
+        }
+        hash = changed;
+        Timer timer;
+        if (!registry.reload()) {
+            print_warning(registry.geterror());
+            continue;
+        }
+        DependencyUpdate update = watch_update(registry, state);
+        if (update.empty()) {
+            continue;
+        }
+        double updatetime = timer.lap();
+        std::vector<std::string> artifacts;
+        for (size_t artifact : update.artifacts) {
+            artifacts.push_back(state.graph.artifact_name(artifact));
+        }
+        print_info("watch update");
+        if (update.colorspaces.size()) {
+            print_info("  colorspaces: ", Strutil::join(update.colorspaces, ", "));
+        }
+        if (update.illuminants.size()) {
+            print_info("  illuminants: ", Strutil::join(update.illuminants, ", "));
+        }
+        print_info("  recomputed: ", Strutil::sprintf("%d entries, %d pairs", update.nodes, update.pairs));
+        print_info("  update time: ", updatetime);
+        if (!state.graph.rebuild(update.artifacts)) {
+            print_warning("could not rebuild all artifacts");
+        }
+        if (artifacts.size()) {
+            print_info("  artifacts: ", Strutil::join(artifacts, ", "));
+            print_info("  rebuild time: ", timer.lap());
+        }
+        std::cout.flush();
+    }
+}
+
+// watch resource files, serve queries of the latest entries and keep the pairwise table,
+// ocio config and lut of tool up to date
+bool run_watch(Registry& registry)
+{
+    if (!registry.load_colorspaces() || !registry.load_illuminants()) {
+        print_error(registry.geterror());
+        return false;
+    }
+    uint64_t hash;
+    if (!cache_hash({ registry.colorspacesfile(), registry.illuminantsfile() }, hash)) {
+        return false;
+    }
+    Timer timer;
+    WatchState state;
+    DependencyGraph& graph = state.graph;
+    watch_update(registry, state);
+    print_info("watch: ", registry.colorspacesfile().size() ? registry.colorspacesfile() : std::string("builtin colorspaces"));
+    print_info("  illuminants: ", registry.illuminantsfile());
+    print_info("  interval: ", Strutil::sprintf("%d ms", tool.watchinterval));
+    print_info("  colorspaces: ", graph.colorspace_names().size());
+    print_info("  update time: ", timer.lap());
+    
+    // artifacts, the pairwise table and config depend on all colorspaces and the lut on
+    // its input and output colorspace
+    if (tool.all.size()) {
+        graph.add_artifact(tool.all, { dependency_all }, {}, [&]() {
+            const std::vector<std::string> names = graph.colorspace_names();
+            std::vector<size_t> slots;
+            for (const std::string& name : names) {
+                slots.push_back(graph.find_colorspace(name));
+            }
+            std::vector<std::string> methods;
+            for (AdaptationMethod method : graph.methods()) {
+                methods.push_back(format_method(method));
+            }
+            return write_pairwise(names, methods, [&](size_t input, size_t output, size_t method) {
+                return graph.transform(slots[input], slots[output], method);
+            });
+        });
+    }
+    if (tool.ocioconfig.size()) {
+        graph.add_artifact(tool.ocioconfig, { dependency_all }, {}, [&]() {
+            return write_ocioconfig(registry.colorspaces());
+        });
+    }
+    if (tool.lutfile.size()) {
+        graph.add_artifact(tool.lutfile, { tool.inputcolorspace, tool.outputcolorspace }, {}, [&]() {
+            return watch_lut(graph);
+        });
+    }
+    std::vector<size_t> artifacts;
+    for (size_t artifact = 0; artifact < graph.artifacts(); ++artifact) {
+        artifacts.push_back(artifact);
+    }
+    if (!graph.rebuild(artifacts)) {
+        return false;
+    }
+    
+    watching = true;
+    if (tool.serve.size()) {
+        std::thread watcher(watch_registry, std::ref(registry), std::ref(state), hash);
+        bool valid = serve_socket(tool.serve, tool.threads, [&](const std::string& request, size_t number) {
+            std::shared_lock<std::shared_timed_mutex> lock(state.mutex);
+            string_view str = Strutil::strip(request);
+            if (Strutil::iequals(str, "colorspaces")) {
+                return state.colorspaces;
+            }
+            if (Strutil::iequals(str, "illuminants")) {
+                return state.illuminants;
+            }
+            return batch_query(graph, request, number);
+        });
+        watching = false;
+        watcher.join();
+        return valid;
+    }
+    handle_signals();
+    print_info("watching until interrupted");
+    std::cout.flush();
+    watch_registry(registry, state, hash);
+    print_info("watch stopped");
+    return true;
+}
+
+// utils - cct
+// ccts as a value, a list like 3200,5600 or ranges like 2000-10000:100
+bool parse_ccts(const std::string& str, std::vector<double>& ccts)
+{
+    for (const std::string& item : Strutil::splits(str, ",")) {
+        double first, last, step;
+        char* end;
+        first = std::strtod(item.c_str(), &end);
+        if (end == item.c_str()) {
+            return false;
+        }
+        if (*end == '\0') {
+            ccts.push_back(first);
+            continue;
+        }
+        if (std::sscanf(end, "-%lf:%lf", &last, &step) != 2 || step <= 0.0 || last < first) {
+            return false;
+        }
+        for (int i = 0; first + i * step <= last * (1.0 + 1e-12); ++i) {
+            ccts.push_back(first + i * step);
+        }
+    }
+    return ccts.size() > 0;
+}
+
+// cct adaptation as a json line
+std::string cct_result(double cct, double tint, const std::string& output, const double* whitepoint, const double* matrix)
+{
+    std::string result = Strutil::sprintf("{\"cct\": %.17g, \"tint\": %.17g, \"locus\": \"%s\"", cct, tint, locus_name(tool.locus));
+    result += ", \"output\": " + json_string(output);
+    result += ", \"method\": " + json_string(runadaptation.transform->name);
+    if (runadaptation.degree < 1.0) {
+        result += Strutil::sprintf(", \"degree\": %.17g", runadaptation.degree);
+    }
+    result += Strutil::sprintf(", \"whitepoint\": [%.17g, %.17g], \"matrix\": [", whitepoint[0], whitepoint[1]);
+    for (int i = 0; i < 9; ++i) {
+        result += Strutil::sprintf(i ? ", %.17g" : "%.17g", matrix[i]);
+    }
+    return result + "]}\n";
+}
+
+// utils - spectral
+// read spectral file, false and error printed if missing or without columns
+bool read_spectral_file(const std::string& filename, int columns, SpectralData& data)
+{
+    PhaseScope scope(PhaseIO);
+    std::string error;
+    if (!read_spectral(filename, data, error)) {
+        print_error(error);
+        return false;
+    }
+    if (columns && data.values.cols() != columns) {
+        print_error(Strutil::sprintf("expected %d spectra in: ", columns), filename);
+        return false;
+    }
+    return true;
+}
+
+// whitepoints of illuminant spds and blackbodies of tool, with camera matrices fitted
+// per illuminant when a camera is set
+bool run_spectral()
+{
+    Timer timer;
+    Observer observer;
+    Eigen::MatrixXd cmfs;
+    if (parse_observer(tool.observer, observer)) {
+        cmfs = observer_cmfs(observer);
+    } else {
+        SpectralData data;
+        if (!read_spectral_file(tool.observer, 3, data)) {
+            return false;
+        }
+        cmfs = data.values;
+    }
+    SpectralData illuminants;
+    if (tool.spectral.size() && !read_spectral_file(tool.spectral, 0, illuminants)) {
+        return false;
+    }
+    std::vector<double> ccts;
+    if (tool.blackbody.size()) {
+        if (!parse_ccts(tool.blackbody, ccts)) {
+            print_error("could not parse blackbody cct: ", tool.blackbody);
+            return false;
+        }
+        const Eigen::Index first = illuminants.values.cols();
+        illuminants.values.conservativeResize(spectral_samples, first + ccts.size());
+        for (size_t i = 0; i < ccts.size(); ++i) {
+            illuminants.names.push_back(Strutil::sprintf("blackbody_%g", ccts[i]));
+            illuminants.values.col(first + i) = blackbody_spd(ccts[i]);
+        }
+    }
+    const Eigen::MatrixXd whitepoints = spectral_whitepoints(cmfs, illuminants.values);
+    
+    std::vector<CameraFit> fits;
+    if (tool.camera.size()) {
+        SpectralData camera, patches;
+        if (!read_spectral_file(tool.camera, 3, camera)) {
+            return false;
+        }
+        if (tool.patches.size()) {
+            if (!read_spectral_file(tool.patches, 0, patches)) {
+                return false;
+            }
+        } else {
+            patches.values = training_reflectances();
+        }
+        fits = fit_cameras(cmfs, camera.values, illuminants.values, patches.values, tool.threads);
+        print_info("camera: ", tool.camera);
+        print_info("  patches: ", patches.values.cols());
+    }
+    
+    print_info("spectral: ", tool.observer);
+    print_info("  illuminants: ", illuminants.names.size());
+    print_info("  time: ", timer.lap());
+    for (size_t i = 0; i < illuminants.names.size(); ++i) {
+        const Eigen::Vector3d xyz = whitepoints.col(i);
+        if (xyz.y() <= 0.0) {
+            print_warning("illuminant without luminance: ", illuminants.names[i]);
+            continue;
+        }
+        Illuminant illuminant;
+        illuminant.name = illuminants.names[i];
+        illuminant.whitepoint = Eigen::Vector2d(xyz.x(), xyz.y()) / xyz.sum();
+        print_info("illuminant: ", illuminant.name);
+        print_value("  whitepoint: ", illuminant.whitepoint);
+        print_value("  whitepoint XYZ: ", xyz);
+        format_illuminant(illuminant);
+        if (fits.size()) {
+            const CameraFit& fit = fits[i];
+            if (!fit.valid) {
+                print_warning("camera fit failed for illuminant: ", illuminant.name);
+                continue;
+            }
+            Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> matrix(fit.matrix);
+            print_value("  camera white: ", Eigen::Map<const Eigen::Vector3d>(fit.white));
+            print_value("  camera to XYZ: ", matrix);
+            print_info("  camera rms error: ", fit.rms);
+            print_info("  camera max error: ", fit.max);
+            document.add_matrix(illuminant.name + "_camera_to_xyz", fit.matrix);
+            document.add_vector(illuminant.name + "_camera_white", fit.white, 3);
+        }
+    }
+    return write_format();
+}
+
+// utils - chains
+// stages as name[/trc] separated by ':', e.g AWG3/LogC3:AP0:AP1:Rec709. stages without
+// trc use input and output trc at the ends and colorspace trc with --trc, else linear
+bool parse_chain(const TransformCache& cache, const std::string& chain, std::vector<ChainStage>& stages)
+{
+    std::vector<std::string> names = Strutil::splits(chain, ":");
+    if (names.size() < 2) {
+        print_error("chain needs at least two colorspaces: ", chain);
+        return false;
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string name = names[i], trc;
+        size_t slash = name.find('/');
+        if (slash != std::string::npos) {
+            trc = name.substr(slash + 1);
+            name = name.substr(0, slash);
+        }
+        int index = cache.find_colorspace(name);
+        if (index < 0) {
+            print_error("unknown chain colorspace: ", name);
+            return false;
+        }
+        ChainStage stage;
+        stage.colorspace = cache_colorspace(cache, index);
+        if (trc.empty()) {
+            if (i == 0 && tool.inputtrc.size()) {
+                trc = tool.inputtrc;
+            } else if (i + 1 == names.size() && tool.outputtrc.size()) {
+                trc = tool.outputtrc;
+            } else {
+                trc = tool.trc ? stage.colorspace.trc : "Linear";
+            }
+        }
+        if (!parse_transfer(trc, stage.transfer)) {
+            print_error("unknown chain transfer: ", trc);
+            print_error("supported transfers: ", Strutil::join(transfer_names(), ", "));
+            return false;
+        }
+        stages.push_back(stage);
+    }
+    return true;
+}
+
+// main
+int
+main( int argc, const char * argv[])
+{
+    // Helpful for debugging to make sure that any crashes dump a stack
+    // trace.
+    Sysutil::setup_crash_stacktrace("stdout");
+
+    Filesystem::convert_native_arguments(argc, (const char**)argv);
+    ArgParse ap;
+
+    ap.intro("colortool -- a utility set for color space conversions, with support for white point adaptation\n");
+    ap.usage("colortool [options] filename...")
+      .add_help(false)
+      .exit_on_error(true);
+    
+    ap.separator("General flags:");
+    ap.arg("--help", &tool.help)
+      .help("Print help message");
+    
+    ap.arg("-v", &tool.verbose)
+      .help("Verbose status messages");
+    
+    ap.arg("--stats", &tool.stats)
+      .help("Print wall time of load, compute, io and output phases");
+    
+    ap.arg("--colorspaces", &tool.colorspaces)
+      .help("List all colorspaces");
+    
+    ap.arg("--illuminants", &tool.illuminants)
+      .help("List all illuminants");
+    
+    ap.arg("--adaptationmethod %s:adaptationmethod")
+      .help("Adaptation methods: xyzscaling, bradford, cat02, vonkries, cat16 or a name in --adaptations, default: cat02")
+      .action(set_adaptationmethod);
+    
+    ap.arg("--adaptations %s:FILE", &tool.adaptations)
+      .help("Custom adaptation methods as json of xyz to lms matrices, used by --adaptationmethod");
+    
+    ap.arg("--adaptationdegree %f:DEGREE", &tool.adaptationdegree)
+      .help("Degree of adaptation in range 0-1, 1 is full adaptation and 0 none, default: 1");
+    
+    ap.arg("--adaptationluminance %f:NITS", &tool.adaptationluminance)
+      .help("Degree of adaptation from adapting luminance in cd/m2 as in cam16, replaces --adaptationdegree");
+    
+    ap.arg("--whitemap %s:FILE", &tool.whitemap)
+      .help("Image of whites per pixel in linear input rgb, input image is adapted pixel by pixel to the output whitepoint");
+
+    ap.separator("Input flags:");
+    ap.arg("--inputcolorspace %s:FILE", &tool.inputcolorspace)
+      .help("Input color space");
+    
+    ap.arg("--inputilluminant %s:FILE", &tool.inputilluminant)
+      .help("Input illuminant");
+    
+    ap.arg("--inputcct %s:CCT", &tool.inputcct)
+      .help("Input whitepoint as color temperature in kelvin, a list like 3200,5600 or range like 2000-10000:100 gives a table");
+    
+    ap.arg("--tint %f:TINT", &tool.tint)
+      .help("Tint of input color temperature, positive is greener, default: 0");
+    
+    ap.arg("--locus %s:locus")
+      .help("Locus of input color temperature: planckian, daylight, default: planckian")
+      .action(set_locus);
+    
+    ap.arg("--inputtrc %s:TRC", &tool.inputtrc)
+      .help("Input transfer, decoded to linear before transform, e.g LogC3, LogC4, sRGB, Gamma2.4");
+    
+    ap.arg("--chain %s:CHAIN", &tool.chain)
+      .help("Colorspace chain as name[/trc] stages, e.g AWG3/LogC3:AP0:AP1:Rec709, fused and converted in one pass");
+    
+    ap.arg("--input %s:FILE", &tool.inputfilename)
+      .help("Input image, converted from input to output color space");
+    
+    ap.separator("Output flags:");
+    ap.arg("--outputcolorspace %s:FILE", &tool.outputcolorspace)
+      .help("Output color space, required to compute transform");
+
+    ap.arg("--outputilluminant %s:FILE", &tool.outputilluminant)
+      .help("Output illuminant, required to compute transform");
+    
+    ap.arg("--outputtrc %s:TRC", &tool.outputtrc)
+      .help("Output transfer, encoded from linear after transform");
+    
+    ap.arg("--precision %s:PRECISION")
+      .help("Compute transform in precision and report its errors: half, float, double, extended")
+      .action(set_precision);
+    
+    ap.arg("--trc", &tool.trc)
+      .help("Use transfers of input and output color spaces unless set");
+    
+    ap.arg("--output %s:FILE", &tool.outputfilename)
+      .help("Output image, required to convert input image");
+    
+    ap.arg("--threads %d:THREADS", &tool.threads)
+      .help("Number of threads used for image conversion, default: 0 (all cores)");
+    
+    ap.arg("--frames %s:RANGE", &tool.frames)
+      .help("Frame range of sequence, e.g 1001-2400, input and output are patterns like plate.%04d.exr");
+    
+    ap.arg("--buffers %d:BUFFERS", &tool.buffers)
+      .help("Frames in flight when converting sequences, default: 3");
+    
+    ap.arg("--memorylimit %d:MB", &tool.memorylimit)
+      .help("Convert images in bands of rows with pixel buffers within limit in MB, --buffers bands in flight, default: 0 for whole images");
+    
+    ap.separator("LUT flags:");
+    ap.arg("--lut %s:FILE", &tool.lutfile)
+      .help("Bake transform including transfers into a 3d lut, .cube or .spi3d");
+    
+    ap.arg("--lutsize %d:SIZE", &tool.lutsize)
+      .help("Lattice size of baked lut, default: 33");
+    
+    ap.arg("--applylut %s:FILE", &tool.applylut)
+      .help("Convert input image through a .cube or .spi3d lut instead of the transform");
+    
+    ap.separator("OpenColorIO flags:");
+    ap.arg("--ocioconfig %s:FILE", &tool.ocioconfig)
+      .help("Write an OpenColorIO config with all colorspaces, uses --adaptationmethod");
+    
+    ap.arg("--ocio", &tool.ocio)
+      .help("Convert input image with the OpenColorIO cpu processor instead of colortool kernels");
+    
+    ap.separator("White balance flags:");
+    ap.arg("--awb %s:METHOD")
+      .help("Auto white balance per frame from image statistics: grayworld, brightest, adapted to output illuminant or output color space")
+      .action(set_whitebalance);
+    
+    ap.arg("--awbpercentile %f:PERCENTILE", &tool.awbpercentile)
+      .help("Luminance percentile of brightest patch, default: 0.95");
+    
+    ap.arg("--awbstep %d:STEP", &tool.awbstep)
+      .help("Every n-th row and column is sampled for statistics, default: 8");
+    
+    ap.arg("--awbsmoothing %f:FRAMES", &tool.awbsmoothing)
+      .help("Time constant of temporal smoothing in frames, default: 8, 0 for none");
+    
+    ap.arg("--awbsidecar %s:FILE", &tool.awbsidecar)
+      .help("Sidecar of per frame estimates, default: next to input as <name>.awb.json");
+    
+    ap.separator("Gamut flags:");
+    ap.arg("--gamutcompress", &tool.gamutcompress)
+      .help("Compress out of gamut colors of input color space into output color space, limits from primaries");
+    
+    ap.arg("--gamutthreshold %f:THRESHOLD", &tool.gamutthreshold)
+      .help("Distance from achromatic below which colors are kept, default: 0.8");
+    
+    ap.arg("--gamutpower %f:POWER", &tool.gamutpower)
+      .help("Power of compression curve, higher is closer to a clip, default: 1.2");
+    
+    ap.separator("Analysis flags:");
+    ap.arg("--analyze", &tool.analyze)
+      .help("Compare converted output with input in cielab and ictcp, delta e, gamut and histograms");
+    
+    ap.arg("--compare %s:FILE", &tool.compare)
+      .help("Compare input image or sequence with image in output color space if set, no output is written");
+    
+    ap.arg("--gamuttarget %s:COLORSPACE", &tool.gamuttarget)
+      .help("Color space of out of gamut fractions, default: output or input color space");
+    
+    ap.arg("--histogrambins %d:BINS", &tool.histogrambins)
+      .help("Histogram bins of channel values in range 0-1, 0 for none, default: 16");
+    
+    ap.arg("--deltaethreshold %f:DELTAE", &tool.deltaethreshold)
+      .help("Delta e 2000 above which pixels are counted, default: 1.0");
+    
+    ap.arg("--analysisnits %f:NITS", &tool.analysisnits)
+      .help("Luminance in cd/m2 of Y = 1 for ictcp, default: 100");
+    
+    ap.separator("Spectral flags:");
+    ap.arg("--spectral %s:FILE", &tool.spectral)
+      .help("Whitepoints of illuminant spds in a csv file, one column per illuminant");
+    
+    ap.arg("--blackbody %s:CCT", &tool.blackbody)
+      .help("Whitepoints of blackbody illuminants in kelvin, a list like 3200,5600 or range like 2000-10000:100");
+    
+    ap.arg("--observer %s:OBSERVER", &tool.observer)
+      .help("Observer of spectral whitepoints: cie1931, cie1964 or a csv file of x, y and z, default: cie1931");
+    
+    ap.arg("--camera %s:FILE", &tool.camera)
+      .help("Fit camera rgb to xyz matrices per illuminant from r, g and b sensitivities in a csv file");
+    
+    ap.arg("--patches %s:FILE", &tool.patches)
+      .help("Training reflectances of camera fit in a csv file, default: smooth synthetic set");
+    
+    ap.separator("Format flags:");
+    ap.arg("--all %s:FILE", &tool.all)
+      .help("Write transforms of all color space pairs and adaptation methods as one table in --format, default: json, - for stdout");
+    
+    ap.arg("--format %s:FORMAT")
+      .help("Write matrices and whitepoints instead of info: text, json, bin, cpp, glsl, metal, osl, default: text")
+      .action(set_format);
+    
+    ap.arg("--formatoutput %s:FILE", &tool.formatoutput)
+      .help("Output file of format, default: stdout");
+    
+    ap.separator("Cache flags:");
+    ap.arg("--cachefile %s:FILE", &tool.cachefile)
+      .help("Transform cache file, default: user cache directory");
+    
+    ap.arg("--nocache", &tool.nocache)
+      .help("Do not read or write the transform cache");
+    
+    ap.separator("Batch flags:");
+    ap.arg("--batch %s:FILE", &tool.batchfile)
+      .help("Batch queries, one per line as 'input output [method]' or json, - for stdin");
+    
+    ap.arg("--batchoutput %s:FILE", &tool.batchoutput)
+      .help("Batch results as json lines, default: stdout");
     
-    ap.arg("--adaptationmethod %s:adaptationmethod")
-      .help("Adaptation methods: xyzscaling, bradford, cat02, vonkries, default: cat02")
-      .action(set_adaptationmethod);
-
-    ap.separator("Input flags:");
-    ap.arg("--inputcolorspace %s:FILE", &tool.inputcolorspace)
-      .help("Input color space");
+    ap.separator("Server flags:");
+    ap.arg("--serve %s:SOCKET", &tool.serve)
+      .help("Serve queries on a unix domain socket until interrupted, uses --threads");
     
-    ap.arg("--inputilluminant %s:FILE", &tool.inputilluminant)
-      .help("Input illuminant");
+    ap.separator("Watch flags:");
+    ap.arg("--watch", &tool.watch)
+      .help("Watch resource files until interrupted, transforms of the server and --all, --ocioconfig and --lut files are updated for changed entries only");
     
-    ap.separator("Output flags:");
-    ap.arg("--outputcolorspace %s:FILE", &tool.outputcolorspace)
-      .help("Output color space, required to compute transform");
-
-    ap.arg("--outputilluminant %s:FILE", &tool.outputilluminant)
-      .help("Output illuminant, required to compute transform");
+    ap.arg("--watchinterval %d:MS", &tool.watchinterval)
+      .help("Interval between checks of watched files in milliseconds, default: 250");
     
     // clang-format on
     if (ap.parse_args(argc, (const char**)argv) < 0) {
@@ -313,6 +2368,18 @@ main( int argc, const char * argv[])
         ap.abort();
         return EXIT_SUCCESS;
     }
+    printinfo = tool.format == OutputFormat::Text && tool.all != "-";
+    
+    // stats, printed when main returns
+    struct StatsReport
+    {
+        ~StatsReport()
+        {
+            if (tool.stats) {
+                print_stats();
+            }
+        }
+    } statsreport;
     
     if (!tool.colorspaces) {
         if (argc <= 1) {
@@ -322,108 +2389,464 @@ main( int argc, const char * argv[])
         }
     }
     
-    // colortool program
-    print_info("colortool -- a utility set for color space conversions, with support for white point adaptation.");
+    if (tool.inputfilename.size()) {
+        if (!tool.outputfilename.size() && tool.compare.empty()) {
+            print_error("output image must be set when input image is set");
+            return EXIT_FAILURE;
+        }
+        if (tool.applylut.empty() && tool.chain.empty() && (!tool.inputcolorspace.size() || (!tool.outputcolorspace.size() && tool.compare.empty()))) {
+            print_error("input and output color space or chain must be set to convert image");
+            return EXIT_FAILURE;
+        }
+        if (tool.frames.size()) {
+            int first, last;
+            if (!parse_frames(tool.frames, first, last)) {
+                print_error("could not parse frame range: ", tool.frames);
+                return EXIT_FAILURE;
+            }
+            const std::string& outputpattern = tool.compare.size() ? tool.compare : tool.outputfilename;
+            if (tool.inputfilename.find('%') == std::string::npos || outputpattern.find('%') == std::string::npos) {
+                print_error("input and output must be frame patterns like plate.%04d.exr when frames are set");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    
+    if (tool.chain.size() && (tool.inputcolorspace.size() || tool.outputcolorspace.size() || tool.applylut.size())) {
+        print_error("chain can not be used with input and output color space or applylut");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.memorylimit < 0 || (tool.memorylimit > 0 && tool.awb)) {
+        print_error("memory limit must not be negative and can not be used with auto white balance");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.awb && (tool.inputfilename.empty() || tool.chain.size() || tool.applylut.size() || tool.ocio)) {
+        print_error("auto white balance needs an input image and can not be used with chain, applylut or ocio");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.awbstep < 1 || !(tool.awbpercentile >= 0.0f && tool.awbpercentile <= 1.0f) || !(tool.awbsmoothing >= 0.0f)) {
+        print_error("auto white balance step must be positive, percentile in range 0-1 and smoothing not negative");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.gamutcompress && (tool.chain.size() || tool.applylut.size() || tool.ocio)) {
+        print_error("gamut compression can not be used with chain, applylut or ocio");
+        return EXIT_FAILURE;
+    }
+    
+    if (!(tool.gamutthreshold >= 0.0f && tool.gamutthreshold < 1.0f) || !(tool.gamutpower >= 1.0f)) {
+        print_error("gamut threshold must be in range 0-1 and power at least 1");
+        return EXIT_FAILURE;
+    }
+    
+    if ((tool.analyze || tool.compare.size()) && (tool.inputfilename.empty() || tool.inputcolorspace.empty() || tool.applylut.size() || tool.memorylimit > 0)) {
+        print_error("analysis needs an input image and input color space and can not be used with applylut or memory limit");
+        return EXIT_FAILURE;
+    }
+    
+    if ((tool.analyze && (tool.outputcolorspace.empty() || tool.compare.size())) || (tool.compare.size() && tool.outputfilename.size())) {
+        print_error("analyze needs an output color space, compare can not be used with analyze or output image");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.histogrambins < 0 || !(tool.deltaethreshold >= 0.0f) || !(tool.analysisnits > 0.0f)) {
+        print_error("histogram bins and delta e threshold must not be negative and nits must be positive");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.ocio && tool.applylut.size()) {
+        print_error("ocio and applylut can not be used together");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.lutsize < lut_minsize || tool.lutsize > lut_maxsize) {
+        print_error("lut size must be in range: ", Strutil::sprintf("%d-%d", lut_minsize, lut_maxsize));
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.camera.size() && tool.spectral.empty() && tool.blackbody.empty()) {
+        print_error("spectral illuminants or blackbody must be set for camera fit");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.serve.size() && tool.batchfile.size()) {
+        print_error("batch and serve can not be used together");
+        return EXIT_FAILURE;
+    }
+    
+    // custom and partial adaptation are computed from the transform, watched transforms
+    // are updated per builtin method and an ocio config converts through its reference
+    // whitepoint, where partial adaptations do not compose to the colortool transform
+    if (!(tool.adaptationdegree >= 0.0f && tool.adaptationdegree <= 1.0f) || !(tool.adaptationluminance >= 0.0f)) {
+        print_error("adaptation degree must be in range 0-1 and luminance not negative");
+        return EXIT_FAILURE;
+    }
+    
+    if (custom_adaptation() && tool.watch) {
+        print_error("custom or partial adaptation can not be used with watch");
+        return EXIT_FAILURE;
+    }
+    
+    if ((tool.adaptationdegree != 1.0f || tool.adaptationluminance > 0.0f) && tool.ocioconfig.size()) {
+        print_error("partial adaptation can not be used with ocio config");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.whitemap.size() && (tool.inputfilename.empty() || tool.outputcolorspace.empty() || tool.frames.size() || tool.memorylimit > 0 || tool.applylut.size() || tool.ocio || tool.lutfile.size() || tool.gamutcompress)) {
+        print_error("white map needs an input image and output color space and can not be used with frames, memory limit, applylut, ocio, lut or gamut compression");
+        return EXIT_FAILURE;
+    }
+    
+    if (tool.watch) {
+        if (tool.serve.empty() && tool.all.empty() && tool.ocioconfig.empty() && tool.lutfile.empty()) {
+            print_error("serve, all, ocio config or lut must be set for watch");
+            return EXIT_FAILURE;
+        }
+        if (tool.batchfile.size() || tool.inputfilename.size() || tool.chain.size() || tool.applylut.size()) {
+            print_error("watch can not be used with batch, input image, chain or apply lut");
+            return EXIT_FAILURE;
+        }
+        if (tool.lutfile.size() && (tool.inputcolorspace.empty() || tool.outputcolorspace.empty())) {
+            print_error("input and output color space must be set for a watched lut");
+            return EXIT_FAILURE;
+        }
+        if (tool.watchinterval <= 0) {
+            print_error("watch interval must be positive");
+            return EXIT_FAILURE;
+        }
+    }
+    
+    std::vector<double> ccts;
+    if (tool.inputcct.size()) {
+        if (!parse_ccts(tool.inputcct, ccts)) {
+            print_error("could not parse input cct: ", tool.inputcct);
+            return EXIT_FAILURE;
+        }
+        if (!tool.outputilluminant.size() && !tool.outputcolorspace.size()) {
+            print_error("output illuminant or output color space must be set for input cct");
+            return EXIT_FAILURE;
+        }
+        if (tool.inputfilename.size() || tool.inputilluminant.size()) {
+            print_error("input cct can not be used with input image or input illuminant");
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // colortool program, batch results and cct tables on stdout are kept machine readable
+    bool batchstdout = (tool.batchfile.size() || ccts.size() > 1) && (tool.batchoutput.empty() || tool.batchoutput == "-");
+    if (!batchstdout) {
+        print_info("colortool -- a utility set for color space conversions, with support for white point adaptation.");
+    }
     
     // precision
     print_precision(6);
 
-    // colorspaces
-    std::map<std::string, Colorspace> colorspaces;
-    {
-        std::string jsonfile = resources_path("colorspaces.json");
-        std::ifstream json(jsonfile);
-        if (json.is_open()) {
-            ptree pt;
-            read_json(jsonfile, pt);
-            for (const std::pair<const ptree::key_type, ptree>& item : pt) {
-                std::string name = item.first;
-                const ptree& data = item.second;
-                Colorspace cs;
-                cs.name = name;
-                bool valid = true;
-                try {
-                    cs.description = data.get<std::string>("description");
-                    cs.r.x() = data.get<double>("primaries.R.x", 0.0f);
-                    cs.r.y() = data.get<double>("primaries.R.y", 0.0f);
-                    cs.g.x() = data.get<double>("primaries.G.x", 0.0f);
-                    cs.g.y() = data.get<double>("primaries.G.y", 0.0f);
-                    cs.b.x() = data.get<double>("primaries.B.x", 0.0f);
-                    cs.b.y() = data.get<double>("primaries.B.y", 0.0f);
-                    cs.whitepoint.x() = data.get<double>("whitepoint.x", 0.0f);
-                    cs.whitepoint.y() = data.get<double>("whitepoint.y", 0.0f);
-                } catch (const boost::property_tree::ptree_error& e) {
-                    valid = false;
-                    print_error("missing or invalid value in colorspace: ", e.what());
-                    return EXIT_FAILURE;
-                }
-                colorspaces[name] = cs;
-            }
-        } else {
-            print_error("could not open colorspaces file: ", jsonfile);
+    // registry, only the files needed are read and builtin colorspaces are used
+    // when there is no colorspaces file
+    std::string colorspacesfile = resources_path("colorspaces.json");
+    Registry registry(Filesystem::exists(colorspacesfile) ? colorspacesfile : std::string(), resources_path("illuminants.json"));
+    if (registry.colorspacesfile().empty()) {
+        registry.set_colorspaces(builtin_registry_colorspaces());
+    }
+    
+    if (tool.colorspaces) {
+        if (!registry.load_colorspaces()) {
+            print_error(registry.geterror());
             ap.abort();
             return EXIT_FAILURE;
         }
+        print_info("Colorspaces:");
+        for (const RegistryColorspace& cs : registry.colorspaces()) {
+            print_info("    ", cs.name);
+        }
+        return EXIT_SUCCESS;
     }
     
-    if (tool.colorspaces) {
-        print_info("Colorspaces:");
-        for (const std::pair<std::string, Colorspace>& pair : colorspaces) {
-            print_info("    ", pair.first);
+    if (tool.illuminants) {
+        if (!registry.load_illuminants()) {
+            print_error(registry.geterror());
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        print_info("Illuminants:");
+        for (const RegistryIlluminant& im : registry.illuminants()) {
+            print_info("    ", im.name);
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // adaptation
+    if (!open_adaptation(batchstdout)) {
+        ap.abort();
+        return EXIT_FAILURE;
+    }
+    
+    // watch, transforms and artifacts of changed entries are updated until interrupted
+    if (tool.watch) {
+        if (!run_watch(registry)) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // opencolorio config
+    if (tool.ocioconfig.size()) {
+        if (!registry.load_colorspaces()) {
+            print_error(registry.geterror());
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        if (!write_ocioconfig(registry.colorspaces())) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // spectral whitepoints and camera fits
+    if (tool.spectral.size() || tool.blackbody.size()) {
+        if (!run_spectral()) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // pairwise transforms
+    if (tool.all.size()) {
+        if (!registry.load_colorspaces()) {
+            print_error(registry.geterror());
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        Timer timer;
+        phasestats.begin(PhaseCompute);
+        std::vector<Colorspace> colorspaces;
+        for (const RegistryColorspace& cs : registry.colorspaces()) {
+            Colorspace colorspace;
+            colorspace.name = cs.name;
+            colorspace.r = Eigen::Vector2d(cs.r);
+            colorspace.g = Eigen::Vector2d(cs.g);
+            colorspace.b = Eigen::Vector2d(cs.b);
+            colorspace.whitepoint = Eigen::Vector2d(cs.whitepoint);
+            colorspaces.push_back(colorspace);
+        }
+        PairwiseTable table = pairwise_transforms(colorspaces, runadaptation.transforms.transforms(), runadaptation.degree, tool.threads);
+        std::vector<std::string> methods;
+        for (const std::string& name : table.methods) {
+            methods.push_back(adaptation_suffix(name, runadaptation.degree));
+        }
+        if (!write_pairwise(table.names, methods, [&](size_t input, size_t output, size_t method) {
+            return table.transform(input, output, method);
+        })) {
+            ap.abort();
+            return EXIT_FAILURE;
         }
+        print_info("  time: ", timer.lap());
         return EXIT_SUCCESS;
     }
     
-    // illuminants
-    std::map<std::string, Illuminant> illuminants;
+    // cache
+    TransformCache cache;
     {
-        std::string jsonfile = resources_path("illuminants.json");
-        std::ifstream json(jsonfile);
-        if (json.is_open()) {
-            ptree pt;
-            read_json(jsonfile, pt);
-            for (const std::pair<const ptree::key_type, ptree>& item : pt) {
-                std::string name = item.first;
-                const ptree& data = item.second;
-                Illuminant im;
-                im.name = name;
-                bool valid = true;
-                try {
-                    im.description = data.get<std::string>("description");
-                    im.whitepoint.x() = data.get<double>("whitepoint.x", 0.0f);
-                    im.whitepoint.y() = data.get<double>("whitepoint.y", 0.0f);
-                } catch (const boost::property_tree::ptree_error& e) {
-                    valid = false;
-                    print_error("missing or invalid value in illuminants: ", e.what());
-                    return EXIT_FAILURE;
-                }
-                illuminants[name] = im;
+        std::string cachefile;
+        if (!tool.nocache) {
+            cachefile = tool.cachefile.size() ? tool.cachefile : cache_path("colortool.cache");
+        }
+        if (!open_cache(cachefile, registry, cache)) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+    }
+    phasestats.begin(PhaseCompute);
+    
+    // batch
+    if (tool.batchfile.size()) {
+        if (!run_batch(cache, tool.batchfile, tool.batchoutput, tool.threads)) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // server
+    if (tool.serve.size()) {
+        if (!run_server(cache, tool.serve, tool.threads)) {
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // apply lut, replaces the transform of input and output color space
+    if (tool.applylut.size()) {
+        Lut3D lut;
+        std::string error;
+        phasestats.begin(PhaseIO);
+        if (!read_lut(tool.applylut, lut, error)) {
+            print_error(error);
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        phasestats.begin(PhaseCompute);
+        print_info("apply lut: ", tool.applylut);
+        print_info("  size: ", lut.size);
+        if (tool.inputfilename.size()) {
+            PixelConversion conversion;
+            conversion.lut = &lut;
+            if (!convert_input(conversion, tool.outputcolorspace)) {
+                ap.abort();
+                return EXIT_FAILURE;
             }
-        } else {
-            print_error("could not open illuminants file: ", jsonfile);
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // chain, fused and converted in one pass
+    if (tool.chain.size()) {
+        std::vector<ChainStage> stages;
+        if (!parse_chain(cache, tool.chain, stages)) {
             ap.abort();
             return EXIT_FAILURE;
         }
+        ChainPlan plan = plan_chain(stages, *runadaptation.transform, runadaptation.degree);
+        std::vector<std::string> names;
+        for (const ChainStage& stage : stages) {
+            names.push_back(stage.colorspace.name + " " + transfer_name(stage.transfer));
+        }
+        print_info("chain: ", Strutil::join(names, " -> "));
+        print_info("  adaptation method: ", runadaptation.name);
+        if (tool.verbose) {
+            print_info("  plan");
+            for (const ChainOp& op : plan.ops) {
+                print_info("    ", chainop_name(op, runadaptation.name));
+            }
+        }
+        print_info("  optimized plan");
+        for (const ChainOp& op : plan.fused) {
+            print_info("    ", chainop_name(op, runadaptation.name));
+            if (op.type == ChainOpType::Matrix) {
+                print_value("      matrix: ", CacheMatrix(op.matrix));
+            }
+        }
+        print_info("  ops: ", Strutil::sprintf("%d, %d after fusion, %d cancelled", int(plan.ops.size()), int(plan.fused.size()), plan.cancelled));
+        print_info("  passes: ", Strutil::sprintf("%d, 1 after fusion, %d saved", plan.hops, plan.hops - 1));
+        print_info("  transforms per pass: ", plan.transforms.size());
+        
+        // lut
+        if (tool.lutfile.size()) {
+            if (plan.transforms.size() != 1) {
+                print_error("lut needs a single transform, chain is fused into: ", plan.transforms.size());
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+            if (!bake_lutfile(plan.transforms.front(), "colortool chain " + Strutil::join(names, " to "))) {
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+        }
+        
+        // convert
+        if (tool.inputfilename.size()) {
+            PixelConversion conversion;
+            conversion.transforms = plan.transforms;
+            if (!convert_input(conversion, stages.back().colorspace.name)) {
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
     }
     
-    if (tool.illuminants) {
-        print_info("Illuminants:");
-        for (const std::pair<std::string, Illuminant>& pair : illuminants) {
-            print_info("    ", pair.first);
+    // input cct, adapted to output illuminant or whitepoint of output color space
+    if (ccts.size()) {
+        std::string output;
+        double target[2];
+        if (tool.outputilluminant.size()) {
+            int outputindex = cache.find_illuminant(tool.outputilluminant);
+            if (outputindex < 0) {
+                print_error("unknown output illuminant: ", tool.outputilluminant);
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+            output = tool.outputilluminant;
+            std::copy(cache.illuminant(outputindex).whitepointxy, cache.illuminant(outputindex).whitepointxy + 2, target);
+        } else {
+            int outputindex = cache.find_colorspace(tool.outputcolorspace);
+            if (outputindex < 0) {
+                print_error("unknown output colorspace: ", tool.outputcolorspace);
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+            output = tool.outputcolorspace;
+            std::copy(cache.colorspace(outputindex).whitepointxy, cache.colorspace(outputindex).whitepointxy + 2, target);
+        }
+        std::vector<double> tints(ccts.size(), tool.tint);
+        std::vector<double> matrices(ccts.size() * 9), whitepoints(ccts.size() * 2);
+        if (!cct_adaptation_matrices(ccts.data(), tints.data(), ccts.size(), tool.locus, target, *runadaptation.transform, runadaptation.degree, matrices.data(), whitepoints.data())) {
+            double mincct, maxcct;
+            locus_range(tool.locus, mincct, maxcct);
+            std::string range = std::isinf(maxcct) ? Strutil::sprintf("%.0fK and up", mincct) : Strutil::sprintf("%.0fK to %.0fK", mincct, maxcct);
+            print_error("input cct out of range, range of locus: ", range);
+            ap.abort();
+            return EXIT_FAILURE;
+        }
+        if (tool.format != OutputFormat::Text) { // whitepoints and adaptation matrices
+            for (size_t i = 0; i < ccts.size(); ++i) {
+                std::string name = Strutil::sprintf("cct_%g_tint_%g_%s", ccts[i], tool.tint, locus_name(tool.locus));
+                document.add_vector(name + "_whitepoint", whitepoints.data() + i * 2, 2);
+                document.add_matrix(name + "_to_" + output + "_" + runadaptation.suffix, matrices.data() + i * 9);
+            }
+            return write_format() ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (ccts.size() > 1) { // table of adaptation matrices as json lines
+            std::vector<std::string> results;
+            for (size_t i = 0; i < ccts.size(); ++i) {
+                results.push_back(cct_result(ccts[i], tool.tint, output, whitepoints.data() + i * 2, matrices.data() + i * 9));
+            }
+            if (!write_results(results, tool.batchoutput)) {
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
         }
+        Eigen::Vector2d inputwhitepoint(whitepoints.data());
+        print_info("input cct: ", Strutil::sprintf("%gK, tint %g, %s", ccts.front(), tool.tint, locus_name(tool.locus)));
+        print_info("  XY");
+        print_value("    whitepoint: ", inputwhitepoint);
+        print_info("  XYZ");
+        print_value("    whitepoint: ", xy_to_xyz(inputwhitepoint));
+        print_info("output: ", output);
+        print_value("    whitepoint: ", Eigen::Vector2d(target));
+        CacheMatrix adaptation(matrices.data());
+        print_info("whitepoint adaptation: ", runadaptation.name);
+        print_value("    matrix: ", adaptation);
+        print_value("    matrix transposed: ", adaptation.transpose());
         return EXIT_SUCCESS;
     }
     
+    // adaptation, custom and partial adaptation are computed instead of read from cache
+    const AdaptationTransform* adaptationtransform = runadaptation.custom ? runadaptation.transform : nullptr;
+    const double adaptationdegree = runadaptation.degree;
+    const std::string& adaptationname = runadaptation.name;
+    const std::string& adaptationsuffix = runadaptation.suffix;
+    
     // input colorspace
     if (tool.inputcolorspace.size()) {
-        if (!colorspaces.count(tool.inputcolorspace)) {
+        int inputindex = cache.find_colorspace(tool.inputcolorspace);
+        if (inputindex < 0) {
             print_error("unknown input colorspace: ", tool.inputcolorspace);
             ap.abort();
             return EXIT_FAILURE;
         }
         
-        Eigen::Matrix3d inputxyz;
-        Colorspace inputcolorspace = colorspaces[tool.inputcolorspace];
+        CacheMatrix inputxyz(cache.colorspace(inputindex).rgbxyz);
+        CacheMatrix inputrgb(cache.colorspace(inputindex).xyzrgb);
+        Colorspace inputcolorspace = cache_colorspace(cache, inputindex);
         Eigen::Vector3d inputwhitepoint;
         print_info("input colorspace: ", inputcolorspace.name);
         {
@@ -432,6 +2855,7 @@ main( int argc, const char * argv[])
             Eigen::Vector3d b = xy_to_xyz(inputcolorspace.b);
             inputwhitepoint = xy_to_xyz(inputcolorspace.whitepoint);
             if (tool.verbose) {
+                print_info("  trc: ", inputcolorspace.trc);
                 print_info("  XY");
                 print_value("    r: ", inputcolorspace.r);
                 print_value("    g: ", inputcolorspace.g);
@@ -443,27 +2867,29 @@ main( int argc, const char * argv[])
                 print_value("    b: ", b);
                 print_value("    whitepoint: ", inputwhitepoint);
             }
-            inputxyz = rgb_to_xyz(r, g, b, inputwhitepoint);
             print_info("  RGB XYZ");
             print_value("    matrix: ", inputxyz);
             print_value("    matrix transposed: ", inputxyz.transpose());
             print_info("  RGB Y luminance coeff");
             print_value("    vector: ", inputxyz.row(1));
             print_info("  XYZ RGB");
-            print_value("    matrix: ", inputxyz.inverse());
-            print_value("    matrix transposed: ", inputxyz.inverse().transpose());
+            print_value("    matrix: ", inputrgb);
+            print_value("    matrix transposed: ", inputrgb.transpose());
+            format_colorspace(inputcolorspace, inputxyz.data(), inputrgb.data());
         }
         
         // output color space
         if (tool.outputcolorspace.size()) {
-            if (!colorspaces.count(tool.outputcolorspace)) {
+            int outputindex = cache.find_colorspace(tool.outputcolorspace);
+            if (outputindex < 0) {
                 print_error("unknown output colorsoace: ", tool.outputcolorspace);
                 ap.abort();
                 return EXIT_FAILURE;
             }
 
-            Eigen::Matrix3d outputxyz;
-            Colorspace outputcolorspace = colorspaces[tool.outputcolorspace];
+            CacheMatrix outputxyz(cache.colorspace(outputindex).rgbxyz);
+            CacheMatrix outputrgb(cache.colorspace(outputindex).xyzrgb);
+            Colorspace outputcolorspace = cache_colorspace(cache, outputindex);
             Eigen::Vector3d outputwhitepoint;
             print_info("output colorspace: ", outputcolorspace.name);
             {
@@ -473,6 +2899,7 @@ main( int argc, const char * argv[])
                 outputwhitepoint = xy_to_xyz(outputcolorspace.whitepoint);
                 if (tool.verbose) {
                    
+                    print_info("  trc: ", outputcolorspace.trc);
                     print_info("  XY");
                     print_value("    r: ", outputcolorspace.r);
                     print_value("    g: ", outputcolorspace.g);
@@ -484,35 +2911,35 @@ main( int argc, const char * argv[])
                     print_value("    b: ", b);
                     print_value("    whitepoint: ", outputwhitepoint);
                 }
-                outputxyz = rgb_to_xyz(r, g, b, outputwhitepoint);
                 print_info("  RGB XYZ");
                 print_value("    matrix: ", outputxyz);
                 print_value("    matrix transposed: ", outputxyz.transpose());
                 print_info("  RGB Y luminance coeff");
                 print_value("    vector: ", outputxyz.row(1));
                 print_info("  XYZ RGB");
-                print_value("    matrix: ", outputxyz.inverse());
-                print_value("    matrix transposed: ", outputxyz.inverse().transpose());
+                print_value("    matrix: ", outputrgb);
+                print_value("    matrix transposed: ", outputrgb.transpose());
+                format_colorspace(outputcolorspace, outputxyz.data(), outputrgb.data());
             }
 
             // whitepoint adaptation
-            Eigen::Matrix3d adaptation;
-            adaptation = adaptation_matrix(inputwhitepoint, outputwhitepoint, tool.adaptationmethod);
-            std::string adaptationmethod;
+            double adaptationvalues[9], transformvalues[9];
+            const double* adaptationdata;
+            const double* transformdata;
+            if (adaptationtransform) {
+                adaptation_matrix(*adaptationtransform, inputwhitepoint.data(), outputwhitepoint.data(), adaptationdegree, adaptationvalues);
+                transform_matrix(inputcolorspace, outputcolorspace, *adaptationtransform, adaptationdegree, transformvalues);
+                adaptationdata = adaptationvalues;
+                transformdata = transformvalues;
+            } else {
+                adaptationdata = cache.adaptation(cache.colorspace(inputindex).whitepoint, cache.colorspace(outputindex).whitepoint, cache_method(tool.adaptationmethod));
+                transformdata = cache.transform(inputindex, outputindex, cache_method(tool.adaptationmethod));
+            }
+            CacheMatrix adaptation(adaptationdata);
             {
-                if (tool.adaptationmethod == AdaptationMethod::XYZScaling) {
-                    adaptationmethod = "XYZScaling";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::Bradford) {
-                    adaptationmethod = "Bradford";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::Cat02) {
-                    adaptationmethod = "Cat02";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::VonKries) {
-                    adaptationmethod = "VonKries";
-                }
-                print_info("whitepoint adaptation: ", adaptationmethod);
+                std::string transformname = inputcolorspace.name + "_to_" + outputcolorspace.name + "_" + adaptationsuffix;
+                document.add_matrix(transformname + "_adaptation", adaptation.data());
+                print_info("whitepoint adaptation: ", adaptationname);
                 print_value("    matrix: ", adaptation);
                 print_value("    matrix transposed: ", adaptation.transpose());
                 if (tool.verbose) {
@@ -525,14 +2952,180 @@ main( int argc, const char * argv[])
                 }
                 
                 // transform
-                Eigen::Matrix3d transform;
-                transform = outputxyz.inverse() * adaptation * inputxyz;
+                CacheMatrix transform(transformdata);
                 print_info("input to output transformation");
                 print_value("    matrix: ", transform);
                 print_script("  script: ", transform);
                 print_value("    matrix transposed: ", transform.transpose());
                 print_script("  script transposed: ", transform.transpose());
+                document.add_matrix(transformname, transform.data());
+                
+                // precision, the transform computed in the chosen type with its errors
+                long double pixelmatrix[9];
+                std::copy(transform.data(), transform.data() + 9, pixelmatrix);
+                if (tool.precisionreport) {
+                    PrecisionTransform precisiontransform = precision_transform(inputcolorspace, outputcolorspace, *runadaptation.transform, runadaptation.degree, tool.precision);
+                    Eigen::Map<const Eigen::Matrix<long double, 3, 3, Eigen::RowMajor>> precisionmatrix(precisiontransform.matrix);
+                    Eigen::Map<const Eigen::Matrix<long double, 3, 3, Eigen::RowMajor>> precisioninverse(precisiontransform.inverse);
+                    print_info("precision: ", precision_name(tool.precision));
+                    print_precision(precision_digits(tool.precision));
+                    print_value("    matrix: ", precisionmatrix);
+                    print_script("  script: ", precisionmatrix);
+                    print_value("    inverse: ", precisioninverse);
+                    print_precision(6);
+                    print_info("    round trip error: ", Strutil::sprintf("%.3g", precisiontransform.roundtrip));
+                    print_info("    max deviation: ", Strutil::sprintf("%.3g, %.3g, %.3g", precisiontransform.deviation[0], precisiontransform.deviation[1], precisiontransform.deviation[2]));
+                    print_info("    neutral error: ", Strutil::sprintf("%.3g", precisiontransform.neutral));
+                    std::copy(precisiontransform.matrix, precisiontransform.matrix + 9, pixelmatrix);
+                    double precisionvalues[9];
+                    std::copy(precisiontransform.matrix, precisiontransform.matrix + 9, precisionvalues);
+                    document.add_matrix(transformname + "_" + precision_name(tool.precision), precisionvalues);
+                }
+                
+                // transfers, pixel kernels use a float matrix rounded with neutrals kept
+                PixelTransform pixeltransform;
+                {
+                    long double rounded[9];
+                    round_matrix(pixelmatrix, Precision::Float, rounded);
+                    std::copy(rounded, rounded + 9, pixeltransform.matrix);
+                }
+                {
+                    std::string inputtrc = tool.inputtrc.size() ? tool.inputtrc : tool.trc ? inputcolorspace.trc : "Linear";
+                    std::string outputtrc = tool.outputtrc.size() ? tool.outputtrc : tool.trc ? outputcolorspace.trc : "Linear";
+                    if (!parse_transfer(inputtrc, pixeltransform.decode)) {
+                        print_error("unknown input transfer: ", inputtrc);
+                        print_error("supported transfers: ", Strutil::join(transfer_names(), ", "));
+                        ap.abort();
+                        return EXIT_FAILURE;
+                    }
+                    if (!parse_transfer(outputtrc, pixeltransform.encode)) {
+                        print_error("unknown output transfer: ", outputtrc);
+                        print_error("supported transfers: ", Strutil::join(transfer_names(), ", "));
+                        ap.abort();
+                        return EXIT_FAILURE;
+                    }
+                    print_info("input transfer: ", transfer_name(pixeltransform.decode));
+                    print_info("output transfer: ", transfer_name(pixeltransform.encode));
+                }
+                
+                // gamut compression, after the matrix in output rgb
+                if (tool.gamutcompress) {
+                    pixeltransform.gamut = gamut_compression(transform.data(), tool.gamutthreshold, tool.gamutpower);
+                    const GamutCompression& gamut = pixeltransform.gamut;
+                    print_info("gamut compression: ", Strutil::sprintf("threshold %g, power %g", tool.gamutthreshold, tool.gamutpower));
+                    print_value("    limit: ", Eigen::Vector3f(gamut.limit[0], gamut.limit[1], gamut.limit[2]));
+                    if (gamut.limit[0] <= 1.0f && gamut.limit[1] <= 1.0f && gamut.limit[2] <= 1.0f) {
+                        print_info("    input gamut is inside output gamut, no compression");
+                    }
+                }
+                
+                // lut
+                if (tool.lutfile.size()) {
+                    std::string title = Strutil::sprintf("colortool %s %s to %s %s", inputcolorspace.name, transfer_name(pixeltransform.decode), outputcolorspace.name, transfer_name(pixeltransform.encode));
+                    if (!bake_lutfile(pixeltransform, title)) {
+                        ap.abort();
+                        return EXIT_FAILURE;
+                    }
+                }
+                
+                // compare, input with an image in output color space
+                if (tool.compare.size()) {
+                    QualityCheck analysis;
+                    analysis.reference = tool.inputfilename;
+                    analysis.test = tool.compare;
+                    if (!analysis_settings(cache, inputindex, outputindex, pixeltransform.decode, pixeltransform.encode, analysis) || !compare_input(analysis)) {
+                        ap.abort();
+                        return EXIT_FAILURE;
+                    }
+                    analysis.format(document);
+                }
+                
+                // convert
+                else if (tool.inputfilename.size()) {
+                    PixelConversion conversion;
+                    conversion.transforms = { pixeltransform };
+                    WhiteMap whitemap;
+                    if (tool.whitemap.size()) { // replaces the transform, adapted pixel by pixel
+                        phasestats.begin(PhaseIO);
+                        if (!whitemap.read(tool.whitemap)) {
+                            ap.abort();
+                            return EXIT_FAILURE;
+                        }
+                        phasestats.begin(PhaseCompute);
+                        whitemap.adaptation = pixel_adaptation(inputcolorspace, outputcolorspace, *adaptationtransform, adaptationdegree);
+                        whitemap.adaptation.decode = pixeltransform.decode;
+                        whitemap.adaptation.encode = pixeltransform.encode;
+                        conversion.whitemap = &whitemap;
+                        print_info("white map: ", tool.whitemap);
+                        print_info("  resolution: ", Strutil::sprintf("%dx%d, %d channels", whitemap.whites.spec().width, whitemap.whites.spec().height, whitemap.nchannels()));
+                    }
+                    AutoWhiteBalance whitebalance;
+                    if (tool.awb) { // target is the output illuminant if set
+                        int illuminantindex = tool.outputilluminant.size() ? cache.find_illuminant(tool.outputilluminant) : -1;
+                        if (tool.outputilluminant.size() && illuminantindex < 0) {
+                            print_error("unknown output illuminant: ", tool.outputilluminant);
+                            ap.abort();
+                            return EXIT_FAILURE;
+                        }
+                        const double* target = illuminantindex >= 0 ? cache.illuminant(illuminantindex).whitepointxy : cache.colorspace(outputindex).whitepointxy;
+                        whitebalance.settings.method = tool.awbmethod;
+                        whitebalance.settings.percentile = tool.awbpercentile;
+                        whitebalance.settings.step = tool.awbstep;
+                        whitebalance.settings.transfer = pixeltransform.decode;
+                        std::copy(inputxyz.data() + 3, inputxyz.data() + 6, whitebalance.settings.luminance);
+                        whitebalance.smoothing.frames = tool.awbsmoothing;
+                        whitebalance.transform = pixeltransform;
+                        std::copy(inputxyz.data(), inputxyz.data() + 9, whitebalance.rgbxyz);
+                        std::copy(outputrgb.data(), outputrgb.data() + 9, whitebalance.xyzrgb);
+                        std::copy(target, target + 2, whitebalance.target);
+                        whitebalance.adaptation = runadaptation.transform;
+                        whitebalance.degree = runadaptation.degree;
+                        whitebalance.sidecar = tool.awbsidecar.size() ? tool.awbsidecar : whitebalance_sidecar(tool.inputfilename);
+                        std::string key = Strutil::sprintf("%s %s %s %s %d", tool.inputfilename, inputcolorspace.name, transfer_name(pixeltransform.decode), whitebalance_name(tool.awbmethod), tool.awbstep);
+                        if (tool.awbmethod == WhiteBalanceMethod::BrightestPatch) {
+                            key += Strutil::sprintf(" %g", tool.awbpercentile);
+                        }
+                        whitebalance.open(key);
+                        conversion.whitebalance = &whitebalance;
+                    }
+                    QualityCheck analysis;
+                    if (tool.analyze) { // output compared with input
+                        analysis.reference = tool.inputfilename;
+                        analysis.test = tool.outputfilename;
+                        if (!analysis_settings(cache, inputindex, outputindex, pixeltransform.decode, pixeltransform.encode, analysis)) {
+                            ap.abort();
+                            return EXIT_FAILURE;
+                        }
+                        conversion.analysis = &analysis;
+                    }
+                    if (!convert_input(conversion, outputcolorspace.name)) {
+                        ap.abort();
+                        return EXIT_FAILURE;
+                    }
+                    if (tool.analyze) {
+                        analysis.format(document);
+                    }
+                }
+            }
+        }
+        else if (tool.compare.size()) { // compare, both images in input color space
+            std::string inputtrc = tool.inputtrc.size() ? tool.inputtrc : tool.trc ? inputcolorspace.trc : "Linear";
+            Transfer decode;
+            if (!parse_transfer(inputtrc, decode)) {
+                print_error("unknown input transfer: ", inputtrc);
+                print_error("supported transfers: ", Strutil::join(transfer_names(), ", "));
+                ap.abort();
+                return EXIT_FAILURE;
+            }
+            print_info("input transfer: ", transfer_name(decode));
+            QualityCheck analysis;
+            analysis.reference = tool.inputfilename;
+            analysis.test = tool.compare;
+            if (!analysis_settings(cache, inputindex, inputindex, decode, decode, analysis) || !compare_input(analysis)) {
+                ap.abort();
+                return EXIT_FAILURE;
             }
+            analysis.format(document);
         }
         else {
             print_info("no output color space defined, will be skipped.");
@@ -544,14 +3137,14 @@ main( int argc, const char * argv[])
     
     // input illuminant
     if (tool.inputilluminant.size()) {
-        if (!illuminants.count(tool.inputilluminant)) {
+        int inputindex = cache.find_illuminant(tool.inputilluminant);
+        if (inputindex < 0) {
             print_error("unknown input illuminant: ", tool.inputilluminant);
             ap.abort();
             return EXIT_FAILURE;
         }
         
-        Eigen::Matrix3d inputxyz;
-        Illuminant inputilluminant = illuminants[tool.inputilluminant];
+        Illuminant inputilluminant = cache_illuminant(cache, inputindex);
         Eigen::Vector3d inputwhitepoint;
         print_info("input illuminant: ", inputilluminant.name);
         print_info("     description: ", inputilluminant.description);
@@ -563,18 +3156,19 @@ main( int argc, const char * argv[])
             }
             print_info("  XYZ");
             print_value("    whitepoint: ", inputwhitepoint);
+            format_illuminant(inputilluminant);
         }
         
         // output illuminant
         if (tool.outputilluminant.size()) {
-            if (!illuminants.count(tool.outputilluminant)) {
+            int outputindex = cache.find_illuminant(tool.outputilluminant);
+            if (outputindex < 0) {
                 print_error("unknown output illuminant: ", tool.outputilluminant);
                 ap.abort();
                 return EXIT_FAILURE;
             }
 
-            Eigen::Matrix3d outputxyz;
-            Illuminant outputilluminant = illuminants[tool.outputilluminant];
+            Illuminant outputilluminant = cache_illuminant(cache, outputindex);
             Eigen::Vector3d outputwhitepoint;
             print_info("output illuminant: ", outputilluminant.name);
             {
@@ -585,26 +3179,20 @@ main( int argc, const char * argv[])
                 }
                 print_info("  XYZ");
                 print_value("    whitepoint: ", outputwhitepoint);
+                format_illuminant(outputilluminant);
             }
 
             // whitepoint adaptation
-            Eigen::Matrix3d adaptation;
-            adaptation = adaptation_matrix(inputwhitepoint, outputwhitepoint, tool.adaptationmethod);
-            std::string adaptationmethod;
+            double adaptationvalues[9];
+            const double* adaptationdata = cache.adaptation(cache.illuminant(inputindex).whitepoint, cache.illuminant(outputindex).whitepoint, cache_method(tool.adaptationmethod));
+            if (adaptationtransform) {
+                adaptation_matrix(*adaptationtransform, inputwhitepoint.data(), outputwhitepoint.data(), adaptationdegree, adaptationvalues);
+                adaptationdata = adaptationvalues;
+            }
+            CacheMatrix adaptation(adaptationdata);
             {
-                if (tool.adaptationmethod == AdaptationMethod::XYZScaling) {
-                    adaptationmethod = "XYZScaling";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::Bradford) {
-                    adaptationmethod = "Bradford";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::Cat02) {
-                    adaptationmethod = "Cat02";
-                }
-                else if (tool.adaptationmethod == AdaptationMethod::VonKries) {
-                    adaptationmethod = "VonKries";
-                }
-                print_info("whitepoint adaptation: ", adaptationmethod);
+                document.add_matrix(inputilluminant.name + "_to_" + outputilluminant.name + "_" + adaptationsuffix + "_adaptation", adaptation.data());
+                print_info("whitepoint adaptation: ", adaptationname);
                 print_value("    matrix: ", adaptation);
                 print_value("    matrix transposed: ", adaptation.transpose());
                 if (tool.verbose) {
@@ -624,5 +3212,9 @@ main( int argc, const char * argv[])
     else {
         print_info("no input illuminant defined, will be skipped.");
     }
+    if (!write_format()) {
+        ap.abort();
+        return EXIT_FAILURE;
+    }
     return 0;
 }
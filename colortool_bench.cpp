@@ -0,0 +1,1363 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// openimageio
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
+
+using namespace OIIO;
+
+// boost
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+// colortool
+#include "libcolortool/colortool.h"
+#include "libcolortool/jsonreader.h"
+#include "libcolortool/server.h"
+#include "libcolortool/transfer.h"
+
+using namespace colortool;
+
+// bench tool
+struct BenchTool
+{
+    bool help = false;
+    int width = 4096;
+    int height = 2160;
+    int iterations = 10;
+    int entries = 10000;
+    std::string socket;
+    int clients = 4;
+    int requests = 10000;
+    bool latency = false;
+    std::string plate;
+    std::string resources = "resources";
+    std::string json;
+};
+
+static BenchTool tool;
+
+// results, every measurement is recorded as group, name and values and written with
+// --json for regression tracking
+struct BenchRecord
+{
+    std::string group;
+    std::string name;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+static std::vector<BenchRecord> records;
+
+static void
+record(const std::string& group, const std::string& name, std::vector<std::pair<std::string, double>> values)
+{
+    records.push_back({ group, name, std::move(values) });
+}
+
+static std::string
+json_string(const std::string& str)
+{
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+static std::string
+json_number(double value)
+{
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char str[32];
+    std::snprintf(str, sizeof(str), "%.6g", value);
+    return str;
+}
+
+// write records with the settings of the run, one record per line
+static bool
+write_records(const std::string& filename)
+{
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        std::fprintf(stderr, "error: could not open json output: %s\n", filename.c_str());
+        return false;
+    }
+    std::fprintf(file, "{\n    \"kernel\": %s,\n    \"cores\": %u,\n    \"width\": %d,\n    \"height\": %d,\n    \"iterations\": %d,\n    \"results\": [",
+                 json_string(pixel_kernel()->name).c_str(), std::thread::hardware_concurrency(), tool.width, tool.height, tool.iterations);
+    for (size_t i = 0; i < records.size(); ++i) {
+        const BenchRecord& result = records[i];
+        std::string line = "{\"group\": " + json_string(result.group) + ", \"name\": " + json_string(result.name);
+        for (const auto& value : result.values) {
+            line += ", " + json_string(value.first) + ": " + json_number(value.second);
+        }
+        std::fprintf(file, "%s\n        %s}", i ? "," : "", line.c_str());
+    }
+    std::fprintf(file, "\n    ]\n}\n");
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        std::fprintf(stderr, "error: could not write json output: %s\n", filename.c_str());
+        return false;
+    }
+    std::printf("info: results: %s, %zu records\n", filename.c_str(), records.size());
+    return true;
+}
+
+// ap0 to ap1 and back, applied in pairs so values stay bounded between iterations
+static const float forward[9] = {
+     1.4514393161f, -0.2365107469f, -0.2149285693f,
+    -0.0765537734f,  1.1762296998f, -0.0996759264f,
+     0.0083161484f, -0.0060324498f,  0.9977163014f
+};
+
+static const float inverse[9] = {
+     0.6954522414f,  0.1406786965f,  0.1638690622f,
+     0.0447945634f,  0.8596711185f,  0.0955343182f,
+    -0.0055258826f,  0.0040252103f,  1.0015006723f
+};
+
+// layouts
+enum Layout {
+    InterleavedRGB,
+    InterleavedRGBA,
+    Planar
+};
+
+static const char*
+layout_name(Layout layout)
+{
+    switch (layout) {
+        case InterleavedRGB: return "rgb";
+        case InterleavedRGBA: return "rgba";
+        default: return "planar";
+    }
+}
+
+// buffer, planar buffers store r, g and b planes after each other
+template <typename T>
+struct Buffer
+{
+    Layout layout;
+    size_t pixels;
+    int nchannels;
+    std::vector<T> data;
+
+    Buffer(Layout layout, size_t pixels)
+    : layout(layout), pixels(pixels), nchannels(layout == InterleavedRGBA ? 4 : 3), data(pixels * nchannels) {}
+
+    size_t bytes() const { return data.size() * sizeof(T); }
+
+    // channel c of pixel i
+    T& at(size_t i, int c) { return layout == Planar ? data[c * pixels + i] : data[i * nchannels + c]; }
+};
+
+template <typename T>
+static void
+apply(const PixelKernel* kernel, Buffer<T>& buffer, const float* matrix);
+
+template <>
+void
+apply(const PixelKernel* kernel, Buffer<float>& buffer, const float* matrix)
+{
+    if (buffer.layout == Planar) {
+        float* p = buffer.data.data();
+        kernel->matrix_planar_f32(p, p + buffer.pixels, p + 2 * buffer.pixels, buffer.pixels, matrix);
+    } else {
+        kernel->matrix_interleaved_f32(buffer.data.data(), buffer.pixels, buffer.nchannels, matrix);
+    }
+}
+
+template <>
+void
+apply(const PixelKernel* kernel, Buffer<half>& buffer, const float* matrix)
+{
+    if (buffer.layout == Planar) {
+        half* p = buffer.data.data();
+        kernel->matrix_planar_f16(p, p + buffer.pixels, p + 2 * buffer.pixels, buffer.pixels, matrix);
+    } else {
+        kernel->matrix_interleaved_f16(buffer.data.data(), buffer.pixels, buffer.nchannels, matrix);
+    }
+}
+
+struct Result
+{
+    double gbs = 0.0;
+    double maxerror = 0.0;
+};
+
+// throughput counts bytes read and written, error is measured against a double
+// precision reference of a single forward pass
+template <typename T>
+static Result
+bench(const PixelKernel* kernel, Layout layout, size_t pixels, int iterations)
+{
+    Buffer<T> buffer(layout, pixels);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-0.1f, 2.0f);
+    for (T& value : buffer.data) {
+        value = T(dist(rng));
+    }
+    std::vector<double> reference(pixels * 3);
+    for (size_t i = 0; i < pixels; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            double v = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                v += double(forward[c * 3 + k]) * double(float(buffer.at(i, k)));
+            }
+            reference[i * 3 + c] = v;
+        }
+    }
+    Result result;
+    apply(kernel, buffer, forward);
+    for (size_t i = 0; i < pixels; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            result.maxerror = std::max(result.maxerror, std::abs(double(float(buffer.at(i, c))) - reference[i * 3 + c]));
+        }
+    }
+    apply(kernel, buffer, inverse);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        apply(kernel, buffer, forward);
+        apply(kernel, buffer, inverse);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.gbs = 2.0 * 2.0 * iterations * double(buffer.bytes()) / seconds / 1e9;
+    return result;
+}
+
+// transfers, exact is the double precision reference curve. decode error is relative
+// to the linear value, encode error is absolute in encoded values.
+static void
+bench_transfer(const Transfer& transfer, bool encode, size_t count, int iterations)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> input(count);
+    for (float& value : input) {
+        if (encode) { // scene linear, mostly log distributed with a few negatives
+            float u = dist(rng);
+            value = u < 0.1f ? (u - 0.05f) * 0.2f : std::exp2(-14.0f + 20.0f * dist(rng));
+        } else {
+            value = -0.05f + 1.1f * dist(rng);
+        }
+    }
+    std::vector<double> exact(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            exact[j] = encode ? transfer_encode(transfer, input[j]) : transfer_decode(transfer, input[j]);
+        }
+    }
+    double exactseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double exactgbs = 2.0 * iterations * double(count * sizeof(float)) / exactseconds / 1e9;
+    std::printf("info:   %-20s %-6s %-8s %8.2f GB/s %6.2fx\n",
+                transfer_name(transfer).c_str(), encode ? "encode" : "decode", "exact", exactgbs, 1.0);
+    const std::string name = transfer_name(transfer) + (encode ? " encode " : " decode ");
+    record("transfer", name + "exact", { { "gbs", exactgbs } });
+    
+    std::vector<float> values(count);
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        double seconds = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            values = input;
+            auto start = std::chrono::steady_clock::now();
+            if (encode) {
+                kernel->encode_f32(values.data(), count, transfer);
+            } else {
+                kernel->decode_f32(values.data(), count, transfer);
+            }
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double maxerror = 0.0;
+        for (size_t j = 0; j < count; ++j) {
+            double error = std::abs(double(values[j]) - exact[j]);
+            if (!encode) {
+                error /= std::max(std::abs(exact[j]), 1e-4);
+            }
+            maxerror = std::max(maxerror, error);
+        }
+        double gbs = 2.0 * iterations * double(count * sizeof(float)) / seconds / 1e9;
+        std::printf("info:   %-20s %-6s %-8s %8.2f GB/s %6.2fx  max error: %.3g\n",
+                    transfer_name(transfer).c_str(), encode ? "encode" : "decode", kernel->name, gbs, gbs / exactgbs, maxerror);
+        record("transfer", name + kernel->name, { { "gbs", gbs }, { "speedup", gbs / exactgbs }, { "maxerror", maxerror } });
+    }
+}
+
+// plate, rgba pixels of an image or encoded values near neutral like camera footage.
+// saturated corners of the cube map far outside output encodings and are left out.
+static bool
+plate_values(const std::string& filename, size_t pixels, std::vector<float>& values)
+{
+    if (filename.size()) {
+        auto input = ImageInput::open(filename);
+        if (!input) {
+            std::fprintf(stderr, "error: could not open plate: %s\n", OIIO::geterror().c_str());
+            return false;
+        }
+        const ImageSpec& spec = input->spec();
+        std::vector<float> data(spec.image_pixels() * spec.nchannels);
+        if (spec.nchannels < 3 || !input->read_image(0, 0, 0, spec.nchannels, TypeDesc::FLOAT, data.data())) {
+            std::fprintf(stderr, "error: could not read plate with at least 3 channels: %s\n", filename.c_str());
+            return false;
+        }
+        values.resize(spec.image_pixels() * 4);
+        for (size_t i = 0; i < size_t(spec.image_pixels()); ++i) {
+            std::copy(data.data() + i * spec.nchannels, data.data() + i * spec.nchannels + 3, values.data() + i * 4);
+            values[i * 4 + 3] = 1.0f;
+        }
+        return true;
+    }
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f), chroma(-0.05f, 0.05f);
+    values.resize(pixels * 4);
+    for (size_t i = 0; i < pixels; ++i) {
+        float grey = dist(rng);
+        for (int c = 0; c < 4; ++c) {
+            values[i * 4 + c] = std::min(std::max(grey + chroma(rng), 0.0f), 1.0f);
+        }
+    }
+    return true;
+}
+
+// conversions, transforms between builtin colorspaces including transfers with the
+// colortool kernels, the opencolorio cpu processor and luts of a few sizes on the same
+// interleaved rgba plate. error is absolute in encoded values against the exact double
+// precision transform on a subset of the pixels, over all pixels and over pixels with
+// exact values in [0, 1].
+static void
+bench_conversion(const char* input, const char* output, const std::vector<float>& values, int iterations)
+{
+    const BuiltinColorspace& in = builtin_colorspace(find_builtin_colorspace(input));
+    const BuiltinColorspace& out = builtin_colorspace(find_builtin_colorspace(output));
+    const double* matrix = builtin_transform(find_builtin_colorspace(input), find_builtin_colorspace(output), Cat02);
+    PixelTransform transform;
+    parse_transfer(in.trc, transform.decode);
+    parse_transfer(out.trc, transform.encode);
+    std::transform(matrix, matrix + 9, transform.matrix, [](double v) { return static_cast<float>(v); });
+    
+    size_t pixels = values.size() / 4;
+    size_t samples = std::min(pixels, size_t(1) << 18);
+    std::vector<double> exact(samples * 3);
+    std::vector<bool> inrange(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        double rgb[3] = { values[i * 4], values[i * 4 + 1], values[i * 4 + 2] };
+        double* result = exact.data() + i * 3;
+        transform_value(transform, rgb, result);
+        inrange[i] = *std::min_element(result, result + 3) >= 0.0 && *std::max_element(result, result + 3) <= 1.0;
+    }
+    std::string name = std::string(input) + " " + in.trc + " to " + output + " " + out.trc;
+    auto run = [&](const char* kernel, const std::string& method, const std::function<void(float*)>& apply) {
+        std::vector<float> result(values.size());
+        double seconds = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            std::copy(values.begin(), values.end(), result.begin());
+            auto start = std::chrono::steady_clock::now();
+            apply(result.data());
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double maxerror = 0.0, rangeerror = 0.0;
+        for (size_t i = 0; i < samples; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                double error = std::abs(double(result[i * 4 + c]) - exact[i * 3 + c]);
+                maxerror = std::max(maxerror, error);
+                rangeerror = inrange[i] ? std::max(rangeerror, error) : rangeerror;
+            }
+        }
+        double mps = iterations * double(pixels) / seconds / 1e6;
+        std::printf("info:   %-8s %-8s %8.1f Mpixels/s  max error: %.3g, in [0, 1]: %.3g\n", method.c_str(), kernel, mps, maxerror, rangeerror);
+        record("conversion", name + " " + method + " " + kernel, { { "mpixels", mps }, { "maxerror", maxerror }, { "rangeerror", rangeerror } });
+    };
+    std::printf("info:   %s\n", name.c_str());
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        run(kernel->name, "analytic", [&](float* buffer) {
+            kernel->transform_interleaved_f32(buffer, pixels, 4, transform);
+        });
+    }
+    OcioProcessor processor;
+    if (processor.create(transform)) {
+        run("cpu", "ocio", [&](float* buffer) {
+            processor.apply(buffer, pixels, 4);
+        });
+    } else {
+        std::printf("info:   ocio     %s\n", processor.geterror().c_str());
+    }
+    for (int size : { 17, 33, 65 }) {
+        Lut3D lut;
+        auto start = std::chrono::steady_clock::now();
+        bake_lut(transform, size, lut);
+        double bake = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("info:   lut %d baked in %.1f ms\n", size, bake * 1e3);
+        record("conversion", name + " lut " + std::to_string(size) + " bake", { { "ms", bake * 1e3 } });
+        for (const PixelKernel* kernel : pixel_kernels()) {
+            run(kernel->name, "lut " + std::to_string(size), [&](float* buffer) {
+                kernel->lut_interleaved_f32(buffer, pixels, 4, lut.data.data(), lut.size);
+            });
+        }
+    }
+}
+
+// registry, synthetic colorspaces file parsed with property tree into a map as
+// colortool used to and with the registry, followed by a lookup of every name
+static std::string
+synthetic_colorspaces(int entries)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::ostringstream json;
+    json << "{\n";
+    for (int i = 0; i < entries; ++i) {
+        json << "    \"CS" << i << "\": {\n"
+             << "        \"description\": \"synthetic colorspace " << i << "\",\n"
+             << "        \"trc\": \"Linear\",\n"
+             << "        \"primaries\": {\n"
+             << "            \"R\": { \"x\": " << dist(rng) << ", \"y\": " << dist(rng) << " },\n"
+             << "            \"G\": { \"x\": " << dist(rng) << ", \"y\": " << dist(rng) << " },\n"
+             << "            \"B\": { \"x\": " << dist(rng) << ", \"y\": " << dist(rng) << " }\n"
+             << "        },\n"
+             << "        \"whitepoint\": { \"x\": " << dist(rng) << ", \"y\": " << dist(rng) << " }\n"
+             << "    }" << (i < entries - 1 ? "," : "") << "\n";
+    }
+    json << "}\n";
+    return json.str();
+}
+
+struct PtreeColorspace
+{
+    std::string description;
+    std::string trc;
+    double values[8];
+};
+
+static void
+bench_registry(int entries, int iterations)
+{
+    std::string json = synthetic_colorspaces(entries);
+    std::vector<std::string> names;
+    for (int i = 0; i < entries; ++i) {
+        names.push_back("CS" + std::to_string(i));
+    }
+    std::shuffle(names.begin(), names.end(), std::mt19937(42));
+    
+    double ptreeload = 0.0, ptreefind = 0.0;
+    size_t found = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        std::map<std::string, PtreeColorspace> colorspaces;
+        {
+            using namespace boost::property_tree;
+            std::istringstream stream(json);
+            ptree pt;
+            read_json(stream, pt);
+            for (const std::pair<const ptree::key_type, ptree>& item : pt) {
+                const ptree& data = item.second;
+                PtreeColorspace cs;
+                cs.description = data.get<std::string>("description");
+                cs.trc = data.get<std::string>("trc", "Linear");
+                const char* paths[] = { "primaries.R.x", "primaries.R.y", "primaries.G.x", "primaries.G.y",
+                                        "primaries.B.x", "primaries.B.y", "whitepoint.x", "whitepoint.y" };
+                for (int p = 0; p < 8; ++p) {
+                    cs.values[p] = data.get<double>(paths[p], 0.0);
+                }
+                colorspaces[item.first] = cs;
+            }
+        }
+        auto loaded = std::chrono::steady_clock::now();
+        for (const std::string& name : names) {
+            found += colorspaces.count(name);
+        }
+        auto end = std::chrono::steady_clock::now();
+        ptreeload += std::chrono::duration<double>(loaded - start).count();
+        ptreefind += std::chrono::duration<double>(end - loaded).count();
+    }
+    
+    double registryload = 0.0, registryfind = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<RegistryColorspace> colorspaces;
+        std::string error;
+        if (!Registry::parse_colorspaces(json.data(), json.size(), colorspaces, error)) {
+            std::fprintf(stderr, "error: could not parse synthetic colorspaces: %s\n", error.c_str());
+            return;
+        }
+        auto loaded = std::chrono::steady_clock::now();
+        for (const std::string& name : names) {
+            auto it = std::lower_bound(colorspaces.begin(), colorspaces.end(), name, [](const RegistryColorspace& cs, const std::string& name) {
+                return cs.name < name;
+            });
+            found += it != colorspaces.end() && it->name == name;
+        }
+        auto end = std::chrono::steady_clock::now();
+        registryload += std::chrono::duration<double>(loaded - start).count();
+        registryfind += std::chrono::duration<double>(end - loaded).count();
+    }
+    
+    std::printf("info:   entries: %d, size: %.2f MB, found: %zu\n", entries, json.size() / 1e6, found);
+    std::printf("info:   %-10s load: %8.3f ms  lookup: %8.3f ms  total: %8.3f ms\n", "ptree",
+                1e3 * ptreeload / iterations, 1e3 * ptreefind / iterations, 1e3 * (ptreeload + ptreefind) / iterations);
+    std::printf("info:   %-10s load: %8.3f ms  lookup: %8.3f ms  total: %8.3f ms  %6.2fx\n", "registry",
+                1e3 * registryload / iterations, 1e3 * registryfind / iterations, 1e3 * (registryload + registryfind) / iterations,
+                (ptreeload + ptreefind) / (registryload + registryfind));
+    record("registry", "ptree", { { "entries", entries }, { "load_ms", 1e3 * ptreeload / iterations }, { "lookup_ms", 1e3 * ptreefind / iterations } });
+    record("registry", "registry", { { "entries", entries }, { "load_ms", 1e3 * registryload / iterations }, { "lookup_ms", 1e3 * registryfind / iterations } });
+}
+
+// registry dependencies, a full update of all pairs against updates of one changed
+// entry, as by a watched colorspaces file
+static void
+bench_dependency(int entries, int iterations)
+{
+    std::string json = synthetic_colorspaces(entries);
+    std::vector<RegistryColorspace> colorspaces;
+    std::string error;
+    if (!Registry::parse_colorspaces(json.data(), json.size(), colorspaces, error)) {
+        std::fprintf(stderr, "error: could not parse synthetic colorspaces: %s\n", error.c_str());
+        return;
+    }
+    const std::vector<AdaptationMethod> methods = { XYZScaling, Bradford, Cat02, VonKries, Cat16 };
+    const std::vector<RegistryIlluminant> illuminants;
+    
+    double full = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        DependencyGraph graph(methods);
+        auto start = std::chrono::steady_clock::now();
+        graph.update(colorspaces, illuminants);
+        full += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    DependencyGraph graph(methods);
+    graph.update(colorspaces, illuminants);
+    size_t rebuilt = 0;
+    graph.add_artifact("lut", { colorspaces[0].name, colorspaces[1].name }, {}, [&]() {
+        rebuilt++;
+        return true;
+    });
+    double edit = 0.0, description = 0.0;
+    size_t pairs = 0;
+    std::mt19937 rng(42);
+    for (int i = 0; i < iterations; ++i) {
+        RegistryColorspace& cs = colorspaces[rng() % colorspaces.size()];
+        cs.r[0] += 1e-4;
+        auto start = std::chrono::steady_clock::now();
+        DependencyUpdate update = graph.update(colorspaces, illuminants);
+        graph.rebuild(update.artifacts);
+        auto edited = std::chrono::steady_clock::now();
+        cs.description += " edited";
+        graph.rebuild(graph.update(colorspaces, illuminants).artifacts);
+        auto end = std::chrono::steady_clock::now();
+        edit += std::chrono::duration<double>(edited - start).count();
+        description += std::chrono::duration<double>(end - edited).count();
+        pairs += update.pairs;
+    }
+    
+    std::printf("info:   entries: %d, methods: %zu, pairs per edit: %zu, artifact rebuilds: %zu\n", entries, methods.size(), pairs / iterations, rebuilt);
+    std::printf("info:   %-12s %8.3f ms\n", "full", 1e3 * full / iterations);
+    std::printf("info:   %-12s %8.3f ms  %8.1fx\n", "edit", 1e3 * edit / iterations, full / edit);
+    std::printf("info:   %-12s %8.3f ms\n", "description", 1e3 * description / iterations);
+    record("dependency", "full", { { "entries", entries }, { "time_ms", 1e3 * full / iterations } });
+    record("dependency", "edit", { { "entries", entries }, { "time_ms", 1e3 * edit / iterations } });
+    record("dependency", "description", { { "entries", entries }, { "time_ms", 1e3 * description / iterations } });
+}
+
+// registry files, load time of colorspaces.json and illuminants.json of resources and
+// of the builtin colorspace tables, a new registry per iteration
+static void
+bench_registry_files(const std::string& resources, int iterations)
+{
+    const std::string colorspacesfile = resources + "/colorspaces.json";
+    const std::string illuminantsfile = resources + "/illuminants.json";
+    double colorspacesload = 0.0, illuminantsload = 0.0, builtinload = 0.0;
+    size_t colorspaces = 0, illuminants = 0, builtins = 0;
+    for (int i = 0; i < iterations; ++i) {
+        Registry registry(colorspacesfile, illuminantsfile);
+        auto start = std::chrono::steady_clock::now();
+        if (!registry.load_colorspaces()) {
+            std::printf("info:   %s\n", registry.geterror().c_str());
+            return;
+        }
+        auto loaded = std::chrono::steady_clock::now();
+        if (!registry.load_illuminants()) {
+            std::printf("info:   %s\n", registry.geterror().c_str());
+            return;
+        }
+        auto end = std::chrono::steady_clock::now();
+        std::vector<RegistryColorspace> builtin = builtin_registry_colorspaces();
+        auto converted = std::chrono::steady_clock::now();
+        colorspacesload += std::chrono::duration<double>(loaded - start).count();
+        illuminantsload += std::chrono::duration<double>(end - loaded).count();
+        builtinload += std::chrono::duration<double>(converted - end).count();
+        colorspaces = registry.colorspaces().size();
+        illuminants = registry.illuminants().size();
+        builtins = builtin.size();
+    }
+    std::printf("info:   %-18s %6zu entries  load: %8.3f ms\n", "colorspaces.json", colorspaces, 1e3 * colorspacesload / iterations);
+    std::printf("info:   %-18s %6zu entries  load: %8.3f ms\n", "illuminants.json", illuminants, 1e3 * illuminantsload / iterations);
+    std::printf("info:   %-18s %6zu entries  load: %8.3f ms\n", "builtin", builtins, 1e3 * builtinload / iterations);
+    record("registry", "colorspaces.json", { { "entries", double(colorspaces) }, { "load_ms", 1e3 * colorspacesload / iterations } });
+    record("registry", "illuminants.json", { { "entries", double(illuminants) }, { "load_ms", 1e3 * illuminantsload / iterations } });
+    record("registry", "builtin", { { "entries", double(builtins) }, { "load_ms", 1e3 * builtinload / iterations } });
+}
+
+// server load test, clients send transform queries for all colorspace pairs and
+// methods in a loop and the round trip of each request is measured
+static bool
+bench_server(const std::string& socket, int clients, int requests)
+{
+    std::vector<std::string> colorspaces;
+    {
+        Client client;
+        std::string response;
+        if (!client.connect(socket) || !client.request("colorspaces", response)) {
+            std::fprintf(stderr, "error: %s\n", client.geterror().c_str());
+            return false;
+        }
+        JsonReader reader(response.data(), response.size());
+        bool valid = reader.read_object([&](const std::string&) {
+            return reader.read_array([&]() {
+                std::string name;
+                bool valid = reader.read_scalar(name);
+                colorspaces.push_back(name);
+                return valid;
+            });
+        });
+        if (!valid || colorspaces.empty()) {
+            std::fprintf(stderr, "error: could not parse colorspaces: %s\n", reader.error.c_str());
+            return false;
+        }
+    }
+    std::vector<std::string> queries;
+    for (const std::string& input : colorspaces) {
+        for (const std::string& output : colorspaces) {
+            for (const char* method : { "xyzscaling", "bradford", "cat02", "vonkries", "cat16" }) {
+                queries.push_back(input + " " + output + " " + method);
+            }
+        }
+    }
+    
+    std::vector<std::vector<double>> latencies(clients);
+    std::vector<int> failures(clients, 0);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            Client client;
+            if (!client.connect(socket)) {
+                failures[c] = requests;
+                return;
+            }
+            std::string response;
+            latencies[c].reserve(requests);
+            for (int i = 0; i < requests; ++i) {
+                auto begin = std::chrono::steady_clock::now();
+                bool valid = client.request(queries[(size_t(c) * 7919 + i) % queries.size()], response);
+                latencies[c].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+                if (!valid || response.find("\"matrix\"") == std::string::npos) {
+                    ++failures[c];
+                    if (!valid) {
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::vector<double> all;
+    int failed = 0;
+    for (int c = 0; c < clients; ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        failed += failures[c];
+    }
+    if (all.empty()) {
+        std::fprintf(stderr, "error: no requests answered on socket: %s\n", socket.c_str());
+        return false;
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all[std::min(all.size() - 1, size_t(p * all.size()))]; };
+    std::printf("info:   socket: %s, clients: %d, requests: %zu, failed: %d\n", socket.c_str(), clients, all.size(), failed);
+    std::printf("info:   throughput: %.0f requests/s\n", all.size() / seconds);
+    std::printf("info:   latency p50: %.1f us  p90: %.1f us  p99: %.1f us  p99.9: %.1f us  max: %.1f us\n",
+                percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), all.back());
+    record("server", socket, { { "clients", clients }, { "requests", double(all.size()) }, { "failed", failed }, { "throughput", all.size() / seconds },
+                               { "p50_us", percentile(0.5) }, { "p90_us", percentile(0.9) }, { "p99_us", percentile(0.99) },
+                               { "p999_us", percentile(0.999) }, { "max_us", all.back() } });
+    return failed == 0;
+}
+
+// latency, per call time of library functions. iterations are doubled until a run
+// takes at least 0.1 seconds, inputs rotate so calls can not be folded
+template <typename T>
+static inline void
+do_not_optimize(const T& value)
+{
+#if defined(_MSC_VER)
+    static volatile const void* sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r"(&value) : "memory");
+#endif
+}
+
+template <typename F>
+static void
+bench_latency(const char* name, F&& function)
+{
+    size_t iterations = 1;
+    double seconds = 0.0;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds >= 0.1 || iterations >= (size_t(1) << 30)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    std::printf("info:   %-36s %10.1f ns %12zu iterations\n", name, 1e9 * seconds / iterations, iterations);
+    record("latency", name, { { "ns", 1e9 * seconds / iterations }, { "iterations", double(iterations) } });
+}
+
+static Colorspace
+bench_colorspace(const char* name, double rx, double ry, double gx, double gy, double bx, double by, double wx, double wy)
+{
+    Colorspace cs;
+    cs.name = name;
+    cs.r = Eigen::Vector2d(rx, ry);
+    cs.g = Eigen::Vector2d(gx, gy);
+    cs.b = Eigen::Vector2d(bx, by);
+    cs.whitepoint = Eigen::Vector2d(wx, wy);
+    return cs;
+}
+
+static void
+bench_latencies()
+{
+    const Colorspace colorspaces[] = {
+        bench_colorspace("AP0", 0.7347, 0.2653, 0.0, 1.0, 0.0001, -0.0770, 0.32168, 0.33767),
+        bench_colorspace("AP1", 0.713, 0.293, 0.165, 0.830, 0.128, 0.044, 0.32168, 0.33767),
+        bench_colorspace("Rec709", 0.64, 0.33, 0.30, 0.60, 0.15, 0.06, 0.3127, 0.3290),
+        bench_colorspace("P3D65", 0.680, 0.320, 0.265, 0.690, 0.150, 0.060, 0.3127, 0.3290)
+    };
+    const size_t count = sizeof(colorspaces) / sizeof(colorspaces[0]);
+    const AdaptationMethod methods[] = { XYZScaling, Bradford, Cat02, VonKries, Cat16 };
+    const size_t methodcount = sizeof(methods) / sizeof(methods[0]);
+    
+    bench_latency("xy_to_xyz", [&](size_t i) {
+        Eigen::Vector3d xyz = xy_to_xyz(colorspaces[i % count].whitepoint);
+        do_not_optimize(xyz);
+    });
+    bench_latency("rgb_to_xyz", [&](size_t i) {
+        Eigen::Matrix3d m = rgb_to_xyz(colorspaces[i % count]);
+        do_not_optimize(m);
+    });
+    bench_latency("rgb_to_xyz buffer", [&](size_t i) {
+        const Colorspace& cs = colorspaces[i % count];
+        double m[9];
+        rgb_to_xyz(cs.r.data(), cs.g.data(), cs.b.data(), cs.whitepoint.data(), m);
+        do_not_optimize(m);
+    });
+    bench_latency("adaptation_matrix cone", [&](size_t i) {
+        Eigen::Matrix3d m = adaptation_matrix(methods[i % methodcount]);
+        do_not_optimize(m);
+    });
+    bench_latency("adaptation_matrix", [&](size_t i) {
+        Eigen::Matrix3d m = adaptation_matrix(xy_to_xyz(colorspaces[i % count].whitepoint), xy_to_xyz(colorspaces[(i + 1) % count].whitepoint), methods[i % methodcount]);
+        do_not_optimize(m);
+    });
+    bench_latency("adaptation_matrix uncached inverse", [&](size_t i) { // cone inverted per call
+        Eigen::Matrix3d cone = adaptation_matrix(methods[i % methodcount]);
+        Eigen::Vector3d source = cone * xy_to_xyz(colorspaces[i % count].whitepoint);
+        Eigen::Vector3d target = cone * xy_to_xyz(colorspaces[(i + 1) % count].whitepoint);
+        Eigen::Matrix3d m = cone.inverse() * target.cwiseQuotient(source).asDiagonal() * cone;
+        do_not_optimize(m);
+    });
+    const AdaptationTransforms adaptations;
+    bench_latency("adaptation_matrix transform partial", [&](size_t i) {
+        const AdaptationTransform& transform = adaptations.transforms()[i % methodcount];
+        Eigen::Vector3d source = xy_to_xyz(colorspaces[i % count].whitepoint);
+        Eigen::Vector3d target = xy_to_xyz(colorspaces[(i + 1) % count].whitepoint);
+        double m[9];
+        adaptation_matrix(transform, source.data(), target.data(), 0.8, m);
+        do_not_optimize(m);
+    });
+    bench_latency("adaptation_matrix buffer", [&](size_t i) {
+        double m[9];
+        adaptation_matrix(colorspaces[i % count].whitepoint.data(), colorspaces[(i + 1) % count].whitepoint.data(), methods[i % methodcount], m);
+        do_not_optimize(m);
+    });
+    bench_latency("transform_matrix", [&](size_t i) {
+        Eigen::Matrix3d m = transform_matrix(colorspaces[i % count], colorspaces[(i / count) % count], methods[i % methodcount]);
+        do_not_optimize(m);
+    });
+    bench_latency("transform_matrix buffer", [&](size_t i) {
+        double m[9];
+        transform_matrix(colorspaces[i % count], colorspaces[(i / count) % count], methods[i % methodcount], m);
+        do_not_optimize(m);
+    });
+    
+    // cache lookup by name and index
+    TransformCacheBuilder builder;
+    for (const Colorspace& cs : colorspaces) {
+        Eigen::Vector3d whitepoint = xy_to_xyz(cs.whitepoint);
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> rgbxyz = rgb_to_xyz(cs);
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> xyzrgb = rgbxyz.inverse();
+        builder.add_colorspace(cs.name, cs.description, cs.trc, cs.r.data(), cs.g.data(), cs.b.data(),
+                               cs.whitepoint.data(), whitepoint.data(), rgbxyz.data(), xyzrgb.data());
+    }
+    TransformCache cache;
+    cache.open(builder.build(0, methodcount, [](const double* source, const double* target, size_t method, double* matrix) {
+        Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> adaptation(matrix);
+        adaptation = adaptation_matrix(Eigen::Vector3d(source), Eigen::Vector3d(target), AdaptationMethod(XYZScaling + method));
+    }), 0);
+    bench_latency("cache transform by name", [&](size_t i) {
+        int input = cache.find_colorspace(colorspaces[i % count].name);
+        int output = cache.find_colorspace(colorspaces[(i / count) % count].name);
+        const double* m = cache.transform(input, output, i % methodcount);
+        do_not_optimize(m);
+    });
+    bench_latency("cache transform by index", [&](size_t i) {
+        const double* m = cache.transform(i % count, (i / count) % count, i % methodcount);
+        do_not_optimize(m);
+    });
+    
+    // builtin tables
+    bench_latency("builtin transform by name", [&](size_t i) {
+        int input = find_builtin_colorspace(colorspaces[i % count].name);
+        int output = find_builtin_colorspace(colorspaces[(i / count) % count].name);
+        const double* m = builtin_transform(input, output, methods[i % methodcount]);
+        do_not_optimize(m);
+    });
+    bench_latency("builtin transform constexpr", [&](size_t) {
+        constexpr double m00 = BuiltinTables::transform[builtin::AP0][builtin::AP1][Cat02 - XYZScaling][0];
+        double m = m00;
+        do_not_optimize(m);
+    });
+}
+
+template <typename T>
+static void
+bench_layout(const char* type, Layout layout, size_t pixels, int iterations)
+{
+    double scalar = 0.0;
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        Result result = bench<T>(kernel, layout, pixels, iterations);
+        if (kernel->isa == PixelIsa::Scalar) {
+            scalar = result.gbs;
+        }
+        std::printf("info:   %-4s %-7s %-8s %8.2f GB/s %6.2fx  max error: %.3g\n",
+                    type, layout_name(layout), kernel->name, result.gbs, result.gbs / scalar, result.maxerror);
+        record("matrix", std::string(type) + " " + layout_name(layout) + " " + kernel->name,
+               { { "gbs", result.gbs }, { "speedup", result.gbs / scalar }, { "maxerror", result.maxerror } });
+    }
+}
+
+// gamut compression, linear transform between builtin colorspaces with and without
+// compression fused into the matrix pass. error is relative against the double
+// precision reference on a subset of the pixels.
+static void
+bench_gamut(const char* input, const char* output, const std::vector<float>& values, int iterations)
+{
+    const double* matrix = builtin_transform(find_builtin_colorspace(input), find_builtin_colorspace(output), Cat02);
+    PixelTransform transform;
+    std::transform(matrix, matrix + 9, transform.matrix, [](double v) { return static_cast<float>(v); });
+    PixelTransform compressed = transform;
+    compressed.gamut = gamut_compression(matrix);
+    std::printf("info:   %s to %s, limit: %.3f, %.3f, %.3f\n", input, output, compressed.gamut.limit[0], compressed.gamut.limit[1], compressed.gamut.limit[2]);
+    
+    size_t pixels = values.size() / 4;
+    size_t samples = std::min(pixels, size_t(1) << 18);
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        double mps[2] = { 0.0, 0.0 };
+        double maxerror = 0.0;
+        std::vector<float> result(values.size());
+        for (int pass = 0; pass < 2; ++pass) {
+            const PixelTransform& applied = pass ? compressed : transform;
+            double seconds = 0.0;
+            for (int i = 0; i < iterations; ++i) {
+                std::copy(values.begin(), values.end(), result.begin());
+                auto start = std::chrono::steady_clock::now();
+                kernel->transform_interleaved_f32(result.data(), pixels, 4, applied);
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            mps[pass] = iterations * double(pixels) / seconds / 1e6;
+        }
+        for (size_t i = 0; i < samples; ++i) {
+            double rgb[3] = { values[i * 4], values[i * 4 + 1], values[i * 4 + 2] }, exact[3];
+            transform_value(compressed, rgb, exact);
+            for (int c = 0; c < 3; ++c) {
+                maxerror = std::max(maxerror, std::abs(double(result[i * 4 + c]) - exact[c]) / std::max(std::abs(exact[c]), 1.0));
+            }
+        }
+        std::printf("info:   %-8s matrix %8.1f Mpixels/s  compressed %8.1f Mpixels/s  max error: %.3g\n", kernel->name, mps[0], mps[1], maxerror);
+        record("gamut", std::string(input) + " to " + output + " " + kernel->name, { { "mpixels", mps[0] }, { "compressed_mpixels", mps[1] }, { "maxerror", maxerror } });
+    }
+}
+
+// spectral, whitepoints of blackbody illuminants integrated in one product and camera
+// fits of gaussian sensitivities per illuminant, on the synthetic training set and on
+// a larger set of scaled copies spread across patch blocks
+static void
+bench_spectral(int illuminants, int iterations)
+{
+    const Eigen::MatrixXd cmfs = observer_cmfs(Observer::CIE1931);
+    Eigen::MatrixXd spds(spectral_samples, illuminants);
+    for (int i = 0; i < illuminants; ++i) {
+        spds.col(i) = blackbody_spd(2000.0 + 8000.0 * i / std::max(illuminants - 1, 1));
+    }
+    Eigen::MatrixXd camera(spectral_samples, 3);
+    for (int i = 0; i < spectral_samples; ++i) {
+        const double l = spectral_wavelength(i);
+        camera(i, 0) = std::exp(-0.5 * std::pow((l - 600.0) / 35.0, 2.0));
+        camera(i, 1) = std::exp(-0.5 * std::pow((l - 535.0) / 40.0, 2.0));
+        camera(i, 2) = std::exp(-0.5 * std::pow((l - 455.0) / 30.0, 2.0));
+    }
+    const Eigen::MatrixXd reflectances = training_reflectances();
+    Eigen::MatrixXd large(spectral_samples, reflectances.cols() * 20);
+    for (Eigen::Index i = 0; i < large.cols(); ++i) {
+        large.col(i) = reflectances.col(i % reflectances.cols()) * (0.25 + 0.75 * double(i / reflectances.cols()) / 19.0);
+    }
+    
+    double whiteseconds = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        Eigen::MatrixXd whitepoints = spectral_whitepoints(cmfs, spds);
+        whiteseconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        do_not_optimize(whitepoints);
+    }
+    std::printf("info:   whitepoints %6d illuminants %10.3f ms\n", illuminants, 1e3 * whiteseconds / iterations);
+    record("spectral", "whitepoints", { { "illuminants", illuminants }, { "ms", 1e3 * whiteseconds / iterations } });
+    const Eigen::MatrixXd* sets[] = { &reflectances, &large };
+    for (const Eigen::MatrixXd* patches : sets) {
+        double seconds = 0.0, rms = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<CameraFit> fits = fit_cameras(cmfs, camera, spds, *patches);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            rms = fits.back().rms;
+        }
+        const int count = int(patches->cols());
+        std::printf("info:   camera fits %6d illuminants %10.3f ms  patches: %d, rms error: %.3g\n", illuminants, 1e3 * seconds / iterations, count, rms);
+        record("spectral", "camera fits " + std::to_string(count), { { "illuminants", illuminants }, { "patches", count }, { "ms", 1e3 * seconds / iterations }, { "rms", rms } });
+    }
+}
+
+// adaptation, per pixel whites of a plate lit by tungsten on one side and daylight on
+// the other, adapted pixel by pixel to the output whitepoint with cat16. throughput of
+// the planar kernels and interleaved staging against the transform of a single white,
+// error is absolute against the double precision adaptation of each pixel.
+static void
+bench_adaptation(const char* input, const char* output, const std::vector<float>& values, int iterations)
+{
+    const BuiltinColorspace& in = builtin_colorspace(find_builtin_colorspace(input));
+    const BuiltinColorspace& out = builtin_colorspace(find_builtin_colorspace(output));
+    Colorspace incs, outcs;
+    for (Colorspace* cs : { &incs, &outcs }) {
+        const BuiltinColorspace& builtin = cs == &incs ? in : out;
+        cs->name = builtin.name;
+        cs->r = Eigen::Vector2d(builtin.r);
+        cs->g = Eigen::Vector2d(builtin.g);
+        cs->b = Eigen::Vector2d(builtin.b);
+        cs->whitepoint = Eigen::Vector2d(builtin.whitepoint);
+    }
+    const AdaptationTransform transform = adaptation_transform(Cat16);
+    const PixelAdaptation adaptation = pixel_adaptation(incs, outcs, transform, 1.0);
+    
+    // whites in linear input rgb, blended across the plate as rows of a square image
+    const size_t pixels = values.size() / 4;
+    const size_t width = std::max(size_t(std::sqrt(double(pixels))), size_t(1));
+    Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> xyzrgb(in.xyzrgb);
+    const Eigen::Vector3d tungsten = xyzrgb * xy_to_xyz(Eigen::Vector2d(0.44757, 0.40745));
+    const Eigen::Vector3d daylight = xyzrgb * xy_to_xyz(Eigen::Vector2d(0.31271, 0.32902));
+    std::vector<float> whites(pixels * 3);
+    for (size_t i = 0; i < pixels; ++i) {
+        const double t = double(i % width) / double(std::max(width - 1, size_t(1)));
+        for (int c = 0; c < 3; ++c) {
+            whites[i * 3 + c] = static_cast<float>(tungsten[c] * (1.0 - t) + daylight[c] * t);
+        }
+    }
+    
+    // double reference on a subset of the pixels
+    const size_t samples = std::min(pixels, size_t(1) << 16);
+    std::vector<double> exact(samples * 3);
+    Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> rgbxyz(in.rgbxyz), outxyzrgb(out.xyzrgb);
+    const Eigen::Vector3d target = xy_to_xyz(outcs.whitepoint);
+    for (size_t i = 0; i < samples; ++i) {
+        Eigen::Vector3d source = rgbxyz * Eigen::Vector3d(whites[i * 3], whites[i * 3 + 1], whites[i * 3 + 2]);
+        Eigen::Vector3d scaled = target * source[1];
+        double matrix[9];
+        adaptation_matrix(transform, source.data(), scaled.data(), 1.0, matrix);
+        Eigen::Vector3d rgb = outxyzrgb * Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(matrix) * rgbxyz * Eigen::Vector3d(values[i * 4], values[i * 4 + 1], values[i * 4 + 2]);
+        std::copy(rgb.data(), rgb.data() + 3, exact.data() + i * 3);
+    }
+    auto error = [&](const float* r, const float* g, const float* b, size_t stride) {
+        double maxerror = 0.0;
+        for (size_t i = 0; i < samples; ++i) {
+            const float result[3] = { r[i * stride], g[i * stride], b[i * stride] };
+            for (int c = 0; c < 3; ++c) {
+                maxerror = std::max(maxerror, std::abs(double(result[c]) - exact[i * 3 + c]));
+            }
+        }
+        return maxerror;
+    };
+    
+    std::printf("info:   %s to %s, cat16, %zu pixels\n", input, output, pixels);
+    std::vector<float> planes[6];
+    for (int c = 0; c < 3; ++c) {
+        planes[3 + c].resize(pixels);
+        for (size_t i = 0; i < pixels; ++i) {
+            planes[3 + c][i] = whites[i * 3 + c];
+        }
+    }
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        double seconds = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                planes[c].resize(pixels);
+                for (size_t p = 0; p < pixels; ++p) {
+                    planes[c][p] = values[p * 4 + c];
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            kernel->adapt_planar_f32(planes[0].data(), planes[1].data(), planes[2].data(), planes[3].data(), planes[4].data(), planes[5].data(), pixels, adaptation);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        const double mps = iterations * double(pixels) / seconds / 1e6;
+        const double maxerror = error(planes[0].data(), planes[1].data(), planes[2].data(), 1);
+        std::printf("info:   %-8s per pixel planar %8.1f Mpixels/s  max error: %.3g\n", kernel->name, mps, maxerror);
+        record("adaptation", std::string(input) + " to " + output + " planar " + kernel->name, { { "mpixels", mps }, { "maxerror", maxerror } });
+    }
+    
+    // interleaved rgba with the best kernel, staged through tiles, and one white
+    std::vector<float> result(values.size());
+    double seconds[2] = { 0.0, 0.0 };
+    PixelTransform single;
+    {
+        double matrix[9];
+        transform_matrix(incs, outcs, transform, 1.0, matrix);
+        std::transform(matrix, matrix + 9, single.matrix, [](double v) { return static_cast<float>(v); });
+    }
+    for (int pass = 1; pass >= 0; --pass) {
+        for (int i = 0; i < iterations; ++i) {
+            std::copy(values.begin(), values.end(), result.begin());
+            auto start = std::chrono::steady_clock::now();
+            if (pass) {
+                adapt_pixels(result.data(), whites.data(), pixels, 4, 3, adaptation);
+            } else {
+                pixel_kernel()->transform_interleaved_f32(result.data(), pixels, 4, single);
+            }
+            seconds[pass] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (pass) {
+            const double mps = iterations * double(pixels) / seconds[pass] / 1e6;
+            const double maxerror = error(result.data(), result.data() + 1, result.data() + 2, 4);
+            std::printf("info:   %-8s per pixel rgba   %8.1f Mpixels/s  max error: %.3g\n", pixel_kernel()->name, mps, maxerror);
+            record("adaptation", std::string(input) + " to " + output + " interleaved " + pixel_kernel()->name, { { "mpixels", mps }, { "maxerror", maxerror } });
+        }
+    }
+    const double mps = iterations * double(pixels) / seconds[0] / 1e6;
+    std::printf("info:   %-8s single white    %8.1f Mpixels/s\n", pixel_kernel()->name, mps);
+    record("adaptation", std::string(input) + " to " + output + " single " + pixel_kernel()->name, { { "mpixels", mps } });
+}
+
+// analysis, delta e 2000 of the kernels against the double reference on lab pairs from
+// the plate and its conversion, and the whole analysis of the plate as colortool
+// --analyze runs it, reference input and test output adapted to the input white
+static void
+bench_analysis(const char* input, const char* output, const std::vector<float>& values, int iterations)
+{
+    const int inputindex = find_builtin_colorspace(input), outputindex = find_builtin_colorspace(output);
+    const BuiltinColorspace& in = builtin_colorspace(inputindex);
+    const BuiltinColorspace& out = builtin_colorspace(outputindex);
+    const double* matrix = builtin_transform(inputindex, outputindex, Cat02);
+    PixelTransform transform;
+    parse_transfer(in.trc, transform.decode);
+    parse_transfer(out.trc, transform.encode);
+    std::transform(matrix, matrix + 9, transform.matrix, [](double v) { return static_cast<float>(v); });
+    std::vector<float> converted = values;
+    pixel_kernel()->transform_interleaved_f32(converted.data(), converted.size() / 4, 4, transform);
+    
+    AnalysisSettings settings;
+    settings.reference.decode = transform.decode;
+    settings.test.decode = transform.encode;
+    std::copy(in.rgbxyz, in.rgbxyz + 9, settings.reference.rgbxyz);
+    Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> inputxyz(in.rgbxyz), outputxyz(out.rgbxyz);
+    Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> testxyz(settings.test.rgbxyz);
+    testxyz = inputxyz * Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(matrix).inverse();
+    Eigen::Vector3d white = xy_to_xyz(Eigen::Vector2d(in.whitepoint[0], in.whitepoint[1]));
+    std::copy(white.data(), white.data() + 3, settings.white);
+    settings.gamut = true;
+    Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> xyzgamut(settings.xyzgamut);
+    xyzgamut = testxyz.inverse();
+    
+    // lab pairs, planar
+    const size_t pixels = values.size() / 4;
+    std::vector<float> lab[6];
+    for (int n = 0; n < 2; ++n) {
+        const std::vector<float>& source = n ? converted : values;
+        const AnalysisImage& image = n ? settings.test : settings.reference;
+        for (int c = 0; c < 3; ++c) {
+            lab[n * 3 + c].resize(pixels);
+            for (size_t i = 0; i < pixels; ++i) {
+                lab[n * 3 + c][i] = source[i * 4 + c];
+            }
+            pixel_kernel()->decode_f32(lab[n * 3 + c].data(), pixels, image.decode);
+        }
+        float labmatrix[9];
+        lab_matrix(image, settings, labmatrix);
+        pixel_kernel()->lab_planar_f32(lab[n * 3].data(), lab[n * 3 + 1].data(), lab[n * 3 + 2].data(), pixels, labmatrix);
+    }
+    const size_t samples = std::min(pixels, size_t(1) << 18);
+    std::vector<double> exact(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        const double lab1[3] = { lab[0][i], lab[1][i], lab[2][i] }, lab2[3] = { lab[3][i], lab[4][i], lab[5][i] };
+        exact[i] = delta_e2000(lab1, lab2);
+    }
+    
+    std::string name = std::string(input) + " to " + output;
+    std::printf("info:   %s\n", name.c_str());
+    std::vector<float> deltae(pixels);
+    for (const PixelKernel* kernel : pixel_kernels()) {
+        double seconds = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            kernel->deltae2000_planar_f32(lab[0].data(), lab[1].data(), lab[2].data(), lab[3].data(), lab[4].data(), lab[5].data(), deltae.data(), pixels);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double maxerror = 0.0;
+        for (size_t i = 0; i < samples; ++i) {
+            if (std::isfinite(exact[i])) {
+                maxerror = std::max(maxerror, std::abs(double(deltae[i]) - exact[i]));
+            }
+        }
+        double mps = iterations * double(pixels) / seconds / 1e6;
+        std::printf("info:   %-17s %-8s %8.1f Mpixels/s  max error: %.3g\n", "delta e 2000", kernel->name, mps, maxerror);
+        record("analysis", name + " deltae2000 " + kernel->name, { { "mpixels", mps }, { "maxerror", maxerror } });
+    }
+    const int width = 1024, height = int(pixels / width); // rows to spread across threads
+    for (int threads : { 1, 0 }) {
+        double seconds = 0.0;
+        AnalysisStats stats;
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            analyze_images(values.data(), converted.data(), width, height, 4, settings, stats, threads);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double mps = iterations * double(width) * height / seconds / 1e6;
+        std::printf("info:   %-17s %-8s %8.1f Mpixels/s  mean delta e: %.3g, out of gamut: %.2f%%\n", "analysis", threads ? "1 thread" : "all", mps, stats.deltae_mean(), 100.0 * stats.outofgamut_fraction(0));
+        record("analysis", name + (threads ? " 1 thread" : " all threads"), { { "mpixels", mps }, { "deltae", stats.deltae_mean() }, { "outofgamut", stats.outofgamut_fraction(0) } });
+    }
+}
+
+// thread scaling, conversion of rows of an interleaved rgba image with the best kernel
+// spread across the oiio thread pool like colortool, at a few image sizes and thread
+// counts doubled up to all cores. speedup is relative to one thread.
+static void
+bench_threads(const char* input, const char* output, int width, int height, int iterations)
+{
+    const BuiltinColorspace& in = builtin_colorspace(find_builtin_colorspace(input));
+    const BuiltinColorspace& out = builtin_colorspace(find_builtin_colorspace(output));
+    const double* matrix = builtin_transform(find_builtin_colorspace(input), find_builtin_colorspace(output), Cat02);
+    PixelTransform transform;
+    parse_transfer(in.trc, transform.decode);
+    parse_transfer(out.trc, transform.encode);
+    std::transform(matrix, matrix + 9, transform.matrix, [](double v) { return static_cast<float>(v); });
+    
+    std::vector<int> counts;
+    const int cores = std::max(int(std::thread::hardware_concurrency()), 1);
+    for (int threads = 1; threads < cores; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(cores);
+    std::vector<std::pair<int, int>> sizes = { { 256, 256 }, { 1920, 1080 } };
+    if (width * height > 1920 * 1080) {
+        sizes.push_back({ width, height });
+    }
+    std::printf("info:   %s %s to %s %s, kernel: %s\n", input, in.trc, output, out.trc, pixel_kernel()->name);
+    for (const std::pair<int, int>& size : sizes) {
+        const size_t pixels = size_t(size.first) * size.second;
+        std::vector<float> values, result;
+        plate_values(std::string(), pixels, values);
+        result.resize(values.size());
+        double single = 0.0;
+        for (int threads : counts) {
+            double seconds = 0.0;
+            for (int i = 0; i < iterations; ++i) {
+                std::copy(values.begin(), values.end(), result.begin());
+                auto start = std::chrono::steady_clock::now();
+                parallel_for_chunked(0, size.second, 0, [&](int64_t begin, int64_t end) {
+                    for (int64_t y = begin; y < end; ++y) {
+                        pixel_kernel()->transform_interleaved_f32(result.data() + size_t(y) * size.first * 4, size.first, 4, transform);
+                    }
+                }, paropt(threads));
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            double mps = iterations * double(pixels) / seconds / 1e6;
+            single = threads == 1 ? mps : single;
+            std::printf("info:   %5dx%-5d threads: %3d %10.1f Mpixels/s %6.2fx\n", size.first, size.second, threads, mps, mps / single);
+            record("threads", std::to_string(size.first) + "x" + std::to_string(size.second) + " " + std::to_string(threads),
+                   { { "width", size.first }, { "height", size.second }, { "threads", threads }, { "mpixels", mps }, { "speedup", mps / single } });
+        }
+    }
+}
+
+// main
+int
+main(int argc, const char* argv[])
+{
+    ArgParse ap;
+    ap.intro("colortool_bench -- benchmarks for colortool\n");
+    ap.usage("colortool_bench [options]")
+      .add_help(false)
+      .exit_on_error(true);
+    
+    ap.arg("--help", &tool.help)
+      .help("Print help message");
+    
+    ap.arg("--width %d:WIDTH", &tool.width)
+      .help("Image width, default: 4096");
+    
+    ap.arg("--height %d:HEIGHT", &tool.height)
+      .help("Image height, default: 2160");
+    
+    ap.arg("--iterations %d:ITERATIONS", &tool.iterations)
+      .help("Iterations per measurement, default: 10");
+    
+    ap.arg("--entries %d:ENTRIES", &tool.entries)
+      .help("Entries in synthetic colorspaces file, default: 10000");
+    
+    ap.arg("--socket %s:SOCKET", &tool.socket)
+      .help("Load test a colortool --serve socket instead of kernels");
+    
+    ap.arg("--clients %d:CLIENTS", &tool.clients)
+      .help("Concurrent clients for load test, default: 4");
+    
+    ap.arg("--requests %d:REQUESTS", &tool.requests)
+      .help("Requests per client for load test, default: 10000");
+    
+    ap.arg("--latency", &tool.latency)
+      .help("Measure per call latency of library functions only");
+    
+    ap.arg("--plate %s:FILE", &tool.plate)
+      .help("Image used for conversions instead of synthetic pixels");
+    
+    ap.arg("--resources %s:DIR", &tool.resources)
+      .help("Directory of colorspaces.json and illuminants.json, default: resources");
+    
+    ap.arg("--json %s:FILE", &tool.json)
+      .help("Write results as json for regression tracking");
+    
+    if (ap.parse_args(argc, argv) < 0) {
+        std::fprintf(stderr, "error: could not parse arguments: %s\n", ap.geterror().c_str());
+        ap.print_help();
+        return EXIT_FAILURE;
+    }
+    if (tool.help) {
+        ap.print_help();
+        return EXIT_SUCCESS;
+    }
+    
+    // server
+    if (tool.socket.size()) {
+        std::printf("info: colortool_bench -- server\n");
+        bool valid = bench_server(tool.socket, tool.clients, tool.requests);
+        return valid && (tool.json.empty() || write_records(tool.json)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    // latency
+    std::printf("info: colortool_bench -- latency\n");
+    bench_latencies();
+    if (tool.latency) {
+        return tool.json.empty() || write_records(tool.json) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    // registry
+    std::printf("info: colortool_bench -- registry\n");
+    bench_registry_files(tool.resources, tool.iterations);
+    bench_registry(tool.entries, tool.iterations);
+    bench_dependency(std::min(tool.entries, 500), tool.iterations);
+    
+    size_t pixels = size_t(tool.width) * size_t(tool.height);
+    std::printf("info: colortool_bench -- pixel kernels\n");
+    std::printf("info:   pixels: %dx%d, iterations: %d, best kernel: %s\n", tool.width, tool.height, tool.iterations, pixel_kernel()->name);
+    
+    // matrix kernels
+    std::printf("info: matrix\n");
+    for (Layout layout : { InterleavedRGB, InterleavedRGBA, Planar }) {
+        bench_layout<float>("f32", layout, pixels, tool.iterations);
+    }
+    for (Layout layout : { InterleavedRGB, InterleavedRGBA, Planar }) {
+        bench_layout<half>("f16", layout, pixels, tool.iterations);
+    }
+    
+    // transfer kernels
+    std::printf("info: transfer\n");
+    for (const char* name : { "sRGB", "Gamma2.4", "LogC3", "LogC4", "DaVinci Intermediate", "Film 5", "ACEScc", "ACEScct" }) {
+        Transfer transfer;
+        parse_transfer(name, transfer);
+        bench_transfer(transfer, false, pixels, tool.iterations);
+        bench_transfer(transfer, true, pixels, tool.iterations);
+    }
+    
+    // conversions, kernels, ocio and luts
+    std::vector<float> plate;
+    if (!plate_values(tool.plate, pixels, plate)) {
+        return EXIT_FAILURE;
+    }
+    std::printf("info: conversion\n");
+    std::printf("info:   plate: %s, %zu pixels\n", tool.plate.size() ? tool.plate.c_str() : "synthetic", plate.size() / 4);
+    bench_conversion("AWG4", "DWG", plate, tool.iterations);
+    bench_conversion("AWG3", "Rec709", plate, tool.iterations);
+    bench_conversion("GEN5", "AWG3", plate, tool.iterations);
+    
+    // gamut compression
+    std::printf("info: gamut compression\n");
+    bench_gamut("AWG4", "Rec709", plate, tool.iterations);
+    bench_gamut("AP0", "AP1", plate, tool.iterations);
+    
+    // spectral
+    std::printf("info: spectral\n");
+    bench_spectral(500, tool.iterations);
+    
+    // adaptation
+    std::printf("info: adaptation\n");
+    bench_adaptation("AWG4", "Rec709", plate, tool.iterations);
+    
+    // analysis
+    std::printf("info: analysis\n");
+    bench_analysis("AWG4", "Rec709", plate, tool.iterations);
+    
+    // thread scaling
+    std::printf("info: threads\n");
+    bench_threads("AWG4", "Rec709", tool.width, tool.height, tool.iterations);
+    return tool.json.empty() || write_records(tool.json) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,169 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+// colortool
+#include "libcolortool/colormath.h"
+#include "libcolortool/registry.h"
+#include "libcolortool/transformcache.h"
+
+using namespace colortool;
+
+// generates builtin tables from colorspaces json, run at build time
+static const char* usage = "colortool_generate -- generates builtin colorspace tables\n"
+                           "usage: colortool_generate colorspaces.json builtin_tables.h\n";
+
+static std::string
+c_string(const std::string& str)
+{
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+static std::string
+c_identifier(const std::string& name)
+{
+    std::string identifier;
+    for (char c : name) {
+        identifier += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if (identifier.empty() || std::isdigit(static_cast<unsigned char>(identifier[0]))) {
+        identifier = "_" + identifier;
+    }
+    return identifier;
+}
+
+static std::string
+c_values(const double* values, int count)
+{
+    std::string result = "{ ";
+    char value[32];
+    for (int i = 0; i < count; ++i) {
+        std::snprintf(value, sizeof(value), "%.17g", values[i]);
+        result += value;
+        result += i < count - 1 ? ", " : " }";
+    }
+    return result;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    if (argc != 3) {
+        std::cerr << usage;
+        return EXIT_FAILURE;
+    }
+    std::string jsonfile = argv[1];
+    std::string headerfile = argv[2];
+    
+    std::string json;
+    {
+        std::ifstream file(jsonfile, std::ios::binary);
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        json = stream.str();
+    }
+    Registry registry(jsonfile, std::string());
+    if (!registry.load_colorspaces()) {
+        std::cerr << "error: " << registry.geterror() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::vector<RegistryColorspace>& entries = registry.colorspaces();
+    if (entries.empty()) {
+        std::cerr << "error: no colorspaces in file: " << jsonfile << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<Colorspace> colorspaces;
+    for (const RegistryColorspace& entry : entries) {
+        Colorspace cs;
+        cs.name = entry.name;
+        cs.r = Eigen::Vector2d(entry.r);
+        cs.g = Eigen::Vector2d(entry.g);
+        cs.b = Eigen::Vector2d(entry.b);
+        cs.whitepoint = Eigen::Vector2d(entry.whitepoint);
+        colorspaces.push_back(cs);
+    }
+    const AdaptationMethod methods[] = { XYZScaling, Bradford, Cat02, VonKries, Cat16 };
+    
+    std::ostringstream header;
+    header << "// generated by colortool_generate from colorspaces.json, do not edit\n\n"
+           << "#pragma once\n\n"
+           << "namespace colortool {\n\n"
+           << "struct BuiltinTables\n"
+           << "{\n"
+           << "    static constexpr uint64_t hash = " << TransformCache::hash(json.data(), json.size()) << "ull;\n"
+           << "    static constexpr size_t colorspaces = " << colorspaces.size() << ";\n"
+           << "    static constexpr size_t methods = " << sizeof(methods) / sizeof(methods[0]) << ";\n\n"
+           << "    static constexpr BuiltinColorspace colorspace[colorspaces] = {\n";
+    for (size_t i = 0; i < colorspaces.size(); ++i) {
+        const RegistryColorspace& entry = entries[i];
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> rgbxyz = rgb_to_xyz(colorspaces[i]);
+        Eigen::Matrix<double, 3, 3, Eigen::RowMajor> xyzrgb = rgbxyz.inverse();
+        header << "        { " << c_string(entry.name) << ", " << c_string(entry.description) << ", " << c_string(entry.trc) << ",\n"
+               << "          " << c_values(entry.r, 2) << ", " << c_values(entry.g, 2) << ", " << c_values(entry.b, 2) << ", " << c_values(entry.whitepoint, 2) << ",\n"
+               << "          " << c_values(rgbxyz.data(), 9) << ",\n"
+               << "          " << c_values(xyzrgb.data(), 9) << " }" << (i < colorspaces.size() - 1 ? "," : "") << "\n";
+    }
+    header << "    };\n\n"
+           << "    // input, output, adaptation method from XYZScaling\n"
+           << "    static constexpr double transform[colorspaces][colorspaces][methods][9] = {\n";
+    for (size_t i = 0; i < colorspaces.size(); ++i) {
+        header << "        { // " << colorspaces[i].name << "\n";
+        for (size_t o = 0; o < colorspaces.size(); ++o) {
+            header << "            { // " << colorspaces[o].name << "\n";
+            for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); ++m) {
+                double matrix[9];
+                transform_matrix(colorspaces[i], colorspaces[o], methods[m], matrix);
+                header << "                " << c_values(matrix, 9) << (m < sizeof(methods) / sizeof(methods[0]) - 1 ? "," : "") << "\n";
+            }
+            header << "            }" << (o < colorspaces.size() - 1 ? "," : "") << "\n";
+        }
+        header << "        }" << (i < colorspaces.size() - 1 ? "," : "") << "\n";
+    }
+    header << "    };\n"
+           << "};\n\n"
+           << "namespace builtin {\n";
+    std::set<std::string> identifiers;
+    for (size_t i = 0; i < colorspaces.size(); ++i) {
+        std::string identifier = c_identifier(colorspaces[i].name);
+        if (!identifiers.insert(identifier).second) {
+            std::cerr << "error: colorspace name is not unique as identifier: " << colorspaces[i].name << std::endl;
+            return EXIT_FAILURE;
+        }
+        header << "constexpr size_t " << identifier << " = " << i << ";\n";
+    }
+    header << "}\n\n"
+           << "}\n";
+    
+    // unchanged tables are not written to avoid rebuilds
+    std::string content = header.str();
+    {
+        std::ifstream file(headerfile, std::ios::binary);
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        if (file.is_open() && stream.str() == content) {
+            return EXIT_SUCCESS;
+        }
+    }
+    std::ofstream file(headerfile, std::ios::binary | std::ios::trunc);
+    if (!file.write(content.data(), content.size())) {
+        std::cerr << "error: could not write header file: " << headerfile << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,326 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "adaptation.h"
+#include "jsonreader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+const size_t adaptation_tile = 256; // pixels per staging tile
+
+// cone responses of whites scaled partially by degree
+Eigen::Vector3d
+adaptation_scale(const AdaptationTransform& transform, const Eigen::Vector3d& source, const Eigen::Vector3d& target, double degree)
+{
+    Eigen::Map<const RowMatrix3d> cone(transform.cone);
+    Eigen::Vector3d sourcelms = cone * source;
+    Eigen::Vector3d targetlms = cone * target;
+    return (degree * targetlms.cwiseQuotient(sourcelms)).array() + (1.0 - degree);
+}
+
+Eigen::Matrix3d
+adaptation_matrix(const AdaptationTransform& transform, const Eigen::Vector3d& source, const Eigen::Vector3d& target, double degree)
+{
+    Eigen::Map<const RowMatrix3d> cone(transform.cone);
+    Eigen::Map<const RowMatrix3d> inverse(transform.inverse);
+    return inverse * adaptation_scale(transform, source, target, degree).asDiagonal() * cone;
+}
+
+void
+store(const Eigen::Matrix3d& m, double* matrix)
+{
+    Eigen::Map<RowMatrix3d> rowmatrix(matrix);
+    rowmatrix = m;
+}
+
+bool
+parse_number(const std::string& text, double& value)
+{
+    char* last = nullptr;
+    value = std::strtod(text.c_str(), &last);
+    return text.size() && last == text.c_str() + text.size();
+}
+
+// matrix as 3 rows of 3 values or 9 values
+bool
+read_matrix(JsonReader& reader, const std::string& name, double* matrix)
+{
+    int count = 0;
+    std::function<bool()> element = [&]() {
+        if (reader.peek('[')) {
+            return reader.read_array(element);
+        }
+        std::string text;
+        if (!reader.read_scalar(text)) {
+            return false;
+        }
+        if (count == 9) {
+            return reader.fail("too many values in matrix of " + name);
+        }
+        if (!parse_number(text, matrix[count++])) {
+            return reader.fail("invalid value in matrix of " + name);
+        }
+        return true;
+    };
+    if (!reader.read_array(element)) {
+        return false;
+    }
+    return count == 9 || reader.fail("expected 9 values in matrix of " + name);
+}
+
+bool
+read_file(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    data = stream.str();
+    return true;
+}
+
+template <typename T>
+void
+adapt_tiles(T* pixels, const float* whites, size_t count, int nchannels, int wchannels, const PixelAdaptation& adaptation)
+{
+    alignas(64) float r[adaptation_tile], g[adaptation_tile], b[adaptation_tile];
+    alignas(64) float wr[adaptation_tile], wg[adaptation_tile], wb[adaptation_tile];
+    const PixelKernel* kernel = pixel_kernel();
+    for (size_t i = 0; i < count; i += adaptation_tile) {
+        const size_t n = std::min(adaptation_tile, count - i);
+        T* p = pixels + i * nchannels;
+        const float* w = whites + i * wchannels;
+        for (size_t x = 0; x < n; ++x, p += nchannels, w += wchannels) {
+            r[x] = static_cast<float>(p[0]);
+            g[x] = static_cast<float>(p[1]);
+            b[x] = static_cast<float>(p[2]);
+            wr[x] = w[0];
+            wg[x] = w[1];
+            wb[x] = w[2];
+        }
+        kernel->adapt_planar_f32(r, g, b, wr, wg, wb, n, adaptation);
+        p = pixels + i * nchannels;
+        for (size_t x = 0; x < n; ++x, p += nchannels) {
+            p[0] = static_cast<T>(r[x]);
+            p[1] = static_cast<T>(g[x]);
+            p[2] = static_cast<T>(b[x]);
+        }
+    }
+}
+
+}
+
+AdaptationTransform
+adaptation_transform(AdaptationMethod method)
+{
+    AdaptationTransform transform;
+    std::string name = adaptationmethod_name(method);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    transform.name = name;
+    transform.description = std::string("Builtin ") + adaptationmethod_name(method) + " cone response";
+    store(adaptation_matrix(method), transform.cone);
+    store(adaptation_inverse(method), transform.inverse);
+    return transform;
+}
+
+bool
+adaptation_transform(const std::string& name, const std::string& description, const double* cone, AdaptationTransform& transform)
+{
+    Eigen::Map<const RowMatrix3d> matrix(cone);
+    Eigen::FullPivLU<Eigen::Matrix3d> lu(matrix);
+    if (!lu.isInvertible()) {
+        return false;
+    }
+    transform.name = name;
+    transform.description = description;
+    std::copy(cone, cone + 9, transform.cone);
+    store(lu.inverse(), transform.inverse);
+    return true;
+}
+
+double
+adaptation_degree(double luminance, double surround)
+{
+    double degree = surround * (1.0 - (1.0 / 3.6) * std::exp((-luminance - 42.0) / 92.0));
+    return std::min(std::max(degree, 0.0), 1.0);
+}
+
+void
+adaptation_matrix(const AdaptationTransform& transform, const double* source, const double* target, double degree, double* matrix)
+{
+    store(adaptation_matrix(transform, Eigen::Vector3d(source), Eigen::Vector3d(target), degree), matrix);
+}
+
+void
+transform_matrix(const Colorspace& input, const Colorspace& output, const AdaptationTransform& transform, double degree, double* matrix)
+{
+    Eigen::Matrix3d adaptation = adaptation_matrix(transform, xy_to_xyz(input.whitepoint), xy_to_xyz(output.whitepoint), degree);
+    store(rgb_to_xyz(output).inverse() * adaptation * rgb_to_xyz(input), matrix);
+}
+
+PixelAdaptation
+pixel_adaptation(const Colorspace& input, const Colorspace& output, const AdaptationTransform& transform, double degree)
+{
+    Eigen::Map<const RowMatrix3d> cone(transform.cone);
+    Eigen::Map<const RowMatrix3d> inverse(transform.inverse);
+    Eigen::Matrix3d rgbxyz = rgb_to_xyz(input);
+    RowMatrix3d rgblms = cone * rgbxyz;
+    RowMatrix3d lmsrgb = rgb_to_xyz(output).inverse() * inverse;
+    Eigen::Vector3d target = cone * xy_to_xyz(output.whitepoint);
+    PixelAdaptation adaptation;
+    for (int i = 0; i < 9; ++i) {
+        adaptation.rgblms[i] = static_cast<float>(rgblms.data()[i]);
+        adaptation.lmsrgb[i] = static_cast<float>(lmsrgb.data()[i]);
+    }
+    for (int i = 0; i < 3; ++i) {
+        adaptation.luminance[i] = static_cast<float>(rgbxyz(1, i));
+        adaptation.target[i] = static_cast<float>(target[i]);
+    }
+    adaptation.degree = static_cast<float>(std::min(std::max(degree, 0.0), 1.0));
+    return adaptation;
+}
+
+void
+adapt_pixels(float* pixels, const float* whites, size_t count, int nchannels, int wchannels, const PixelAdaptation& adaptation)
+{
+    adapt_tiles(pixels, whites, count, nchannels, wchannels, adaptation);
+}
+
+void
+adapt_pixels(half* pixels, const float* whites, size_t count, int nchannels, int wchannels, const PixelAdaptation& adaptation)
+{
+    adapt_tiles(pixels, whites, count, nchannels, wchannels, adaptation);
+}
+
+AdaptationTransforms::AdaptationTransforms()
+{
+    for (int method = XYZScaling; method <= Cat16; ++method) {
+        transformlist.push_back(adaptation_transform(AdaptationMethod(method)));
+    }
+}
+
+bool
+AdaptationTransforms::read(const std::string& filename)
+{
+    std::string data, err;
+    if (!read_file(filename, data)) {
+        error = "could not open adaptations file: " + filename;
+        return false;
+    }
+    std::vector<AdaptationTransform> transforms;
+    if (!parse(data.data(), data.size(), transforms, err)) {
+        error = "could not parse adaptations file: " + filename + ", " + err;
+        return false;
+    }
+    for (AdaptationTransform& transform : transforms) {
+        auto it = std::find_if(transformlist.begin(), transformlist.end(), [&](const AdaptationTransform& other) {
+            return other.name == transform.name;
+        });
+        if (it != transformlist.end()) {
+            *it = std::move(transform);
+        } else {
+            transformlist.push_back(std::move(transform));
+        }
+    }
+    return true;
+}
+
+const AdaptationTransform*
+AdaptationTransforms::find(const std::string& name) const
+{
+    for (const AdaptationTransform& transform : transformlist) {
+        if (transform.name == name) {
+            return &transform;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string>
+AdaptationTransforms::names() const
+{
+    std::vector<std::string> names;
+    for (const AdaptationTransform& transform : transformlist) {
+        names.push_back(transform.name);
+    }
+    return names;
+}
+
+const std::vector<AdaptationTransform>&
+AdaptationTransforms::transforms() const
+{
+    return transformlist;
+}
+
+const std::string&
+AdaptationTransforms::geterror() const
+{
+    return error;
+}
+
+bool
+AdaptationTransforms::parse(const char* data, size_t size, std::vector<AdaptationTransform>& transforms, std::string& error)
+{
+    transforms.clear();
+    JsonReader reader(data, size);
+    bool valid = reader.read_object([&](const std::string& name) {
+        if (!reader.peek('{')) {
+            return reader.fail("expected object for adaptation: " + name);
+        }
+        std::string description;
+        double cone[9];
+        bool hasdescription = false, hasmatrix = false;
+        bool fields = reader.read_object([&](const std::string& key) {
+            if (key == "description") {
+                hasdescription = true;
+                return reader.read_scalar(description);
+            }
+            if (key == "matrix") {
+                hasmatrix = true;
+                return read_matrix(reader, name, cone);
+            }
+            return reader.skip_value();
+        });
+        if (!fields) {
+            return false;
+        }
+        if (!hasdescription) {
+            return reader.fail("missing description in adaptation: " + name);
+        }
+        if (!hasmatrix) {
+            return reader.fail("missing matrix in adaptation: " + name);
+        }
+        AdaptationTransform transform;
+        if (!adaptation_transform(name, description, cone, transform)) {
+            return reader.fail("singular matrix in adaptation: " + name);
+        }
+        transforms.push_back(std::move(transform));
+        return true;
+    });
+    if (valid && !reader.at_end()) {
+        valid = reader.fail("unexpected data after object");
+    }
+    if (!valid) {
+        error = reader.error;
+        transforms.clear();
+        return false;
+    }
+    return true;
+}
+
+}
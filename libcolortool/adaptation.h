@@ -0,0 +1,89 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "colormath.h"
+#include "pixelkernel.h"
+
+namespace colortool {
+
+// adaptation
+// chromatic adaptation transforms as a cone basis, xyz to lms and its inverse computed
+// once when the transform is made. builtin methods and custom matrices read from json
+// are used the same way. cone responses are scaled by the ratio of target to source
+// white, partially by a degree of adaptation, or by a white per pixel for spatially
+// varying illumination where the scale is formed in the kernels and no matrix is built.
+
+// adaptation transform, 3x3 row major
+struct AdaptationTransform
+{
+    std::string name;
+    std::string description;
+    double cone[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 }; // xyz to lms
+    double inverse[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 }; // lms to xyz
+};
+
+// transform of builtin method, named as on the command line, e.g cat16
+AdaptationTransform adaptation_transform(AdaptationMethod method);
+
+// transform of a cone matrix, false if the matrix is singular
+bool adaptation_transform(const std::string& name, const std::string& description, const double* cone, AdaptationTransform& transform);
+
+// degree of adaptation of cam16 for adapting luminance in cd/m2 and surround factor,
+// 1.0 average, 0.9 dim and 0.8 dark, clamped to [0, 1]
+double adaptation_degree(double luminance, double surround = 1.0);
+
+// adaptation from source to target whitepoint in xyz, degree 1 is full adaptation and
+// 0 none. cone responses are scaled by degree * target / source + 1 - degree
+void adaptation_matrix(const AdaptationTransform& transform, const double* source, const double* target, double degree, double* matrix);
+
+// rgb of input to rgb of output with adaptation of whitepoints
+void transform_matrix(const Colorspace& input, const Colorspace& output, const AdaptationTransform& transform, double degree, double* matrix);
+
+// per pixel adaptation from linear rgb of input with a white per pixel to rgb of output
+// adapted to the output whitepoint, decode and encode are linear
+PixelAdaptation pixel_adaptation(const Colorspace& input, const Colorspace& output, const AdaptationTransform& transform, double degree);
+
+// adapt interleaved pixels with nchannels >= 3 by interleaved whites in linear rgb of
+// input with wchannels >= 3, staged planar through tiles
+void adapt_pixels(float* pixels, const float* whites, size_t count, int nchannels, int wchannels, const PixelAdaptation& adaptation);
+void adapt_pixels(half* pixels, const float* whites, size_t count, int nchannels, int wchannels, const PixelAdaptation& adaptation);
+
+// adaptation transforms
+// builtin methods followed by custom transforms read from json files, e.g
+// { "Sharp": { "description": "...", "matrix": [[...], [...], [...]] } }
+// with the xyz to lms matrix as rows. custom transforms replace builtins of the same name.
+class AdaptationTransforms
+{
+public:
+    AdaptationTransforms();
+
+    // read custom transforms, false and error set if the file could not be read or
+    // parsed, transforms are kept on error
+    bool read(const std::string& filename);
+
+    // transform by name, nullptr if not found
+    const AdaptationTransform* find(const std::string& name) const;
+
+    // names in order, builtins first
+    std::vector<std::string> names() const;
+
+    const std::vector<AdaptationTransform>& transforms() const;
+    const std::string& geterror() const;
+
+    // parse json data, transforms in file order
+    static bool parse(const char* data, size_t size, std::vector<AdaptationTransform>& transforms, std::string& error);
+
+private:
+    std::vector<AdaptationTransform> transformlist;
+    std::string error;
+};
+
+}
@@ -0,0 +1,402 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "analysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+const size_t analysis_tile = 256; // pixels per staging tile
+const int analysis_blockrows = 16; // rows per block of partial sums
+
+// delta e 2000 with the hue terms from the unit hue vectors, multiple angles of the
+// mean hue by recurrence so only the rotation term needs an angle. the simd kernels
+// evaluate the same expressions, see pixelkernel_impl.h
+template <typename T>
+T deltae2000(T l1, T a1, T b1, T l2, T a2, T b2)
+{
+    const T c7 = T(6103515625.0); // 25^7
+    const T cab = (std::sqrt(a1 * a1 + b1 * b1) + std::sqrt(a2 * a2 + b2 * b2)) * T(0.5);
+    const T cab7 = cab * cab * cab * cab * cab * cab * cab;
+    const T g = T(0.5) * (T(1) - std::sqrt(cab7 / (cab7 + c7)));
+    const T ap1 = a1 * (T(1) + g), ap2 = a2 * (T(1) + g);
+    const T cp1 = std::sqrt(ap1 * ap1 + b1 * b1), cp2 = std::sqrt(ap2 * ap2 + b2 * b2);
+
+    // hue difference, dh^2 = da^2 + db^2 - dc^2 which is 4 c1 c2 sin^2(dh / 2) without
+    // the cancellation of the cosine, signed by the sine of the difference
+    const T dap = ap2 - ap1, db = b2 - b1, dcp = cp2 - cp1;
+    const T dh2 = std::sqrt(std::max(dap * dap + db * db - dcp * dcp, T(0)));
+    const T dhp = ap1 * b2 - b1 * ap2 < T(0) ? -dh2 : dh2;
+
+    // mean hue, the bisector of the unit hue vectors, achromatic values have none. for
+    // opposite hues the mean of the angles in [0, 360) as in sharma, the first hue
+    // turned by 90 degrees when it is below 180 and the second otherwise
+    const T u1x = cp1 > T(0) ? ap1 / cp1 : T(0), u1y = cp1 > T(0) ? b1 / cp1 : T(0);
+    const T u2x = cp2 > T(0) ? ap2 / cp2 : T(0), u2y = cp2 > T(0) ? b2 / cp2 : T(0);
+    T hx = u1x + u2x, hy = u1y + u2y;
+    const T length = std::sqrt(hx * hx + hy * hy);
+    if (length > T(1e-6)) {
+        hx /= length;
+        hy /= length;
+    } else {
+        const bool first = b1 > T(0) || (b1 == T(0) && ap1 > T(0));
+        hx = -(first ? u1y : u2y);
+        hy = first ? u1x : u2x;
+    }
+    const T c1h = hx, s1h = hy;
+    const T c2h = c1h * c1h - s1h * s1h, s2h = T(2) * s1h * c1h;
+    const T c3h = c2h * c1h - s2h * s1h, s3h = s2h * c1h + c2h * s1h;
+    const T c4h = c2h * c2h - s2h * s2h, s4h = T(2) * s2h * c2h;
+    const T deg = T(3.14159265358979323846 / 180.0);
+    const T t = T(1) - T(0.17) * (c1h * T(0.86602540378443865) + s1h * T(0.5)) // cos(h - 30)
+        + T(0.24) * c2h + T(0.32) * (c3h * T(0.99452189536827329) - s3h * T(0.10452846326765347)) // cos(3h + 6)
+        - T(0.20) * (c4h * T(0.45399049973954675) + s4h * T(0.89100652418836787)); // cos(4h - 63)
+
+    T hp = std::atan2(hy, hx) / deg;
+    if (hp < T(0)) {
+        hp += T(360);
+    }
+    const T lp = (l1 + l2) * T(0.5) - T(50);
+    const T cp = (cp1 + cp2) * T(0.5);
+    const T cp7 = cp * cp * cp * cp * cp * cp * cp;
+    const T sl = T(1) + T(0.015) * lp * lp / std::sqrt(T(20) + lp * lp);
+    const T sc = T(1) + T(0.045) * cp;
+    const T sh = T(1) + T(0.015) * cp * t;
+    const T theta = T(30) * std::exp(-((hp - T(275)) / T(25)) * ((hp - T(275)) / T(25)));
+    const T rt = -std::sin(T(2) * theta * deg) * T(2) * std::sqrt(cp7 / (cp7 + c7));
+    const T dl = (l2 - l1) / sl, dc = (cp2 - cp1) / sc, dh = dhp / sh;
+    return std::sqrt(std::max(dl * dl + dc * dc + dh * dh + rt * dc * dh, T(0)));
+}
+
+// histogram index of value, nan is not counted
+inline int histogram_bin(float value, int bins, float low, float scale)
+{
+    if (value < low) {
+        return 0;
+    }
+    const float bin = (value - low) * scale;
+    return bin < float(bins) ? int(bin) + 1 : bin >= float(bins) ? bins + 1 : -1;
+}
+
+// tile of an image staged planar, decoded values and linear copies for ictcp
+struct AnalysisTile
+{
+    float r[analysis_tile], g[analysis_tile], b[analysis_tile];
+    float i[analysis_tile], t[analysis_tile], p[analysis_tile];
+    bool finite[analysis_tile];
+};
+
+// a block of rows accumulated into thread stats, double sums of the block are kept
+// apart so they are added in block order
+struct AnalysisKernel
+{
+    const AnalysisSettings& settings;
+    float lab[2][9];
+    float ictcp[2][9];
+    float gamut[2][9];
+    float low;
+    float scale;
+
+    AnalysisKernel(const AnalysisSettings& analysis)
+    : settings(analysis)
+    {
+        const AnalysisImage* images[2] = { &settings.reference, &settings.test };
+        for (int n = 0; n < 2; ++n) {
+            lab_matrix(*images[n], settings, lab[n]);
+            ictcp_matrix(*images[n], settings, ictcp[n]);
+            Eigen::Map<const RowMatrix3d> xyzgamut(settings.xyzgamut);
+            Eigen::Map<const RowMatrix3d> rgbxyz(images[n]->rgbxyz);
+            RowMatrix3d m = xyzgamut * rgbxyz;
+            for (int i = 0; i < 9; ++i) {
+                gamut[n][i] = float(m.data()[i]);
+            }
+        }
+        low = float(settings.low);
+        scale = float(settings.bins / std::max(settings.high - settings.low, 1e-30));
+    }
+
+    // stage, histogram, decode and count out of gamut pixels of a tile
+    template <typename T>
+    void stage(const T* pixels, size_t n, int nchannels, int image, AnalysisTile& tile, AnalysisStats& stats) const
+    {
+        const int bins = settings.bins;
+        uint64_t* histogram = stats.histograms[image].data();
+        const T* p = pixels;
+        for (size_t x = 0; x < n; ++x, p += nchannels) {
+            tile.r[x] = static_cast<float>(p[0]);
+            tile.g[x] = static_cast<float>(p[1]);
+            tile.b[x] = static_cast<float>(p[2]);
+        }
+        if (bins > 0) {
+            const float* channels[3] = { tile.r, tile.g, tile.b };
+            for (int c = 0; c < 3; ++c) {
+                uint64_t* counts = histogram + c * (bins + 2);
+                for (size_t x = 0; x < n; ++x) {
+                    int bin = histogram_bin(channels[c][x], bins, low, scale);
+                    if (bin >= 0) {
+                        counts[bin]++;
+                    }
+                }
+            }
+        }
+        const Transfer& decode = image ? settings.test.decode : settings.reference.decode;
+        if (decode.type != TransferType::Linear) {
+            pixel_kernel()->decode_f32(tile.r, n, decode);
+            pixel_kernel()->decode_f32(tile.g, n, decode);
+            pixel_kernel()->decode_f32(tile.b, n, decode);
+        }
+        const float* m = gamut[image];
+        const float tolerance = float(-settings.tolerance);
+        uint64_t samples = 0, outside = 0;
+        for (size_t x = 0; x < n; ++x) {
+            const float r = tile.r[x], g = tile.g[x], b = tile.b[x];
+            const bool finite = std::isfinite(r) && std::isfinite(g) && std::isfinite(b);
+            tile.finite[x] = finite;
+            samples += finite;
+            if (settings.gamut && finite) {
+                const float tr = m[0] * r + m[1] * g + m[2] * b;
+                const float tg = m[3] * r + m[4] * g + m[5] * b;
+                const float tb = m[6] * r + m[7] * g + m[8] * b;
+                outside += tr < tolerance || tg < tolerance || tb < tolerance;
+            }
+        }
+        stats.samples[image] += samples;
+        stats.outofgamut[image] += outside;
+    }
+
+    // cielab in r, g, b and ictcp in i, t, p
+    void convert(AnalysisTile& tile, size_t n, int image) const
+    {
+        std::copy(tile.r, tile.r + n, tile.i);
+        std::copy(tile.g, tile.g + n, tile.t);
+        std::copy(tile.b, tile.b + n, tile.p);
+        pixel_kernel()->lab_planar_f32(tile.r, tile.g, tile.b, n, lab[image]);
+        pixel_kernel()->ictcp_planar_f32(tile.i, tile.t, tile.p, n, ictcp[image]);
+    }
+
+    template <typename T>
+    void rows(const T* reference, const T* test, int width, int begin, int end, int nchannels, AnalysisStats& stats, double* sums) const
+    {
+        AnalysisTile tiles[2];
+        float deltae[analysis_tile];
+        uint64_t* deltaes = stats.deltaes.data();
+        const float threshold = float(settings.threshold), deltascale = float(1.0 / analysis_deltastep);
+        const size_t rowvalues = size_t(width) * nchannels;
+        for (int y = begin; y < end; ++y) {
+            for (size_t x = 0; x < size_t(width); x += analysis_tile) {
+                const size_t n = std::min(analysis_tile, size_t(width) - x);
+                const size_t offset = size_t(y) * rowvalues + x * nchannels;
+                stage(reference + offset, n, nchannels, 0, tiles[0], stats);
+                if (!test) {
+                    continue;
+                }
+                stage(test + offset, n, nchannels, 1, tiles[1], stats);
+                convert(tiles[0], n, 0);
+                convert(tiles[1], n, 1);
+                const AnalysisTile& t0 = tiles[0];
+                const AnalysisTile& t1 = tiles[1];
+                pixel_kernel()->deltae2000_planar_f32(t0.r, t0.g, t0.b, t1.r, t1.g, t1.b, deltae, n);
+                float sum = 0.0f, itpsum = 0.0f, max = 0.0f, itpmax = 0.0f;
+                uint64_t visible = 0, pixels = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    if (!t0.finite[i] || !t1.finite[i]) {
+                        continue;
+                    }
+                    const float de = deltae[i];
+                    const float di = t1.i[i] - t0.i[i], dt = (t1.t[i] - t0.t[i]) * 0.5f, dp = t1.p[i] - t0.p[i];
+                    const float itp = 720.0f * std::sqrt(di * di + dt * dt + dp * dp);
+                    sum += de;
+                    itpsum += itp;
+                    max = std::max(max, de);
+                    itpmax = std::max(itpmax, itp);
+                    visible += de > threshold;
+                    deltaes[std::min(int(de * deltascale), analysis_deltabins - 1)]++;
+                    pixels++;
+                }
+                sums[0] += sum;
+                sums[1] += itpsum;
+                stats.deltaemax = std::max(stats.deltaemax, double(max));
+                stats.deltaitpmax = std::max(stats.deltaitpmax, double(itpmax));
+                stats.visible += visible;
+                stats.pixels += pixels;
+            }
+        }
+    }
+};
+
+void init_stats(AnalysisStats& stats, int bins)
+{
+    stats.bins = bins;
+    stats.deltaes.assign(analysis_deltabins, 0);
+    stats.histograms[0].assign(size_t(std::max(bins, 0) + 2) * 3, 0);
+    stats.histograms[1].assign(size_t(std::max(bins, 0) + 2) * 3, 0);
+}
+
+template <typename T>
+void analyze(const T* reference, const T* test, int width, int height, int nchannels, const AnalysisSettings& settings, AnalysisStats& stats, int threads)
+{
+    if (stats.deltaes.empty()) {
+        init_stats(stats, settings.bins);
+    }
+    if (width <= 0 || height <= 0 || nchannels < 3) {
+        return;
+    }
+    // blocks of rows are interleaved across threads, counts go to stats of the thread
+    // and double sums to the block
+    const AnalysisKernel kernel(settings);
+    const int blocks = (height + analysis_blockrows - 1) / analysis_blockrows;
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::min(count, blocks);
+    std::vector<AnalysisStats> partials(count);
+    std::vector<double> sums(size_t(blocks) * 2, 0.0);
+    auto compute = [&](int index) {
+        AnalysisStats& partial = partials[index];
+        init_stats(partial, settings.bins);
+        for (int block = index; block < blocks; block += count) {
+            const int begin = block * analysis_blockrows, end = std::min(begin + analysis_blockrows, height);
+            kernel.rows(reference, test, width, begin, end, nchannels, partial, sums.data() + size_t(block) * 2);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(compute, i);
+    }
+    compute(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    for (const AnalysisStats& partial : partials) {
+        stats.add(partial);
+    }
+    for (int block = 0; block < blocks; ++block) {
+        stats.deltae += sums[size_t(block) * 2];
+        stats.deltaitp += sums[size_t(block) * 2 + 1];
+    }
+}
+
+}
+
+void
+AnalysisStats::add(const AnalysisStats& other)
+{
+    if (deltaes.empty()) {
+        init_stats(*this, other.bins);
+    }
+    pixels += other.pixels;
+    deltae += other.deltae;
+    deltaemax = std::max(deltaemax, other.deltaemax);
+    deltaitp += other.deltaitp;
+    deltaitpmax = std::max(deltaitpmax, other.deltaitpmax);
+    visible += other.visible;
+    for (size_t i = 0; i < std::min(deltaes.size(), other.deltaes.size()); ++i) {
+        deltaes[i] += other.deltaes[i];
+    }
+    for (int n = 0; n < 2; ++n) {
+        samples[n] += other.samples[n];
+        outofgamut[n] += other.outofgamut[n];
+        for (size_t i = 0; i < std::min(histograms[n].size(), other.histograms[n].size()); ++i) {
+            histograms[n][i] += other.histograms[n][i];
+        }
+    }
+}
+
+double
+AnalysisStats::deltae_mean() const
+{
+    return pixels ? deltae / double(pixels) : 0.0;
+}
+
+double
+AnalysisStats::deltaitp_mean() const
+{
+    return pixels ? deltaitp / double(pixels) : 0.0;
+}
+
+double
+AnalysisStats::visible_fraction() const
+{
+    return pixels ? double(visible) / double(pixels) : 0.0;
+}
+
+double
+AnalysisStats::outofgamut_fraction(int image) const
+{
+    return samples[image] ? double(outofgamut[image]) / double(samples[image]) : 0.0;
+}
+
+double
+AnalysisStats::deltae_percentile(double percentile) const
+{
+    if (!pixels) {
+        return 0.0;
+    }
+    const double target = std::min(std::max(percentile, 0.0), 1.0) * double(pixels);
+    uint64_t sum = 0;
+    for (int i = 0; i < int(deltaes.size()); ++i) {
+        sum += deltaes[i];
+        if (sum > 0 && double(sum) >= target) {
+            return i + 1 < analysis_deltabins ? std::min((i + 1) * analysis_deltastep, deltaemax) : deltaemax;
+        }
+    }
+    return deltaemax;
+}
+
+double
+delta_e2000(const double* lab1, const double* lab2)
+{
+    return deltae2000<double>(lab1[0], lab1[1], lab1[2], lab2[0], lab2[1], lab2[2]);
+}
+
+void
+lab_matrix(const AnalysisImage& image, const AnalysisSettings& settings, float* matrix)
+{
+    Eigen::Map<const RowMatrix3d> rgbxyz(image.rgbxyz);
+    const Eigen::Vector3d white(settings.white[0], settings.white[1], settings.white[2]);
+    RowMatrix3d m = white.cwiseInverse().asDiagonal() * rgbxyz;
+    for (int i = 0; i < 9; ++i) {
+        matrix[i] = float(m.data()[i]);
+    }
+}
+
+void
+ictcp_matrix(const AnalysisImage& image, const AnalysisSettings& settings, float* matrix)
+{
+    // bt.2020 primaries and d65, lms crosstalk matrix of bt.2100
+    const Eigen::Vector3d d65 = xy_to_xyz(Eigen::Vector2d(0.3127, 0.3290));
+    const Eigen::Matrix3d rec2020 = rgb_to_xyz(xy_to_xyz(Eigen::Vector2d(0.708, 0.292)), xy_to_xyz(Eigen::Vector2d(0.170, 0.797)),
+                                               xy_to_xyz(Eigen::Vector2d(0.131, 0.046)), d65);
+    Eigen::Matrix3d rgblms;
+    rgblms << 1688.0, 2146.0, 262.0,
+              683.0, 2951.0, 462.0,
+              99.0, 309.0, 3688.0;
+    rgblms /= 4096.0;
+    const Eigen::Vector3d white(settings.white[0], settings.white[1], settings.white[2]);
+    Eigen::Map<const RowMatrix3d> rgbxyz(image.rgbxyz);
+    RowMatrix3d m = (settings.luminance / 10000.0) * rgblms * rec2020.inverse() * adaptation_matrix(white, d65, AdaptationMethod::Bradford) * rgbxyz;
+    for (int i = 0; i < 9; ++i) {
+        matrix[i] = float(m.data()[i]);
+    }
+}
+
+void
+analyze_images(const float* reference, const float* test, int width, int height, int nchannels, const AnalysisSettings& settings, AnalysisStats& stats, int threads)
+{
+    analyze(reference, test, width, height, nchannels, settings, stats, threads);
+}
+
+void
+analyze_images(const half* reference, const half* test, int width, int height, int nchannels, const AnalysisSettings& settings, AnalysisStats& stats, int threads)
+{
+    analyze(reference, test, width, height, nchannels, settings, stats, threads);
+}
+
+}
@@ -0,0 +1,95 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "colormath.h"
+#include "pixelkernel.h"
+#include "transfer.h"
+
+namespace colortool {
+
+// image analysis
+// a test image compared to a reference in cielab and ictcp with delta e statistics,
+// pixels outside the gamut of a target colorspace and histograms of channel values.
+// rows are converted in tiles with the simd kernels and spread across threads with an
+// accumulator per block, combined in block order so results do not depend on the
+// thread count.
+
+// how pixels of an image reach xyz, decoded to linear and by matrix to xyz of the
+// analysis white
+struct AnalysisImage
+{
+    Transfer decode;
+    double rgbxyz[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 }; // 3x3 row major
+};
+
+// analysis settings
+struct AnalysisSettings
+{
+    AnalysisImage reference;
+    AnalysisImage test;
+    double white[3] = { 0.95047, 1.0, 1.08883 }; // xyz of the analysis white, Y = 1
+    double luminance = 100.0; // cd/m2 of Y = 1 for ictcp
+    double threshold = 1.0; // delta e 2000 counted as visible above
+    bool gamut = false; // count pixels outside the target gamut
+    double xyzgamut[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 }; // xyz to rgb of target
+    double tolerance = 1e-4; // target rgb below -tolerance is outside the gamut
+    int bins = 16; // histogram bins of encoded channel values in [low, high)
+    double low = 0.0;
+    double high = 1.0;
+};
+
+// delta e histogram for percentiles, bins of 0.01 up to 20 and one for larger values
+const int analysis_deltabins = 2001;
+const double analysis_deltastep = 0.01;
+
+// accumulated statistics, added image by image and frame by frame. histograms have
+// bins + 2 counts per channel, values below low, the bins and values at or above high.
+struct AnalysisStats
+{
+    uint64_t pixels = 0; // compared pixels with finite values
+    double deltae = 0.0; // sum of delta e 2000
+    double deltaemax = 0.0;
+    double deltaitp = 0.0; // sum of delta e itp
+    double deltaitpmax = 0.0;
+    uint64_t visible = 0; // delta e 2000 above threshold
+    std::vector<uint64_t> deltaes; // delta e 2000 histogram
+    uint64_t samples[2] = { 0, 0 }; // analyzed pixels of reference and test
+    uint64_t outofgamut[2] = { 0, 0 };
+    std::vector<uint64_t> histograms[2]; // 3 channels of bins + 2
+    int bins = 0;
+
+    // add statistics of the same settings
+    void add(const AnalysisStats& other);
+
+    // means, fractions and percentile in [0, 1] of delta e 2000 from the histogram,
+    // accurate to a bin
+    double deltae_mean() const;
+    double deltaitp_mean() const;
+    double visible_fraction() const;
+    double outofgamut_fraction(int image) const;
+    double deltae_percentile(double percentile) const;
+};
+
+// delta e 2000 of cielab values, sharma, wu and dalal formulation
+double delta_e2000(const double* lab1, const double* lab2);
+
+// matrices of the kernels for settings, rgb to lab with the white divided out and rgb
+// to lms of ictcp with bradford adaptation of the white to d65 and 1 = 10000 cd/m2
+void lab_matrix(const AnalysisImage& image, const AnalysisSettings& settings, float* matrix);
+void ictcp_matrix(const AnalysisImage& image, const AnalysisSettings& settings, float* matrix);
+
+// analyze interleaved pixels, height rows of width pixels with nchannels >= 3. test is
+// compared with reference when set, nullptr for gamut and histograms of reference only.
+// rows are spread across threads, 0 for all cores, and added to stats.
+void analyze_images(const float* reference, const float* test, int width, int height, int nchannels, const AnalysisSettings& settings, AnalysisStats& stats, int threads = 0);
+void analyze_images(const half* reference, const half* test, int width, int height, int nchannels, const AnalysisSettings& settings, AnalysisStats& stats, int threads = 0);
+
+}
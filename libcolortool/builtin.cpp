@@ -0,0 +1,72 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "builtin.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace colortool {
+
+constexpr BuiltinColorspace BuiltinTables::colorspace[];
+constexpr double BuiltinTables::transform[][BuiltinTables::colorspaces][BuiltinTables::methods][9];
+
+size_t
+builtin_colorspaces()
+{
+    return BuiltinTables::colorspaces;
+}
+
+const BuiltinColorspace&
+builtin_colorspace(size_t index)
+{
+    return BuiltinTables::colorspace[index];
+}
+
+int
+find_builtin_colorspace(const std::string& name)
+{
+    const BuiltinColorspace* begin = BuiltinTables::colorspace;
+    const BuiltinColorspace* end = begin + BuiltinTables::colorspaces;
+    const BuiltinColorspace* it = std::lower_bound(begin, end, name, [](const BuiltinColorspace& cs, const std::string& name) {
+        return std::strcmp(cs.name, name.c_str()) < 0;
+    });
+    return it != end && name == it->name ? static_cast<int>(it - begin) : -1;
+}
+
+const double*
+builtin_transform(size_t input, size_t output, AdaptationMethod method)
+{
+    if (method < XYZScaling || method > Cat16) {
+        return nullptr;
+    }
+    return BuiltinTables::transform[input][output][method - XYZScaling];
+}
+
+uint64_t
+builtin_hash()
+{
+    return BuiltinTables::hash;
+}
+
+std::vector<RegistryColorspace>
+builtin_registry_colorspaces()
+{
+    std::vector<RegistryColorspace> colorspaces;
+    for (const BuiltinColorspace& builtin : BuiltinTables::colorspace) {
+        RegistryColorspace cs;
+        cs.name = builtin.name;
+        cs.description = builtin.description;
+        cs.trc = builtin.trc;
+        std::copy(builtin.r, builtin.r + 2, cs.r);
+        std::copy(builtin.g, builtin.g + 2, cs.g);
+        std::copy(builtin.b, builtin.b + 2, cs.b);
+        std::copy(builtin.whitepoint, builtin.whitepoint + 2, cs.whitepoint);
+        colorspaces.push_back(cs);
+    }
+    return colorspaces;
+}
+
+}
@@ -0,0 +1,61 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include "colormath.h"
+#include "registry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace colortool {
+
+// builtin colorspace, matrices are 3x3 row major
+struct BuiltinColorspace
+{
+    const char* name;
+    const char* description;
+    const char* trc;
+    double r[2];
+    double g[2];
+    double b[2];
+    double whitepoint[2];
+    double rgbxyz[9];
+    double xyzrgb[9];
+};
+
+}
+
+// builtin tables
+// generated at build time from resources/colorspaces.json by colortool_generate,
+// BuiltinTables holds the colorspaces sorted by name and transforms between every
+// pair for each adaptation method as constexpr data, and namespace builtin holds
+// an index constant per colorspace, e.g builtin::AP0.
+#include "libcolortool/builtin_tables.h"
+
+namespace colortool {
+
+// number of builtin colorspaces
+size_t builtin_colorspaces();
+
+// builtin colorspace at index
+const BuiltinColorspace& builtin_colorspace(size_t index);
+
+// index of name, -1 if not found
+int find_builtin_colorspace(const std::string& name);
+
+// transform from input to output builtin colorspace, nullptr for method None
+const double* builtin_transform(size_t input, size_t output, AdaptationMethod method);
+
+// content hash of the colorspaces json the tables were generated from
+uint64_t builtin_hash();
+
+// builtin colorspaces as registry entries
+std::vector<RegistryColorspace> builtin_registry_colorspaces();
+
+}
@@ -0,0 +1,225 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "cct.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+// locus point in cie 1960 uv with unit normal of the isotemperature line
+struct LocusPoint
+{
+    double mired;
+    double u, v;
+    double nu, nv;
+};
+
+// robertson isotemperature lines, mired, u, v and slope of the line, integrated
+// from planck's law and the cie 1931 observer
+const double robertson[31][4] = {
+    {   0.0, 0.18006, 0.26352, -0.24341 },
+    {  10.0, 0.18066, 0.26589, -0.25479 },
+    {  20.0, 0.18133, 0.26846, -0.26876 },
+    {  30.0, 0.18208, 0.27119, -0.28539 },
+    {  40.0, 0.18293, 0.27407, -0.30470 },
+    {  50.0, 0.18388, 0.27709, -0.32675 },
+    {  60.0, 0.18494, 0.28021, -0.35156 },
+    {  70.0, 0.18611, 0.28342, -0.37915 },
+    {  80.0, 0.18740, 0.28668, -0.40955 },
+    {  90.0, 0.18880, 0.28997, -0.44278 },
+    { 100.0, 0.19032, 0.29326, -0.47888 },
+    { 125.0, 0.19462, 0.30141, -0.58204 },
+    { 150.0, 0.19962, 0.30921, -0.70471 },
+    { 175.0, 0.20525, 0.31647, -0.84901 },
+    { 200.0, 0.21142, 0.32312, -1.0182 },
+    { 225.0, 0.21807, 0.32909, -1.2168 },
+    { 250.0, 0.22511, 0.33439, -1.4512 },
+    { 275.0, 0.23247, 0.33904, -1.7298 },
+    { 300.0, 0.24010, 0.34308, -2.0637 },
+    { 325.0, 0.24792, 0.34655, -2.4681 },
+    { 350.0, 0.25591, 0.34951, -2.9641 },
+    { 375.0, 0.26400, 0.35200, -3.5814 },
+    { 400.0, 0.27218, 0.35407, -4.3633 },
+    { 425.0, 0.28039, 0.35577, -5.3762 },
+    { 450.0, 0.28863, 0.35714, -6.7262 },
+    { 475.0, 0.29685, 0.35823, -8.5955 },
+    { 500.0, 0.30505, 0.35907, -11.324 },
+    { 525.0, 0.31320, 0.35968, -15.628 },
+    { 550.0, 0.32129, 0.36011, -23.325 },
+    { 575.0, 0.32931, 0.36038, -40.770 },
+    { 600.0, 0.33724, 0.36051, -116.45 }
+};
+
+const double tintscale = -3000.0;
+const double daylightmin = 4000.0;
+const double daylightmax = 25000.0;
+const double daylightstep = 2.5; // mired
+
+// cie daylight locus xy
+void daylight_xy(double cct, double* xy)
+{
+    const double t = 1.0 / cct;
+    xy[0] = cct <= 7000.0
+        ? ((-4.6070e9 * t + 2.9678e6) * t + 0.09911e3) * t + 0.244063
+        : ((-2.0064e9 * t + 1.9018e6) * t + 0.24748e3) * t + 0.237040;
+    xy[1] = (-3.0 * xy[0] + 2.870) * xy[0] - 0.275;
+}
+
+void xy_to_uv(const double* xy, double& u, double& v)
+{
+    const double d = -2.0 * xy[0] + 12.0 * xy[1] + 3.0;
+    u = 4.0 * xy[0] / d;
+    v = 6.0 * xy[1] / d;
+}
+
+void uv_to_xy(double u, double v, double* xy)
+{
+    const double d = 2.0 * u - 8.0 * v + 4.0;
+    xy[0] = 3.0 * u / d;
+    xy[1] = 2.0 * v / d;
+}
+
+std::vector<LocusPoint> planckian_table()
+{
+    std::vector<LocusPoint> table;
+    for (const double* entry : robertson) {
+        const double length = std::sqrt(1.0 + entry[3] * entry[3]);
+        table.push_back({ entry[0], entry[1], entry[2], 1.0 / length, entry[3] / length });
+    }
+    return table;
+}
+
+// daylight locus sampled uniformly in mired, normals are perpendicular to the locus
+// and point the same way as robertson's lines
+std::vector<LocusPoint> daylight_table()
+{
+    const double first = 1e6 / daylightmax, last = 1e6 / daylightmin;
+    const int count = int(std::ceil((last - first) / daylightstep)) + 1;
+    std::vector<LocusPoint> table;
+    for (int i = 0; i < count; ++i) {
+        const double mired = std::min(first + i * daylightstep, last);
+        LocusPoint point;
+        point.mired = mired;
+        double xy[2], xy0[2], xy1[2], u0, v0, u1, v1;
+        daylight_xy(1e6 / mired, xy);
+        daylight_xy(1e6 / (mired - 0.01), xy0);
+        daylight_xy(1e6 / (mired + 0.01), xy1);
+        xy_to_uv(xy, point.u, point.v);
+        xy_to_uv(xy0, u0, v0);
+        xy_to_uv(xy1, u1, v1);
+        const double du = u1 - u0, dv = v1 - v0, length = std::sqrt(du * du + dv * dv);
+        point.nu = dv / length;
+        point.nv = -du / length;
+        if (point.nu < 0.0) {
+            point.nu = -point.nu;
+            point.nv = -point.nv;
+        }
+        table.push_back(point);
+    }
+    return table;
+}
+
+// tables are built once and shared
+const std::vector<LocusPoint>& locus_table(Locus locus)
+{
+    static const std::vector<LocusPoint> planckian = planckian_table();
+    static const std::vector<LocusPoint> daylight = daylight_table();
+    return locus == Locus::Planckian ? planckian : daylight;
+}
+
+}
+
+bool
+parse_locus(const std::string& name, Locus& locus)
+{
+    if (name == "planckian") {
+        locus = Locus::Planckian;
+    } else if (name == "daylight") {
+        locus = Locus::Daylight;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+locus_name(Locus locus)
+{
+    return locus == Locus::Planckian ? "planckian" : "daylight";
+}
+
+void
+locus_range(Locus locus, double& mincct, double& maxcct)
+{
+    if (locus == Locus::Planckian) {
+        mincct = 1e6 / robertson[30][0];
+        maxcct = std::numeric_limits<double>::infinity();
+    } else {
+        mincct = daylightmin;
+        maxcct = daylightmax;
+    }
+}
+
+bool
+cct_to_xy(double cct, double tint, Locus locus, double* xy)
+{
+    double mincct, maxcct;
+    locus_range(locus, mincct, maxcct);
+    if (!(cct >= mincct * (1.0 - 1e-9) && cct <= maxcct * (1.0 + 1e-9))) {
+        return false;
+    }
+    const std::vector<LocusPoint>& table = locus_table(locus);
+    const double mired = std::min(std::max(1e6 / cct, table.front().mired), table.back().mired);
+    auto upper = std::upper_bound(table.begin() + 1, table.end() - 1, mired, [](double value, const LocusPoint& point) {
+        return value < point.mired;
+    });
+    const LocusPoint& p0 = *(upper - 1);
+    const LocusPoint& p1 = *upper;
+    const double f = (mired - p0.mired) / (p1.mired - p0.mired);
+    double u = p0.u + (p1.u - p0.u) * f;
+    double v = p0.v + (p1.v - p0.v) * f;
+    if (tint != 0.0) {
+        double nu = p0.nu + (p1.nu - p0.nu) * f;
+        double nv = p0.nv + (p1.nv - p0.nv) * f;
+        const double length = std::sqrt(nu * nu + nv * nv);
+        const double offset = tint / tintscale;
+        u += nu / length * offset;
+        v += nv / length * offset;
+    }
+    uv_to_xy(u, v, xy);
+    return true;
+}
+
+bool
+cct_adaptation_matrices(const double* ccts, const double* tints, size_t count, Locus locus, const double* target,
+                        const AdaptationTransform& transform, double degree, double* matrices, double* whitepoints)
+{
+    const Eigen::Map<const RowMatrix3d> cone(transform.cone);
+    const Eigen::Map<const RowMatrix3d> inverse(transform.inverse);
+    const Eigen::Vector3d targetlms = cone * xy_to_xyz(Eigen::Vector2d(target));
+    for (size_t i = 0; i < count; ++i) {
+        double xy[2];
+        if (!cct_to_xy(ccts[i], tints ? tints[i] : 0.0, locus, xy)) {
+            return false;
+        }
+        const Eigen::Vector3d sourcelms = cone * xy_to_xyz(Eigen::Vector2d(xy));
+        const Eigen::Vector3d scale = (degree * targetlms.cwiseQuotient(sourcelms)).array() + (1.0 - degree);
+        Eigen::Map<RowMatrix3d>(matrices + i * 9) = inverse * scale.asDiagonal() * cone;
+        if (whitepoints) {
+            std::copy(xy, xy + 2, whitepoints + i * 2);
+        }
+    }
+    return true;
+}
+
+}
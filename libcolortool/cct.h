@@ -0,0 +1,47 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+
+#include "adaptation.h"
+#include "colormath.h"
+
+namespace colortool {
+
+// correlated color temperature
+// whitepoints from cct in kelvin and tint, looked up in precomputed locus tables
+// interpolated in mired. tint is the offset along the isotemperature line in dng
+// units, 1 / 3000 in cie 1960 uv, positive is a greener whitepoint that is corrected
+// towards magenta as in raw converters.
+
+// locus of cct
+enum class Locus {
+    Planckian,
+    Daylight
+};
+
+// parse locus name, planckian or daylight, false if unknown
+bool parse_locus(const std::string& name, Locus& locus);
+
+// locus name
+const char* locus_name(Locus locus);
+
+// cct range of locus in kelvin, planckian is 1667k and up and daylight the cie
+// daylight range 4000k to 25000k
+void locus_range(Locus locus, double& mincct, double& maxcct);
+
+// whitepoint xy of cct with tint on locus, false if cct is out of range
+bool cct_to_xy(double cct, double tint, Locus locus, double* xy);
+
+// adaptation matrices from whitepoints of cct and tint pairs to target whitepoint xy,
+// count 3x3 row major matrices written to matrices and whitepoints xy to whitepoints
+// if set. the cone matrix is shared so every cct only costs a lookup and a diagonal
+// scale, partially adapted by degree. false if any cct is out of range.
+bool cct_adaptation_matrices(const double* ccts, const double* tints, size_t count, Locus locus, const double* target,
+                             const AdaptationTransform& transform, double degree, double* matrices, double* whitepoints = nullptr);
+
+}
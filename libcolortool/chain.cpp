@@ -0,0 +1,201 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "chain.h"
+
+#include <algorithm>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+bool same_transfer(const Transfer& a, const Transfer& b)
+{
+    return a.type == b.type && (a.type != TransferType::Gamma || a.gamma == b.gamma);
+}
+
+bool same_whitepoint(const double* a, const double* b)
+{
+    return a[0] == b[0] && a[1] == b[1];
+}
+
+ChainOp transfer_op(ChainOpType type, const Transfer& transfer)
+{
+    ChainOp op;
+    op.type = type;
+    op.transfer = transfer;
+    return op;
+}
+
+ChainOp matrix_op(ChainOpType type, const std::string& name, const Eigen::Matrix3d& matrix)
+{
+    ChainOp op;
+    op.type = type;
+    op.name = name;
+    Eigen::Map<RowMatrix3d>(op.matrix) = matrix;
+    return op;
+}
+
+ChainOp adaptation_op(const Colorspace& source, const Colorspace& target, const AdaptationTransform& adaptation, double degree)
+{
+    ChainOp op;
+    op.type = ChainOpType::Adaptation;
+    op.name = source.name;
+    const Eigen::Vector3d sourcexyz = xy_to_xyz(source.whitepoint);
+    const Eigen::Vector3d targetxyz = xy_to_xyz(target.whitepoint);
+    adaptation_matrix(adaptation, sourcexyz.data(), targetxyz.data(), degree, op.matrix);
+    op.targetname = target.name;
+    std::copy(source.whitepoint.data(), source.whitepoint.data() + 2, op.source);
+    std::copy(target.whitepoint.data(), target.whitepoint.data() + 2, op.target);
+    return op;
+}
+
+// push op onto reduced ops, cancels inverse pairs and merges adaptations, returns
+// number of ops removed
+int push_op(std::vector<ChainOp>& ops, const ChainOp& op, const AdaptationTransform& adaptation, double degree)
+{
+    if (op.type == ChainOpType::Adaptation && same_whitepoint(op.source, op.target)) {
+        return 1;
+    }
+    if (ops.empty()) {
+        ops.push_back(op);
+        return 0;
+    }
+    ChainOp& last = ops.back();
+    // encode followed by decode of the same invertible transfer
+    if (last.type == ChainOpType::Encode && op.type == ChainOpType::Decode
+        && same_transfer(last.transfer, op.transfer) && transfer_invertible(op.transfer)) {
+        ops.pop_back();
+        return 2;
+    }
+    // xyz to rgb followed by rgb to xyz of the same colorspace, and the reverse
+    if (((last.type == ChainOpType::XyzToRgb && op.type == ChainOpType::RgbToXyz)
+         || (last.type == ChainOpType::RgbToXyz && op.type == ChainOpType::XyzToRgb))
+        && last.name == op.name) {
+        ops.pop_back();
+        return 2;
+    }
+    // adaptations a to b and b to c are a to c, von kries style adaptations of the
+    // same method share the cone matrix so only the diagonal scale changes. partial
+    // adaptations do not compose to a to c, their scales are multiplied instead
+    if (last.type == ChainOpType::Adaptation && op.type == ChainOpType::Adaptation
+        && same_whitepoint(last.target, op.source)) {
+        ChainOp merged = last;
+        ops.pop_back();
+        if (degree < 1.0) {
+            Eigen::Map<RowMatrix3d>(merged.matrix) = Eigen::Map<const RowMatrix3d>(op.matrix) * Eigen::Map<const RowMatrix3d>(last.matrix);
+            merged.targetname = op.targetname;
+            std::copy(op.target, op.target + 2, merged.target);
+            ops.push_back(merged);
+            return 1;
+        }
+        Colorspace source, target;
+        source.name = merged.name;
+        source.whitepoint = Eigen::Vector2d(merged.source);
+        target.name = op.targetname;
+        target.whitepoint = Eigen::Vector2d(op.target);
+        return 1 + push_op(ops, adaptation_op(source, target, adaptation, degree), adaptation, degree);
+    }
+    ops.push_back(op);
+    return 0;
+}
+
+}
+
+bool
+transfer_invertible(const Transfer& transfer)
+{
+    return transfer.type != TransferType::ACEScc;
+}
+
+ChainPlan
+plan_chain(const std::vector<ChainStage>& stages, const AdaptationTransform& adaptation, double degree)
+{
+    ChainPlan plan;
+    plan.hops = std::max(int(stages.size()) - 1, 0);
+    for (int i = 0; i < plan.hops; ++i) {
+        const ChainStage& input = stages[i];
+        const ChainStage& output = stages[i + 1];
+        Eigen::Matrix3d rgbxyz = rgb_to_xyz(input.colorspace);
+        Eigen::Matrix3d xyzrgb = rgb_to_xyz(output.colorspace).inverse();
+        plan.ops.push_back(transfer_op(ChainOpType::Decode, input.transfer));
+        plan.ops.push_back(matrix_op(ChainOpType::RgbToXyz, input.colorspace.name, rgbxyz));
+        plan.ops.push_back(adaptation_op(input.colorspace, output.colorspace, adaptation, degree));
+        plan.ops.push_back(matrix_op(ChainOpType::XyzToRgb, output.colorspace.name, xyzrgb));
+        plan.ops.push_back(transfer_op(ChainOpType::Encode, output.transfer));
+    }
+
+    // symbolic reduction, linear transfers are the identity
+    std::vector<ChainOp> reduced;
+    for (const ChainOp& op : plan.ops) {
+        bool transfer = op.type == ChainOpType::Decode || op.type == ChainOpType::Encode;
+        if (transfer && op.transfer.type == TransferType::Linear) {
+            plan.cancelled++;
+            continue;
+        }
+        plan.cancelled += push_op(reduced, op, adaptation, degree);
+    }
+
+    // fold matrices between transfers into one
+    for (const ChainOp& op : reduced) {
+        bool transfer = op.type == ChainOpType::Decode || op.type == ChainOpType::Encode;
+        if (!transfer && plan.fused.size() && plan.fused.back().type == ChainOpType::Matrix) {
+            Eigen::Map<RowMatrix3d> matrix(plan.fused.back().matrix);
+            matrix = Eigen::Map<const RowMatrix3d>(op.matrix) * matrix;
+        } else if (!transfer) {
+            ChainOp folded = op;
+            folded.type = ChainOpType::Matrix;
+            folded.name.clear();
+            plan.fused.push_back(folded);
+        } else {
+            plan.fused.push_back(op);
+        }
+    }
+
+    // pixel transforms of decode -> matrix -> encode, a transform ends at an encode or
+    // where a decode follows
+    PixelTransform transform;
+    bool open = false;
+    for (const ChainOp& op : plan.fused) {
+        if (op.type == ChainOpType::Decode && open) {
+            plan.transforms.push_back(transform);
+            transform = PixelTransform();
+        }
+        open = true;
+        if (op.type == ChainOpType::Decode) {
+            transform.decode = op.transfer;
+        } else if (op.type == ChainOpType::Matrix) {
+            std::copy(op.matrix, op.matrix + 9, transform.matrix);
+        } else {
+            transform.encode = op.transfer;
+            plan.transforms.push_back(transform);
+            transform = PixelTransform();
+            open = false;
+        }
+    }
+    if (open || plan.transforms.empty()) {
+        plan.transforms.push_back(transform);
+    }
+    return plan;
+}
+
+std::string
+chainop_name(const ChainOp& op, const std::string& method)
+{
+    switch (op.type) {
+        case ChainOpType::Decode: return "decode " + transfer_name(op.transfer);
+        case ChainOpType::Encode: return "encode " + transfer_name(op.transfer);
+        case ChainOpType::RgbToXyz: return op.name + " rgb to xyz";
+        case ChainOpType::XyzToRgb: return "xyz to " + op.name + " rgb";
+        case ChainOpType::Adaptation:
+            return method + " adaptation " + op.name + " to " + op.targetname + " whitepoint";
+        case ChainOpType::Matrix: return "matrix";
+    }
+    return "unknown";
+}
+
+}
@@ -0,0 +1,73 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "adaptation.h"
+#include "colormath.h"
+#include "pixelkernel.h"
+#include "transfer.h"
+
+namespace colortool {
+
+// transform chain
+// a conversion through colorspaces, e.g AWG3 LogC3 -> AP0 -> AP1 -> Rec709, where
+// every hop is decode -> rgb to xyz -> adaptation -> xyz to rgb -> encode. the plan
+// is reduced symbolically, inverse pairs cancel and adaptations merge, and the
+// remaining matrices are folded so the chain is applied in one pass.
+
+// chain stage, pixels between hops are encoded with transfer
+struct ChainStage
+{
+    Colorspace colorspace;
+    Transfer transfer;
+};
+
+// chain operation
+enum class ChainOpType {
+    Decode,
+    Encode,
+    RgbToXyz,
+    XyzToRgb,
+    Adaptation,
+    Matrix
+};
+
+struct ChainOp
+{
+    ChainOpType type;
+    Transfer transfer; // decode and encode
+    std::string name; // colorspace of rgb to xyz and xyz to rgb, source of adaptation
+    std::string targetname; // target of adaptation
+    double source[2]; // adaptation whitepoints in xy
+    double target[2];
+    double matrix[9]; // 3x3 row major, all but decode and encode
+};
+
+// chain plan
+struct ChainPlan
+{
+    int hops = 0;
+    std::vector<ChainOp> ops; // hop by hop, as converted one pass per hop
+    std::vector<ChainOp> fused; // cancelled and folded
+    std::vector<PixelTransform> transforms; // fused ops as pixel transforms
+    int cancelled = 0; // ops removed by symbolic reduction
+};
+
+// plan chain of at least two stages with adaptation transform, partially adapted by
+// degree at every hop
+ChainPlan plan_chain(const std::vector<ChainStage>& stages, const AdaptationTransform& adaptation, double degree = 1.0);
+
+// true if encode followed by decode of transfer is the identity for all values,
+// false for transfers that clamp like acescc
+bool transfer_invertible(const Transfer& transfer);
+
+// operation description with adaptation method name, e.g "AWG3 rgb to xyz"
+std::string chainop_name(const ChainOp& op, const std::string& method);
+
+}
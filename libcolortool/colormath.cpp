@@ -0,0 +1,153 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "colormath.h"
+
+#include <vector>
+
+namespace colortool {
+
+constexpr double ConeMatrices::xyzscaling[];
+constexpr double ConeMatrices::bradford[];
+constexpr double ConeMatrices::cat02[];
+constexpr double ConeMatrices::vonkries[];
+constexpr double ConeMatrices::cat16[];
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+void
+store(const Eigen::Matrix3d& m, double* matrix)
+{
+    Eigen::Map<RowMatrix3d> rowmatrix(matrix);
+    rowmatrix = m;
+}
+
+// cone response matrix and inverse of a method
+struct ConeBasis
+{
+    Eigen::Matrix3d cone;
+    Eigen::Matrix3d inverse;
+};
+
+const double* cone_matrix(AdaptationMethod method)
+{
+    switch (method) {
+        case Bradford: return ConeMatrices::bradford;
+        case Cat02: return ConeMatrices::cat02;
+        case VonKries: return ConeMatrices::vonkries;
+        case Cat16: return ConeMatrices::cat16;
+        default: return ConeMatrices::xyzscaling;
+    }
+}
+
+// bases of methods from XYZScaling, built on first use
+const ConeBasis& cone_basis(AdaptationMethod method)
+{
+    static const std::vector<ConeBasis> bases = [] {
+        std::vector<ConeBasis> bases;
+        for (int method = XYZScaling; method <= Cat16; ++method) {
+            ConeBasis basis;
+            basis.cone = Eigen::Map<const RowMatrix3d>(cone_matrix(AdaptationMethod(method)));
+            basis.inverse = basis.cone.inverse();
+            bases.push_back(basis);
+        }
+        return bases;
+    }();
+    return bases[method >= XYZScaling && method <= Cat16 ? method - XYZScaling : 0];
+}
+
+}
+
+Eigen::Vector3d
+xy_to_xyz(const Eigen::Vector2d& xy)
+{
+    return Eigen::Vector3d(xy.x() / xy.y(), 1.0, (1.0 - xy.x() - xy.y()) / xy.y());
+}
+
+Eigen::Matrix3d
+rgb_to_xyz(const Eigen::Vector3d& r, const Eigen::Vector3d& g, const Eigen::Vector3d& b, const Eigen::Vector3d& whitepoint)
+{
+    Eigen::Matrix3d m; // matrix from primaries
+    m.col(0) = r;
+    m.col(1) = g;
+    m.col(2) = b;
+    Eigen::Vector3d s = m.inverse() * whitepoint; // scaling factors S using whitepoint
+    Eigen::Matrix3d xyz;
+    xyz.col(0) = s(0) * m.col(0);
+    xyz.col(1) = s(1) * m.col(1);
+    xyz.col(2) = s(2) * m.col(2);
+    return xyz;
+}
+
+Eigen::Matrix3d
+rgb_to_xyz(const Colorspace& colorspace)
+{
+    return rgb_to_xyz(xy_to_xyz(colorspace.r), xy_to_xyz(colorspace.g), xy_to_xyz(colorspace.b), xy_to_xyz(colorspace.whitepoint));
+}
+
+Eigen::Matrix3d
+adaptation_matrix(AdaptationMethod method)
+{
+    return cone_basis(method).cone;
+}
+
+Eigen::Matrix3d
+adaptation_inverse(AdaptationMethod method)
+{
+    return cone_basis(method).inverse;
+}
+
+Eigen::Matrix3d
+adaptation_matrix(const Eigen::Vector3d& source, const Eigen::Vector3d& target, AdaptationMethod method)
+{
+    const ConeBasis& basis = cone_basis(method);
+    Eigen::Vector3d sourcelms = basis.cone * source;
+    Eigen::Vector3d targetlms = basis.cone * target;
+    Eigen::Matrix3d scale = targetlms.cwiseQuotient(sourcelms).asDiagonal(); // compute scaling factors
+    Eigen::Matrix3d adaptationMatrix = basis.inverse * scale * basis.cone; // compute final adaptation
+    return adaptationMatrix;
+}
+
+Eigen::Matrix3d
+transform_matrix(const Colorspace& input, const Colorspace& output, AdaptationMethod method)
+{
+    Eigen::Matrix3d adaptation = adaptation_matrix(xy_to_xyz(input.whitepoint), xy_to_xyz(output.whitepoint), method);
+    return rgb_to_xyz(output).inverse() * adaptation * rgb_to_xyz(input);
+}
+
+void
+rgb_to_xyz(const double* r, const double* g, const double* b, const double* whitepoint, double* matrix)
+{
+    store(rgb_to_xyz(xy_to_xyz(Eigen::Vector2d(r)), xy_to_xyz(Eigen::Vector2d(g)), xy_to_xyz(Eigen::Vector2d(b)), xy_to_xyz(Eigen::Vector2d(whitepoint))), matrix);
+}
+
+void
+adaptation_matrix(const double* source, const double* target, AdaptationMethod method, double* matrix)
+{
+    store(adaptation_matrix(xy_to_xyz(Eigen::Vector2d(source)), xy_to_xyz(Eigen::Vector2d(target)), method), matrix);
+}
+
+void
+transform_matrix(const Colorspace& input, const Colorspace& output, AdaptationMethod method, double* matrix)
+{
+    store(transform_matrix(input, output, method), matrix);
+}
+
+const char*
+adaptationmethod_name(AdaptationMethod method)
+{
+    switch (method) {
+        case XYZScaling: return "XYZScaling";
+        case Bradford: return "Bradford";
+        case Cat02: return "Cat02";
+        case VonKries: return "VonKries";
+        case Cat16: return "Cat16";
+        default: return "None";
+    }
+}
+
+}
@@ -0,0 +1,107 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+
+#include <Eigen/Dense>
+
+namespace colortool {
+
+// adaptation methods
+enum AdaptationMethod {
+    None,
+    XYZScaling,
+    Bradford,
+    Cat02,
+    VonKries,
+    Cat16
+};
+
+// colorspace, primaries and whitepoint in xy
+struct Colorspace
+{
+    std::string name;
+    std::string description;
+    std::string trc;
+    Eigen::Vector2d r;
+    Eigen::Vector2d g;
+    Eigen::Vector2d b;
+    Eigen::Vector2d whitepoint;
+};
+
+// illuminant, whitepoint in xy
+struct Illuminant
+{
+    std::string name;
+    std::string description;
+    Eigen::Vector2d whitepoint;
+};
+
+// cone response matrices, 3x3 row major
+struct ConeMatrices
+{
+    static constexpr double xyzscaling[9] = {
+        1.0, 0.0, 0.0,
+        0.0, 1.0, 0.0,
+        0.0, 0.0, 1.0
+    };
+    static constexpr double bradford[9] = {
+         0.8951,  0.2664, -0.1614,
+        -0.7502,  1.7135,  0.0367,
+         0.0389, -0.0685,  1.0296
+    };
+    static constexpr double cat02[9] = {
+         0.7328,  0.4296, -0.1624,
+        -0.7036,  1.6975,  0.0061,
+         0.0030,  0.0136,  0.9834
+    };
+    static constexpr double vonkries[9] = {
+         0.40024,  0.70760, -0.08081,
+        -0.22630,  1.16532,  0.04570,
+         0.00000,  0.00000,  0.91822
+    };
+    static constexpr double cat16[9] = {
+         0.401288,  0.650173, -0.051461,
+        -0.250268,  1.204414,  0.045854,
+        -0.002079,  0.048952,  0.953127
+    };
+};
+
+// color math
+// matrices are returned by value or written to caller buffers as 3x3 row major
+// doubles, none of the functions allocate.
+
+// xy chromaticity to XYZ with Y = 1
+Eigen::Vector3d xy_to_xyz(const Eigen::Vector2d& xy);
+
+// rgb to XYZ from primaries and whitepoint in XYZ
+Eigen::Matrix3d rgb_to_xyz(const Eigen::Vector3d& r, const Eigen::Vector3d& g, const Eigen::Vector3d& b, const Eigen::Vector3d& whitepoint);
+
+// rgb to XYZ of colorspace
+Eigen::Matrix3d rgb_to_xyz(const Colorspace& colorspace);
+
+// cone response matrix of method, identity for XYZScaling
+Eigen::Matrix3d adaptation_matrix(AdaptationMethod method);
+
+// inverse of the cone response matrix of method, computed once per method
+Eigen::Matrix3d adaptation_inverse(AdaptationMethod method);
+
+// adaptation from source to target whitepoint in XYZ
+Eigen::Matrix3d adaptation_matrix(const Eigen::Vector3d& source, const Eigen::Vector3d& target, AdaptationMethod method);
+
+// rgb of input to rgb of output with whitepoint adaptation
+Eigen::Matrix3d transform_matrix(const Colorspace& input, const Colorspace& output, AdaptationMethod method);
+
+// caller buffers, chromaticities as xy pairs
+void rgb_to_xyz(const double* r, const double* g, const double* b, const double* whitepoint, double* matrix);
+void adaptation_matrix(const double* source, const double* target, AdaptationMethod method, double* matrix);
+void transform_matrix(const Colorspace& input, const Colorspace& output, AdaptationMethod method, double* matrix);
+
+// adaptation method name, e.g Cat02
+const char* adaptationmethod_name(AdaptationMethod method);
+
+}
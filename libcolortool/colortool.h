@@ -0,0 +1,34 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+// colortool
+// public header of the colortool library, color math and its precision modes, adaptation
+// transforms, builtin colorspace tables, transfers, transform chains, gamut compression,
+// pixel kernels, 3d luts, opencolorio configs and processors, registry of colorspaces
+// and illuminants, spectral whitepoints and camera fits, the transform cache, pairwise
+// transform tables, registry dependencies, structured output formats and image analysis.
+
+#include "adaptation.h"
+#include "analysis.h"
+#include "builtin.h"
+#include "cct.h"
+#include "chain.h"
+#include "colormath.h"
+#include "dependency.h"
+#include "format.h"
+#include "gamut.h"
+#include "lut.h"
+#include "ocio.h"
+#include "pairwise.h"
+#include "pipeline.h"
+#include "pixelkernel.h"
+#include "precision.h"
+#include "registry.h"
+#include "spectral.h"
+#include "transfer.h"
+#include "transformcache.h"
+#include "whitebalance.h"
@@ -0,0 +1,371 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "dependency.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+const size_t dependency_npos = size_t(-1);
+
+// pairs per thread, small updates are computed on the calling thread
+const size_t dependency_pairs = 4096;
+
+bool same_xy(const double* a, const double* b)
+{
+    return a[0] == b[0] && a[1] == b[1];
+}
+
+// node values, primaries and whitepoint
+bool same_node(const RegistryColorspace& a, const RegistryColorspace& b)
+{
+    return same_xy(a.r, b.r) && same_xy(a.g, b.g) && same_xy(a.b, b.b) && same_xy(a.whitepoint, b.whitepoint);
+}
+
+bool same_node(const RegistryIlluminant& a, const RegistryIlluminant& b)
+{
+    return same_xy(a.whitepoint, b.whitepoint);
+}
+
+// all values, a changed description or trc invalidates artifacts but not transforms
+bool same_entry(const RegistryColorspace& a, const RegistryColorspace& b)
+{
+    return same_node(a, b) && a.description == b.description && a.trc == b.trc;
+}
+
+bool same_entry(const RegistryIlluminant& a, const RegistryIlluminant& b)
+{
+    return same_node(a, b) && a.description == b.description;
+}
+
+// rgb to xyz and whitepoint xyz of node, identity for illuminants
+void node_matrix(const RegistryColorspace& cs, Eigen::Matrix3d& rgbxyz, Eigen::Vector3d& whitepoint)
+{
+    whitepoint = xy_to_xyz(Eigen::Vector2d(cs.whitepoint));
+    rgbxyz = rgb_to_xyz(xy_to_xyz(Eigen::Vector2d(cs.r)), xy_to_xyz(Eigen::Vector2d(cs.g)), xy_to_xyz(Eigen::Vector2d(cs.b)), whitepoint);
+}
+
+void node_matrix(const RegistryIlluminant& im, Eigen::Matrix3d& rgbxyz, Eigen::Vector3d& whitepoint)
+{
+    whitepoint = xy_to_xyz(Eigen::Vector2d(im.whitepoint));
+    rgbxyz.setIdentity();
+}
+
+// artifacts of name and of all entries, sorted and unique
+std::vector<size_t> find_dependents(const std::vector<std::pair<std::string, size_t>>& dependents, const std::string& name)
+{
+    std::vector<size_t> artifacts;
+    for (const std::string& key : { std::string(dependency_all), name }) {
+        auto range = std::equal_range(dependents.begin(), dependents.end(), std::make_pair(key, size_t(0)),
+                                      [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+            return a.first < b.first;
+        });
+        for (auto it = range.first; it != range.second; ++it) {
+            artifacts.push_back(it->second);
+        }
+    }
+    std::sort(artifacts.begin(), artifacts.end());
+    artifacts.erase(std::unique(artifacts.begin(), artifacts.end()), artifacts.end());
+    return artifacts;
+}
+
+void add_dependents(std::vector<std::pair<std::string, size_t>>& dependents, const std::vector<std::string>& names, size_t artifact)
+{
+    for (const std::string& name : names) {
+        auto pair = std::make_pair(name, artifact);
+        dependents.insert(std::upper_bound(dependents.begin(), dependents.end(), pair), pair);
+    }
+}
+
+int find_slot(const std::vector<std::pair<std::string, size_t>>& index, const std::string& name)
+{
+    auto it = std::lower_bound(index.begin(), index.end(), name, [](const std::pair<std::string, size_t>& entry, const std::string& name) {
+        return entry.first < name;
+    });
+    return it != index.end() && it->first == name ? int(it->second) : -1;
+}
+
+}
+
+DependencyGraph::DependencyGraph(const std::vector<AdaptationMethod>& methods)
+: methodlist(methods)
+{
+}
+
+template <typename T>
+void
+DependencyGraph::update_table(Table& table, std::vector<T>& entries, const std::vector<T>& updated, std::vector<std::string>& names,
+                              DependencyUpdate& update, int threads)
+{
+    const size_t m = methodlist.size();
+
+    // merge of old and updated names, both sorted
+    std::vector<std::pair<std::string, size_t>> index;
+    std::vector<std::pair<size_t, size_t>> added; // position in index, updated entry
+    std::vector<size_t> dirty; // slots with changed nodes
+    index.reserve(updated.size());
+    size_t i = 0, u = 0;
+    while (i < table.index.size() || u < updated.size()) {
+        int order = i == table.index.size() ? 1 : u == updated.size() ? -1 : table.index[i].first.compare(updated[u].name);
+        if (order < 0) {
+            const size_t slot = table.index[i++].second;
+            names.push_back(entries[slot].name);
+            table.used[slot] = false;
+            table.slots.push_back(slot);
+        } else if (order > 0) {
+            names.push_back(updated[u].name);
+            added.emplace_back(index.size(), u);
+            index.emplace_back(updated[u++].name, dependency_npos);
+        } else {
+            const size_t slot = table.index[i++].second;
+            const T& entry = updated[u++];
+            if (!same_entry(entries[slot], entry)) {
+                names.push_back(entry.name);
+                if (!same_node(entries[slot], entry)) {
+                    dirty.push_back(slot);
+                }
+                entries[slot] = entry;
+            }
+            index.emplace_back(entry.name, slot);
+        }
+    }
+    if (names.empty()) {
+        return;
+    }
+
+    // slots, pairs are moved to a larger table when full
+    const size_t required = table.used.size() + added.size() - std::min(added.size(), table.slots.size());
+    if (required > table.capacity) {
+        size_t capacity = std::max<size_t>(table.capacity, 8);
+        while (capacity < required) {
+            capacity *= 2;
+        }
+        const size_t row = table.capacity * m * 9;
+        std::vector<double> pairs(capacity * capacity * m * 9);
+        for (size_t slot = 0; slot < table.capacity; ++slot) {
+            std::copy(table.pairs.begin() + slot * row, table.pairs.begin() + (slot + 1) * row, pairs.begin() + slot * capacity * m * 9);
+        }
+        table.pairs.swap(pairs);
+        table.cones.resize(capacity * m);
+        table.matrices.resize(capacity * 18);
+        entries.resize(capacity);
+        table.capacity = capacity;
+    }
+    for (const std::pair<size_t, size_t>& entry : added) {
+        size_t slot;
+        if (table.slots.size()) {
+            slot = table.slots.back();
+            table.slots.pop_back();
+            table.used[slot] = true;
+        } else {
+            slot = table.used.size();
+            table.used.push_back(true);
+        }
+        entries[slot] = updated[entry.second];
+        index[entry.first].second = slot;
+        dirty.push_back(slot);
+    }
+    table.index.swap(index);
+    if (dirty.empty()) {
+        return;
+    }
+
+    // nodes
+    for (size_t slot : dirty) {
+        Eigen::Matrix3d rgbxyz;
+        Eigen::Vector3d whitepoint;
+        node_matrix(entries[slot], rgbxyz, whitepoint);
+        Eigen::Map<RowMatrix3d>(table.matrices.data() + slot * 18) = rgbxyz;
+        Eigen::Map<RowMatrix3d>(table.matrices.data() + slot * 18 + 9) = rgbxyz.inverse();
+        for (size_t k = 0; k < m; ++k) {
+            table.cones[slot * m + k] = cone_space(rgbxyz, whitepoint, methodlist[k]);
+        }
+    }
+    update.nodes += dirty.size();
+
+    // pairs, rows of dirty inputs and columns of dirty outputs. inputs are interleaved
+    // across threads
+    std::vector<size_t> live;
+    std::vector<bool> isdirty(table.capacity, false);
+    live.reserve(table.index.size());
+    for (const std::pair<std::string, size_t>& entry : table.index) {
+        live.push_back(entry.second);
+    }
+    for (size_t slot : dirty) {
+        isdirty[slot] = true;
+    }
+    const size_t n = live.size(), d = dirty.size();
+    const size_t pairs = d * n + (n - d) * d;
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::max(std::min(count, int(pairs / dependency_pairs)), 1);
+    auto compute = [&](int first) {
+        for (size_t l = first; l < n; l += count) {
+            const size_t input = live[l];
+            const std::vector<size_t>& outputs = isdirty[input] ? live : dirty;
+            for (size_t output : outputs) {
+                for (size_t k = 0; k < m; ++k) {
+                    cone_transform(table.cones[input * m + k], table.cones[output * m + k],
+                                   table.pairs.data() + ((input * table.capacity + output) * m + k) * 9);
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < count; ++t) {
+        pool.emplace_back(compute, t);
+    }
+    compute(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    update.pairs += pairs;
+}
+
+DependencyUpdate
+DependencyGraph::update(const std::vector<RegistryColorspace>& colorspaces, const std::vector<RegistryIlluminant>& illuminants, int threads)
+{
+    DependencyUpdate update;
+    update_table(colorspacetable, colorspacelist, colorspaces, update.colorspaces, update, threads);
+    update_table(illuminanttable, illuminantlist, illuminants, update.illuminants, update, threads);
+    for (const std::string& name : update.colorspaces) {
+        const std::vector<size_t> artifacts = colorspace_artifacts(name);
+        update.artifacts.insert(update.artifacts.end(), artifacts.begin(), artifacts.end());
+    }
+    for (const std::string& name : update.illuminants) {
+        const std::vector<size_t> artifacts = illuminant_artifacts(name);
+        update.artifacts.insert(update.artifacts.end(), artifacts.begin(), artifacts.end());
+    }
+    std::sort(update.artifacts.begin(), update.artifacts.end());
+    update.artifacts.erase(std::unique(update.artifacts.begin(), update.artifacts.end()), update.artifacts.end());
+    return update;
+}
+
+size_t
+DependencyGraph::add_artifact(const std::string& name, const std::vector<std::string>& colorspaces, const std::vector<std::string>& illuminants, const Rebuild& rebuild)
+{
+    const size_t artifact = artifactlist.size();
+    artifactlist.push_back({ name, rebuild });
+    add_dependents(colorspacedependents, colorspaces, artifact);
+    add_dependents(illuminantdependents, illuminants, artifact);
+    return artifact;
+}
+
+bool
+DependencyGraph::rebuild(const std::vector<size_t>& artifacts)
+{
+    bool valid = true;
+    for (size_t artifact : artifacts) {
+        valid = artifactlist[artifact].rebuild() && valid;
+    }
+    return valid;
+}
+
+std::vector<size_t>
+DependencyGraph::colorspace_artifacts(const std::string& name) const
+{
+    return find_dependents(colorspacedependents, name);
+}
+
+std::vector<size_t>
+DependencyGraph::illuminant_artifacts(const std::string& name) const
+{
+    return find_dependents(illuminantdependents, name);
+}
+
+size_t
+DependencyGraph::artifacts() const
+{
+    return artifactlist.size();
+}
+
+const std::string&
+DependencyGraph::artifact_name(size_t artifact) const
+{
+    return artifactlist[artifact].name;
+}
+
+const std::vector<AdaptationMethod>&
+DependencyGraph::methods() const
+{
+    return methodlist;
+}
+
+std::vector<std::string>
+DependencyGraph::colorspace_names() const
+{
+    std::vector<std::string> names;
+    names.reserve(colorspacetable.index.size());
+    for (const std::pair<std::string, size_t>& entry : colorspacetable.index) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+std::vector<std::string>
+DependencyGraph::illuminant_names() const
+{
+    std::vector<std::string> names;
+    names.reserve(illuminanttable.index.size());
+    for (const std::pair<std::string, size_t>& entry : illuminanttable.index) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+int
+DependencyGraph::find_colorspace(const std::string& name) const
+{
+    return find_slot(colorspacetable.index, name);
+}
+
+int
+DependencyGraph::find_illuminant(const std::string& name) const
+{
+    return find_slot(illuminanttable.index, name);
+}
+
+const RegistryColorspace&
+DependencyGraph::colorspace(size_t slot) const
+{
+    return colorspacelist[slot];
+}
+
+const double*
+DependencyGraph::rgbxyz(size_t slot) const
+{
+    return colorspacetable.matrices.data() + slot * 18;
+}
+
+const double*
+DependencyGraph::xyzrgb(size_t slot) const
+{
+    return colorspacetable.matrices.data() + slot * 18 + 9;
+}
+
+const RegistryIlluminant&
+DependencyGraph::illuminant(size_t slot) const
+{
+    return illuminantlist[slot];
+}
+
+const double*
+DependencyGraph::transform(size_t input, size_t output, size_t method) const
+{
+    return colorspacetable.pairs.data() + ((input * colorspacetable.capacity + output) * methodlist.size() + method) * 9;
+}
+
+const double*
+DependencyGraph::adaptation(size_t input, size_t output, size_t method) const
+{
+    return illuminanttable.pairs.data() + ((input * illuminanttable.capacity + output) * methodlist.size() + method) * 9;
+}
+
+}
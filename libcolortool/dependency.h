@@ -0,0 +1,124 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "colormath.h"
+#include "pairwise.h"
+#include "registry.h"
+
+namespace colortool {
+
+// registry dependencies
+// transforms derived from registry entries, kept up to date entry by entry. colorspaces
+// and illuminants are nodes in slots with rgb to xyz, xyz to rgb and cone spaces per
+// method, and transforms of pairs are tables indexed by slot. an update diffs entries
+// by name and value, recomputes the nodes whose primaries or whitepoint changed and
+// only the rows and columns of their pairs. artifacts like baked luts and exported
+// configs are registered with the entries they depend on and are invalidated when one
+// of them is added, changed or removed. the graph is not thread safe, readers of a
+// graph that is updated must be serialized by the caller.
+
+// depends on all entries of a kind
+const char* const dependency_all = "*";
+
+// result of an update
+struct DependencyUpdate
+{
+    std::vector<std::string> colorspaces; // added, changed or removed names
+    std::vector<std::string> illuminants;
+    size_t nodes = 0; // recomputed colorspaces and illuminants
+    size_t pairs = 0; // recomputed pairs, each with a transform per method
+    std::vector<size_t> artifacts; // invalidated artifacts
+
+    bool empty() const { return colorspaces.empty() && illuminants.empty(); }
+};
+
+class DependencyGraph
+{
+public:
+    // rebuild of an artifact, false on error
+    typedef std::function<bool()> Rebuild;
+
+    explicit DependencyGraph(const std::vector<AdaptationMethod>& methods);
+
+    // update to entries sorted by name, as read by the registry. the first update
+    // computes all transforms, pairs are spread across threads, 0 for all cores
+    DependencyUpdate update(const std::vector<RegistryColorspace>& colorspaces, const std::vector<RegistryIlluminant>& illuminants, int threads = 0);
+
+    // artifact depending on colorspaces and illuminants by name or dependency_all,
+    // returns the artifact index
+    size_t add_artifact(const std::string& name, const std::vector<std::string>& colorspaces, const std::vector<std::string>& illuminants, const Rebuild& rebuild);
+
+    // rebuild artifacts, all are rebuilt and false if one failed
+    bool rebuild(const std::vector<size_t>& artifacts);
+
+    // artifacts depending on a colorspace or illuminant name
+    std::vector<size_t> colorspace_artifacts(const std::string& name) const;
+    std::vector<size_t> illuminant_artifacts(const std::string& name) const;
+
+    size_t artifacts() const;
+    const std::string& artifact_name(size_t artifact) const;
+    const std::vector<AdaptationMethod>& methods() const;
+
+    // names sorted, slot of name or -1 if not found
+    std::vector<std::string> colorspace_names() const;
+    std::vector<std::string> illuminant_names() const;
+    int find_colorspace(const std::string& name) const;
+    int find_illuminant(const std::string& name) const;
+
+    // entry and matrices of a colorspace slot, 3x3 row major
+    const RegistryColorspace& colorspace(size_t slot) const;
+    const double* rgbxyz(size_t slot) const;
+    const double* xyzrgb(size_t slot) const;
+    const RegistryIlluminant& illuminant(size_t slot) const;
+
+    // transform from input to output colorspace slot, adaptation from input to output
+    // illuminant slot, for a method index
+    const double* transform(size_t input, size_t output, size_t method) const;
+    const double* adaptation(size_t input, size_t output, size_t method) const;
+
+private:
+    // nodes in slots, freed slots are reused and pairs are capacity x capacity x methods
+    // so slots keep their transforms when entries are added or removed
+    struct Table
+    {
+        std::vector<ConeSpace> cones; // slot * methods + method
+        std::vector<double> matrices; // rgb to xyz and xyz to rgb per slot
+        std::vector<double> pairs; // ((input * capacity + output) * methods + method) * 9
+        std::vector<bool> used;
+        std::vector<size_t> slots; // free slots
+        std::vector<std::pair<std::string, size_t>> index; // names sorted, slot
+        size_t capacity = 0;
+    };
+
+    // artifact, its dependencies are kept by name in the dependents
+    struct Artifact
+    {
+        std::string name;
+        Rebuild rebuild;
+    };
+
+    template <typename T>
+    void update_table(Table& table, std::vector<T>& entries, const std::vector<T>& updated, std::vector<std::string>& names,
+                      DependencyUpdate& update, int threads);
+
+    std::vector<AdaptationMethod> methodlist;
+    Table colorspacetable;
+    Table illuminanttable;
+    std::vector<RegistryColorspace> colorspacelist; // by slot
+    std::vector<RegistryIlluminant> illuminantlist;
+    std::vector<Artifact> artifactlist;
+    std::vector<std::pair<std::string, size_t>> colorspacedependents; // names sorted, artifact
+    std::vector<std::pair<std::string, size_t>> illuminantdependents;
+};
+
+}
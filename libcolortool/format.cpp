@@ -0,0 +1,303 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "format.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace colortool {
+
+namespace {
+
+// number with digits, 17 digits are written as 15 when that reads back exactly. shader
+// literals always get a decimal point or exponent
+void append_number(std::string& buffer, double value, int digits, bool literal)
+{
+    char str[40];
+    int length = std::snprintf(str, sizeof(str), "%.*g", digits == 17 ? 15 : digits, value);
+    if (digits == 17 && std::strtod(str, nullptr) != value) {
+        length = std::snprintf(str, sizeof(str), "%.17g", value);
+    }
+    buffer.append(str, length);
+    if (literal && std::isfinite(value) && !std::strpbrk(str, ".e")) {
+        buffer += ".0";
+    }
+}
+
+void append_json_number(std::string& buffer, double value)
+{
+    if (std::isfinite(value)) {
+        append_number(buffer, value, 17, false);
+    } else {
+        buffer += "null";
+    }
+}
+
+// values of entry separated by ", ", column major for matrices of the shader formats
+void append_values(std::string& buffer, const FormatDocument& document, const FormatDocument::Entry& entry, int digits,
+                   bool literal, bool columnmajor)
+{
+    const double* data = document.values.data() + entry.offset;
+    for (int i = 0; i < entry.rows * entry.cols; ++i) {
+        int index = columnmajor ? (i % entry.rows) * entry.cols + i / entry.rows : i;
+        if (i) {
+            buffer += ", ";
+        }
+        append_number(buffer, data[index], digits, literal);
+    }
+}
+
+template <typename T>
+void append_binary(std::string& buffer, T value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool is_matrix(const FormatDocument::Entry& entry)
+{
+    return entry.rows == 3 && entry.cols == 3;
+}
+
+bool is_vector(const FormatDocument::Entry& entry)
+{
+    return entry.rows == 1 && entry.cols >= 2 && entry.cols <= 4;
+}
+
+void serialize_json(const FormatDocument& document, std::string& buffer)
+{
+    buffer += "{\n";
+    for (size_t e = 0; e < document.entries.size(); ++e) {
+        const FormatDocument::Entry& entry = document.entries[e];
+        const double* data = document.values.data() + entry.offset;
+        buffer += "    \"" + entry.name + "\": ";
+        if (entry.rows > 1) {
+            buffer += "[";
+            for (int r = 0; r < entry.rows; ++r) {
+                buffer += r ? ", [" : "[";
+                for (int c = 0; c < entry.cols; ++c) {
+                    buffer += c ? ", " : "";
+                    append_json_number(buffer, data[r * entry.cols + c]);
+                }
+                buffer += "]";
+            }
+            buffer += "]";
+        } else {
+            buffer += "[";
+            for (int c = 0; c < entry.cols; ++c) {
+                buffer += c ? ", " : "";
+                append_json_number(buffer, data[c]);
+            }
+            buffer += "]";
+        }
+        buffer += e + 1 < document.entries.size() ? ",\n" : "\n";
+    }
+    buffer += "}\n";
+}
+
+void serialize_binary(const FormatDocument& document, std::string& buffer)
+{
+    buffer.append(format_magic, sizeof(format_magic));
+    append_binary(buffer, uint32_t(format_version));
+    append_binary(buffer, uint32_t(document.entries.size()));
+    for (const FormatDocument::Entry& entry : document.entries) {
+        append_binary(buffer, uint32_t(entry.rows));
+        append_binary(buffer, uint32_t(entry.cols));
+        append_binary(buffer, uint32_t(entry.name.size()));
+        buffer += entry.name;
+        buffer.append(reinterpret_cast<const char*>(document.values.data() + entry.offset), entry.rows * entry.cols * sizeof(double));
+    }
+}
+
+void serialize_cpp(const FormatDocument& document, std::string& buffer)
+{
+    buffer += "// colortool, matrices are row major\n#pragma once\n\n";
+    for (const FormatDocument::Entry& entry : document.entries) {
+        buffer += "static const double " + entry.name + "[" + std::to_string(entry.rows * entry.cols) + "] = { ";
+        append_values(buffer, document, entry, 17, true, false);
+        buffer += " };\n";
+    }
+}
+
+void serialize_glsl(const FormatDocument& document, std::string& buffer)
+{
+    buffer += "// colortool, matrices are column major, rgb = matrix * rgb\n\n";
+    for (const FormatDocument::Entry& entry : document.entries) {
+        const std::string count = std::to_string(entry.rows * entry.cols);
+        std::string type = is_matrix(entry) ? "mat3" : is_vector(entry) ? "vec" + std::to_string(entry.cols) : "float[" + count + "]";
+        buffer += "const " + (is_matrix(entry) || is_vector(entry) ? type + " " + entry.name : "float " + entry.name + "[" + count + "]");
+        buffer += " = " + type + "(";
+        append_values(buffer, document, entry, 9, true, true);
+        buffer += ");\n";
+    }
+}
+
+void serialize_metal(const FormatDocument& document, std::string& buffer)
+{
+    buffer += "// colortool, matrices are column major, rgb = matrix * rgb\n#include <metal_stdlib>\nusing namespace metal;\n\n";
+    for (const FormatDocument::Entry& entry : document.entries) {
+        const double* data = document.values.data() + entry.offset;
+        if (is_matrix(entry)) {
+            buffer += "constant float3x3 " + entry.name + " = float3x3(";
+            for (int c = 0; c < 3; ++c) {
+                buffer += c ? ", float3(" : "float3(";
+                for (int r = 0; r < 3; ++r) {
+                    buffer += r ? ", " : "";
+                    append_number(buffer, data[r * 3 + c], 9, true);
+                }
+                buffer += ")";
+            }
+            buffer += ");\n";
+        } else if (is_vector(entry)) {
+            const std::string type = "float" + std::to_string(entry.cols);
+            buffer += "constant " + type + " " + entry.name + " = " + type + "(";
+            append_values(buffer, document, entry, 9, true, false);
+            buffer += ");\n";
+        } else {
+            buffer += "constant float " + entry.name + "[" + std::to_string(entry.rows * entry.cols) + "] = { ";
+            append_values(buffer, document, entry, 9, true, false);
+            buffer += " };\n";
+        }
+    }
+}
+
+// osl has no global constants, entries are macros. matrices are 4x4 with points as row
+// vectors so the 3x3 is transposed into the upper left.
+void serialize_osl(const FormatDocument& document, std::string& buffer)
+{
+    buffer += "// colortool, rgb = color(transform(matrix, point(rgb)))\n\n";
+    for (const FormatDocument::Entry& entry : document.entries) {
+        const double* data = document.values.data() + entry.offset;
+        if (is_matrix(entry)) {
+            buffer += "#define " + entry.name + " matrix(";
+            for (int r = 0; r < 4; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    buffer += r || c ? ", " : "";
+                    append_number(buffer, r < 3 && c < 3 ? data[c * 3 + r] : r == c ? 1.0 : 0.0, 9, true);
+                }
+            }
+            buffer += ")\n";
+        } else if (entry.rows == 1 && (entry.cols == 2 || entry.cols == 3)) {
+            buffer += "#define " + entry.name + (entry.cols == 3 ? " color(" : " vector(");
+            append_values(buffer, document, entry, 9, true, false);
+            buffer += entry.cols == 2 ? ", 0.0)\n" : ")\n";
+        } else {
+            buffer += "// " + entry.name + ": not supported in osl\n";
+        }
+    }
+}
+
+void serialize_text(const FormatDocument& document, std::string& buffer)
+{
+    for (const FormatDocument::Entry& entry : document.entries) {
+        buffer += entry.name + ": ";
+        append_values(buffer, document, entry, 6, false, false);
+        buffer += "\n";
+    }
+}
+
+}
+
+bool
+parse_format(const std::string& name, OutputFormat& format)
+{
+    if (name == "text") {
+        format = OutputFormat::Text;
+    } else if (name == "json") {
+        format = OutputFormat::Json;
+    } else if (name == "bin") {
+        format = OutputFormat::Binary;
+    } else if (name == "cpp") {
+        format = OutputFormat::Cpp;
+    } else if (name == "glsl") {
+        format = OutputFormat::Glsl;
+    } else if (name == "metal") {
+        format = OutputFormat::Metal;
+    } else if (name == "osl") {
+        format = OutputFormat::Osl;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+format_name(OutputFormat format)
+{
+    switch (format) {
+        case OutputFormat::Json: return "json";
+        case OutputFormat::Binary: return "bin";
+        case OutputFormat::Cpp: return "cpp";
+        case OutputFormat::Glsl: return "glsl";
+        case OutputFormat::Metal: return "metal";
+        case OutputFormat::Osl: return "osl";
+        default: return "text";
+    }
+}
+
+std::string
+format_identifier(const std::string& name)
+{
+    std::string identifier;
+    identifier.reserve(name.size() + 1);
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        identifier += '_';
+    }
+    for (char c : name) {
+        identifier += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return identifier;
+}
+
+void
+FormatDocument::add(const std::string& name, int rows, int cols, const double* data)
+{
+    entries.push_back({ format_identifier(name), rows, cols, values.size() });
+    values.insert(values.end(), data, data + rows * cols);
+}
+
+void
+FormatDocument::serialize(OutputFormat format, std::string& buffer) const
+{
+    buffer.reserve(buffer.size() + entries.size() * 64 + values.size() * 24);
+    switch (format) {
+        case OutputFormat::Json: serialize_json(*this, buffer); break;
+        case OutputFormat::Binary: serialize_binary(*this, buffer); break;
+        case OutputFormat::Cpp: serialize_cpp(*this, buffer); break;
+        case OutputFormat::Glsl: serialize_glsl(*this, buffer); break;
+        case OutputFormat::Metal: serialize_metal(*this, buffer); break;
+        case OutputFormat::Osl: serialize_osl(*this, buffer); break;
+        default: serialize_text(*this, buffer); break;
+    }
+}
+
+bool
+write_document(const std::string& filename, const FormatDocument& document, OutputFormat format, std::string& error)
+{
+    std::string buffer;
+    document.serialize(format, buffer);
+    const bool standard = filename.empty() || filename == "-";
+    FILE* file = standard ? stdout : std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        error = "could not open output file: " + filename;
+        return false;
+    }
+    bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    written = std::fflush(file) == 0 && written;
+    if (!standard) {
+        written = std::fclose(file) == 0 && written;
+    }
+    if (!written) {
+        error = "could not write output: " + (standard ? std::string("stdout") : filename);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,71 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace colortool {
+
+// output formats
+// matrices, vectors and whitepoints collected in a document and serialized into one
+// buffer written at once. names are made valid identifiers for the source formats.
+
+// formats, text is the info output of the tool
+enum class OutputFormat {
+    Text,
+    Json,
+    Binary,
+    Cpp,
+    Glsl,
+    Metal,
+    Osl
+};
+
+// parse format name, text, json, bin, cpp, glsl, metal or osl, false if unknown
+bool parse_format(const std::string& name, OutputFormat& format);
+
+// format name
+const char* format_name(OutputFormat format);
+
+// identifier of name, characters other than letters and digits are replaced by _ and
+// a leading digit is prefixed with _
+std::string format_identifier(const std::string& name);
+
+// document of named values, rows x cols doubles row major, vectors have one row.
+// values of all entries share one buffer so large documents allocate rarely.
+struct FormatDocument
+{
+    struct Entry
+    {
+        std::string name;
+        int rows;
+        int cols;
+        size_t offset;
+    };
+    std::vector<Entry> entries;
+    std::vector<double> values;
+
+    // add entry, name is made an identifier
+    void add(const std::string& name, int rows, int cols, const double* data);
+    void add_matrix(const std::string& name, const double* matrix) { add(name, 3, 3, matrix); }
+    void add_vector(const std::string& name, const double* vector, int size) { add(name, 1, size, vector); }
+
+    // serialize in format, appended to buffer
+    void serialize(OutputFormat format, std::string& buffer) const;
+};
+
+// binary layout, native byte order: magic "CTFD", uint32 version and entry count, then
+// per entry uint32 rows, cols and name length, the name without terminator and rows x
+// cols float64 values
+const char format_magic[4] = { 'C', 'T', 'F', 'D' };
+const unsigned format_version = 1;
+
+// write document to file, stdout if empty or -, in one write. false and error if the
+// file could not be written
+bool write_document(const std::string& filename, const FormatDocument& document, OutputFormat format, std::string& error);
+
+}
@@ -0,0 +1,81 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "gamut.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace colortool {
+
+namespace {
+
+const int edgesteps = 256;
+
+// distance of channels from the max channel, 0 for black
+void distances(const double* rgb, double* d)
+{
+    const double ac = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+    for (int i = 0; i < 3; ++i) {
+        d[i] = ac != 0.0 ? (ac - rgb[i]) / std::abs(ac) : 0.0;
+    }
+}
+
+}
+
+GamutCompression
+gamut_compression(const double* matrix, float threshold, float power)
+{
+    GamutCompression gamut;
+    gamut.enabled = true;
+    gamut.power = power;
+    // source gamut boundary in target rgb, the distance is invariant to scale so the
+    // edges between primaries cover every direction of the boundary
+    double limit[3] = { 0.0, 0.0, 0.0 };
+    for (int edge = 0; edge < 3; ++edge) {
+        const int first = edge, second = (edge + 1) % 3;
+        for (int step = 0; step <= edgesteps; ++step) {
+            double source[3] = { 0.0, 0.0, 0.0 };
+            source[first] = 1.0 - double(step) / edgesteps;
+            source[second] = double(step) / edgesteps;
+            double rgb[3], d[3];
+            for (int i = 0; i < 3; ++i) {
+                rgb[i] = matrix[i * 3] * source[0] + matrix[i * 3 + 1] * source[1] + matrix[i * 3 + 2] * source[2];
+            }
+            distances(rgb, d);
+            for (int i = 0; i < 3; ++i) {
+                limit[i] = std::max(limit[i], d[i]);
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        gamut.threshold[i] = threshold;
+        gamut.limit[i] = static_cast<float>(limit[i]);
+    }
+    return gamut;
+}
+
+void
+compress_gamut(const GamutCompression& gamut, double* rgb)
+{
+    if (!gamut.enabled) {
+        return;
+    }
+    const double ac = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+    const double p = gamut.power;
+    double d[3];
+    distances(rgb, d);
+    for (int i = 0; i < 3; ++i) {
+        const double t = gamut.threshold[i], l = gamut.limit[i];
+        if (l > 1.0 && t < 1.0 && d[i] >= t) {
+            const double s = (l - t) / std::pow(std::pow((1.0 - t) / (l - t), -p) - 1.0, 1.0 / p);
+            const double x = (d[i] - t) / s;
+            d[i] = t + s * x / std::pow(1.0 + std::pow(x, p), 1.0 / p);
+        }
+        rgb[i] = ac - d[i] * std::abs(ac);
+    }
+}
+
+}
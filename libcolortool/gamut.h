@@ -0,0 +1,27 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include "pixelkernel.h"
+
+namespace colortool {
+
+// gamut compression
+// out of gamut colors are pulled towards the achromatic axis by compressing the distance
+// d = (ac - c) / |ac| of every channel from the max channel ac. distances below threshold
+// are kept, above threshold they are compressed so that the limit maps onto the gamut
+// boundary d = 1. the distance is a ratio so luminance and hue are kept, values above 1
+// in every channel are not touched.
+
+// compression of a source to target rgb matrix, 3x3 row major. limits are the largest
+// distances of the source gamut in target rgb, sampled along the edges between source
+// primaries, channels already inside the target gamut get no compression
+GamutCompression gamut_compression(const double* matrix, float threshold = 0.8f, float power = 1.2f);
+
+// compress linear target rgb in double precision, reference of the kernel
+void compress_gamut(const GamutCompression& gamut, double* rgb);
+
+}
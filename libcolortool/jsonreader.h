@@ -0,0 +1,192 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+
+namespace colortool {
+
+// json reader
+// single pass over the data without building a tree, objects are visited member
+// by member and scalars are returned as text.
+class JsonReader
+{
+public:
+    JsonReader(const char* data, size_t size)
+    : begin(data), ptr(data), end(data + size)
+    {
+    }
+
+    template <typename F>
+    bool read_object(F&& member)
+    {
+        if (!consume('{')) {
+            return fail("expected object");
+        }
+        if (consume('}')) {
+            return true;
+        }
+        std::string key;
+        do {
+            if (!read_string(key)) {
+                return fail("expected member name");
+            }
+            if (!consume(':')) {
+                return fail("expected ':'");
+            }
+            if (!member(key)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}') || fail("expected ',' or '}'");
+    }
+
+    bool read_scalar(std::string& text)
+    {
+        skip_whitespace();
+        if (ptr < end && *ptr == '"') {
+            return read_string(text);
+        }
+        const char* start = ptr;
+        while (ptr < end && (std::isalnum(static_cast<unsigned char>(*ptr)) || *ptr == '-' || *ptr == '+' || *ptr == '.')) {
+            ++ptr;
+        }
+        if (ptr == start) {
+            return fail("expected value");
+        }
+        text.assign(start, ptr);
+        return true;
+    }
+
+    template <typename F>
+    bool read_array(F&& element)
+    {
+        if (!consume('[')) {
+            return fail("expected array");
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!element()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']') || fail("expected ',' or ']'");
+    }
+
+    bool skip_value()
+    {
+        if (peek('{')) {
+            return read_object([&](const std::string&) { return skip_value(); });
+        }
+        if (peek('[')) {
+            return read_array([&]() { return skip_value(); });
+        }
+        std::string text;
+        return read_scalar(text);
+    }
+
+    bool peek(char c)
+    {
+        skip_whitespace();
+        return ptr < end && *ptr == c;
+    }
+
+    bool at_end()
+    {
+        skip_whitespace();
+        return ptr == end;
+    }
+
+    bool fail(const std::string& message)
+    {
+        if (error.empty()) {
+            error = message + " at line " + std::to_string(std::count(begin, ptr, '\n') + 1);
+        }
+        return false;
+    }
+
+    std::string error;
+
+private:
+    void skip_whitespace()
+    {
+        while (ptr < end && (*ptr == ' ' || *ptr == '\n' || *ptr == '\r' || *ptr == '\t')) {
+            ++ptr;
+        }
+    }
+
+    bool consume(char c)
+    {
+        if (peek(c)) {
+            ++ptr;
+            return true;
+        }
+        return false;
+    }
+
+    bool read_string(std::string& str)
+    {
+        if (!consume('"')) {
+            return fail("expected string");
+        }
+        str.clear();
+        while (ptr < end && *ptr != '"') {
+            const char* start = ptr;
+            while (ptr < end && *ptr != '"' && *ptr != '\\') {
+                ++ptr;
+            }
+            str.append(start, ptr);
+            if (ptr < end && *ptr == '\\') {
+                if (++ptr == end) {
+                    break;
+                }
+                char c = *ptr++;
+                switch (c) {
+                    case 'b': str += '\b'; break;
+                    case 'f': str += '\f'; break;
+                    case 'n': str += '\n'; break;
+                    case 'r': str += '\r'; break;
+                    case 't': str += '\t'; break;
+                    case 'u': {
+                        if (end - ptr < 4) {
+                            return fail("invalid escape");
+                        }
+                        unsigned long code = std::strtoul(std::string(ptr, 4).c_str(), nullptr, 16);
+                        ptr += 4;
+                        if (code < 0x80) {
+                            str += char(code);
+                        } else if (code < 0x800) {
+                            str += char(0xc0 | (code >> 6));
+                            str += char(0x80 | (code & 0x3f));
+                        } else {
+                            str += char(0xe0 | (code >> 12));
+                            str += char(0x80 | ((code >> 6) & 0x3f));
+                            str += char(0x80 | (code & 0x3f));
+                        }
+                        break;
+                    }
+                    default: str += c; break;
+                }
+            }
+        }
+        if (ptr == end) {
+            return fail("unterminated string");
+        }
+        ++ptr;
+        return true;
+    }
+
+    const char* begin;
+    const char* ptr;
+    const char* end;
+};
+
+}
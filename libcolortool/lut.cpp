@@ -0,0 +1,285 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "lut.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "gamut.h"
+
+namespace colortool {
+
+namespace {
+
+enum LutFormat {
+    UnknownFormat,
+    CubeFormat,
+    Spi3dFormat
+};
+
+LutFormat lut_format(const std::string& filename)
+{
+    size_t dot = filename.rfind('.');
+    std::string extension = dot == std::string::npos ? std::string() : filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (extension == "cube") {
+        return CubeFormat;
+    } else if (extension == "spi3d") {
+        return Spi3dFormat;
+    }
+    return UnknownFormat;
+}
+
+// floats on line, false if anything else is found
+bool parse_floats(const char* line, float* values, int count)
+{
+    char* end;
+    for (int i = 0; i < count; ++i) {
+        values[i] = std::strtof(line, &end);
+        if (end == line) {
+            return false;
+        }
+        line = end;
+    }
+    while (std::isspace(static_cast<unsigned char>(*line))) {
+        ++line;
+    }
+    return *line == '\0';
+}
+
+bool read_cube(std::istream& stream, Lut3D& lut, std::string& error)
+{
+    std::string line;
+    size_t values = 0, count = 0;
+    while (std::getline(stream, line)) {
+        if (line.size() && line.back() == '\r') {
+            line.pop_back();
+        }
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        const char* p = line.c_str() + start;
+        if (std::isalpha(static_cast<unsigned char>(*p))) {
+            std::istringstream keyword(p);
+            std::string key;
+            keyword >> key;
+            if (key == "TITLE") {
+                continue;
+            } else if (key == "LUT_3D_SIZE") {
+                int size = 0;
+                if (!(keyword >> size) || size < lut_minsize || size > lut_maxsize) {
+                    error = "unsupported LUT_3D_SIZE: " + line;
+                    return false;
+                }
+                lut.size = size;
+                count = size_t(size) * size * size;
+                lut.data.resize(count * 3);
+            } else if (key == "DOMAIN_MIN" || key == "DOMAIN_MAX") {
+                float domain[3];
+                float expected = key == "DOMAIN_MIN" ? 0.0f : 1.0f;
+                if (!parse_floats(p + key.size(), domain, 3) || domain[0] != expected || domain[1] != expected || domain[2] != expected) {
+                    error = "unsupported domain, only [0, 1] is supported: " + line;
+                    return false;
+                }
+            } else if (key == "LUT_1D_SIZE") {
+                error = "1d luts are not supported";
+                return false;
+            } else {
+                error = "unknown keyword: " + key;
+                return false;
+            }
+            continue;
+        }
+        if (!count) {
+            error = "data before LUT_3D_SIZE";
+            return false;
+        }
+        if (values == count || !parse_floats(p, lut.data.data() + values * 3, 3)) {
+            error = "unexpected line: " + line;
+            return false;
+        }
+        values++;
+    }
+    if (!count || values != count) {
+        error = "expected " + std::to_string(count) + " lut entries, found " + std::to_string(values);
+        return false;
+    }
+    return true;
+}
+
+bool read_spi3d(std::istream& stream, Lut3D& lut, std::string& error)
+{
+    std::string magic, version;
+    int channelsin = 0, channelsout = 0, sizer = 0, sizeg = 0, sizeb = 0;
+    if (!(stream >> magic >> version) || magic != "SPILUT") {
+        error = "missing SPILUT header";
+        return false;
+    }
+    if (!(stream >> channelsin >> channelsout) || channelsin != 3 || channelsout != 3) {
+        error = "only 3 to 3 channel luts are supported";
+        return false;
+    }
+    if (!(stream >> sizer >> sizeg >> sizeb) || sizer != sizeg || sizer != sizeb || sizer < lut_minsize || sizer > lut_maxsize) {
+        error = "unsupported lut size";
+        return false;
+    }
+    lut.size = sizer;
+    size_t count = size_t(sizer) * sizer * sizer;
+    lut.data.assign(count * 3, 0.0f);
+    std::vector<bool> found(count, false);
+    size_t values = 0;
+    int r, g, b;
+    float rgb[3];
+    while (stream >> r >> g >> b >> rgb[0] >> rgb[1] >> rgb[2]) {
+        if (r < 0 || g < 0 || b < 0 || r >= sizer || g >= sizer || b >= sizer) {
+            error = "lut index out of range";
+            return false;
+        }
+        std::copy(rgb, rgb + 3, lut.at(r, g, b));
+        size_t index = (size_t(b) * sizer + g) * sizer + r;
+        if (!found[index]) {
+            found[index] = true;
+            values++;
+        }
+    }
+    if (!stream.eof() || values != count) {
+        error = "expected " + std::to_string(count) + " lut entries, found " + std::to_string(values);
+        return false;
+    }
+    return true;
+}
+
+}
+
+void
+transform_value(const PixelTransform& transform, const double* rgb, double* result)
+{
+    double linear[3];
+    for (int i = 0; i < 3; ++i) {
+        linear[i] = transfer_decode(transform.decode, rgb[i]);
+    }
+    double values[3];
+    for (int i = 0; i < 3; ++i) {
+        const float* m = transform.matrix + i * 3;
+        values[i] = m[0] * linear[0] + m[1] * linear[1] + m[2] * linear[2];
+    }
+    compress_gamut(transform.gamut, values);
+    for (int i = 0; i < 3; ++i) {
+        result[i] = transfer_encode(transform.encode, values[i]);
+    }
+}
+
+bool
+bake_lut(const PixelTransform& transform, int size, Lut3D& lut, int threads)
+{
+    if (size < lut_minsize || size > lut_maxsize) {
+        return false;
+    }
+    lut.size = size;
+    lut.data.resize(size_t(size) * size * size * 3);
+
+    // blue slices are interleaved across threads, the reference curves are
+    // expensive so every slice costs about the same
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::min(count, size);
+    auto bake = [&](int first) {
+        const double scale = 1.0 / (size - 1);
+        for (int b = first; b < size; b += count) {
+            for (int g = 0; g < size; ++g) {
+                for (int r = 0; r < size; ++r) {
+                    double rgb[3] = { r * scale, g * scale, b * scale }, result[3];
+                    transform_value(transform, rgb, result);
+                    float* p = lut.at(r, g, b);
+                    p[0] = static_cast<float>(result[0]);
+                    p[1] = static_cast<float>(result[1]);
+                    p[2] = static_cast<float>(result[2]);
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(bake, i);
+    }
+    bake(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return true;
+}
+
+bool
+read_lut(const std::string& filename, Lut3D& lut, std::string& error)
+{
+    LutFormat format = lut_format(filename);
+    if (format == UnknownFormat) {
+        error = "unknown lut format, expected .cube or .spi3d: " + filename;
+        return false;
+    }
+    std::ifstream stream(filename);
+    if (!stream) {
+        error = "could not open lut file: " + filename;
+        return false;
+    }
+    std::string err;
+    if (!(format == CubeFormat ? read_cube(stream, lut, err) : read_spi3d(stream, lut, err))) {
+        error = "could not parse lut file: " + filename + ", " + err;
+        return false;
+    }
+    return true;
+}
+
+bool
+write_lut(const std::string& filename, const Lut3D& lut, const std::string& title, std::string& error)
+{
+    LutFormat format = lut_format(filename);
+    if (format == UnknownFormat) {
+        error = "unknown lut format, expected .cube or .spi3d: " + filename;
+        return false;
+    }
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        error = "could not open lut file for writing: " + filename;
+        return false;
+    }
+    const int size = lut.size;
+    if (format == CubeFormat) {
+        std::fprintf(file, "# %s\n", title.c_str());
+        std::fprintf(file, "LUT_3D_SIZE %d\n", size);
+        for (int b = 0; b < size; ++b) {
+            for (int g = 0; g < size; ++g) {
+                for (int r = 0; r < size; ++r) {
+                    const float* p = lut.at(r, g, b);
+                    std::fprintf(file, "%.6f %.6f %.6f\n", p[0], p[1], p[2]);
+                }
+            }
+        }
+    } else { // spi3d has blue changing fastest
+        std::fprintf(file, "SPILUT 1.0\n3 3\n%d %d %d\n", size, size, size);
+        for (int r = 0; r < size; ++r) {
+            for (int g = 0; g < size; ++g) {
+                for (int b = 0; b < size; ++b) {
+                    const float* p = lut.at(r, g, b);
+                    std::fprintf(file, "%d %d %d %.6f %.6f %.6f\n", r, g, b, p[0], p[1], p[2]);
+                }
+            }
+        }
+    }
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        error = "could not write lut file: " + filename;
+        return false;
+    }
+    return true;
+}
+
+}
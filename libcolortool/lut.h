@@ -0,0 +1,59 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "pixelkernel.h"
+
+namespace colortool {
+
+// 3d lut
+// size^3 rgb float triples with red changing fastest, the domain is [0, 1] on
+// every axis and input outside the domain is clamped. applied with tetrahedral
+// interpolation, the lattice is baked from the exact double reference curves.
+struct Lut3D
+{
+    int size = 0;
+    std::vector<float> data;
+
+    // rgb triple at lattice point
+    float* at(int r, int g, int b) { return data.data() + 3 * ((size_t(b) * size + g) * size + r); }
+    const float* at(int r, int g, int b) const { return data.data() + 3 * ((size_t(b) * size + g) * size + r); }
+};
+
+// lut sizes supported by bake and read
+const int lut_minsize = 2;
+const int lut_maxsize = 129;
+
+// bake transform into lut of size, lattice slices are baked in parallel on
+// threads, 0 for all cores
+bool bake_lut(const PixelTransform& transform, int size, Lut3D& lut, int threads = 0);
+
+// exact transform of a single rgb value in double precision, as baked
+void transform_value(const PixelTransform& transform, const double* rgb, double* result);
+
+// read .cube or .spi3d lut, false and error if unsupported or malformed
+bool read_lut(const std::string& filename, Lut3D& lut, std::string& error);
+
+// write .cube or .spi3d lut by extension, title is written as a comment
+bool write_lut(const std::string& filename, const Lut3D& lut, const std::string& title, std::string& error);
+
+// utils - kernels
+inline void
+apply_lut(float* pixels, size_t count, int nchannels, const Lut3D& lut)
+{
+    pixel_kernel()->lut_interleaved_f32(pixels, count, nchannels, lut.data.data(), lut.size);
+}
+
+inline void
+apply_lut(half* pixels, size_t count, int nchannels, const Lut3D& lut)
+{
+    pixel_kernel()->lut_interleaved_f16(pixels, count, nchannels, lut.data.data(), lut.size);
+}
+
+}
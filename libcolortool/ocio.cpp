@@ -0,0 +1,263 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "ocio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// opencolorio
+#include <OpenColorIO/OpenColorIO.h>
+
+namespace OCIO = OCIO_NAMESPACE;
+
+namespace colortool {
+
+namespace {
+
+const double ocio_whitepoint[2] = { 0.31272, 0.32903 }; // d65 as in illuminants.json
+
+// transform from encoded to linear, nullptr for linear. log curves are ocio log camera
+// transforms with the linear segment slope of the curve, forward is linear to log so
+// they are inverted. acescc has no linear segment and its toe below 2^-15 is not modeled.
+OCIO::TransformRcPtr
+ocio_decode(const Transfer& transfer)
+{
+    auto logcamera = [](double base, double logslope, double logoffset, double linslope, double linoffset, double linbreak, double linearslope) {
+        const double breaks[3] = { linbreak, linbreak, linbreak };
+        OCIO::LogCameraTransformRcPtr transform = OCIO::LogCameraTransform::Create(breaks);
+        const double logslopes[3] = { logslope, logslope, logslope };
+        const double logoffsets[3] = { logoffset, logoffset, logoffset };
+        const double linslopes[3] = { linslope, linslope, linslope };
+        const double linoffsets[3] = { linoffset, linoffset, linoffset };
+        const double linearslopes[3] = { linearslope, linearslope, linearslope };
+        transform->setBase(base);
+        transform->setLogSideSlopeValue(logslopes);
+        transform->setLogSideOffsetValue(logoffsets);
+        transform->setLinSideSlopeValue(linslopes);
+        transform->setLinSideOffsetValue(linoffsets);
+        transform->setLinearSlopeValue(linearslopes);
+        transform->setDirection(OCIO::TRANSFORM_DIR_INVERSE);
+        return OCIO::TransformRcPtr(transform);
+    };
+    switch (transfer.type) {
+        case TransferType::Linear:
+            return OCIO::TransformRcPtr();
+        case TransferType::sRGB: {
+            OCIO::ExponentWithLinearTransformRcPtr transform = OCIO::ExponentWithLinearTransform::Create();
+            const double gamma[4] = { srgb::gamma, srgb::gamma, srgb::gamma, 1.0 };
+            const double offset[4] = { srgb::b, srgb::b, srgb::b, 0.0 };
+            transform->setGamma(gamma);
+            transform->setOffset(offset);
+            return OCIO::TransformRcPtr(transform);
+        }
+        case TransferType::Gamma: {
+            OCIO::ExponentTransformRcPtr transform = OCIO::ExponentTransform::Create();
+            const double value[4] = { transfer.gamma, transfer.gamma, transfer.gamma, 1.0 };
+            transform->setValue(value);
+            transform->setNegativeStyle(OCIO::NEGATIVE_MIRROR);
+            return OCIO::TransformRcPtr(transform);
+        }
+        case TransferType::LogC3:
+            return logcamera(10.0, logc3::c, logc3::d, logc3::a, logc3::b, logc3::cut, logc3::e);
+        case TransferType::LogC4:
+            return logcamera(2.0, logc4::b / 14.0, logc4::c - 6.0 * logc4::b / 14.0, logc4::a, 64.0, logc4::t(), 1.0 / logc4::s());
+        case TransferType::DaVinciIntermediate:
+            return logcamera(2.0, davinci::c, davinci::b * davinci::c, 1.0, davinci::a, davinci::lincut, davinci::m);
+        case TransferType::Film5:
+            return logcamera(std::exp(1.0), film5::a, film5::c, 1.0, film5::b, film5::lincut, film5::d);
+        case TransferType::ACEScc: {
+            OCIO::LogAffineTransformRcPtr transform = OCIO::LogAffineTransform::Create();
+            const double logslopes[3] = { 1.0 / acescc::b, 1.0 / acescc::b, 1.0 / acescc::b };
+            const double logoffsets[3] = { acescc::a / acescc::b, acescc::a / acescc::b, acescc::a / acescc::b };
+            transform->setBase(2.0);
+            transform->setLogSideSlopeValue(logslopes);
+            transform->setLogSideOffsetValue(logoffsets);
+            transform->setDirection(OCIO::TRANSFORM_DIR_INVERSE);
+            return OCIO::TransformRcPtr(transform);
+        }
+        case TransferType::ACEScct:
+            return logcamera(2.0, 1.0 / acescc::b, acescc::a / acescc::b, 1.0, 0.0, acescct::lincut, acescct::a);
+    }
+    return OCIO::TransformRcPtr();
+}
+
+OCIO::TransformRcPtr
+ocio_encode(const Transfer& transfer)
+{
+    OCIO::TransformRcPtr transform = ocio_decode(transfer);
+    if (transform) {
+        OCIO::TransformRcPtr inverse = transform->createEditableCopy();
+        inverse->setDirection(transform->getDirection() == OCIO::TRANSFORM_DIR_FORWARD ? OCIO::TRANSFORM_DIR_INVERSE : OCIO::TRANSFORM_DIR_FORWARD);
+        return inverse;
+    }
+    return transform;
+}
+
+OCIO::TransformRcPtr
+ocio_matrix(const double* matrix)
+{
+    double m44[16] = {
+        matrix[0], matrix[1], matrix[2], 0.0,
+        matrix[3], matrix[4], matrix[5], 0.0,
+        matrix[6], matrix[7], matrix[8], 0.0,
+        0.0, 0.0, 0.0, 1.0
+    };
+    OCIO::MatrixTransformRcPtr transform = OCIO::MatrixTransform::Create();
+    transform->setMatrix(m44);
+    return OCIO::TransformRcPtr(transform);
+}
+
+const char*
+ocio_encoding(const Transfer& transfer)
+{
+    switch (transfer.type) {
+        case TransferType::Linear: return "scene-linear";
+        case TransferType::sRGB:
+        case TransferType::Gamma: return "sdr-video";
+        default: return "log";
+    }
+}
+
+// a single pixel row, rgb channels of interleaved pixels
+void ocio_apply(const OCIO::ConstCPUProcessorRcPtr& processor, void* pixels, size_t count, int nchannels, OCIO::BitDepth depth, size_t size)
+{
+    OCIO::PackedImageDesc desc(pixels, long(count), 1, OCIO::CHANNEL_ORDERING_RGB, depth,
+                               ptrdiff_t(size), ptrdiff_t(size * nchannels), ptrdiff_t(size * nchannels * count));
+    processor->apply(desc);
+}
+
+}
+
+bool
+ocio_config(const std::vector<RegistryColorspace>& colorspaces, const AdaptationTransform& transform, std::string& config, std::string& error)
+{
+    try {
+        OCIO::ConfigRcPtr ocioconfig = OCIO::Config::Create();
+        ocioconfig->setMajorVersion(2);
+        ocioconfig->setMinorVersion(0);
+        ocioconfig->setDescription(("colortool colorspaces, adaptation method: " + transform.name).c_str());
+
+        OCIO::ColorSpaceRcPtr reference = OCIO::ColorSpace::Create();
+        reference->setName(ocio_reference);
+        reference->setFamily("colortool");
+        reference->setDescription("CIE XYZ with D65 whitepoint, reference of all colorspaces");
+        reference->setEncoding("scene-linear");
+        ocioconfig->addColorSpace(reference);
+
+        for (const RegistryColorspace& cs : colorspaces) {
+            Transfer transfer;
+            if (!parse_transfer(cs.trc, transfer)) {
+                error = "unknown transfer of colorspace " + cs.name + ": " + cs.trc;
+                return false;
+            }
+            // rgb to reference, adapted from colorspace to reference whitepoint
+            double rgbxyz[9], adaptation[9], matrix[9];
+            rgb_to_xyz(cs.r, cs.g, cs.b, cs.whitepoint, rgbxyz);
+            const Eigen::Vector3d sourcexyz = xy_to_xyz(Eigen::Vector2d(cs.whitepoint));
+            const Eigen::Vector3d targetxyz = xy_to_xyz(Eigen::Vector2d(ocio_whitepoint));
+            adaptation_matrix(transform, sourcexyz.data(), targetxyz.data(), 1.0, adaptation);
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    matrix[i * 3 + j] = adaptation[i * 3] * rgbxyz[j] + adaptation[i * 3 + 1] * rgbxyz[3 + j] + adaptation[i * 3 + 2] * rgbxyz[6 + j];
+                }
+            }
+            OCIO::TransformRcPtr decode = ocio_decode(transfer);
+            for (bool linear : { false, true }) {
+                if (linear && !decode) {
+                    break;
+                }
+                OCIO::ColorSpaceRcPtr colorspace = OCIO::ColorSpace::Create();
+                colorspace->setName(linear ? (cs.name + " Linear").c_str() : cs.name.c_str());
+                colorspace->setFamily("colortool");
+                colorspace->setDescription(linear ? (cs.description + ", linear").c_str() : cs.description.c_str());
+                colorspace->setEncoding(linear ? "scene-linear" : ocio_encoding(transfer));
+                OCIO::GroupTransformRcPtr group = OCIO::GroupTransform::Create();
+                if (!linear && decode) {
+                    group->appendTransform(decode);
+                }
+                group->appendTransform(ocio_matrix(matrix));
+                colorspace->setTransform(group, OCIO::COLORSPACE_DIR_TO_REFERENCE);
+                ocioconfig->addColorSpace(colorspace);
+            }
+        }
+        ocioconfig->setRole(OCIO::ROLE_DEFAULT, ocio_reference);
+        ocioconfig->setRole(OCIO::ROLE_SCENE_LINEAR, ocio_reference);
+        ocioconfig->setRole(OCIO::ROLE_REFERENCE, ocio_reference);
+        ocioconfig->addDisplayView("None", "Raw", ocio_reference, "");
+        ocioconfig->validate();
+
+        std::ostringstream stream;
+        ocioconfig->serialize(stream);
+        config = stream.str();
+    } catch (const OCIO::Exception& exception) {
+        error = std::string("could not create ocio config: ") + exception.what();
+        return false;
+    }
+    return true;
+}
+
+struct OcioProcessor::Processors
+{
+    OCIO::ConstCPUProcessorRcPtr f32;
+    OCIO::ConstCPUProcessorRcPtr f16;
+};
+
+OcioProcessor::OcioProcessor()
+{
+}
+
+OcioProcessor::~OcioProcessor()
+{
+}
+
+bool
+OcioProcessor::create(const PixelTransform& transform)
+{
+    try {
+        // raw config, processors are cached by ocio for equal transforms
+        static OCIO::ConstConfigRcPtr config = OCIO::Config::CreateRaw();
+        OCIO::GroupTransformRcPtr group = OCIO::GroupTransform::Create();
+        if (OCIO::TransformRcPtr decode = ocio_decode(transform.decode)) {
+            group->appendTransform(decode);
+        }
+        double matrix[9];
+        std::copy(transform.matrix, transform.matrix + 9, matrix);
+        group->appendTransform(ocio_matrix(matrix));
+        if (OCIO::TransformRcPtr encode = ocio_encode(transform.encode)) {
+            group->appendTransform(encode);
+        }
+        OCIO::ConstProcessorRcPtr processor = config->getProcessor(group);
+        std::unique_ptr<Processors> created(new Processors());
+        created->f32 = processor->getOptimizedCPUProcessor(OCIO::BIT_DEPTH_F32, OCIO::BIT_DEPTH_F32, OCIO::OPTIMIZATION_DEFAULT);
+        created->f16 = processor->getOptimizedCPUProcessor(OCIO::BIT_DEPTH_F16, OCIO::BIT_DEPTH_F16, OCIO::OPTIMIZATION_DEFAULT);
+        processors = std::move(created);
+    } catch (const OCIO::Exception& exception) {
+        error = std::string("could not create ocio processor: ") + exception.what();
+        return false;
+    }
+    return true;
+}
+
+void
+OcioProcessor::apply(float* pixels, size_t count, int nchannels) const
+{
+    ocio_apply(processors->f32, pixels, count, nchannels, OCIO::BIT_DEPTH_F32, sizeof(float));
+}
+
+void
+OcioProcessor::apply(half* pixels, size_t count, int nchannels) const
+{
+    ocio_apply(processors->f16, pixels, count, nchannels, OCIO::BIT_DEPTH_F16, sizeof(half));
+}
+
+const std::string&
+OcioProcessor::geterror() const
+{
+    return error;
+}
+
+}
@@ -0,0 +1,57 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "adaptation.h"
+#include "colormath.h"
+#include "pixelkernel.h"
+#include "registry.h"
+
+namespace colortool {
+
+// opencolorio
+// configs and processors built from colortool colorspaces and transforms, opencolorio
+// is used by the translation unit only and is not part of the public headers.
+
+// reference colorspace of generated configs
+const char* const ocio_reference = "CIE-XYZ-D65";
+
+// ocio config with a colorspace per registry colorspace decoded by its trc, and a
+// linear variant for non linear trcs. colorspaces are converted to the reference with
+// full adaptation of transform, so any pair of them gives the colortool transform.
+bool ocio_config(const std::vector<RegistryColorspace>& colorspaces, const AdaptationTransform& transform, std::string& config, std::string& error);
+
+// ocio processor
+// optimized cpu processors for a pixel transform, created once and shared by all
+// threads and frames. apply is thread safe.
+class OcioProcessor
+{
+public:
+    OcioProcessor();
+    ~OcioProcessor();
+    OcioProcessor(const OcioProcessor&) = delete;
+    OcioProcessor& operator=(const OcioProcessor&) = delete;
+
+    // create processors for transform, false if ocio fails
+    bool create(const PixelTransform& transform);
+
+    // interleaved pixels with nchannels >= 3, only the first three channels are transformed
+    void apply(float* pixels, size_t count, int nchannels) const;
+    void apply(half* pixels, size_t count, int nchannels) const;
+
+    const std::string& geterror() const;
+
+private:
+    struct Processors;
+    std::unique_ptr<Processors> processors;
+    std::string error;
+};
+
+}
@@ -0,0 +1,106 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "pairwise.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+}
+
+ConeSpace
+cone_space(const Eigen::Matrix3d& rgbxyz, const Eigen::Vector3d& whitepoint, AdaptationMethod method)
+{
+    const Eigen::Matrix3d cone = adaptation_matrix(method);
+    ConeSpace space;
+    space.rgblms = cone * rgbxyz;
+    space.lmsrgb = rgbxyz.inverse() * adaptation_inverse(method);
+    space.white = cone * whitepoint;
+    return space;
+}
+
+ConeSpace
+cone_space(const Eigen::Matrix3d& rgbxyz, const Eigen::Vector3d& whitepoint, const AdaptationTransform& transform)
+{
+    Eigen::Map<const RowMatrix3d> cone(transform.cone);
+    ConeSpace space;
+    space.rgblms = cone * rgbxyz;
+    space.lmsrgb = rgbxyz.inverse() * Eigen::Map<const RowMatrix3d>(transform.inverse);
+    space.white = cone * whitepoint;
+    return space;
+}
+
+void
+cone_transform(const ConeSpace& input, const ConeSpace& output, double* matrix)
+{
+    Eigen::Map<RowMatrix3d> transform(matrix);
+    transform = output.lmsrgb * (output.white.cwiseQuotient(input.white).asDiagonal() * input.rgblms);
+}
+
+void
+cone_transform(const ConeSpace& input, const ConeSpace& output, double degree, double* matrix)
+{
+    if (degree >= 1.0) {
+        cone_transform(input, output, matrix);
+        return;
+    }
+    Eigen::Map<RowMatrix3d> transform(matrix);
+    const Eigen::Vector3d scale = (degree * output.white.cwiseQuotient(input.white)).array() + (1.0 - degree);
+    transform = output.lmsrgb * (scale.asDiagonal() * input.rgblms);
+}
+
+PairwiseTable
+pairwise_transforms(const std::vector<Colorspace>& colorspaces, const std::vector<AdaptationTransform>& transforms, double degree, int threads)
+{
+    PairwiseTable table;
+    const size_t n = colorspaces.size(), m = transforms.size();
+    for (const AdaptationTransform& transform : transforms) {
+        table.methods.push_back(transform.name);
+    }
+    for (const Colorspace& colorspace : colorspaces) {
+        table.names.push_back(colorspace.name);
+    }
+    table.matrices.resize(n * n * m * 9);
+
+    // once per colorspace and transform
+    std::vector<ConeSpace> cones(n * m);
+    for (size_t i = 0; i < n; ++i) {
+        const Eigen::Matrix3d rgbxyz = rgb_to_xyz(colorspaces[i]);
+        const Eigen::Vector3d white = xy_to_xyz(colorspaces[i].whitepoint);
+        for (size_t k = 0; k < m; ++k) {
+            cones[i * m + k] = cone_space(rgbxyz, white, transforms[k]);
+        }
+    }
+
+    // pairs, inputs are interleaved across threads
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::max(std::min(count, int(n)), 1);
+    auto compute = [&](int first) {
+        for (size_t i = first; i < n; i += count) {
+            for (size_t o = 0; o < n; ++o) {
+                for (size_t k = 0; k < m; ++k) {
+                    cone_transform(cones[i * m + k], cones[o * m + k], degree, table.matrices.data() + ((i * n + o) * m + k) * 9);
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(compute, i);
+    }
+    compute(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return table;
+}
+
+}
@@ -0,0 +1,58 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "adaptation.h"
+#include "colormath.h"
+
+namespace colortool {
+
+// pairwise transforms
+// transforms for every ordered pair of colorspaces and adaptation transform. rgb to xyz,
+// xyz to rgb and cone responses are computed once per colorspace and transform, so a
+// pair is a diagonal scale and one 3x3 product. matrices are 3x3 row major doubles.
+
+// rgb to cone responses, cone responses to rgb and the cone response of the whitepoint
+// of a colorspace for a method
+struct ConeSpace
+{
+    Eigen::Matrix3d rgblms;
+    Eigen::Matrix3d lmsrgb;
+    Eigen::Vector3d white;
+};
+
+// cone space of rgb to xyz and whitepoint xyz, identity rgb to xyz for an illuminant
+ConeSpace cone_space(const Eigen::Matrix3d& rgbxyz, const Eigen::Vector3d& whitepoint, AdaptationMethod method);
+ConeSpace cone_space(const Eigen::Matrix3d& rgbxyz, const Eigen::Vector3d& whitepoint, const AdaptationTransform& transform);
+
+// transform from input to output cone space, 3x3 row major, partially adapted by degree
+void cone_transform(const ConeSpace& input, const ConeSpace& output, double* matrix);
+void cone_transform(const ConeSpace& input, const ConeSpace& output, double degree, double* matrix);
+
+// table of transforms, names in colorspace order
+struct PairwiseTable
+{
+    std::vector<std::string> names;
+    std::vector<std::string> methods; // transform names
+    std::vector<double> matrices; // ((input * colorspaces + output) * methods + method) * 9
+
+    size_t colorspaces() const { return names.size(); }
+
+    // transform from input to output colorspace index with method index
+    const double* transform(size_t input, size_t output, size_t method) const
+    {
+        return matrices.data() + ((input * names.size() + output) * methods.size() + method) * 9;
+    }
+};
+
+// transforms of all pairs for adaptation transforms with degree, input colorspaces are
+// spread across threads, 0 for all cores
+PairwiseTable pairwise_transforms(const std::vector<Colorspace>& colorspaces, const std::vector<AdaptationTransform>& transforms, double degree = 1.0, int threads = 0);
+
+}
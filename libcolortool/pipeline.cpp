@@ -0,0 +1,138 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace colortool {
+
+namespace {
+
+// bounded queue of frame and buffer pairs, closed queues return false once empty
+class FrameQueue
+{
+public:
+    void push(size_t frame, size_t buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.emplace_back(frame, buffer);
+        condition.notify_one();
+    }
+
+    bool pop(size_t& frame, size_t& buffer)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return closed || items.size(); });
+        if (items.empty()) {
+            return false;
+        }
+        frame = items.front().first;
+        buffer = items.front().second;
+        items.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        condition.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::pair<size_t, size_t>> items;
+    bool closed = false;
+};
+
+double
+seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+bool
+Pipeline::run(size_t frames, size_t buffers, const Stage& read, const Stage& compute, const Stage& write, PipelineStats& stats)
+{
+    buffers = std::max<size_t>(buffers, 1);
+    FrameQueue available, readqueue, writequeue;
+    for (size_t i = 0; i < buffers; ++i) {
+        available.push(0, i);
+    }
+    std::atomic<bool> failed(false);
+    auto start = std::chrono::steady_clock::now();
+    stats = PipelineStats();
+
+    // a failed stage closes all queues so every stage returns
+    auto fail = [&]() {
+        failed = true;
+        available.close();
+        readqueue.close();
+        writequeue.close();
+    };
+    std::thread reader([&]() {
+        size_t frame, buffer;
+        for (size_t i = 0; i < frames && !failed; ++i) {
+            if (!available.pop(frame, buffer)) {
+                break;
+            }
+            auto begin = std::chrono::steady_clock::now();
+            bool valid = read(i, buffer);
+            stats.read += seconds_since(begin);
+            if (!valid) {
+                fail();
+                break;
+            }
+            readqueue.push(i, buffer);
+        }
+        readqueue.close();
+    });
+    std::thread computer([&]() {
+        size_t frame, buffer;
+        while (readqueue.pop(frame, buffer)) {
+            auto begin = std::chrono::steady_clock::now();
+            bool valid = compute(frame, buffer);
+            stats.compute += seconds_since(begin);
+            if (!valid) {
+                fail();
+                break;
+            }
+            writequeue.push(frame, buffer);
+        }
+        writequeue.close();
+    });
+    std::thread writer([&]() {
+        size_t frame, buffer;
+        while (writequeue.pop(frame, buffer)) {
+            auto begin = std::chrono::steady_clock::now();
+            bool valid = write(frame, buffer);
+            stats.write += seconds_since(begin);
+            if (!valid) {
+                fail();
+                break;
+            }
+            ++stats.frames;
+            available.push(0, buffer);
+        }
+    });
+    reader.join();
+    computer.join();
+    writer.join();
+    stats.elapsed = seconds_since(start);
+    return !failed;
+}
+
+}
@@ -0,0 +1,38 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace colortool {
+
+// pipeline stats, busy time of each stage in seconds
+struct PipelineStats
+{
+    size_t frames = 0;
+    double elapsed = 0.0;
+    double read = 0.0;
+    double compute = 0.0;
+    double write = 0.0;
+};
+
+// pipeline
+// frames are read, computed and written by three stages running concurrently,
+// each on its own thread. frames hold one of a fixed number of recycled buffers
+// from read until written, so memory is bounded by the buffer count however
+// many frames there are. frames are processed and written in order.
+class Pipeline
+{
+public:
+    // stage function for frame index using buffer index, false stops the pipeline
+    typedef std::function<bool(size_t frame, size_t buffer)> Stage;
+
+    // run frames, false if a stage failed
+    static bool run(size_t frames, size_t buffers, const Stage& read, const Stage& compute, const Stage& write, PipelineStats& stats);
+};
+
+}
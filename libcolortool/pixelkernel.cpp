@@ -0,0 +1,195 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "pixelkernel.h"
+#include "pixelkernel_impl.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define COLORTOOL_X86 1
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#  define COLORTOOL_ARM 1
+#endif
+
+namespace colortool {
+
+#if COLORTOOL_X86
+const PixelKernel* pixel_kernel_sse4();
+const PixelKernel* pixel_kernel_avx2();
+const PixelKernel* pixel_kernel_avx512();
+#elif COLORTOOL_ARM
+const PixelKernel* pixel_kernel_neon();
+#endif
+
+namespace detail {
+
+void half_to_float(const half* src, float* dst, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void float_to_half(const float* src, half* dst, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = half(src[i]);
+    }
+}
+
+}
+
+namespace {
+
+// scalar reference, one pixel per register
+struct Scalar
+{
+    typedef float reg;
+    typedef bool mask;
+    static const int width = 1;
+    static inline reg load(const float* p) { return *p; }
+    static inline void store(float* p, reg v) { *p = v; }
+    static inline reg set1(float v) { return v; }
+    static inline reg add(reg a, reg b) { return a + b; }
+    static inline reg sub(reg a, reg b) { return a - b; }
+    static inline reg mul(reg a, reg b) { return a * b; }
+    static inline reg div(reg a, reg b) { return a / b; }
+    static inline reg sqrt(reg x) { return std::sqrt(x); }
+    static inline reg min(reg a, reg b) { return std::min(a, b); }
+    static inline reg max(reg a, reg b) { return std::max(a, b); }
+    static inline reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+    static inline mask cmplt(reg a, reg b) { return a < b; }
+    static inline mask cmple(reg a, reg b) { return a <= b; }
+    static inline reg select(mask m, reg a, reg b) { return m ? a : b; }
+    static inline reg round(reg x) { return std::nearbyint(x); }
+    static inline reg gather(const float* p, reg index) { return p[static_cast<size_t>(index)]; }
+
+    static inline reg frexp(reg x, reg& e)
+    {
+        uint32_t i;
+        std::memcpy(&i, &x, sizeof(i));
+        e = static_cast<float>(static_cast<int>((i >> 23) & 0xff) - 127);
+        i = (i & 0x007fffff) | 0x3f800000;
+        std::memcpy(&x, &i, sizeof(i));
+        return x;
+    }
+
+    static inline reg ldexp(reg x, reg n) { return std::ldexp(x, static_cast<int>(n)); }
+    static inline void half_to_float(const half* src, float* dst, size_t count) { detail::half_to_float(src, dst, count); }
+    static inline void float_to_half(const float* src, half* dst, size_t count) { detail::float_to_half(src, dst, count); }
+};
+
+#if COLORTOOL_X86
+struct Cpu
+{
+    bool sse4 = false;
+    bool avx2 = false;
+    bool avx512 = false;
+};
+
+// cpuid and xgetbv, avx needs os support for the ymm and zmm state
+static Cpu
+cpu_features()
+{
+    Cpu cpu;
+    unsigned int r1[4] = {}, r7[4] = {};
+#  if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int leafs = info[0];
+    __cpuidex(info, 1, 0);
+    for (int i = 0; i < 4; ++i) r1[i] = info[i];
+    if (leafs >= 7) {
+        __cpuidex(info, 7, 0);
+        for (int i = 0; i < 4; ++i) r7[i] = info[i];
+    }
+#  else
+    unsigned int leafs = __get_cpuid_max(0, nullptr);
+    __get_cpuid(1, &r1[0], &r1[1], &r1[2], &r1[3]);
+    if (leafs >= 7) {
+        __cpuid_count(7, 0, r7[0], r7[1], r7[2], r7[3]);
+    }
+#  endif
+    const bool sse41 = r1[2] & (1u << 19);
+    const bool fma = r1[2] & (1u << 12);
+    const bool osxsave = r1[2] & (1u << 27);
+    const bool avx = r1[2] & (1u << 28);
+    const bool f16c = r1[2] & (1u << 29);
+    const bool avx2 = r7[1] & (1u << 5);
+    const bool avx512f = r7[1] & (1u << 16);
+    unsigned long long xcr0 = 0;
+    if (osxsave) {
+#  if defined(_MSC_VER)
+        xcr0 = _xgetbv(0);
+#  else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#  endif
+    }
+    const bool ymm = (xcr0 & 0x6) == 0x6;
+    const bool zmm = (xcr0 & 0xe6) == 0xe6;
+    cpu.sse4 = sse41;
+    cpu.avx2 = sse41 && avx && avx2 && fma && f16c && ymm;
+    cpu.avx512 = cpu.avx2 && avx512f && zmm;
+    return cpu;
+}
+#endif
+
+}
+
+const PixelKernel*
+pixel_kernel(PixelIsa isa)
+{
+    static const PixelKernel scalar = Kernel<Scalar>::kernel(PixelIsa::Scalar, "scalar");
+#if COLORTOOL_X86
+    static const Cpu cpu = cpu_features();
+#endif
+    switch (isa) {
+        case PixelIsa::Scalar:
+            return &scalar;
+#if COLORTOOL_X86
+        case PixelIsa::SSE4:
+            return cpu.sse4 ? pixel_kernel_sse4() : nullptr;
+        case PixelIsa::AVX2:
+            return cpu.avx2 ? pixel_kernel_avx2() : nullptr;
+        case PixelIsa::AVX512:
+            return cpu.avx512 ? pixel_kernel_avx512() : nullptr;
+#elif COLORTOOL_ARM
+        case PixelIsa::Neon:
+            return pixel_kernel_neon();
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+std::vector<const PixelKernel*>
+pixel_kernels()
+{
+    std::vector<const PixelKernel*> kernels;
+    for (PixelIsa isa : { PixelIsa::Scalar, PixelIsa::SSE4, PixelIsa::AVX2, PixelIsa::AVX512, PixelIsa::Neon }) {
+        if (const PixelKernel* kernel = pixel_kernel(isa)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+const PixelKernel*
+pixel_kernel()
+{
+    static const PixelKernel* kernel = pixel_kernels().back();
+    return kernel;
+}
+
+}
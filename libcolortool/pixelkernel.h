@@ -0,0 +1,139 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// imath
+#include <Imath/half.h>
+
+#include "transfer.h"
+
+namespace colortool {
+
+using Imath::half;
+
+// pixel isa
+enum class PixelIsa {
+    Scalar,
+    SSE4,
+    AVX2,
+    AVX512,
+    Neon
+};
+
+// gamut compression, distance based chroma compression as in the aces reference gamut
+// compression. distances of channels from the max channel above threshold are
+// compressed so that limit lands on the gamut boundary, see gamut.h.
+struct GamutCompression
+{
+    bool enabled = false;
+    float threshold[3] = { 0.815f, 0.803f, 0.880f };
+    float limit[3] = { 1.147f, 1.264f, 1.312f };
+    float power = 1.2f;
+};
+
+// pixel transform, decode -> matrix -> gamut compression -> encode
+struct PixelTransform
+{
+    Transfer decode;
+    float matrix[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    GamutCompression gamut;
+    Transfer encode;
+};
+
+// pixel adaptation, decode -> rgb to lms -> scale by white -> lms to rgb -> encode.
+// whites are linear rgb per pixel, scaled in lms by degree * luminance * target / white
+// + 1 - degree so each white lands on the target white at its own luminance, see
+// adaptation.h.
+struct PixelAdaptation
+{
+    Transfer decode;
+    float rgblms[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    float lmsrgb[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    float luminance[3] = { 0.0f, 1.0f, 0.0f }; // Y row of rgb to xyz
+    float target[3] = { 1.0f, 1.0f, 1.0f }; // lms of the target white, Y = 1
+    float degree = 1.0f;
+    Transfer encode;
+};
+
+// pixel kernel
+// matrices are 3x3 row major floats, pixels are transformed in place. interleaved
+// buffers have nchannels >= 3 and only the first three channels are transformed.
+// transfers use fast log2 and exp2 approximations, see colortool_bench for errors.
+// luts are size^3 rgb floats with red fastest, see lut.h. cielab, ictcp and delta e
+// 2000 of planar cielab are computed for image analysis, see analysis.h. adaptation
+// takes a white per pixel in planes of its own.
+struct PixelKernel
+{
+    PixelIsa isa;
+    const char* name;
+    void (*matrix_interleaved_f32)(float* pixels, size_t count, int nchannels, const float* matrix);
+    void (*matrix_interleaved_f16)(half* pixels, size_t count, int nchannels, const float* matrix);
+    void (*matrix_planar_f32)(float* r, float* g, float* b, size_t count, const float* matrix);
+    void (*matrix_planar_f16)(half* r, half* g, half* b, size_t count, const float* matrix);
+    void (*transform_interleaved_f32)(float* pixels, size_t count, int nchannels, const PixelTransform& transform);
+    void (*transform_interleaved_f16)(half* pixels, size_t count, int nchannels, const PixelTransform& transform);
+    void (*transform_planar_f32)(float* r, float* g, float* b, size_t count, const PixelTransform& transform);
+    void (*transform_planar_f16)(half* r, half* g, half* b, size_t count, const PixelTransform& transform);
+    void (*decode_f32)(float* values, size_t count, const Transfer& transfer);
+    void (*encode_f32)(float* values, size_t count, const Transfer& transfer);
+    void (*lut_interleaved_f32)(float* pixels, size_t count, int nchannels, const float* lut, int size);
+    void (*lut_interleaved_f16)(half* pixels, size_t count, int nchannels, const float* lut, int size);
+    void (*lab_planar_f32)(float* r, float* g, float* b, size_t count, const float* matrix);
+    void (*ictcp_planar_f32)(float* r, float* g, float* b, size_t count, const float* matrix);
+    void (*deltae2000_planar_f32)(const float* l1, const float* a1, const float* b1, const float* l2, const float* a2, const float* b2, float* deltae, size_t count);
+    void (*adapt_planar_f32)(float* r, float* g, float* b, const float* wr, const float* wg, const float* wb, size_t count, const PixelAdaptation& adaptation);
+};
+
+// best kernel supported by the cpu, selected once at runtime
+const PixelKernel* pixel_kernel();
+
+// kernel for isa, nullptr if not supported by the build or cpu
+const PixelKernel* pixel_kernel(PixelIsa isa);
+
+// all kernels supported by the build and cpu, scalar first
+std::vector<const PixelKernel*> pixel_kernels();
+
+// utils - kernels
+inline void
+apply_matrix(float* pixels, size_t count, int nchannels, const float* matrix)
+{
+    pixel_kernel()->matrix_interleaved_f32(pixels, count, nchannels, matrix);
+}
+
+inline void
+apply_matrix(half* pixels, size_t count, int nchannels, const float* matrix)
+{
+    pixel_kernel()->matrix_interleaved_f16(pixels, count, nchannels, matrix);
+}
+
+inline void
+apply_matrix(float* r, float* g, float* b, size_t count, const float* matrix)
+{
+    pixel_kernel()->matrix_planar_f32(r, g, b, count, matrix);
+}
+
+inline void
+apply_matrix(half* r, half* g, half* b, size_t count, const float* matrix)
+{
+    pixel_kernel()->matrix_planar_f16(r, g, b, count, matrix);
+}
+
+inline void
+apply_transform(float* pixels, size_t count, int nchannels, const PixelTransform& transform)
+{
+    pixel_kernel()->transform_interleaved_f32(pixels, count, nchannels, transform);
+}
+
+inline void
+apply_transform(half* pixels, size_t count, int nchannels, const PixelTransform& transform)
+{
+    pixel_kernel()->transform_interleaved_f16(pixels, count, nchannels, transform);
+}
+
+}
@@ -0,0 +1,93 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "pixelkernel_impl.h"
+
+#include <immintrin.h>
+#include <cstring>
+
+namespace colortool {
+namespace {
+
+// avx2, 8 floats with fma and f16c half conversion
+struct AVX2
+{
+    typedef __m256 reg;
+    typedef __m256 mask;
+    static const int width = 8;
+    static inline reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+    static inline reg set1(float v) { return _mm256_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static inline reg sqrt(reg x) { return _mm256_sqrt_ps(x); }
+    static inline reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static inline reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline mask cmplt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline mask cmple(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static inline reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+    static inline reg round(reg x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline reg gather(const float* p, reg index) { return _mm256_i32gather_ps(p, _mm256_cvttps_epi32(index), 4); }
+
+    static inline reg frexp(reg x, reg& e)
+    {
+        __m256i i = _mm256_castps_si256(x);
+        e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(i, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+        return _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(i, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    }
+
+    static inline reg ldexp(reg x, reg n)
+    {
+        return _mm256_mul_ps(x, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23)));
+    }
+
+    static inline void half_to_float(const half* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        }
+        if (i < count) {
+            alignas(16) half h[width] = {};
+            alignas(32) float f[width];
+            std::memcpy(h, src + i, (count - i) * sizeof(half));
+            _mm256_store_ps(f, _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(h))));
+            std::memcpy(dst + i, f, (count - i) * sizeof(float));
+        }
+    }
+
+    static inline void float_to_half(const float* src, half* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+        }
+        if (i < count) {
+            alignas(32) float f[width] = {};
+            alignas(16) half h[width];
+            std::memcpy(f, src + i, (count - i) * sizeof(float));
+            _mm_store_si128(reinterpret_cast<__m128i*>(h), _mm256_cvtps_ph(_mm256_load_ps(f), _MM_FROUND_TO_NEAREST_INT));
+            std::memcpy(dst + i, h, (count - i) * sizeof(half));
+        }
+    }
+};
+
+}
+
+const PixelKernel*
+pixel_kernel_avx2()
+{
+    static const PixelKernel kernel = Kernel<AVX2>::kernel(PixelIsa::AVX2, "avx2");
+    return &kernel;
+}
+
+}
+
+#endif
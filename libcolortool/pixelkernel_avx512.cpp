@@ -0,0 +1,87 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "pixelkernel_impl.h"
+
+#include <immintrin.h>
+#include <cstring>
+
+namespace colortool {
+namespace {
+
+// avx-512f, 16 floats with fma and half conversion
+struct AVX512
+{
+    typedef __m512 reg;
+    typedef __mmask16 mask;
+    static const int width = 16;
+    static inline reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static inline void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+    static inline reg set1(float v) { return _mm512_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static inline reg sqrt(reg x) { return _mm512_sqrt_ps(x); }
+    static inline reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static inline reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static inline mask cmplt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline mask cmple(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static inline reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static inline reg round(reg x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static inline reg gather(const float* p, reg index) { return _mm512_i32gather_ps(_mm512_cvttps_epi32(index), p, 4); }
+
+    static inline reg frexp(reg x, reg& e)
+    {
+        __m512i i = _mm512_castps_si512(x);
+        e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_and_si512(_mm512_srli_epi32(i, 23), _mm512_set1_epi32(0xff)), _mm512_set1_epi32(127)));
+        return _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(i, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(0x3f800000)));
+    }
+
+    static inline reg ldexp(reg x, reg n) { return _mm512_scalef_ps(x, n); }
+
+    static inline void half_to_float(const half* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+        }
+        if (i < count) {
+            __mmask16 mask = static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m256i h = _mm256_setzero_si256();
+            std::memcpy(&h, src + i, (count - i) * sizeof(half));
+            _mm512_mask_storeu_ps(dst + i, mask, _mm512_cvtph_ps(h));
+        }
+    }
+
+    static inline void float_to_half(const float* src, half* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+        }
+        if (i < count) {
+            __mmask16 mask = static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m256i h = _mm512_cvtps_ph(_mm512_maskz_loadu_ps(mask, src + i), _MM_FROUND_TO_NEAREST_INT);
+            std::memcpy(static_cast<void*>(dst + i), &h, (count - i) * sizeof(half));
+        }
+    }
+};
+
+}
+
+const PixelKernel*
+pixel_kernel_avx512()
+{
+    static const PixelKernel kernel = Kernel<AVX512>::kernel(PixelIsa::AVX512, "avx512");
+    return &kernel;
+}
+
+}
+
+#endif
@@ -0,0 +1,975 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include "pixelkernel.h"
+
+#include <cmath>
+
+// pixel kernel implementation, instantiated once per isa translation unit with a
+// simd traits type S. kernels and helpers are in an anonymous namespace and must not
+// call inline functions or templates with external linkage, e.g std::copy, std::min
+// or imath half conversions. those are emitted once per translation unit compiled
+// with the isa flags and the linker keeps one copy for all callers, so the scalar or
+// sse4 kernels could end up calling avx512 code. use the kernel_ helpers below and
+// detail:: half conversion compiled for the baseline isa instead, libm calls on
+// constants are fine.
+//
+// traits:
+//   reg, mask, width
+//   load(const float*), store(float*, reg), set1(float)
+//   add, sub, mul, div, sqrt, min, max, fmadd(a, b, c) -> a * b + c
+//   cmplt, cmple -> mask, select(mask, a, b) -> mask ? a : b
+//   round(x) to nearest, frexp(x, e) -> mantissa in [1, 2), ldexp(x, n) -> x * 2^n
+//   gather(const float* p, index) -> p[index] per lane, index is a whole float
+//   half_to_float(const half*, float*, n), float_to_half(const float*, half*, n)
+
+namespace colortool {
+namespace detail {
+
+// half conversion compiled for the baseline isa
+void half_to_float(const half* src, float* dst, size_t count);
+void float_to_half(const float* src, half* dst, size_t count);
+
+}
+
+namespace {
+
+static const size_t kernel_tile = 256; // pixels per staging tile, fits in l1
+static const double kernel_ln2 = 0.693147180559945309417;
+static const double kernel_sqrt2 = 1.41421356237309504880;
+static const double kernel_pi = 3.14159265358979323846;
+
+// local copy and min, internal linkage and always inlined so each isa gets its own
+#if defined(_MSC_VER)
+#  define KERNEL_INLINE static __forceinline
+#else
+#  define KERNEL_INLINE static inline __attribute__((always_inline))
+#endif
+
+template <typename T>
+KERNEL_INLINE void kernel_copy(const T* first, const T* last, T* result)
+{
+    for (; first != last; ++first, ++result) {
+        *result = *first;
+    }
+}
+
+KERNEL_INLINE size_t kernel_min(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+template <typename S>
+struct Kernel
+{
+    typedef typename S::reg reg;
+    typedef typename S::mask mask;
+
+    // math
+
+    static inline reg set1(double v) { return S::set1(static_cast<float>(v)); }
+
+    // log2 as 2/ln2 * atanh((m - 1) / (m + 1)) with the mantissa in [sqrt(0.5), sqrt(2)),
+    // series to t^7, max error ~4e-8 plus float rounding
+    static inline reg log2(reg x)
+    {
+        reg e;
+        reg m = S::frexp(x, e);
+        mask big = S::cmplt(set1(kernel_sqrt2), m);
+        m = S::select(big, S::mul(m, set1(0.5)), m);
+        e = S::select(big, S::add(e, set1(1.0)), e);
+        reg t = S::div(S::sub(m, set1(1.0)), S::add(m, set1(1.0)));
+        reg t2 = S::mul(t, t);
+        reg p = S::fmadd(t2, S::fmadd(t2, S::fmadd(t2, set1(1.0 / 7.0), set1(1.0 / 5.0)), set1(1.0 / 3.0)), set1(1.0));
+        return S::fmadd(S::mul(t, p), set1(2.0 / kernel_ln2), e);
+    }
+
+    // exp2 as 2^n * e^(f ln2) with f in [-0.5, 0.5], taylor to degree 6,
+    // max relative error ~1.2e-7 plus float rounding
+    static inline reg exp2(reg x)
+    {
+        x = S::min(S::max(x, set1(-126.0)), set1(127.0));
+        reg n = S::round(x);
+        reg y = S::mul(S::sub(x, n), set1(kernel_ln2));
+        reg p = S::fmadd(y, set1(1.0 / 720.0), set1(1.0 / 120.0));
+        p = S::fmadd(y, p, set1(1.0 / 24.0));
+        p = S::fmadd(y, p, set1(1.0 / 6.0));
+        p = S::fmadd(y, p, set1(1.0 / 2.0));
+        p = S::fmadd(y, p, set1(1.0));
+        p = S::fmadd(y, p, set1(1.0));
+        return S::ldexp(p, n);
+    }
+
+    static inline reg pow(reg x, reg exponent) // x > 0
+    {
+        return exp2(S::mul(log2(x), exponent));
+    }
+
+    static inline reg mirror_pow(reg x, reg exponent)
+    {
+        reg zero = S::set1(0.0f);
+        reg a = S::max(x, S::sub(zero, x));
+        reg p = S::select(S::cmplt(zero, a), pow(a, exponent), zero);
+        return S::select(S::cmplt(x, zero), S::sub(zero, p), p);
+    }
+
+    // curves, both branches are evaluated and selected
+
+    template <typename F>
+    static inline void map(float* values, size_t count, F f)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            S::store(values + i, f(S::load(values + i)));
+        }
+        if (i < count) { // tail, padded to a full register
+            float t[S::width] = {};
+            kernel_copy(values + i, values + count, t);
+            S::store(t, f(S::load(t)));
+            kernel_copy(t, t + (count - i), values + i);
+        }
+    }
+
+    static void decode_f32(float* values, size_t count, const Transfer& transfer)
+    {
+        switch (transfer.type) {
+            case TransferType::Linear:
+                break;
+            case TransferType::sRGB: {
+                const reg cut = set1(srgb::logcut), slope = set1(1.0 / srgb::slope);
+                const reg a = set1(1.0 / srgb::a), b = set1(srgb::b), gamma = set1(srgb::gamma);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(x, slope);
+                    reg p = pow(S::max(S::mul(S::add(x, b), a), set1(1e-30)), gamma);
+                    return S::select(S::cmple(x, cut), lin, p);
+                });
+                break;
+            }
+            case TransferType::Gamma: {
+                const reg gamma = S::set1(transfer.gamma);
+                map(values, count, [&](reg x) { return mirror_pow(x, gamma); });
+                break;
+            }
+            case TransferType::LogC3: {
+                const reg cut = set1(logc3::e * logc3::cut + logc3::f);
+                const reg ia = set1(1.0 / logc3::a), b = set1(logc3::b), d = set1(logc3::d);
+                const reg scale = set1(std::log2(10.0) / logc3::c), ie = set1(1.0 / logc3::e), f = set1(logc3::f);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(S::sub(x, f), ie);
+                    reg log = S::mul(S::sub(exp2(S::mul(S::sub(x, d), scale)), b), ia);
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::LogC4: {
+                const reg zero = S::set1(0.0f), s = set1(logc4::s()), t = set1(logc4::t());
+                const reg c = set1(logc4::c), scale = set1(14.0 / logc4::b), ia = set1(1.0 / logc4::a);
+                map(values, count, [&](reg x) {
+                    reg lin = S::fmadd(x, s, t);
+                    reg log = S::mul(S::sub(exp2(S::fmadd(S::sub(x, c), scale, set1(6.0))), set1(64.0)), ia);
+                    return S::select(S::cmplt(x, zero), lin, log);
+                });
+                break;
+            }
+            case TransferType::DaVinciIntermediate: {
+                const reg cut = set1(davinci::logcut), im = set1(1.0 / davinci::m);
+                const reg ic = set1(1.0 / davinci::c), a = set1(davinci::a), b = set1(davinci::b);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(x, im);
+                    reg log = S::sub(exp2(S::sub(S::mul(x, ic), b)), a);
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::Film5: {
+                const reg cut = set1(film5::logcut), id = set1(1.0 / film5::d), e = set1(film5::e);
+                const reg c = set1(film5::c), scale = set1(1.0 / (film5::a * kernel_ln2)), b = set1(film5::b);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(S::sub(x, e), id);
+                    reg log = S::sub(exp2(S::mul(S::sub(x, c), scale)), b);
+                    return S::select(S::cmplt(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::ACEScc: {
+                const reg cut = set1((acescc::a - 15.0) / acescc::b), b = set1(acescc::b), a = set1(acescc::a);
+                const reg toe = set1(std::pow(2.0, -16.0)), max = set1(acescc::max);
+                map(values, count, [&](reg x) {
+                    reg p = exp2(S::sub(S::mul(x, b), a));
+                    reg lin = S::mul(S::sub(p, toe), set1(2.0));
+                    return S::select(S::cmplt(x, cut), lin, S::min(p, max));
+                });
+                break;
+            }
+            case TransferType::ACEScct: {
+                const reg cut = set1(acescct::logcut), ia = set1(1.0 / acescct::a), bb = set1(acescct::b);
+                const reg b = set1(acescc::b), a = set1(acescc::a);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(S::sub(x, bb), ia);
+                    reg log = exp2(S::sub(S::mul(x, b), a));
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+        }
+    }
+
+    static void encode_f32(float* values, size_t count, const Transfer& transfer)
+    {
+        switch (transfer.type) {
+            case TransferType::Linear:
+                break;
+            case TransferType::sRGB: {
+                const reg cut = set1(srgb::lincut), slope = set1(srgb::slope);
+                const reg a = set1(srgb::a), b = set1(srgb::b), igamma = set1(1.0 / srgb::gamma);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(x, slope);
+                    reg p = S::sub(S::mul(a, pow(S::max(x, set1(1e-30)), igamma)), b);
+                    return S::select(S::cmple(x, cut), lin, p);
+                });
+                break;
+            }
+            case TransferType::Gamma: {
+                const reg igamma = S::set1(1.0f / transfer.gamma);
+                map(values, count, [&](reg x) { return mirror_pow(x, igamma); });
+                break;
+            }
+            case TransferType::LogC3: {
+                const reg cut = set1(logc3::cut), a = set1(logc3::a), b = set1(logc3::b);
+                const reg c = set1(logc3::c * std::log10(2.0)), d = set1(logc3::d), e = set1(logc3::e), f = set1(logc3::f);
+                map(values, count, [&](reg x) {
+                    reg lin = S::fmadd(x, e, f);
+                    reg log = S::fmadd(log2(S::max(S::fmadd(x, a, b), set1(1e-30))), c, d);
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::LogC4: {
+                const reg t = set1(logc4::t()), is = set1(1.0 / logc4::s()), a = set1(logc4::a);
+                const reg scale = set1(logc4::b / 14.0), c = set1(logc4::c);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(S::sub(x, t), is);
+                    reg log = S::fmadd(S::sub(log2(S::max(S::fmadd(x, a, set1(64.0)), set1(1e-30))), set1(6.0)), scale, c);
+                    return S::select(S::cmplt(x, t), lin, log);
+                });
+                break;
+            }
+            case TransferType::DaVinciIntermediate: {
+                const reg cut = set1(davinci::lincut), m = set1(davinci::m);
+                const reg a = set1(davinci::a), b = set1(davinci::b), c = set1(davinci::c);
+                map(values, count, [&](reg x) {
+                    reg lin = S::mul(x, m);
+                    reg log = S::mul(S::add(log2(S::max(S::add(x, a), set1(1e-30))), b), c);
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::Film5: {
+                const reg cut = set1(film5::lincut), d = set1(film5::d), e = set1(film5::e);
+                const reg a = set1(film5::a * kernel_ln2), b = set1(film5::b), c = set1(film5::c);
+                map(values, count, [&](reg x) {
+                    reg lin = S::fmadd(x, d, e);
+                    reg log = S::fmadd(log2(S::max(S::add(x, b), set1(1e-30))), a, c);
+                    return S::select(S::cmplt(x, cut), lin, log);
+                });
+                break;
+            }
+            case TransferType::ACEScc: {
+                const reg zero = S::set1(0.0f), cut = set1(std::pow(2.0, -15.0)), toe = set1(std::pow(2.0, -16.0));
+                const reg ib = set1(1.0 / acescc::b), a = set1(acescc::a), min = set1((-16.0 + acescc::a) / acescc::b);
+                map(values, count, [&](reg x) {
+                    reg small = S::fmadd(x, set1(0.5), toe);
+                    reg log = S::mul(S::add(log2(S::select(S::cmplt(x, cut), small, x)), a), ib);
+                    return S::select(S::cmple(x, zero), min, log);
+                });
+                break;
+            }
+            case TransferType::ACEScct: {
+                const reg cut = set1(acescct::lincut), aa = set1(acescct::a), bb = set1(acescct::b);
+                const reg ib = set1(1.0 / acescc::b), a = set1(acescc::a);
+                map(values, count, [&](reg x) {
+                    reg lin = S::fmadd(x, aa, bb);
+                    reg log = S::mul(S::add(log2(S::max(x, set1(1e-30))), a), ib);
+                    return S::select(S::cmple(x, cut), lin, log);
+                });
+                break;
+            }
+        }
+    }
+
+    // transform, decode -> matrix -> gamut compression -> encode on planar tiles
+
+    static inline void matrix(reg& r, reg& g, reg& b, const reg* m)
+    {
+        reg rr = S::fmadd(m[0], r, S::fmadd(m[1], g, S::mul(m[2], b)));
+        reg gg = S::fmadd(m[3], r, S::fmadd(m[4], g, S::mul(m[5], b)));
+        reg bb = S::fmadd(m[6], r, S::fmadd(m[7], g, S::mul(m[8], b)));
+        r = rr;
+        g = gg;
+        b = bb;
+    }
+
+    // gamut compression, distance d = (ac - c) / |ac| from the max channel ac is
+    // compressed above threshold t to t + s * x / (1 + x^p)^(1/p), x = (d - t) / s,
+    // and c = ac - d * |ac|. channels with a limit inside the gamut are never compressed.
+
+    struct Compression
+    {
+        bool active = false;
+        reg threshold[3];
+        reg scale[3];
+        reg inverse[3]; // 1 / scale
+        reg power;
+        reg invpower;
+    };
+
+    static Compression compression(const GamutCompression& gamut)
+    {
+        Compression c;
+        const double p = gamut.power;
+        for (int i = 0; i < 3; ++i) {
+            const double t = gamut.threshold[i], l = gamut.limit[i];
+            const bool active = gamut.enabled && l > 1.0 && t < 1.0;
+            const double s = active ? (l - t) / std::pow(std::pow((1.0 - t) / (l - t), -p) - 1.0, 1.0 / p) : 1.0;
+            c.threshold[i] = set1(active ? t : 1e30);
+            c.scale[i] = set1(s);
+            c.inverse[i] = set1(1.0 / s);
+            c.active = c.active || active;
+        }
+        c.power = set1(p);
+        c.invpower = set1(1.0 / p);
+        return c;
+    }
+
+    // x / (1 + x^p)^(1/p) as 2^(log2 x - log2(1 + x^p) / p)
+    static inline reg compress_distance(reg d, int i, const Compression& c)
+    {
+        reg lx = log2(S::max(S::mul(S::sub(d, c.threshold[i]), c.inverse[i]), set1(1e-30)));
+        reg y = S::sub(lx, S::mul(log2(S::add(exp2(S::mul(lx, c.power)), set1(1.0))), c.invpower));
+        return S::select(S::cmplt(d, c.threshold[i]), d, S::fmadd(c.scale[i], exp2(y), c.threshold[i]));
+    }
+
+    static inline void compress(reg& r, reg& g, reg& b, const Compression& c)
+    {
+        reg zero = S::set1(0.0f);
+        reg ac = S::max(r, S::max(g, b));
+        reg a = S::max(ac, S::sub(zero, ac));
+        reg inverse = S::select(S::cmplt(zero, a), S::div(set1(1.0), a), zero); // 0 for black
+        r = S::sub(ac, S::mul(compress_distance(S::mul(S::sub(ac, r), inverse), 0, c), a));
+        g = S::sub(ac, S::mul(compress_distance(S::mul(S::sub(ac, g), inverse), 1, c), a));
+        b = S::sub(ac, S::mul(compress_distance(S::mul(S::sub(ac, b), inverse), 2, c), a));
+    }
+
+    static void matrix_f32(float* r, float* g, float* b, size_t count, const float* matrix)
+    {
+        matrix_f32<false>(r, g, b, count, matrix, Compression());
+    }
+
+    static void matrix_f32(float* r, float* g, float* b, size_t count, const float* matrix, const GamutCompression& gamut)
+    {
+        Compression c = compression(gamut);
+        if (c.active) {
+            matrix_f32<true>(r, g, b, count, matrix, c);
+        } else {
+            matrix_f32<false>(r, g, b, count, matrix, c);
+        }
+    }
+
+    // matrix with gamut compression fused while the registers are live
+    template <bool compressed>
+    static void matrix_f32(float* r, float* g, float* b, size_t count, const float* matrix, const Compression& c)
+    {
+        reg m[9];
+        for (int i = 0; i < 9; ++i) {
+            m[i] = S::set1(matrix[i]);
+        }
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            reg rv = S::load(r + i);
+            reg gv = S::load(g + i);
+            reg bv = S::load(b + i);
+            Kernel::matrix(rv, gv, bv, m);
+            if (compressed) {
+                compress(rv, gv, bv, c);
+            }
+            S::store(r + i, rv);
+            S::store(g + i, gv);
+            S::store(b + i, bv);
+        }
+        if (i < count) { // tail, padded to a full register
+            float tr[S::width] = {}, tg[S::width] = {}, tb[S::width] = {};
+            size_t n = count - i;
+            kernel_copy(r + i, r + count, tr);
+            kernel_copy(g + i, g + count, tg);
+            kernel_copy(b + i, b + count, tb);
+            reg rv = S::load(tr);
+            reg gv = S::load(tg);
+            reg bv = S::load(tb);
+            Kernel::matrix(rv, gv, bv, m);
+            if (compressed) {
+                compress(rv, gv, bv, c);
+            }
+            S::store(tr, rv);
+            S::store(tg, gv);
+            S::store(tb, bv);
+            kernel_copy(tr, tr + n, r + i);
+            kernel_copy(tg, tg + n, g + i);
+            kernel_copy(tb, tb + n, b + i);
+        }
+    }
+
+    // a single tile, all passes run while the tile is in l1
+    static inline void transform_tile(float* r, float* g, float* b, size_t count, const PixelTransform& transform)
+    {
+        if (transform.decode.type != TransferType::Linear) {
+            decode_f32(r, count, transform.decode);
+            decode_f32(g, count, transform.decode);
+            decode_f32(b, count, transform.decode);
+        }
+        matrix_f32(r, g, b, count, transform.matrix, transform.gamut);
+        if (transform.encode.type != TransferType::Linear) {
+            encode_f32(r, count, transform.encode);
+            encode_f32(g, count, transform.encode);
+            encode_f32(b, count, transform.encode);
+        }
+    }
+
+    static void transform_planar_f32(float* r, float* g, float* b, size_t count, const PixelTransform& transform)
+    {
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            transform_tile(r + i, g + i, b + i, kernel_min(kernel_tile, count - i), transform);
+        }
+    }
+
+    static void transform_planar_f16(half* r, half* g, half* b, size_t count, const PixelTransform& transform)
+    {
+        alignas(64) float tr[kernel_tile], tg[kernel_tile], tb[kernel_tile];
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            S::half_to_float(r + i, tr, n);
+            S::half_to_float(g + i, tg, n);
+            S::half_to_float(b + i, tb, n);
+            transform_tile(tr, tg, tb, n, transform);
+            S::float_to_half(tr, r + i, n);
+            S::float_to_half(tg, g + i, n);
+            S::float_to_half(tb, b + i, n);
+        }
+    }
+
+    // interleaved buffers are staged through planar tiles, nc is the channel
+    // count known at compile time, 0 for any
+    template <typename T, int NC>
+    static inline void deinterleave(const T* p, size_t n, int nchannels, T* r, T* g, T* b)
+    {
+        const size_t stride = NC ? NC : nchannels;
+        for (size_t i = 0; i < n; ++i, p += stride) {
+            r[i] = p[0];
+            g[i] = p[1];
+            b[i] = p[2];
+        }
+    }
+
+    template <typename T, int NC>
+    static inline void interleave(T* p, size_t n, int nchannels, const T* r, const T* g, const T* b)
+    {
+        const size_t stride = NC ? NC : nchannels;
+        for (size_t i = 0; i < n; ++i, p += stride) {
+            p[0] = r[i];
+            p[1] = g[i];
+            p[2] = b[i];
+        }
+    }
+
+    template <int NC>
+    static void transform_interleaved_f32(float* pixels, size_t count, int nchannels, const PixelTransform& transform)
+    {
+        alignas(64) float tr[kernel_tile], tg[kernel_tile], tb[kernel_tile];
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            float* p = pixels + i * nchannels;
+            deinterleave<float, NC>(p, n, nchannels, tr, tg, tb);
+            transform_tile(tr, tg, tb, n, transform);
+            interleave<float, NC>(p, n, nchannels, tr, tg, tb);
+        }
+    }
+
+    static void transform_interleaved_f32(float* pixels, size_t count, int nchannels, const PixelTransform& transform)
+    {
+        switch (nchannels) {
+            case 3: transform_interleaved_f32<3>(pixels, count, nchannels, transform); break;
+            case 4: transform_interleaved_f32<4>(pixels, count, nchannels, transform); break;
+            default: transform_interleaved_f32<0>(pixels, count, nchannels, transform); break;
+        }
+    }
+
+    template <int NC>
+    static void transform_interleaved_f16(half* pixels, size_t count, int nchannels, const PixelTransform& transform)
+    {
+        half hr[kernel_tile], hg[kernel_tile], hb[kernel_tile];
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            half* p = pixels + i * nchannels;
+            deinterleave<half, NC>(p, n, nchannels, hr, hg, hb);
+            transform_planar_f16(hr, hg, hb, n, transform);
+            interleave<half, NC>(p, n, nchannels, hr, hg, hb);
+        }
+    }
+
+    static void transform_interleaved_f16(half* pixels, size_t count, int nchannels, const PixelTransform& transform)
+    {
+        switch (nchannels) {
+            case 3: transform_interleaved_f16<3>(pixels, count, nchannels, transform); break;
+            case 4: transform_interleaved_f16<4>(pixels, count, nchannels, transform); break;
+            default: transform_interleaved_f16<0>(pixels, count, nchannels, transform); break;
+        }
+    }
+
+    // 3d lut, tetrahedral interpolation. the cube is split along its diagonal into six
+    // tetrahedra picked by the order of the fractions, corners are selected branch free
+    // and gathered. float offsets are exact up to lut_maxsize
+
+    static inline void lut(reg& r, reg& g, reg& b, const float* table, int size)
+    {
+        const reg zero = S::set1(0.0f), one = S::set1(1.0f);
+        const reg scale = S::set1(float(size - 1)), top = S::set1(float(size - 2));
+        const reg dr = S::set1(3.0f), dg = S::set1(3.0f * size), db = S::set1(3.0f * size * size);
+        reg f[3] = { r, g, b }, index[3];
+        for (int i = 0; i < 3; ++i) {
+            reg x = S::select(S::cmple(zero, f[i]), f[i], zero); // nan to zero
+            x = S::min(S::mul(x, scale), scale);
+            reg n = S::round(x);
+            n = S::select(S::cmplt(x, n), S::sub(n, one), n); // floor
+            n = S::min(n, top);
+            index[i] = n;
+            f[i] = S::sub(x, n);
+        }
+        reg fmax = S::max(f[0], S::max(f[1], f[2]));
+        reg fmin = S::min(f[0], S::min(f[1], f[2]));
+        reg fmid = S::sub(S::sub(S::add(f[0], S::add(f[1], f[2])), fmax), fmin);
+        // corners are the origin, one step along the max axis, the diagonal less one step
+        // along the min axis and the diagonal. ties resolve to different axes so equal
+        // fractions give zero weights
+        reg maxoffset = S::select(S::cmple(f[1], f[0]),
+                                  S::select(S::cmple(f[2], f[0]), dr, db),
+                                  S::select(S::cmple(f[2], f[1]), dg, db));
+        reg minoffset = S::select(S::cmple(f[2], f[1]),
+                                  S::select(S::cmple(f[2], f[0]), db, dr),
+                                  S::select(S::cmple(f[1], f[0]), dg, dr));
+        reg diagonal = S::add(dr, S::add(dg, db));
+        reg c0 = S::fmadd(index[2], db, S::fmadd(index[1], dg, S::mul(index[0], dr)));
+        reg c1 = S::add(c0, maxoffset);
+        reg c2 = S::sub(S::add(c0, diagonal), minoffset);
+        reg c3 = S::add(c0, diagonal);
+        reg w0 = S::sub(one, fmax), w1 = S::sub(fmax, fmid), w2 = S::sub(fmid, fmin), w3 = fmin;
+        reg rgb[3];
+        for (int j = 0; j < 3; ++j) {
+            const float* p = table + j;
+            rgb[j] = S::fmadd(w3, S::gather(p, c3),
+                     S::fmadd(w2, S::gather(p, c2),
+                     S::fmadd(w1, S::gather(p, c1), S::mul(w0, S::gather(p, c0)))));
+        }
+        r = rgb[0];
+        g = rgb[1];
+        b = rgb[2];
+    }
+
+    static void lut_f32(float* r, float* g, float* b, size_t count, const float* table, int size)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            reg rv = S::load(r + i);
+            reg gv = S::load(g + i);
+            reg bv = S::load(b + i);
+            Kernel::lut(rv, gv, bv, table, size);
+            S::store(r + i, rv);
+            S::store(g + i, gv);
+            S::store(b + i, bv);
+        }
+        if (i < count) { // tail, padded to a full register
+            float tr[S::width] = {}, tg[S::width] = {}, tb[S::width] = {};
+            size_t n = count - i;
+            kernel_copy(r + i, r + count, tr);
+            kernel_copy(g + i, g + count, tg);
+            kernel_copy(b + i, b + count, tb);
+            reg rv = S::load(tr);
+            reg gv = S::load(tg);
+            reg bv = S::load(tb);
+            Kernel::lut(rv, gv, bv, table, size);
+            S::store(tr, rv);
+            S::store(tg, gv);
+            S::store(tb, bv);
+            kernel_copy(tr, tr + n, r + i);
+            kernel_copy(tg, tg + n, g + i);
+            kernel_copy(tb, tb + n, b + i);
+        }
+    }
+
+    template <int NC>
+    static void lut_interleaved_f32(float* pixels, size_t count, int nchannels, const float* table, int size)
+    {
+        alignas(64) float tr[kernel_tile], tg[kernel_tile], tb[kernel_tile];
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            float* p = pixels + i * nchannels;
+            deinterleave<float, NC>(p, n, nchannels, tr, tg, tb);
+            lut_f32(tr, tg, tb, n, table, size);
+            interleave<float, NC>(p, n, nchannels, tr, tg, tb);
+        }
+    }
+
+    static void lut_interleaved_f32(float* pixels, size_t count, int nchannels, const float* table, int size)
+    {
+        switch (nchannels) {
+            case 3: lut_interleaved_f32<3>(pixels, count, nchannels, table, size); break;
+            case 4: lut_interleaved_f32<4>(pixels, count, nchannels, table, size); break;
+            default: lut_interleaved_f32<0>(pixels, count, nchannels, table, size); break;
+        }
+    }
+
+    template <int NC>
+    static void lut_interleaved_f16(half* pixels, size_t count, int nchannels, const float* table, int size)
+    {
+        half hr[kernel_tile], hg[kernel_tile], hb[kernel_tile];
+        alignas(64) float tr[kernel_tile], tg[kernel_tile], tb[kernel_tile];
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            half* p = pixels + i * nchannels;
+            deinterleave<half, NC>(p, n, nchannels, hr, hg, hb);
+            S::half_to_float(hr, tr, n);
+            S::half_to_float(hg, tg, n);
+            S::half_to_float(hb, tb, n);
+            lut_f32(tr, tg, tb, n, table, size);
+            S::float_to_half(tr, hr, n);
+            S::float_to_half(tg, hg, n);
+            S::float_to_half(tb, hb, n);
+            interleave<half, NC>(p, n, nchannels, hr, hg, hb);
+        }
+    }
+
+    static void lut_interleaved_f16(half* pixels, size_t count, int nchannels, const float* table, int size)
+    {
+        switch (nchannels) {
+            case 3: lut_interleaved_f16<3>(pixels, count, nchannels, table, size); break;
+            case 4: lut_interleaved_f16<4>(pixels, count, nchannels, table, size); break;
+            default: lut_interleaved_f16<0>(pixels, count, nchannels, table, size); break;
+        }
+    }
+
+    // analysis, linear rgb to cielab and ictcp in place on planar rows
+
+    template <typename F>
+    static inline void map_planar(float* r, float* g, float* b, size_t count, F f)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            reg x = S::load(r + i), y = S::load(g + i), z = S::load(b + i);
+            f(x, y, z);
+            S::store(r + i, x);
+            S::store(g + i, y);
+            S::store(b + i, z);
+        }
+        if (i < count) { // tail, padded to a full register
+            float tr[S::width] = {}, tg[S::width] = {}, tb[S::width] = {};
+            size_t n = count - i;
+            kernel_copy(r + i, r + count, tr);
+            kernel_copy(g + i, g + count, tg);
+            kernel_copy(b + i, b + count, tb);
+            reg x = S::load(tr), y = S::load(tg), z = S::load(tb);
+            f(x, y, z);
+            S::store(tr, x);
+            S::store(tg, y);
+            S::store(tb, z);
+            kernel_copy(tr, tr + n, r + i);
+            kernel_copy(tg, tg + n, g + i);
+            kernel_copy(tb, tb + n, b + i);
+        }
+    }
+
+    // cielab, matrix is rgb to xyz divided by the white so the white is 1, 1, 1. cube
+    // roots are pow with the fast log2 and exp2, linear segment below (6/29)^3
+    static void lab_planar_f32(float* r, float* g, float* b, size_t count, const float* matrix)
+    {
+        reg m[9];
+        for (int i = 0; i < 9; ++i) {
+            m[i] = S::set1(matrix[i]);
+        }
+        const reg cut = set1(216.0 / 24389.0), slope = set1(24389.0 / 3132.0), offset = set1(4.0 / 29.0);
+        const reg third = set1(1.0 / 3.0);
+        auto f = [&](reg t) {
+            return S::select(S::cmple(t, cut), S::fmadd(t, slope, offset), pow(S::max(t, cut), third));
+        };
+        map_planar(r, g, b, count, [&](reg& x, reg& y, reg& z) {
+            Kernel::matrix(x, y, z, m);
+            reg fx = f(x), fy = f(y), fz = f(z);
+            x = S::fmadd(fy, set1(116.0), set1(-16.0));
+            y = S::mul(S::sub(fx, fy), set1(500.0));
+            z = S::mul(S::sub(fy, fz), set1(200.0));
+        });
+    }
+
+    // ictcp of bt.2100, matrix is rgb to lms scaled so 1 is 10000 cd/m2. lms is pq
+    // encoded with negative values clamped to 0
+    static void ictcp_planar_f32(float* r, float* g, float* b, size_t count, const float* matrix)
+    {
+        static const float lmsictcp[9] = {
+            0.5f, 0.5f, 0.0f,
+            6610.0f / 4096.0f, -13613.0f / 4096.0f, 7003.0f / 4096.0f,
+            17933.0f / 4096.0f, -17390.0f / 4096.0f, -543.0f / 4096.0f
+        };
+        reg m[9], ictcp[9];
+        for (int i = 0; i < 9; ++i) {
+            m[i] = S::set1(matrix[i]);
+            ictcp[i] = S::set1(lmsictcp[i]);
+        }
+        const reg zero = S::set1(0.0f), tiny = set1(1e-30);
+        const reg m1 = set1(2610.0 / 16384.0), m2 = set1(2523.0 / 4096.0 * 128.0);
+        const reg c1 = set1(3424.0 / 4096.0), c2 = set1(2413.0 / 4096.0 * 32.0), c3 = set1(2392.0 / 4096.0 * 32.0);
+        const reg black = pow(c1, m2);
+        auto pq = [&](reg x) {
+            reg y = pow(S::max(x, tiny), m1);
+            reg e = pow(S::div(S::fmadd(c2, y, c1), S::fmadd(c3, y, set1(1.0))), m2);
+            return S::select(S::cmple(x, zero), black, e);
+        };
+        map_planar(r, g, b, count, [&](reg& x, reg& y, reg& z) {
+            Kernel::matrix(x, y, z, m);
+            x = pq(x);
+            y = pq(y);
+            z = pq(z);
+            Kernel::matrix(x, y, z, ictcp);
+        });
+    }
+
+    // atan2 in radians with the octant reduced to [0, 1] and the abramowitz and stegun
+    // 4.4.49 series, max error ~2e-8 plus float rounding
+    static inline reg atan2(reg y, reg x)
+    {
+        const reg zero = S::set1(0.0f);
+        reg ax = S::max(x, S::sub(zero, x)), ay = S::max(y, S::sub(zero, y));
+        reg a = S::div(S::min(ax, ay), S::max(S::max(ax, ay), set1(1e-30)));
+        reg a2 = S::mul(a, a);
+        reg p = S::fmadd(a2, set1(0.0028662257), set1(-0.0161657367));
+        p = S::fmadd(a2, p, set1(0.0429096138));
+        p = S::fmadd(a2, p, set1(-0.0752896400));
+        p = S::fmadd(a2, p, set1(0.1065626393));
+        p = S::fmadd(a2, p, set1(-0.1420889944));
+        p = S::fmadd(a2, p, set1(0.1999355085));
+        p = S::fmadd(a2, p, set1(-0.3333314528));
+        p = S::fmadd(a2, p, set1(1.0));
+        reg r = S::mul(a, p);
+        r = S::select(S::cmplt(ax, ay), S::sub(set1(kernel_pi * 0.5), r), r);
+        r = S::select(S::cmplt(x, zero), S::sub(set1(kernel_pi), r), r);
+        return S::select(S::cmplt(y, zero), S::sub(zero, r), r);
+    }
+
+    // delta e 2000 of cielab as delta_e2000 in analysis.cpp, branches are selects
+    static inline reg deltae2000(reg l1, reg a1, reg b1, reg l2, reg a2, reg b2)
+    {
+        const reg zero = S::set1(0.0f), one = S::set1(1.0f), half = S::set1(0.5f), tiny = set1(1e-30);
+        const reg c7 = set1(6103515625.0); // 25^7
+        auto pow7 = [](reg c) {
+            reg c2 = S::mul(c, c);
+            return S::mul(S::mul(S::mul(c2, c2), c2), c);
+        };
+        reg cab = S::mul(S::add(S::sqrt(S::fmadd(a1, a1, S::mul(b1, b1))), S::sqrt(S::fmadd(a2, a2, S::mul(b2, b2)))), half);
+        reg cab7 = pow7(cab);
+        reg g = S::mul(half, S::sub(one, S::sqrt(S::div(cab7, S::add(cab7, c7)))));
+        reg ap1 = S::mul(a1, S::add(one, g)), ap2 = S::mul(a2, S::add(one, g));
+        reg cp1 = S::sqrt(S::fmadd(ap1, ap1, S::mul(b1, b1))), cp2 = S::sqrt(S::fmadd(ap2, ap2, S::mul(b2, b2)));
+
+        // hue difference
+        reg dap = S::sub(ap2, ap1), db = S::sub(b2, b1), dcp = S::sub(cp2, cp1);
+        reg dh2 = S::sqrt(S::max(S::sub(S::fmadd(dap, dap, S::mul(db, db)), S::mul(dcp, dcp)), zero));
+        reg dhp = S::select(S::cmplt(S::mul(ap1, b2), S::mul(b1, ap2)), S::sub(zero, dh2), dh2);
+
+        // mean hue, bisector of the unit hue vectors, achromatic values have none
+        reg i1 = S::div(one, S::max(cp1, tiny)), i2 = S::div(one, S::max(cp2, tiny));
+        reg u1x = S::mul(ap1, i1), u1y = S::mul(b1, i1), u2x = S::mul(ap2, i2), u2y = S::mul(b2, i2);
+        reg hx = S::add(u1x, u2x), hy = S::add(u1y, u2y);
+        reg length = S::sqrt(S::fmadd(hx, hx, S::mul(hy, hy)));
+        reg inverse = S::div(one, S::max(length, tiny));
+        mask first = S::cmplt(zero, S::select(S::cmplt(b1, zero), set1(-1.0), S::select(S::cmplt(zero, b1), one, ap1)));
+        mask opposite = S::cmple(length, set1(1e-6));
+        hx = S::select(opposite, S::sub(zero, S::select(first, u1y, u2y)), S::mul(hx, inverse));
+        hy = S::select(opposite, S::select(first, u1x, u2x), S::mul(hy, inverse));
+        reg c2h = S::sub(S::mul(hx, hx), S::mul(hy, hy)), s2h = S::mul(set1(2.0), S::mul(hy, hx));
+        reg c3h = S::sub(S::mul(c2h, hx), S::mul(s2h, hy)), s3h = S::fmadd(s2h, hx, S::mul(c2h, hy));
+        reg c4h = S::sub(S::mul(c2h, c2h), S::mul(s2h, s2h)), s4h = S::mul(set1(2.0), S::mul(s2h, c2h));
+        reg t = S::fmadd(set1(-0.17), S::fmadd(hx, set1(0.86602540378443865), S::mul(hy, half)), one);
+        t = S::fmadd(set1(0.24), c2h, t);
+        t = S::fmadd(set1(0.32), S::sub(S::mul(c3h, set1(0.99452189536827329)), S::mul(s3h, set1(0.10452846326765347))), t);
+        t = S::fmadd(set1(-0.20), S::fmadd(c4h, set1(0.45399049973954675), S::mul(s4h, set1(0.89100652418836787))), t);
+
+        // rotation term, sin of 2 theta in [0, pi / 3] by taylor to degree 9
+        reg hp = S::mul(atan2(hy, hx), set1(180.0 / kernel_pi));
+        hp = S::select(S::cmplt(hp, zero), S::add(hp, set1(360.0)), hp);
+        reg d = S::mul(S::sub(hp, set1(275.0)), set1(1.0 / 25.0));
+        reg theta = S::mul(set1(60.0 * kernel_pi / 180.0), exp2(S::mul(S::mul(d, d), set1(-1.0 / kernel_ln2))));
+        reg theta2 = S::mul(theta, theta);
+        reg sine = S::fmadd(theta2, set1(1.0 / 362880.0), set1(-1.0 / 5040.0));
+        sine = S::fmadd(theta2, sine, set1(1.0 / 120.0));
+        sine = S::fmadd(theta2, sine, set1(-1.0 / 6.0));
+        sine = S::mul(theta, S::fmadd(theta2, sine, one));
+
+        reg lp = S::sub(S::mul(S::add(l1, l2), half), set1(50.0));
+        reg cp = S::mul(S::add(cp1, cp2), half);
+        reg cp7 = pow7(cp);
+        reg lp2 = S::mul(lp, lp);
+        reg sl = S::fmadd(set1(0.015), S::div(lp2, S::sqrt(S::add(set1(20.0), lp2))), one);
+        reg sc = S::fmadd(set1(0.045), cp, one);
+        reg sh = S::fmadd(S::mul(set1(0.015), cp), t, one);
+        reg rt = S::mul(S::mul(sine, set1(-2.0)), S::sqrt(S::div(cp7, S::add(cp7, c7))));
+        reg dl = S::div(S::sub(l2, l1), sl), dc = S::div(dcp, sc), dh = S::div(dhp, sh);
+        reg e = S::fmadd(dl, dl, S::fmadd(dc, dc, S::fmadd(dh, dh, S::mul(rt, S::mul(dc, dh)))));
+        return S::sqrt(S::max(e, zero));
+    }
+
+    static void deltae2000_planar_f32(const float* l1, const float* a1, const float* b1, const float* l2, const float* a2, const float* b2, float* deltae, size_t count)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            S::store(deltae + i, deltae2000(S::load(l1 + i), S::load(a1 + i), S::load(b1 + i), S::load(l2 + i), S::load(a2 + i), S::load(b2 + i)));
+        }
+        if (i < count) { // tail, padded to a full register
+            float t[6][S::width] = {}, e[S::width];
+            const float* planes[6] = { l1, a1, b1, l2, a2, b2 };
+            for (int p = 0; p < 6; ++p) {
+                kernel_copy(planes[p] + i, planes[p] + count, t[p]);
+            }
+            S::store(e, deltae2000(S::load(t[0]), S::load(t[1]), S::load(t[2]), S::load(t[3]), S::load(t[4]), S::load(t[5])));
+            kernel_copy(e, e + (count - i), deltae + i);
+        }
+    }
+
+    // adaptation, white per pixel. lms of whites at or below 0 are not adapted
+
+    static inline void adapt_tile(float* r, float* g, float* b, const float* wr, const float* wg, const float* wb, size_t count,
+                                  const reg* rgblms, const reg* lmsrgb, const reg* luminance, const reg* target, reg degree)
+    {
+        const reg zero = S::set1(0.0f), one = S::set1(1.0f), rest = S::sub(one, degree);
+        auto scale = [&](reg w, reg t, reg y) {
+            reg s = S::fmadd(S::div(S::mul(y, t), S::select(S::cmplt(zero, w), w, one)), degree, rest);
+            return S::select(S::cmplt(zero, w), s, one);
+        };
+        auto adapt = [&](reg& x, reg& y, reg& z, reg u, reg v, reg w) {
+            reg lum = S::fmadd(luminance[0], u, S::fmadd(luminance[1], v, S::mul(luminance[2], w)));
+            Kernel::matrix(u, v, w, rgblms);
+            Kernel::matrix(x, y, z, rgblms);
+            x = S::mul(x, scale(u, target[0], lum));
+            y = S::mul(y, scale(v, target[1], lum));
+            z = S::mul(z, scale(w, target[2], lum));
+            Kernel::matrix(x, y, z, lmsrgb);
+        };
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width) {
+            reg x = S::load(r + i), y = S::load(g + i), z = S::load(b + i);
+            adapt(x, y, z, S::load(wr + i), S::load(wg + i), S::load(wb + i));
+            S::store(r + i, x);
+            S::store(g + i, y);
+            S::store(b + i, z);
+        }
+        if (i < count) { // tail, padded to a full register
+            float t[6][S::width] = {};
+            const float* planes[6] = { r, g, b, wr, wg, wb };
+            size_t n = count - i;
+            for (int p = 0; p < 6; ++p) {
+                kernel_copy(planes[p] + i, planes[p] + count, t[p]);
+            }
+            reg x = S::load(t[0]), y = S::load(t[1]), z = S::load(t[2]);
+            adapt(x, y, z, S::load(t[3]), S::load(t[4]), S::load(t[5]));
+            S::store(t[0], x);
+            S::store(t[1], y);
+            S::store(t[2], z);
+            kernel_copy(t[0], t[0] + n, r + i);
+            kernel_copy(t[1], t[1] + n, g + i);
+            kernel_copy(t[2], t[2] + n, b + i);
+        }
+    }
+
+    static void adapt_planar_f32(float* r, float* g, float* b, const float* wr, const float* wg, const float* wb, size_t count, const PixelAdaptation& adaptation)
+    {
+        reg rgblms[9], lmsrgb[9], luminance[3], target[3];
+        for (int i = 0; i < 9; ++i) {
+            rgblms[i] = S::set1(adaptation.rgblms[i]);
+            lmsrgb[i] = S::set1(adaptation.lmsrgb[i]);
+        }
+        for (int i = 0; i < 3; ++i) {
+            luminance[i] = S::set1(adaptation.luminance[i]);
+            target[i] = S::set1(adaptation.target[i]);
+        }
+        const reg degree = S::set1(adaptation.degree);
+        for (size_t i = 0; i < count; i += kernel_tile) {
+            size_t n = kernel_min(kernel_tile, count - i);
+            if (adaptation.decode.type != TransferType::Linear) {
+                decode_f32(r + i, n, adaptation.decode);
+                decode_f32(g + i, n, adaptation.decode);
+                decode_f32(b + i, n, adaptation.decode);
+            }
+            adapt_tile(r + i, g + i, b + i, wr + i, wg + i, wb + i, n, rgblms, lmsrgb, luminance, target, degree);
+            if (adaptation.encode.type != TransferType::Linear) {
+                encode_f32(r + i, n, adaptation.encode);
+                encode_f32(g + i, n, adaptation.encode);
+                encode_f32(b + i, n, adaptation.encode);
+            }
+        }
+    }
+
+    // matrix only
+
+    static PixelTransform matrix_transform(const float* matrix)
+    {
+        PixelTransform transform;
+        kernel_copy(matrix, matrix + 9, transform.matrix);
+        return transform;
+    }
+
+    static void matrix_interleaved_f32(float* pixels, size_t count, int nchannels, const float* matrix)
+    {
+        transform_interleaved_f32(pixels, count, nchannels, matrix_transform(matrix));
+    }
+
+    static void matrix_interleaved_f16(half* pixels, size_t count, int nchannels, const float* matrix)
+    {
+        transform_interleaved_f16(pixels, count, nchannels, matrix_transform(matrix));
+    }
+
+    static void matrix_planar_f32(float* r, float* g, float* b, size_t count, const float* matrix)
+    {
+        matrix_f32(r, g, b, count, matrix);
+    }
+
+    static void matrix_planar_f16(half* r, half* g, half* b, size_t count, const float* matrix)
+    {
+        transform_planar_f16(r, g, b, count, matrix_transform(matrix));
+    }
+
+    static PixelKernel kernel(PixelIsa isa, const char* name)
+    {
+        PixelKernel kernel;
+        kernel.isa = isa;
+        kernel.name = name;
+        kernel.matrix_interleaved_f32 = &Kernel::matrix_interleaved_f32;
+        kernel.matrix_interleaved_f16 = &Kernel::matrix_interleaved_f16;
+        kernel.matrix_planar_f32 = &Kernel::matrix_planar_f32;
+        kernel.matrix_planar_f16 = &Kernel::matrix_planar_f16;
+        kernel.transform_interleaved_f32 = &Kernel::transform_interleaved_f32;
+        kernel.transform_interleaved_f16 = &Kernel::transform_interleaved_f16;
+        kernel.transform_planar_f32 = &Kernel::transform_planar_f32;
+        kernel.transform_planar_f16 = &Kernel::transform_planar_f16;
+        kernel.decode_f32 = &Kernel::decode_f32;
+        kernel.encode_f32 = &Kernel::encode_f32;
+        kernel.lut_interleaved_f32 = &Kernel::lut_interleaved_f32;
+        kernel.lut_interleaved_f16 = &Kernel::lut_interleaved_f16;
+        kernel.lab_planar_f32 = &Kernel::lab_planar_f32;
+        kernel.ictcp_planar_f32 = &Kernel::ictcp_planar_f32;
+        kernel.deltae2000_planar_f32 = &Kernel::deltae2000_planar_f32;
+        kernel.adapt_planar_f32 = &Kernel::adapt_planar_f32;
+        return kernel;
+    }
+};
+
+}
+}
@@ -0,0 +1,99 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#include "pixelkernel_impl.h"
+
+#include <arm_neon.h>
+#include <cstring>
+
+namespace colortool {
+namespace {
+
+// neon, 4 floats with fma and half conversion, always available on arm64
+struct Neon
+{
+    typedef float32x4_t reg;
+    typedef uint32x4_t mask;
+    static const int width = 4;
+    static inline reg load(const float* p) { return vld1q_f32(p); }
+    static inline void store(float* p, reg v) { vst1q_f32(p, v); }
+    static inline reg set1(float v) { return vdupq_n_f32(v); }
+    static inline reg add(reg a, reg b) { return vaddq_f32(a, b); }
+    static inline reg sub(reg a, reg b) { return vsubq_f32(a, b); }
+    static inline reg mul(reg a, reg b) { return vmulq_f32(a, b); }
+    static inline reg div(reg a, reg b) { return vdivq_f32(a, b); }
+    static inline reg sqrt(reg x) { return vsqrtq_f32(x); }
+    static inline reg min(reg a, reg b) { return vminq_f32(a, b); }
+    static inline reg max(reg a, reg b) { return vmaxq_f32(a, b); }
+    static inline reg fmadd(reg a, reg b, reg c) { return vfmaq_f32(c, a, b); }
+    static inline mask cmplt(reg a, reg b) { return vcltq_f32(a, b); }
+    static inline mask cmple(reg a, reg b) { return vcleq_f32(a, b); }
+    static inline reg select(mask m, reg a, reg b) { return vbslq_f32(m, a, b); }
+    static inline reg round(reg x) { return vrndnq_f32(x); }
+
+    static inline reg gather(const float* p, reg index) // emulated, neon has no gather
+    {
+        uint32x4_t i = vcvtq_u32_f32(index);
+        float v[4] = { p[vgetq_lane_u32(i, 0)], p[vgetq_lane_u32(i, 1)], p[vgetq_lane_u32(i, 2)], p[vgetq_lane_u32(i, 3)] };
+        return vld1q_f32(v);
+    }
+
+    static inline reg frexp(reg x, reg& e)
+    {
+        uint32x4_t i = vreinterpretq_u32_f32(x);
+        e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(i, 23), vdupq_n_u32(0xff))), vdupq_n_s32(127)));
+        return vreinterpretq_f32_u32(vorrq_u32(vandq_u32(i, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000)));
+    }
+
+    static inline reg ldexp(reg x, reg n)
+    {
+        return vmulq_f32(x, vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23)));
+    }
+
+    static inline void half_to_float(const half* src, float* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(src + i)))));
+        }
+        if (i < count) {
+            uint16_t h[width] = {};
+            float f[width];
+            std::memcpy(h, src + i, (count - i) * sizeof(half));
+            vst1q_f32(f, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(h))));
+            std::memcpy(dst + i, f, (count - i) * sizeof(float));
+        }
+    }
+
+    static inline void float_to_half(const float* src, half* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            vst1_u16(reinterpret_cast<uint16_t*>(dst + i), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+        }
+        if (i < count) {
+            float f[width] = {};
+            uint16_t h[width];
+            std::memcpy(f, src + i, (count - i) * sizeof(float));
+            vst1_u16(h, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(f))));
+            std::memcpy(dst + i, h, (count - i) * sizeof(half));
+        }
+    }
+};
+
+}
+
+const PixelKernel*
+pixel_kernel_neon()
+{
+    static const PixelKernel kernel = Kernel<Neon>::kernel(PixelIsa::Neon, "neon");
+    return &kernel;
+}
+
+}
+
+#endif
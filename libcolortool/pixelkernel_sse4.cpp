@@ -0,0 +1,69 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "pixelkernel_impl.h"
+
+#include <smmintrin.h>
+
+namespace colortool {
+namespace {
+
+// sse4, 4 floats, no fma and half conversion in the baseline isa
+struct SSE4
+{
+    typedef __m128 reg;
+    typedef __m128 mask;
+    static const int width = 4;
+    static inline reg load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void store(float* p, reg v) { _mm_storeu_ps(p, v); }
+    static inline reg set1(float v) { return _mm_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+    static inline reg sqrt(reg x) { return _mm_sqrt_ps(x); }
+    static inline reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static inline reg fmadd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static inline mask cmplt(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+    static inline mask cmple(reg a, reg b) { return _mm_cmple_ps(a, b); }
+    static inline reg select(mask m, reg a, reg b) { return _mm_blendv_ps(b, a, m); }
+    static inline reg round(reg x) { return _mm_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+    static inline reg gather(const float* p, reg index) // emulated, no gather before avx2
+    {
+        __m128i i = _mm_cvttps_epi32(index);
+        return _mm_setr_ps(p[_mm_extract_epi32(i, 0)], p[_mm_extract_epi32(i, 1)], p[_mm_extract_epi32(i, 2)], p[_mm_extract_epi32(i, 3)]);
+    }
+
+    static inline reg frexp(reg x, reg& e)
+    {
+        __m128i i = _mm_castps_si128(x);
+        e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(i, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127)));
+        return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(i, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+    }
+
+    static inline reg ldexp(reg x, reg n)
+    {
+        return _mm_mul_ps(x, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23)));
+    }
+    static inline void half_to_float(const half* src, float* dst, size_t count) { detail::half_to_float(src, dst, count); }
+    static inline void float_to_half(const float* src, half* dst, size_t count) { detail::float_to_half(src, dst, count); }
+};
+
+}
+
+const PixelKernel*
+pixel_kernel_sse4()
+{
+    static const PixelKernel kernel = Kernel<SSE4>::kernel(PixelIsa::SSE4, "sse4");
+    return &kernel;
+}
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "precision.h"
+
+#include <algorithm>
+#include <cmath>
+
+// imath
+#include <Imath/half.h>
+
+namespace colortool {
+
+namespace {
+
+template <typename T>
+using Matrix3 = Eigen::Matrix<T, 3, 3>;
+
+template <typename T>
+using Vector3 = Eigen::Matrix<T, 3, 1>;
+
+typedef Eigen::Matrix<long double, 3, 3, Eigen::RowMajor> RowMatrix3l;
+
+const int gamutsteps = 8;
+
+// color math of colormath.cpp in T, cone matrices are the double constants
+template <typename T>
+Vector3<T> xy_to_xyz(const Eigen::Vector2d& xy)
+{
+    const T x = T(xy.x()), y = T(xy.y());
+    return Vector3<T>(x / y, T(1), (T(1) - x - y) / y);
+}
+
+// inverse with one newton step x + x (i - m x), which recovers most of the rounding
+// of the cofactor inverse when computed in long double
+template <typename T>
+Matrix3<T> inverse(const Matrix3<T>& m, bool refine)
+{
+    Matrix3<T> x = m.inverse();
+    if (refine) {
+        x += x * (Matrix3<T>::Identity() - m * x);
+    }
+    return x;
+}
+
+template <typename T>
+Matrix3<T> rgb_to_xyz(const Colorspace& colorspace, bool refine)
+{
+    Matrix3<T> m;
+    m.col(0) = xy_to_xyz<T>(colorspace.r);
+    m.col(1) = xy_to_xyz<T>(colorspace.g);
+    m.col(2) = xy_to_xyz<T>(colorspace.b);
+    Vector3<T> s = inverse(m, refine) * xy_to_xyz<T>(colorspace.whitepoint);
+    return m * s.asDiagonal();
+}
+
+// rgb of input to rgb of output, partial adaptation scales by degree * target / source
+// + 1 - degree and backward by the reciprocal of the forward scale
+template <typename T>
+Matrix3<T> transform(const Colorspace& input, const Colorspace& output, const AdaptationTransform& adaptation, double degree, bool backward, bool refine)
+{
+    Matrix3<T> cone = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(adaptation.cone).cast<T>();
+    const Colorspace& source = backward ? output : input;
+    const Colorspace& target = backward ? input : output;
+    Vector3<T> sourcelms = cone * xy_to_xyz<T>(source.whitepoint);
+    Vector3<T> targetlms = cone * xy_to_xyz<T>(target.whitepoint);
+    Vector3<T> scale = targetlms.cwiseQuotient(sourcelms);
+    if (degree < 1.0) {
+        const T d = T(degree);
+        Vector3<T> forward = backward ? sourcelms.cwiseQuotient(targetlms) : scale;
+        forward = (d * forward).array() + (T(1) - d);
+        scale = backward ? forward.cwiseInverse() : forward;
+    }
+    Matrix3<T> catmatrix = inverse(cone, refine) * scale.asDiagonal() * cone;
+    return inverse(rgb_to_xyz<T>(target, refine), refine) * catmatrix * rgb_to_xyz<T>(source, refine);
+}
+
+template <typename T>
+void store(const Matrix3<T>& m, long double* matrix)
+{
+    Eigen::Map<RowMatrix3l> rowmatrix(matrix);
+    rowmatrix = m.template cast<long double>();
+}
+
+long double round_value(long double value, Precision precision)
+{
+    switch (precision) {
+        case Precision::Half: return static_cast<float>(half(static_cast<float>(value)));
+        case Precision::Float: return static_cast<float>(value);
+        case Precision::Double: return static_cast<double>(value);
+        default: return value;
+    }
+}
+
+}
+
+bool
+parse_precision(const std::string& name, Precision& precision)
+{
+    if (name == "half") {
+        precision = Precision::Half;
+    } else if (name == "float") {
+        precision = Precision::Float;
+    } else if (name == "double") {
+        precision = Precision::Double;
+    } else if (name == "extended") {
+        precision = Precision::Extended;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+precision_name(Precision precision)
+{
+    switch (precision) {
+        case Precision::Half: return "half";
+        case Precision::Float: return "float";
+        case Precision::Double: return "double";
+        default: return "extended";
+    }
+}
+
+int
+precision_digits(Precision precision)
+{
+    switch (precision) {
+        case Precision::Half: return 5;
+        case Precision::Float: return 9;
+        case Precision::Double: return 17;
+        default: return 21;
+    }
+}
+
+PrecisionTransform
+precision_transform(const Colorspace& input, const Colorspace& output, const AdaptationTransform& adaptation, double degree, Precision precision)
+{
+    PrecisionTransform result;
+    result.precision = precision;
+    if (precision == Precision::Half || precision == Precision::Float) {
+        long double matrix[9], inverse[9];
+        store(transform<float>(input, output, adaptation, degree, false, false), matrix);
+        store(transform<float>(input, output, adaptation, degree, true, false), inverse);
+        round_matrix(matrix, precision, result.matrix);
+        round_matrix(inverse, precision, result.inverse);
+    } else if (precision == Precision::Double) {
+        store(transform<double>(input, output, adaptation, degree, false, false), result.matrix);
+        store(transform<double>(input, output, adaptation, degree, true, false), result.inverse);
+    } else {
+        store(transform<long double>(input, output, adaptation, degree, false, true), result.matrix);
+        store(transform<long double>(input, output, adaptation, degree, true, true), result.inverse);
+    }
+
+    // errors in long double against the extended transform
+    Eigen::Map<const RowMatrix3l> matrix(result.matrix);
+    Eigen::Map<const RowMatrix3l> inverse(result.inverse);
+    const Matrix3<long double> reference = transform<long double>(input, output, adaptation, degree, false, true);
+    result.roundtrip = double((matrix * inverse - Matrix3<long double>::Identity()).cwiseAbs().maxCoeff());
+    for (int i = 0; i < 3; ++i) {
+        result.neutral = std::max(result.neutral, double(std::abs(matrix.row(i).sum() - reference.row(i).sum())));
+    }
+    for (int b = 0; b <= gamutsteps; ++b) {
+        for (int g = 0; g <= gamutsteps; ++g) {
+            for (int r = 0; r <= gamutsteps; ++r) {
+                const Vector3<long double> rgb(r, g, b);
+                const Vector3<long double> error = (matrix * rgb - reference * rgb) / gamutsteps;
+                for (int i = 0; i < 3; ++i) {
+                    result.deviation[i] = std::max(result.deviation[i], double(std::abs(error(i))));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void
+round_matrix(const long double* matrix, Precision precision, long double* rounded)
+{
+    for (int row = 0; row < 3; ++row) {
+        const long double* m = matrix + row * 3;
+        long double* r = rounded + row * 3;
+        for (int i = 0; i < 3; ++i) {
+            r[i] = round_value(m[i], precision);
+        }
+        // residual of the row sum goes to the coefficient that absorbs it best, small
+        // coefficients have finer spacing and often land closer than the largest
+        const long double sum = m[0] + m[1] + m[2];
+        const long double current = r[0] + r[1] + r[2];
+        long double best = std::abs(sum - current);
+        int index = -1;
+        long double value = 0.0L;
+        for (int i = 0; i < 3; ++i) {
+            const long double adjusted = round_value(r[i] + sum - current, precision);
+            const long double error = std::abs(sum - (current - r[i] + adjusted));
+            if (error < best) {
+                best = error;
+                index = i;
+                value = adjusted;
+            }
+        }
+        if (index >= 0) {
+            r[index] = value;
+        }
+    }
+}
+
+}
@@ -0,0 +1,58 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+
+#include "adaptation.h"
+#include "colormath.h"
+
+namespace colortool {
+
+// precision
+// transforms computed in a chosen scalar type. half and float are for lut boxes and
+// shaders, double is the default and extended computes in long double with refined
+// inverses as a reference. errors are measured against the extended transform.
+
+// precision of transform matrices
+enum class Precision {
+    Half,
+    Float,
+    Double,
+    Extended
+};
+
+// parse precision name, half, float, double or extended, false if unknown
+bool parse_precision(const std::string& name, Precision& precision);
+
+// precision name
+const char* precision_name(Precision precision);
+
+// decimal digits needed to print values of precision without loss
+int precision_digits(Precision precision);
+
+// transform in precision with errors, matrices are 3x3 row major and hold values
+// representable in the precision
+struct PrecisionTransform
+{
+    Precision precision = Precision::Double;
+    long double matrix[9]; // rgb of input to rgb of output
+    long double inverse[9]; // rgb of output to rgb of input
+    double roundtrip = 0.0; // max abs deviation of matrix * inverse from identity
+    double deviation[3] = { 0.0, 0.0, 0.0 }; // max abs deviation per output channel over the input rgb cube
+    double neutral = 0.0; // max abs deviation of row sums, the neutral axis
+};
+
+// transform between colorspaces computed in precision, half is computed in float and
+// rounded. errors are against the extended transform evaluated in long double. the
+// inverse of a partial adaptation uses the reciprocal scale so it is the exact inverse.
+PrecisionTransform precision_transform(const Colorspace& input, const Colorspace& output, const AdaptationTransform& transform, double degree, Precision precision);
+
+// round matrix to precision, row sums are kept as close as the precision allows so
+// neutrals stay neutral when rounded coefficients are used in pixel kernels
+void round_matrix(const long double* matrix, Precision precision, long double* rounded);
+
+}
@@ -0,0 +1,316 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "registry.h"
+#include "jsonreader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace colortool {
+
+namespace {
+
+bool
+parse_number(const std::string& text, double& value)
+{
+    char* last = nullptr;
+    value = std::strtod(text.c_str(), &last);
+    return text.size() && last == text.c_str() + text.size();
+}
+
+// fields
+bool
+set_field(RegistryColorspace& cs, const std::string& path, const std::string& text)
+{
+    static const struct {
+        const char* path;
+        double (RegistryColorspace::*values)[2];
+        int index;
+    } fields[] = {
+        { "primaries.R.x", &RegistryColorspace::r, 0 },
+        { "primaries.R.y", &RegistryColorspace::r, 1 },
+        { "primaries.G.x", &RegistryColorspace::g, 0 },
+        { "primaries.G.y", &RegistryColorspace::g, 1 },
+        { "primaries.B.x", &RegistryColorspace::b, 0 },
+        { "primaries.B.y", &RegistryColorspace::b, 1 },
+        { "whitepoint.x", &RegistryColorspace::whitepoint, 0 },
+        { "whitepoint.y", &RegistryColorspace::whitepoint, 1 }
+    };
+    if (path == "description") {
+        cs.description = text;
+        return true;
+    }
+    if (path == "trc") {
+        cs.trc = text;
+        return true;
+    }
+    for (const auto& field : fields) {
+        if (path == field.path) {
+            return parse_number(text, (cs.*field.values)[field.index]);
+        }
+    }
+    return true;
+}
+
+bool
+set_field(RegistryIlluminant& im, const std::string& path, const std::string& text)
+{
+    if (path == "description") {
+        im.description = text;
+        return true;
+    }
+    if (path == "whitepoint.x") {
+        return parse_number(text, im.whitepoint[0]);
+    }
+    if (path == "whitepoint.y") {
+        return parse_number(text, im.whitepoint[1]);
+    }
+    return true;
+}
+
+template <typename T>
+bool
+read_fields(JsonReader& reader, std::string& path, T& entry, bool& hasdescription)
+{
+    return reader.read_object([&](const std::string& key) {
+        size_t length = path.size();
+        if (length) {
+            path += '.';
+        }
+        path += key;
+        bool valid;
+        if (reader.peek('{')) {
+            valid = read_fields(reader, path, entry, hasdescription);
+        } else if (reader.peek('[')) {
+            valid = reader.skip_value();
+        } else {
+            std::string text;
+            valid = reader.read_scalar(text);
+            if (valid && !set_field(entry, path, text)) {
+                valid = reader.fail("invalid value for " + path + " in " + entry.name);
+            }
+            hasdescription |= path == "description";
+        }
+        path.resize(length);
+        return valid;
+    });
+}
+
+template <typename T>
+bool
+parse_entries(const char* data, size_t size, const char* kind, std::vector<T>& entries, std::string& error)
+{
+    entries.clear();
+    JsonReader reader(data, size);
+    std::string path;
+    bool valid = reader.read_object([&](const std::string& name) {
+        if (!reader.peek('{')) {
+            return reader.fail(std::string("expected object for ") + kind + ": " + name);
+        }
+        T entry;
+        entry.name = name;
+        bool hasdescription = false;
+        if (!read_fields(reader, path, entry, hasdescription)) {
+            return false;
+        }
+        if (!hasdescription) {
+            return reader.fail(std::string("missing description in ") + kind + ": " + name);
+        }
+        entries.push_back(std::move(entry));
+        return true;
+    });
+    if (valid && !reader.at_end()) {
+        valid = reader.fail("unexpected data after object");
+    }
+    if (!valid) {
+        error = reader.error;
+        entries.clear();
+        return false;
+    }
+    // sorted by name, later duplicates replace earlier
+    std::stable_sort(entries.begin(), entries.end(), [](const T& a, const T& b) { return a.name < b.name; });
+    size_t count = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i + 1 < entries.size() && entries[i + 1].name == entries[i].name) {
+            continue;
+        }
+        if (count != i) {
+            entries[count] = std::move(entries[i]);
+        }
+        ++count;
+    }
+    entries.resize(count);
+    return true;
+}
+
+template <typename T>
+const T*
+find_entry(const std::vector<T>& entries, const std::string& name)
+{
+    auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const T& entry, const std::string& name) {
+        return entry.name < name;
+    });
+    return it != entries.end() && it->name == name ? &*it : nullptr;
+}
+
+bool
+read_file(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    data = stream.str();
+    return true;
+}
+
+}
+
+Registry::Registry(const std::string& colorspacesfile, const std::string& illuminantsfile)
+: colorspacespath(colorspacesfile)
+, illuminantspath(illuminantsfile)
+{
+}
+
+bool
+Registry::load_colorspaces()
+{
+    if (!colorspacesloaded) {
+        std::string data, err;
+        if (!read_file(colorspacespath, data)) {
+            error = "could not open colorspaces file: " + colorspacespath;
+            return false;
+        }
+        if (!parse_colorspaces(data.data(), data.size(), colorspacelist, err)) {
+            error = "could not parse colorspaces file: " + colorspacespath + ", " + err;
+            return false;
+        }
+        colorspacesloaded = true;
+    }
+    return true;
+}
+
+bool
+Registry::load_illuminants()
+{
+    if (!illuminantsloaded) {
+        std::string data, err;
+        if (!read_file(illuminantspath, data)) {
+            error = "could not open illuminants file: " + illuminantspath;
+            return false;
+        }
+        if (!parse_illuminants(data.data(), data.size(), illuminantlist, err)) {
+            error = "could not parse illuminants file: " + illuminantspath + ", " + err;
+            return false;
+        }
+        illuminantsloaded = true;
+    }
+    return true;
+}
+
+bool
+Registry::reload()
+{
+    std::string data, err;
+    std::vector<RegistryColorspace> colorspaces;
+    std::vector<RegistryIlluminant> illuminants;
+    const bool colorspacesread = colorspacesloaded && colorspacespath.size();
+    if (colorspacesread) {
+        if (!read_file(colorspacespath, data)) {
+            error = "could not open colorspaces file: " + colorspacespath;
+            return false;
+        }
+        if (!parse_colorspaces(data.data(), data.size(), colorspaces, err)) {
+            error = "could not parse colorspaces file: " + colorspacespath + ", " + err;
+            return false;
+        }
+    }
+    if (illuminantsloaded) {
+        if (!read_file(illuminantspath, data)) {
+            error = "could not open illuminants file: " + illuminantspath;
+            return false;
+        }
+        if (!parse_illuminants(data.data(), data.size(), illuminants, err)) {
+            error = "could not parse illuminants file: " + illuminantspath + ", " + err;
+            return false;
+        }
+        illuminantlist = std::move(illuminants);
+    }
+    if (colorspacesread) {
+        colorspacelist = std::move(colorspaces);
+    }
+    return true;
+}
+
+void
+Registry::set_colorspaces(std::vector<RegistryColorspace> colorspaces)
+{
+    std::stable_sort(colorspaces.begin(), colorspaces.end(), [](const RegistryColorspace& a, const RegistryColorspace& b) {
+        return a.name < b.name;
+    });
+    colorspacelist = std::move(colorspaces);
+    colorspacesloaded = true;
+}
+
+const std::vector<RegistryColorspace>&
+Registry::colorspaces() const
+{
+    return colorspacelist;
+}
+
+const std::vector<RegistryIlluminant>&
+Registry::illuminants() const
+{
+    return illuminantlist;
+}
+
+const RegistryColorspace*
+Registry::find_colorspace(const std::string& name)
+{
+    return load_colorspaces() ? find_entry(colorspacelist, name) : nullptr;
+}
+
+const RegistryIlluminant*
+Registry::find_illuminant(const std::string& name)
+{
+    return load_illuminants() ? find_entry(illuminantlist, name) : nullptr;
+}
+
+const std::string&
+Registry::colorspacesfile() const
+{
+    return colorspacespath;
+}
+
+const std::string&
+Registry::illuminantsfile() const
+{
+    return illuminantspath;
+}
+
+const std::string&
+Registry::geterror() const
+{
+    return error;
+}
+
+bool
+Registry::parse_colorspaces(const char* data, size_t size, std::vector<RegistryColorspace>& colorspaces, std::string& error)
+{
+    return parse_entries(data, size, "colorspace", colorspaces, error);
+}
+
+bool
+Registry::parse_illuminants(const char* data, size_t size, std::vector<RegistryIlluminant>& illuminants, std::string& error)
+{
+    return parse_entries(data, size, "illuminant", illuminants, error);
+}
+
+}
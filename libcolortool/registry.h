@@ -0,0 +1,79 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace colortool {
+
+// colorspace entry
+struct RegistryColorspace
+{
+    std::string name;
+    std::string description;
+    std::string trc = "Linear";
+    double r[2] = { 0.0, 0.0 };
+    double g[2] = { 0.0, 0.0 };
+    double b[2] = { 0.0, 0.0 };
+    double whitepoint[2] = { 0.0, 0.0 };
+};
+
+// illuminant entry
+struct RegistryIlluminant
+{
+    std::string name;
+    std::string description;
+    double whitepoint[2] = { 0.0, 0.0 };
+};
+
+// registry
+// colorspaces and illuminants read from json files, each file is read on first use
+// with a single pass tokenizer and kept as a flat array sorted by name.
+class Registry
+{
+public:
+    Registry(const std::string& colorspacesfile, const std::string& illuminantsfile);
+
+    // load file if not already loaded, false and error set if it could not be read
+    bool load_colorspaces();
+    bool load_illuminants();
+
+    // read loaded files again, e.g when watched files change. entries are kept and false
+    // with error set if a file could not be read or parsed, builtin colorspaces are kept
+    bool reload();
+
+    // use colorspaces instead of reading the file, e.g builtin colorspaces
+    void set_colorspaces(std::vector<RegistryColorspace> colorspaces);
+
+    // sorted by name, empty if not loaded
+    const std::vector<RegistryColorspace>& colorspaces() const;
+    const std::vector<RegistryIlluminant>& illuminants() const;
+
+    // binary search, loads file on first use, nullptr if not found
+    const RegistryColorspace* find_colorspace(const std::string& name);
+    const RegistryIlluminant* find_illuminant(const std::string& name);
+
+    const std::string& colorspacesfile() const;
+    const std::string& illuminantsfile() const;
+    const std::string& geterror() const;
+
+    // parse json data, entries are sorted by name and later duplicates replace earlier
+    static bool parse_colorspaces(const char* data, size_t size, std::vector<RegistryColorspace>& colorspaces, std::string& error);
+    static bool parse_illuminants(const char* data, size_t size, std::vector<RegistryIlluminant>& illuminants, std::string& error);
+
+private:
+    std::string colorspacespath;
+    std::string illuminantspath;
+    std::vector<RegistryColorspace> colorspacelist;
+    std::vector<RegistryIlluminant> illuminantlist;
+    bool colorspacesloaded = false;
+    bool illuminantsloaded = false;
+    std::string error;
+};
+
+}
@@ -0,0 +1,456 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "server.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+namespace colortool {
+
+#if !defined(_WIN32)
+
+namespace {
+
+const size_t server_maxrequest = 8192; // bytes of a request line
+
+bool
+socket_address(const std::string& path, sockaddr_un& address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool
+send_all(int fd, const char* data, size_t size)
+{
+    while (size) {
+#if defined(MSG_NOSIGNAL)
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+#else
+        ssize_t sent = ::send(fd, data, size, 0);
+#endif
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// read a line into buffer, false on end of stream or error
+bool
+read_line(int fd, std::string& buffer, std::string& line)
+{
+    size_t offset = 0;
+    while (true) {
+        size_t newline = buffer.find('\n', offset);
+        if (newline != std::string::npos) {
+            line.assign(buffer, 0, newline);
+            if (line.size() && line.back() == '\r') {
+                line.pop_back();
+            }
+            buffer.erase(0, newline + 1);
+            return true;
+        }
+        offset = buffer.size();
+        char data[4096];
+        ssize_t received = ::recv(fd, data, sizeof(data), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(data, received);
+    }
+}
+
+}
+
+Server::Server()
+: stopped(false)
+{
+}
+
+Server::~Server()
+{
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+    for (int pipefd : wakeup) {
+        if (pipefd >= 0) {
+            ::close(pipefd);
+        }
+    }
+}
+
+bool
+Server::listen(const std::string& socketpath)
+{
+    sockaddr_un address;
+    if (!socket_address(socketpath, address)) {
+        error = "invalid socket path: " + socketpath;
+        return false;
+    }
+    // a socket file nobody answers on is left from a server that did not exit
+    {
+        Client client;
+        if (client.connect(socketpath)) {
+            error = "server already running on socket: " + socketpath;
+            return false;
+        }
+        ::unlink(socketpath.c_str());
+    }
+    if (::pipe(wakeup) < 0) {
+        error = std::string("could not create pipe: ") + std::strerror(errno);
+        return false;
+    }
+    for (int pipefd : wakeup) { // a full pipe must not block writers or the drain
+        ::fcntl(pipefd, F_SETFL, ::fcntl(pipefd, F_GETFL) | O_NONBLOCK);
+        ::fcntl(pipefd, F_SETFD, FD_CLOEXEC);
+    }
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("could not create socket: ") + std::strerror(errno);
+        return false;
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        error = "could not listen on socket: " + socketpath + ", " + std::strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    path = socketpath;
+    return true;
+}
+
+bool
+Server::serve(const Handler& handler, int threads)
+{
+    if (fd < 0) {
+        error = "server is not listening";
+        return false;
+    }
+    struct Connection
+    {
+        int fd;
+        std::string buffer;
+        size_t number = 0;
+    };
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<Connection*> idle;
+    std::deque<Connection*> ready;
+    bool done = false;
+
+    auto close_connection = [](Connection* connection) {
+        ::close(connection->fd);
+        delete connection;
+    };
+    auto wake = [&]() {
+        char c = 0;
+        ssize_t written = ::write(wakeup[1], &c, 1); // a full pipe already wakes the poll
+        (void)written;
+    };
+
+    // workers answer all complete requests of a connection and return it to poll
+    auto worker = [&]() {
+        std::string request, response;
+        while (true) {
+            Connection* connection;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return done || ready.size(); });
+                if (ready.empty()) {
+                    return;
+                }
+                connection = ready.front();
+                ready.pop_front();
+            }
+            char data[4096];
+            ssize_t received;
+            do {
+                received = ::recv(connection->fd, data, sizeof(data), 0);
+            } while (received < 0 && errno == EINTR);
+            bool valid = received > 0;
+            if (valid) {
+                connection->buffer.append(data, received);
+                response.clear();
+                size_t newline;
+                while ((newline = connection->buffer.find('\n')) != std::string::npos) {
+                    request.assign(connection->buffer, 0, newline);
+                    if (request.size() && request.back() == '\r') {
+                        request.pop_back();
+                    }
+                    connection->buffer.erase(0, newline + 1);
+                    response += handler(request, ++connection->number);
+                }
+                // a line without newline beyond the limit is answered and closed
+                bool overflow = connection->buffer.size() > server_maxrequest;
+                if (overflow) {
+                    response += "{\"error\": \"request longer than " + std::to_string(server_maxrequest) + " bytes\"}\n";
+                }
+                valid = send_all(connection->fd, response.data(), response.size()) && !overflow;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (valid && !done) {
+                    idle.push_back(connection);
+                    connection = nullptr;
+                }
+            }
+            if (connection) {
+                close_connection(connection);
+            } else {
+                wake();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        pool.emplace_back(worker);
+    }
+
+    bool valid = true;
+    std::vector<pollfd> fds;
+    std::vector<Connection*> polled;
+    while (!stopped) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            polled = idle;
+        }
+        fds.assign(2, pollfd());
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeup[0];
+        fds[1].events = POLLIN;
+        for (Connection* connection : polled) {
+            pollfd pfd;
+            pfd.fd = connection->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = std::string("could not poll connections: ") + std::strerror(errno);
+            valid = false;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            char data[256];
+            ssize_t drained;
+            do { // until empty, EAGAIN on the non blocking read end
+                drained = ::read(wakeup[0], data, sizeof(data));
+            } while (drained > 0 || (drained < 0 && errno == EINTR));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (fds[i].revents) {
+                idle.erase(std::find(idle.begin(), idle.end(), polled[i - 2]));
+                ready.push_back(polled[i - 2]);
+                condition.notify_one();
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int connection = ::accept(fd, nullptr, nullptr);
+            if (connection >= 0) {
+#if defined(SO_NOSIGPIPE)
+                int nosigpipe = 1;
+                ::setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+                Connection* client = new Connection();
+                client->fd = connection;
+                idle.push_back(client);
+            } else if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                error = std::string("could not accept connection: ") + std::strerror(errno);
+                valid = false;
+                break;
+            }
+        }
+    }
+
+    // workers finish the requests they have, queued and idle connections are closed
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        condition.notify_all();
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    for (Connection* connection : idle) {
+        close_connection(connection);
+    }
+    for (Connection* connection : ready) {
+        close_connection(connection);
+    }
+    return valid;
+}
+
+void
+Server::stop()
+{
+    stopped = true;
+    if (wakeup[1] >= 0) {
+        char c = 0;
+        ssize_t written = ::write(wakeup[1], &c, 1);
+        (void)written;
+    }
+}
+
+Client::Client()
+{
+}
+
+Client::~Client()
+{
+    close();
+}
+
+bool
+Client::connect(const std::string& path)
+{
+    close();
+    sockaddr_un address;
+    if (!socket_address(path, address)) {
+        error = "invalid socket path: " + path;
+        return false;
+    }
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        error = "could not connect to socket: " + path + ", " + std::strerror(errno);
+        close();
+        return false;
+    }
+#if defined(SO_NOSIGPIPE)
+    int nosigpipe = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+    return true;
+}
+
+void
+Client::close()
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    buffer.clear();
+}
+
+bool
+Client::request(const std::string& request, std::string& response)
+{
+    std::string line = request + "\n";
+    if (fd < 0 || !send_all(fd, line.data(), line.size()) || !read_line(fd, buffer, response)) {
+        error = "request failed";
+        return false;
+    }
+    return true;
+}
+
+#else
+
+Server::Server()
+: stopped(false)
+{
+}
+
+Server::~Server()
+{
+}
+
+bool
+Server::listen(const std::string&)
+{
+    error = "server is not supported on windows";
+    return false;
+}
+
+bool
+Server::serve(const Handler&, int)
+{
+    error = "server is not supported on windows";
+    return false;
+}
+
+void
+Server::stop()
+{
+    stopped = true;
+}
+
+Client::Client()
+{
+}
+
+Client::~Client()
+{
+}
+
+bool
+Client::connect(const std::string&)
+{
+    error = "client is not supported on windows";
+    return false;
+}
+
+void
+Client::close()
+{
+}
+
+bool
+Client::request(const std::string&, std::string&)
+{
+    error = "client is not supported on windows";
+    return false;
+}
+
+#endif
+
+const std::string&
+Server::geterror() const
+{
+    return error;
+}
+
+const std::string&
+Client::geterror() const
+{
+    return error;
+}
+
+}
@@ -0,0 +1,72 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace colortool {
+
+// server
+// unix domain socket server, requests and responses are single lines. idle connections
+// are polled and readable ones are handed to a pool of threads, so a small pool serves
+// any number of persistent clients.
+class Server
+{
+public:
+    // response for a request, number counts requests per connection from 1
+    typedef std::function<std::string(const std::string& request, size_t number)> Handler;
+
+    Server();
+    ~Server();
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // bind socket, a stale socket file is replaced, false if a server is running
+    bool listen(const std::string& path);
+
+    // serve until stopped, false on error
+    bool serve(const Handler& handler, int threads);
+
+    // stop serving, safe to call from a signal handler
+    void stop();
+
+    const std::string& geterror() const;
+
+private:
+    int fd = -1;
+    int wakeup[2] = { -1, -1 };
+    std::string path;
+    std::atomic<bool> stopped;
+    std::string error;
+};
+
+// client
+class Client
+{
+public:
+    Client();
+    ~Client();
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    bool connect(const std::string& path);
+    void close();
+
+    // send request line and wait for response line, without newlines
+    bool request(const std::string& request, std::string& response);
+
+    const std::string& geterror() const;
+
+private:
+    int fd = -1;
+    std::string buffer;
+    std::string error;
+};
+
+}
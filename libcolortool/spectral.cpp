@@ -0,0 +1,500 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "spectral.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+const int patchblock = 64; // patches per block of a fit
+
+// gaussian lobe with separate widths below and above the peak
+double lobe(double wavelength, double peak, double below, double above)
+{
+    const double t = (wavelength - peak) / (wavelength < peak ? below : above);
+    return std::exp(-0.5 * t * t);
+}
+
+// cie 1931 2 degree standard observer, 380 to 780 nm in 5 nm steps, x, y and z per row
+const double cie1931_cmfs[spectral_samples * 3] = {
+    0.001368, 0.000039, 0.006450,
+    0.002236, 0.000064, 0.010550,
+    0.004243, 0.000120, 0.020050,
+    0.007650, 0.000217, 0.036210,
+    0.014310, 0.000396, 0.067850,
+    0.023190, 0.000640, 0.110200,
+    0.043510, 0.001210, 0.207400,
+    0.077630, 0.002180, 0.371300,
+    0.134380, 0.004000, 0.645600,
+    0.214770, 0.007300, 1.039050,
+    0.283900, 0.011600, 1.385600,
+    0.328500, 0.016840, 1.622960,
+    0.348280, 0.023000, 1.747060,
+    0.348060, 0.029800, 1.782600,
+    0.336200, 0.038000, 1.772110,
+    0.318700, 0.048000, 1.744100,
+    0.290800, 0.060000, 1.669200,
+    0.251100, 0.073900, 1.528100,
+    0.195360, 0.090980, 1.287640,
+    0.142100, 0.112600, 1.041900,
+    0.095640, 0.139020, 0.812950,
+    0.057950, 0.169300, 0.616200,
+    0.032010, 0.208020, 0.465180,
+    0.014700, 0.258600, 0.353300,
+    0.004900, 0.323000, 0.272000,
+    0.002400, 0.407300, 0.212300,
+    0.009300, 0.503000, 0.158200,
+    0.029100, 0.608200, 0.111700,
+    0.063270, 0.710000, 0.078250,
+    0.109600, 0.793200, 0.057250,
+    0.165500, 0.862000, 0.042160,
+    0.225750, 0.914850, 0.029840,
+    0.290400, 0.954000, 0.020300,
+    0.359700, 0.980300, 0.013400,
+    0.433450, 0.994950, 0.008750,
+    0.512050, 1.000000, 0.005750,
+    0.594500, 0.995000, 0.003900,
+    0.678400, 0.978600, 0.002750,
+    0.762100, 0.952000, 0.002100,
+    0.842500, 0.915400, 0.001800,
+    0.916300, 0.870000, 0.001650,
+    0.978600, 0.816300, 0.001400,
+    1.026300, 0.757000, 0.001100,
+    1.056700, 0.694900, 0.001000,
+    1.062200, 0.631000, 0.000800,
+    1.045600, 0.566800, 0.000600,
+    1.002600, 0.503000, 0.000340,
+    0.938400, 0.441200, 0.000240,
+    0.854450, 0.381000, 0.000190,
+    0.751400, 0.321000, 0.000100,
+    0.642400, 0.265000, 0.000050,
+    0.541900, 0.217000, 0.000030,
+    0.447900, 0.175000, 0.000020,
+    0.360800, 0.138200, 0.000010,
+    0.283500, 0.107000, 0.000000,
+    0.218700, 0.081600, 0.000000,
+    0.164900, 0.061000, 0.000000,
+    0.121200, 0.044580, 0.000000,
+    0.087400, 0.032000, 0.000000,
+    0.063600, 0.023200, 0.000000,
+    0.046770, 0.017000, 0.000000,
+    0.032900, 0.011920, 0.000000,
+    0.022700, 0.008210, 0.000000,
+    0.015840, 0.005723, 0.000000,
+    0.011359, 0.004102, 0.000000,
+    0.008111, 0.002929, 0.000000,
+    0.005790, 0.002091, 0.000000,
+    0.004109, 0.001484, 0.000000,
+    0.002899, 0.001047, 0.000000,
+    0.002049, 0.000740, 0.000000,
+    0.001440, 0.000520, 0.000000,
+    0.001000, 0.000361, 0.000000,
+    0.000690, 0.000249, 0.000000,
+    0.000476, 0.000172, 0.000000,
+    0.000332, 0.000120, 0.000000,
+    0.000235, 0.000085, 0.000000,
+    0.000166, 0.000060, 0.000000,
+    0.000117, 0.000042, 0.000000,
+    0.000083, 0.000030, 0.000000,
+    0.000059, 0.000021, 0.000000,
+    0.000042, 0.000015, 0.000000
+};
+
+// cie 1964 10 degree standard observer, 380 to 780 nm in 5 nm steps, x, y and z per row
+const double cie1964_cmfs[spectral_samples * 3] = {
+    0.000160, 0.000017, 0.000705,
+    0.000662, 0.000072, 0.002928,
+    0.002362, 0.000253, 0.010482,
+    0.007242, 0.000769, 0.032344,
+    0.019110, 0.002004, 0.086011,
+    0.043400, 0.004509, 0.197120,
+    0.084736, 0.008756, 0.389366,
+    0.140638, 0.014456, 0.656760,
+    0.204492, 0.021391, 0.972542,
+    0.264737, 0.029497, 1.282500,
+    0.314679, 0.038676, 1.553480,
+    0.357719, 0.049602, 1.798500,
+    0.383734, 0.062077, 1.967280,
+    0.386726, 0.074704, 2.027300,
+    0.370702, 0.089456, 1.994800,
+    0.342957, 0.106256, 1.900700,
+    0.302273, 0.128201, 1.745370,
+    0.254085, 0.152761, 1.554900,
+    0.195618, 0.185190, 1.317560,
+    0.132349, 0.219940, 1.030200,
+    0.080507, 0.253589, 0.772125,
+    0.041072, 0.297665, 0.570060,
+    0.016172, 0.339133, 0.415254,
+    0.005132, 0.395379, 0.302356,
+    0.003816, 0.460777, 0.218502,
+    0.015444, 0.531360, 0.159249,
+    0.037465, 0.606741, 0.112044,
+    0.071358, 0.685660, 0.082248,
+    0.117749, 0.761757, 0.060709,
+    0.172953, 0.823330, 0.043050,
+    0.236491, 0.875211, 0.030451,
+    0.304213, 0.923810, 0.020584,
+    0.376772, 0.961988, 0.013676,
+    0.451584, 0.982200, 0.007918,
+    0.529826, 0.991761, 0.003988,
+    0.616053, 0.999110, 0.001091,
+    0.705224, 0.997340, 0.000000,
+    0.793832, 0.982380, 0.000000,
+    0.878655, 0.955552, 0.000000,
+    0.951162, 0.915175, 0.000000,
+    1.014160, 0.868934, 0.000000,
+    1.074300, 0.825623, 0.000000,
+    1.118520, 0.777405, 0.000000,
+    1.134300, 0.720353, 0.000000,
+    1.123990, 0.658341, 0.000000,
+    1.089100, 0.593878, 0.000000,
+    1.030480, 0.527963, 0.000000,
+    0.950740, 0.461834, 0.000000,
+    0.856297, 0.398057, 0.000000,
+    0.754930, 0.339554, 0.000000,
+    0.647467, 0.283493, 0.000000,
+    0.535110, 0.228254, 0.000000,
+    0.431567, 0.179828, 0.000000,
+    0.343690, 0.140211, 0.000000,
+    0.268329, 0.107633, 0.000000,
+    0.204300, 0.081187, 0.000000,
+    0.152568, 0.060281, 0.000000,
+    0.112210, 0.044096, 0.000000,
+    0.081261, 0.031800, 0.000000,
+    0.057930, 0.022602, 0.000000,
+    0.040851, 0.015905, 0.000000,
+    0.028623, 0.011130, 0.000000,
+    0.019941, 0.007749, 0.000000,
+    0.013842, 0.005375, 0.000000,
+    0.009577, 0.003718, 0.000000,
+    0.006605, 0.002565, 0.000000,
+    0.004553, 0.001768, 0.000000,
+    0.003145, 0.001222, 0.000000,
+    0.002175, 0.000846, 0.000000,
+    0.001506, 0.000586, 0.000000,
+    0.001045, 0.000407, 0.000000,
+    0.000727, 0.000284, 0.000000,
+    0.000508, 0.000199, 0.000000,
+    0.000356, 0.000140, 0.000000,
+    0.000251, 0.000098, 0.000000,
+    0.000178, 0.000070, 0.000000,
+    0.000126, 0.000050, 0.000000,
+    0.000090, 0.000036, 0.000000,
+    0.000065, 0.000025, 0.000000,
+    0.000046, 0.000018, 0.000000,
+    0.000033, 0.000013, 0.000000
+};
+
+// fields of a csv line separated by commas, semicolons or white space, a trailing
+// separator is ignored
+std::vector<std::string> split_fields(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    for (char c : line) {
+        if (c == ',' || c == ';') {
+            fields.push_back(field);
+            field.clear();
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (field.size()) {
+                fields.push_back(field);
+                field.clear();
+            }
+        } else {
+            field += c;
+        }
+    }
+    if (field.size()) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool parse_number(const std::string& field, double& value)
+{
+    if (field.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtod(field.c_str(), &end);
+    return end == field.c_str() + field.size() && std::isfinite(value);
+}
+
+// responses of reflectances lit by illuminant, camera rgb and cmf xyz, 3 x patches
+void integrate(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& camera, const Eigen::VectorXd& illuminant,
+               const Eigen::MatrixXd& reflectances, Eigen::Index first, Eigen::Index count, Eigen::MatrixXd& rgb, Eigen::MatrixXd& xyz)
+{
+    const Eigen::MatrixXd litcamera = illuminant.asDiagonal() * camera;
+    const Eigen::MatrixXd litcmfs = illuminant.asDiagonal() * cmfs;
+    rgb.middleCols(first, count).noalias() = litcamera.transpose() * reflectances.middleCols(first, count);
+    xyz.middleCols(first, count).noalias() = litcmfs.transpose() * reflectances.middleCols(first, count);
+}
+
+}
+
+bool
+parse_observer(const std::string& name, Observer& observer)
+{
+    if (name == "cie1931") {
+        observer = Observer::CIE1931;
+    } else if (name == "cie1964") {
+        observer = Observer::CIE1964;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+observer_name(Observer observer)
+{
+    return observer == Observer::CIE1931 ? "cie1931" : "cie1964";
+}
+
+Eigen::MatrixXd
+observer_cmfs(Observer observer)
+{
+    const double* table = observer == Observer::CIE1931 ? cie1931_cmfs : cie1964_cmfs;
+    return Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>>(table, spectral_samples, 3);
+}
+
+Eigen::VectorXd
+blackbody_spd(double temperature)
+{
+    const double c2 = 1.4388e-2; // second radiation constant in m k
+    auto planck = [&](double wavelength) {
+        const double l = wavelength * 1e-9;
+        return 1.0 / (std::pow(l, 5.0) * std::expm1(c2 / (l * temperature)));
+    };
+    const double normalize = planck(560.0);
+    Eigen::VectorXd spd(spectral_samples);
+    for (int i = 0; i < spectral_samples; ++i) {
+        spd(i) = planck(spectral_wavelength(i)) / normalize;
+    }
+    return spd;
+}
+
+bool
+read_spectral(const std::string& filename, SpectralData& data, std::string& error)
+{
+    std::ifstream stream(filename);
+    if (!stream) {
+        error = "could not open spectral file: " + filename;
+        return false;
+    }
+    std::vector<double> wavelengths;
+    std::vector<std::vector<double>> rows;
+    std::vector<std::string> names;
+    std::string line;
+    size_t columns = 0, number = 0;
+    while (std::getline(stream, line)) {
+        number++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        std::vector<std::string> fields = split_fields(line);
+        double wavelength;
+        if (!parse_number(fields[0], wavelength)) {
+            if (rows.size() || names.size()) {
+                error = "could not parse spectral file: " + filename + ", line " + std::to_string(number);
+                return false;
+            }
+            names.assign(fields.begin() + 1, fields.end());
+            columns = names.size();
+            continue;
+        }
+        if (!columns) {
+            columns = fields.size() - 1;
+        }
+        if (!columns || fields.size() != columns + 1 || (wavelengths.size() && wavelength <= wavelengths.back())) {
+            error = "could not parse spectral file: " + filename + ", line " + std::to_string(number) + ", expected ascending wavelength and " + std::to_string(columns) + " values";
+            return false;
+        }
+        std::vector<double> row(columns);
+        for (size_t c = 0; c < columns; ++c) {
+            if (!parse_number(fields[c + 1], row[c])) {
+                error = "could not parse spectral file: " + filename + ", line " + std::to_string(number);
+                return false;
+            }
+        }
+        wavelengths.push_back(wavelength);
+        rows.push_back(row);
+    }
+    if (wavelengths.size() < 2) {
+        error = "spectral file needs at least two wavelengths: " + filename;
+        return false;
+    }
+    data.names.clear();
+    for (size_t c = 0; c < columns; ++c) {
+        data.names.push_back(c < names.size() && names[c].size() ? names[c] : std::to_string(c));
+    }
+    data.values = Eigen::MatrixXd::Zero(spectral_samples, columns);
+    for (int i = 0; i < spectral_samples; ++i) {
+        const double l = spectral_wavelength(i);
+        if (l < wavelengths.front() || l > wavelengths.back()) {
+            continue;
+        }
+        size_t upper = std::lower_bound(wavelengths.begin(), wavelengths.end(), l) - wavelengths.begin();
+        size_t lower = upper > 0 && wavelengths[upper] != l ? upper - 1 : upper;
+        const double t = upper == lower ? 0.0 : (l - wavelengths[lower]) / (wavelengths[upper] - wavelengths[lower]);
+        for (size_t c = 0; c < columns; ++c) {
+            data.values(i, c) = rows[lower][c] + (rows[upper][c] - rows[lower][c]) * t;
+        }
+    }
+    return true;
+}
+
+Eigen::MatrixXd
+spectral_whitepoints(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& illuminants)
+{
+    Eigen::MatrixXd xyz = cmfs.transpose() * illuminants;
+    for (Eigen::Index i = 0; i < xyz.cols(); ++i) {
+        xyz.col(i) = xyz(1, i) > 0.0 ? Eigen::Vector3d(xyz.col(i) / xyz(1, i)) : Eigen::Vector3d::Zero();
+    }
+    return xyz;
+}
+
+Eigen::MatrixXd
+training_reflectances()
+{
+    std::vector<Eigen::VectorXd> patches;
+    auto add = [&](const std::function<double(double)>& reflectance) {
+        Eigen::VectorXd patch(spectral_samples);
+        for (int i = 0; i < spectral_samples; ++i) {
+            patch(i) = reflectance(spectral_wavelength(i));
+        }
+        patches.push_back(patch);
+    };
+    for (double width : { 25.0, 50.0, 100.0 }) {
+        for (double center = 400.0; center <= 700.0; center += 25.0) {
+            add([=](double l) { return 0.05 + 0.85 * lobe(l, center, width, width); });
+        }
+    }
+    for (double edge = 450.0; edge <= 650.0; edge += 50.0) {
+        add([=](double l) { return 0.05 + 0.85 / (1.0 + std::exp(-(l - edge) / 15.0)); });
+        add([=](double l) { return 0.05 + 0.85 / (1.0 + std::exp((l - edge) / 15.0)); });
+    }
+    for (double grey : { 0.05, 0.2, 0.5, 0.9 }) {
+        add([=](double) { return grey; });
+    }
+    Eigen::MatrixXd reflectances(spectral_samples, patches.size());
+    for (size_t i = 0; i < patches.size(); ++i) {
+        reflectances.col(i) = patches[i];
+    }
+    return reflectances;
+}
+
+CameraFit
+fit_camera(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& camera, const Eigen::VectorXd& illuminant,
+           const Eigen::MatrixXd& reflectances, int threads)
+{
+    CameraFit fit;
+    const Eigen::Vector3d white = camera.transpose() * illuminant;
+    const Eigen::Vector3d whitexyz = cmfs.transpose() * illuminant;
+    const Eigen::Index patches = reflectances.cols();
+    if (white.minCoeff() <= 0.0 || whitexyz.y() <= 0.0 || patches < 3) {
+        return fit;
+    }
+
+    // responses and normal equations of blocks of patches, one block per thread
+    const int blocks = int((patches + patchblock - 1) / patchblock);
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::max(std::min(count, blocks), 1);
+    Eigen::MatrixXd rgb(3, patches), xyz(3, patches);
+    std::vector<Eigen::Matrix3d> normals(blocks), products(blocks);
+    const Eigen::Vector3d balance = white.cwiseInverse();
+    const double luminance = 1.0 / whitexyz.y();
+    auto compute = [&](int first) {
+        for (int block = first; block < blocks; block += count) {
+            const Eigen::Index begin = Eigen::Index(block) * patchblock;
+            const Eigen::Index size = std::min<Eigen::Index>(patchblock, patches - begin);
+            integrate(cmfs, camera, illuminant, reflectances, begin, size, rgb, xyz);
+            rgb.middleCols(begin, size) = balance.asDiagonal() * rgb.middleCols(begin, size);
+            xyz.middleCols(begin, size) *= luminance;
+            normals[block].noalias() = rgb.middleCols(begin, size) * rgb.middleCols(begin, size).transpose();
+            products[block].noalias() = rgb.middleCols(begin, size) * xyz.middleCols(begin, size).transpose();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(compute, i);
+    }
+    compute(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    Eigen::Matrix3d normal = Eigen::Matrix3d::Zero(), product = Eigen::Matrix3d::Zero();
+    for (int block = 0; block < blocks; ++block) {
+        normal += normals[block];
+        product += products[block];
+    }
+
+    // rows of least squares with white constraint, m = a^-1 (b - lambda 1) with lambda
+    // chosen so that m . 1 is the whitepoint
+    Eigen::LDLT<Eigen::Matrix3d> solver(normal);
+    if (solver.info() != Eigen::Success || !solver.isPositive()) {
+        return fit;
+    }
+    const Eigen::Vector3d ones = Eigen::Vector3d::Ones();
+    const Eigen::Vector3d inverseones = solver.solve(ones);
+    const Eigen::Vector3d whitepoint = whitexyz * luminance;
+    Eigen::Map<RowMatrix3d> matrix(fit.matrix);
+    for (int row = 0; row < 3; ++row) {
+        const Eigen::Vector3d solution = solver.solve(Eigen::Vector3d(product.col(row)));
+        const double lambda = (ones.dot(solution) - whitepoint(row)) / ones.dot(inverseones);
+        matrix.row(row) = (solution - lambda * inverseones).transpose();
+    }
+    const Eigen::VectorXd errors = (matrix * rgb - xyz).colwise().norm();
+    fit.rms = std::sqrt(errors.squaredNorm() / double(patches));
+    fit.max = errors.maxCoeff();
+    for (int i = 0; i < 3; ++i) {
+        fit.white[i] = white(i);
+        fit.whitepoint[i] = whitepoint(i);
+    }
+    fit.valid = std::isfinite(fit.rms);
+    return fit;
+}
+
+std::vector<CameraFit>
+fit_cameras(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& camera, const Eigen::MatrixXd& illuminants,
+            const Eigen::MatrixXd& reflectances, int threads)
+{
+    const int illuminantcount = int(illuminants.cols());
+    std::vector<CameraFit> fits(illuminantcount);
+    if (illuminantcount == 1) {
+        fits[0] = fit_camera(cmfs, camera, illuminants.col(0), reflectances, threads);
+        return fits;
+    }
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::max(std::min(count, illuminantcount), 1);
+    auto compute = [&](int first) {
+        for (int i = first; i < illuminantcount; i += count) {
+            fits[i] = fit_camera(cmfs, camera, illuminants.col(i), reflectances, 1);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(compute, i);
+    }
+    compute(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return fits;
+}
+
+}
@@ -0,0 +1,96 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "colormath.h"
+
+namespace colortool {
+
+// spectral
+// spectra sampled on a common wavelength grid and stored as columns of eigen matrices,
+// one aligned flat array of samples x columns, so integration against observer color
+// matching functions is a vectorized matrix product over all spectra at once.
+
+// wavelength grid in nm, 380 to 780 in 5 nm steps
+const int spectral_start = 380;
+const int spectral_step = 5;
+const int spectral_samples = 81;
+
+// wavelength of sample
+inline double spectral_wavelength(int sample) { return spectral_start + sample * spectral_step; }
+
+// named spectra, samples x columns on the grid
+struct SpectralData
+{
+    std::vector<std::string> names;
+    Eigen::MatrixXd values;
+};
+
+// observers, cie 1931 2 degree and cie 1964 10 degree
+enum class Observer {
+    CIE1931,
+    CIE1964
+};
+
+// parse observer name, cie1931 or cie1964, false if unknown
+bool parse_observer(const std::string& name, Observer& observer);
+
+// observer name
+const char* observer_name(Observer observer);
+
+// color matching functions of observer, samples x 3 for x, y and z, the tabulated cie
+// functions in 5 nm steps
+Eigen::MatrixXd observer_cmfs(Observer observer);
+
+// planck blackbody spd of temperature in kelvin, normalized to 1 at 560 nm
+Eigen::VectorXd blackbody_spd(double temperature);
+
+// read csv of spectra, one row per wavelength in ascending order with the wavelength
+// in nm followed by a value per spectrum, separated by commas, semicolons or white
+// space. an optional header row names the spectra and lines starting with # are
+// skipped. spectra are resampled linearly onto the grid and are zero outside the
+// measured range. false and error if the file could not be read or parsed.
+bool read_spectral(const std::string& filename, SpectralData& data, std::string& error);
+
+// whitepoints of illuminants, samples x count, integrated against cmfs in one product.
+// 3 x count xyz normalized to Y = 1, columns without luminance are zero.
+Eigen::MatrixXd spectral_whitepoints(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& illuminants);
+
+// smooth training reflectances in [0, 1], samples x patches, gaussian bands of a few
+// widths across the visible range, steps and flat greys
+Eigen::MatrixXd training_reflectances();
+
+// camera fit
+// camera rgb to xyz for an illuminant, fitted on reflectances lit by the illuminant.
+// camera rgb is white balanced so the illuminant white is 1, 1, 1 and xyz has Y = 1
+// for the white. the fit is least squares in xyz with rows constrained so white maps
+// exactly to the whitepoint.
+struct CameraFit
+{
+    double matrix[9]; // white balanced camera rgb to xyz, 3x3 row major
+    double white[3]; // camera rgb of the illuminant white before balance
+    double whitepoint[3]; // xyz of the illuminant white
+    double rms = 0.0; // rms xyz error over patches
+    double max = 0.0; // max xyz error over patches
+    bool valid = false;
+};
+
+// fit of camera sensitivities, samples x 3, for one illuminant. patch responses are
+// integrated in blocks spread across threads, 0 for all cores, and the normal equations
+// of the blocks are summed in block order so the fit does not depend on the thread
+// count.
+CameraFit fit_camera(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& camera, const Eigen::VectorXd& illuminant,
+                     const Eigen::MatrixXd& reflectances, int threads = 0);
+
+// fits for illuminants, samples x count, spread across threads with one fit per
+// illuminant, or across patches when there is a single illuminant
+std::vector<CameraFit> fit_cameras(const Eigen::MatrixXd& cmfs, const Eigen::MatrixXd& camera, const Eigen::MatrixXd& illuminants,
+                                   const Eigen::MatrixXd& reflectances, int threads = 0);
+
+}
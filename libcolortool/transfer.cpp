@@ -0,0 +1,205 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "transfer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace colortool {
+
+double logc4::s()
+{
+    return (7.0 * std::log(2.0) * std::pow(2.0, 7.0 - 14.0 * c / b)) / (a * b);
+}
+
+double logc4::t()
+{
+    return (std::pow(2.0, 14.0 * (-c / b) + 6.0) - 64.0) / a;
+}
+
+namespace {
+
+// lower case without spaces, "DaVinci Intermediate" -> "davinciintermediate"
+std::string
+normalize(const std::string& name)
+{
+    std::string str;
+    for (char c : name) {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            str += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    return str;
+}
+
+double
+mirror_pow(double value, double exponent)
+{
+    return value < 0.0 ? -std::pow(-value, exponent) : std::pow(value, exponent);
+}
+
+}
+
+bool
+parse_transfer(const std::string& name, Transfer& transfer)
+{
+    std::string str = normalize(name.substr(0, name.find(',')));
+    transfer = Transfer();
+    if (str == "linear") {
+        transfer.type = TransferType::Linear;
+    }
+    else if (str == "srgb") {
+        transfer.type = TransferType::sRGB;
+    }
+    else if (str.compare(0, 5, "gamma") == 0) {
+        char* end = nullptr;
+        double gamma = std::strtod(str.c_str() + 5, &end);
+        if (end == str.c_str() + 5 || *end || gamma <= 0.0) {
+            return false;
+        }
+        transfer.type = TransferType::Gamma;
+        transfer.gamma = static_cast<float>(gamma);
+    }
+    else if (str == "logc3") {
+        transfer.type = TransferType::LogC3;
+    }
+    else if (str == "logc4") {
+        transfer.type = TransferType::LogC4;
+    }
+    else if (str == "davinciintermediate") {
+        transfer.type = TransferType::DaVinciIntermediate;
+    }
+    else if (str == "film5") {
+        transfer.type = TransferType::Film5;
+    }
+    else if (str == "cc" || str == "acescc") {
+        transfer.type = TransferType::ACEScc;
+    }
+    else if (str == "cct" || str == "acescct") {
+        transfer.type = TransferType::ACEScct;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string
+transfer_name(const Transfer& transfer)
+{
+    switch (transfer.type) {
+        case TransferType::Linear: return "Linear";
+        case TransferType::sRGB: return "sRGB";
+        case TransferType::Gamma: {
+            std::string gamma = std::to_string(transfer.gamma);
+            gamma.erase(gamma.find_last_not_of('0') + 1);
+            if (gamma.back() == '.') {
+                gamma.pop_back();
+            }
+            return "Gamma" + gamma;
+        }
+        case TransferType::LogC3: return "LogC3";
+        case TransferType::LogC4: return "LogC4";
+        case TransferType::DaVinciIntermediate: return "DaVinci Intermediate";
+        case TransferType::Film5: return "Film 5";
+        case TransferType::ACEScc: return "ACEScc";
+        case TransferType::ACEScct: return "ACEScct";
+    }
+    return "Unknown";
+}
+
+std::vector<std::string>
+transfer_names()
+{
+    return { "Linear", "sRGB", "Gamma<value>", "LogC3", "LogC4", "DaVinci Intermediate", "Film 5", "ACEScc", "ACEScct" };
+}
+
+double
+transfer_decode(const Transfer& transfer, double value)
+{
+    const double x = value;
+    switch (transfer.type) {
+        case TransferType::Linear:
+            return x;
+        case TransferType::sRGB:
+            return x <= srgb::logcut ? x / srgb::slope : std::pow((x + srgb::b) / srgb::a, srgb::gamma);
+        case TransferType::Gamma:
+            return mirror_pow(x, transfer.gamma);
+        case TransferType::LogC3:
+            return x > logc3::e * logc3::cut + logc3::f
+                ? (std::pow(10.0, (x - logc3::d) / logc3::c) - logc3::b) / logc3::a
+                : (x - logc3::f) / logc3::e;
+        case TransferType::LogC4:
+            return x >= 0.0
+                ? (std::pow(2.0, 14.0 * (x - logc4::c) / logc4::b + 6.0) - 64.0) / logc4::a
+                : x * logc4::s() + logc4::t();
+        case TransferType::DaVinciIntermediate:
+            return x <= davinci::logcut
+                ? x / davinci::m
+                : std::pow(2.0, x / davinci::c - davinci::b) - davinci::a;
+        case TransferType::Film5:
+            return x < film5::logcut
+                ? (x - film5::e) / film5::d
+                : std::exp((x - film5::c) / film5::a) - film5::b;
+        case TransferType::ACEScc:
+            if (x < (acescc::a - 15.0) / acescc::b) {
+                return (std::pow(2.0, x * acescc::b - acescc::a) - std::pow(2.0, -16.0)) * 2.0;
+            }
+            return std::min(std::pow(2.0, x * acescc::b - acescc::a), acescc::max);
+        case TransferType::ACEScct:
+            return x <= acescct::logcut
+                ? (x - acescct::b) / acescct::a
+                : std::pow(2.0, x * acescc::b - acescc::a);
+    }
+    return x;
+}
+
+double
+transfer_encode(const Transfer& transfer, double value)
+{
+    const double x = value;
+    switch (transfer.type) {
+        case TransferType::Linear:
+            return x;
+        case TransferType::sRGB:
+            return x <= srgb::lincut ? x * srgb::slope : srgb::a * std::pow(x, 1.0 / srgb::gamma) - srgb::b;
+        case TransferType::Gamma:
+            return mirror_pow(x, 1.0 / transfer.gamma);
+        case TransferType::LogC3:
+            return x > logc3::cut
+                ? logc3::c * std::log10(logc3::a * x + logc3::b) + logc3::d
+                : logc3::e * x + logc3::f;
+        case TransferType::LogC4:
+            return x >= logc4::t()
+                ? (std::log2(logc4::a * x + 64.0) - 6.0) / 14.0 * logc4::b + logc4::c
+                : (x - logc4::t()) / logc4::s();
+        case TransferType::DaVinciIntermediate:
+            return x <= davinci::lincut
+                ? x * davinci::m
+                : (std::log2(x + davinci::a) + davinci::b) * davinci::c;
+        case TransferType::Film5:
+            return x < film5::lincut
+                ? film5::d * x + film5::e
+                : film5::a * std::log(x + film5::b) + film5::c;
+        case TransferType::ACEScc:
+            if (x <= 0.0) {
+                return (-16.0 + acescc::a) / acescc::b;
+            }
+            if (x < std::pow(2.0, -15.0)) {
+                return (std::log2(std::pow(2.0, -16.0) + x * 0.5) + acescc::a) / acescc::b;
+            }
+            return (std::log2(x) + acescc::a) / acescc::b;
+        case TransferType::ACEScct:
+            return x <= acescct::lincut
+                ? acescct::a * x + acescct::b
+                : (std::log2(x) + acescc::a) / acescc::b;
+    }
+    return x;
+}
+
+}
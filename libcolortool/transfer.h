@@ -0,0 +1,112 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace colortool {
+
+// transfer types
+enum class TransferType {
+    Linear,
+    sRGB,
+    Gamma,
+    LogC3,
+    LogC4,
+    DaVinciIntermediate,
+    Film5,
+    ACEScc,
+    ACEScct
+};
+
+// transfer, decode is encoded to linear and encode is linear to encoded
+struct Transfer
+{
+    TransferType type = TransferType::Linear;
+    float gamma = 1.0f; // gamma only, negative values are mirrored
+};
+
+// parse trc names as used in colorspaces.json, e.g LogC3, Gamma2.4, DaVinci Intermediate
+// or "cc, cct" where the first entry is used. false if unknown.
+bool parse_transfer(const std::string& name, Transfer& transfer);
+
+// transfer name
+std::string transfer_name(const Transfer& transfer);
+
+// supported transfer names
+std::vector<std::string> transfer_names();
+
+// exact reference curves in double precision
+double transfer_decode(const Transfer& transfer, double value);
+double transfer_encode(const Transfer& transfer, double value);
+
+// curve constants
+namespace srgb {
+    const double a = 1.055;
+    const double b = 0.055;
+    const double gamma = 2.4;
+    const double slope = 12.92;
+    const double lincut = 0.0031308;
+    const double logcut = 0.04045;
+}
+
+// arri logc3, ei 800
+namespace logc3 {
+    const double cut = 0.010591;
+    const double a = 5.555556;
+    const double b = 0.052272;
+    const double c = 0.247190;
+    const double d = 0.385537;
+    const double e = 5.367655;
+    const double f = 0.092809;
+}
+
+// arri logc4
+namespace logc4 {
+    const double a = (262144.0 - 16.0) / 117.45;
+    const double b = (1023.0 - 95.0) / 1023.0;
+    const double c = 95.0 / 1023.0;
+    double s(); // slope of the linear segment
+    double t(); // linear cut
+}
+
+// davinci intermediate
+namespace davinci {
+    const double a = 0.0075;
+    const double b = 7.0;
+    const double c = 0.07329248;
+    const double m = 10.44426855;
+    const double lincut = 0.00262409;
+    const double logcut = 0.02740668;
+}
+
+// blackmagic film generation 5
+namespace film5 {
+    const double a = 0.08692876065491224;
+    const double b = 0.005494072432257808;
+    const double c = 0.5300133392291939;
+    const double d = 8.283605932402494;
+    const double e = 0.09246575342465753;
+    const double lincut = 0.005;
+    const double logcut = d * lincut + e;
+}
+
+// aces acescc and acescct
+namespace acescc {
+    const double a = 9.72;
+    const double b = 17.52;
+    const double max = 65504.0;
+}
+
+namespace acescct {
+    const double a = 10.5402377416545;
+    const double b = 0.0729055341958355;
+    const double lincut = 0.0078125;
+    const double logcut = 0.155251141552511;
+}
+
+}
@@ -0,0 +1,525 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "transformcache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <random>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace colortool {
+
+namespace {
+
+const char cache_magic[8] = { 'c', 't', 'c', 'a', 'c', 'h', 'e', '\0' };
+const uint32_t cache_version = 1;
+const uint32_t cache_endian = 0x01020304;
+const uint32_t cache_empty = 0xffffffff;
+
+enum Kind {
+    ColorspaceKind,
+    IlluminantKind
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t hash;
+    uint64_t size;
+    uint32_t colorspaces;
+    uint32_t illuminants;
+    uint32_t whitepoints;
+    uint32_t methods;
+    uint32_t buckets; // power of two
+    uint32_t reserved;
+    uint64_t colorspaceoffset;
+    uint64_t illuminantoffset;
+    uint64_t adaptationoffset;
+    uint64_t transformoffset;
+    uint64_t bucketoffset;
+    uint64_t stringoffset;
+    uint64_t stringsize;
+};
+
+// open addressing hash table of names, linear probing
+struct Bucket
+{
+    uint64_t hash;
+    uint32_t kind;
+    uint32_t index;
+};
+
+uint64_t
+name_hash(uint32_t kind, const std::string& name)
+{
+    return TransformCache::hash(name.data(), name.size(), TransformCache::hash(&kind, sizeof(kind)));
+}
+
+// offset + product of counts and element size within limit, without overflow
+bool
+extent(uint64_t offset, std::initializer_list<uint64_t> counts, uint64_t limit)
+{
+    uint64_t total = 1;
+    for (uint64_t count : counts) {
+        if (count && total > limit / count) {
+            return false;
+        }
+        total *= count;
+    }
+    return offset <= limit && total <= limit - offset;
+}
+
+size_t
+align(size_t offset)
+{
+    return (offset + 7) & ~size_t(7);
+}
+
+void
+multiply(const double* a, const double* b, double* m)
+{
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            m[i * 3 + j] = a[i * 3 + 0] * b[0 * 3 + j] + a[i * 3 + 1] * b[1 * 3 + j] + a[i * 3 + 2] * b[2 * 3 + j];
+        }
+    }
+}
+
+const Header&
+header(const char* data)
+{
+    return *reinterpret_cast<const Header*>(data);
+}
+
+}
+
+TransformCache::TransformCache()
+{
+}
+
+TransformCache::~TransformCache()
+{
+    close();
+}
+
+bool
+TransformCache::open(const std::string& filename, uint64_t hash)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER filesize;
+    HANDLE handle = nullptr;
+    if (GetFileSizeEx(file, &filesize) && filesize.QuadPart >= LONGLONG(sizeof(Header))) {
+        handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (!handle) {
+        return false;
+    }
+    void* view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(handle);
+    if (!view) {
+        return false;
+    }
+    mapping = view;
+    size = static_cast<size_t>(filesize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(Header))) {
+        view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    mapping = view;
+    size = static_cast<size_t>(st.st_size);
+#endif
+    data = static_cast<const char*>(mapping);
+    return validate(hash);
+}
+
+bool
+TransformCache::open(std::vector<char>&& cache, uint64_t hash)
+{
+    close();
+    buffer = std::move(cache);
+    data = buffer.data();
+    size = buffer.size();
+    return validate(hash);
+}
+
+void
+TransformCache::close()
+{
+    if (mapping) {
+#if defined(_WIN32)
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, size);
+#endif
+        mapping = nullptr;
+    }
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+}
+
+bool
+TransformCache::is_open() const
+{
+    return data != nullptr;
+}
+
+bool
+TransformCache::validate(uint64_t hash)
+{
+    bool valid = size >= sizeof(Header);
+    if (valid) {
+        const Header& h = header(data);
+        uint64_t n = h.colorspaces, k = h.illuminants, w = h.whitepoints, m = h.methods;
+        valid = std::memcmp(h.magic, cache_magic, sizeof(cache_magic)) == 0
+            && h.version == cache_version
+            && h.endian == cache_endian
+            && h.hash == hash
+            && h.size == size
+            && h.buckets && (h.buckets & (h.buckets - 1)) == 0
+            && extent(h.colorspaceoffset, { n, sizeof(CacheColorspace) }, size)
+            && extent(h.illuminantoffset, { k, sizeof(CacheIlluminant) }, size)
+            && extent(h.adaptationoffset, { w, w, m, 9 * sizeof(double) }, size)
+            && extent(h.transformoffset, { n, n, m, 9 * sizeof(double) }, size)
+            && extent(h.bucketoffset, { h.buckets, sizeof(Bucket) }, size)
+            && extent(h.stringoffset, { h.stringsize }, size)
+            && h.stringsize && data[h.stringoffset + h.stringsize - 1] == '\0';
+    }
+    // records, a corrupt body with an intact header is stale and rebuilt
+    if (valid) {
+        const Header& h = header(data);
+        auto offset = [&](uint32_t value) { return value < h.stringsize; };
+        for (size_t i = 0; valid && i < h.colorspaces; ++i) {
+            const CacheColorspace& cs = colorspace(i);
+            valid = offset(cs.name) && offset(cs.description) && offset(cs.trc) && cs.whitepoint < h.whitepoints;
+        }
+        for (size_t i = 0; valid && i < h.illuminants; ++i) {
+            const CacheIlluminant& im = illuminant(i);
+            valid = offset(im.name) && offset(im.description) && im.whitepoint < h.whitepoints;
+        }
+        const Bucket* buckets = reinterpret_cast<const Bucket*>(data + h.bucketoffset);
+        for (size_t i = 0; valid && i < h.buckets; ++i) {
+            const Bucket& bucket = buckets[i];
+            valid = bucket.index == cache_empty
+                || (bucket.kind == ColorspaceKind && bucket.index < h.colorspaces)
+                || (bucket.kind == IlluminantKind && bucket.index < h.illuminants);
+        }
+    }
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+size_t
+TransformCache::colorspaces() const
+{
+    return header(data).colorspaces;
+}
+
+size_t
+TransformCache::illuminants() const
+{
+    return header(data).illuminants;
+}
+
+size_t
+TransformCache::methods() const
+{
+    return header(data).methods;
+}
+
+const CacheColorspace&
+TransformCache::colorspace(size_t index) const
+{
+    return reinterpret_cast<const CacheColorspace*>(data + header(data).colorspaceoffset)[index];
+}
+
+const CacheIlluminant&
+TransformCache::illuminant(size_t index) const
+{
+    return reinterpret_cast<const CacheIlluminant*>(data + header(data).illuminantoffset)[index];
+}
+
+const char*
+TransformCache::string(uint32_t offset) const
+{
+    return data + header(data).stringoffset + offset;
+}
+
+int
+TransformCache::find(uint32_t kind, const std::string& name) const
+{
+    const Header& h = header(data);
+    const Bucket* buckets = reinterpret_cast<const Bucket*>(data + h.bucketoffset);
+    const uint64_t hash = name_hash(kind, name);
+    for (uint32_t i = 0; i < h.buckets; ++i) {
+        const Bucket& bucket = buckets[(hash + i) & (h.buckets - 1)];
+        if (bucket.index == cache_empty) {
+            break;
+        }
+        if (bucket.hash == hash && bucket.kind == kind) {
+            uint32_t offset = kind == ColorspaceKind ? colorspace(bucket.index).name : illuminant(bucket.index).name;
+            if (name == string(offset)) {
+                return static_cast<int>(bucket.index);
+            }
+        }
+    }
+    return -1;
+}
+
+int
+TransformCache::find_colorspace(const std::string& name) const
+{
+    return find(ColorspaceKind, name);
+}
+
+int
+TransformCache::find_illuminant(const std::string& name) const
+{
+    return find(IlluminantKind, name);
+}
+
+const double*
+TransformCache::transform(size_t input, size_t output, size_t method) const
+{
+    const Header& h = header(data);
+    const double* transforms = reinterpret_cast<const double*>(data + h.transformoffset);
+    return transforms + ((input * h.colorspaces + output) * h.methods + method) * 9;
+}
+
+const double*
+TransformCache::adaptation(size_t input, size_t output, size_t method) const
+{
+    const Header& h = header(data);
+    const double* adaptations = reinterpret_cast<const double*>(data + h.adaptationoffset);
+    return adaptations + ((input * h.whitepoints + output) * h.methods + method) * 9;
+}
+
+uint64_t
+TransformCache::hash(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void
+TransformCacheBuilder::add_colorspace(const std::string& name, const std::string& description, const std::string& trc,
+                                      const double* r, const double* g, const double* b, const double* whitepointxy,
+                                      const double* whitepointxyz, const double* rgbxyz, const double* xyzrgb)
+{
+    Colorspace cs;
+    cs.name = name;
+    cs.description = description;
+    cs.trc = trc;
+    std::memset(&cs.record, 0, sizeof(cs.record));
+    std::copy(r, r + 2, cs.record.r);
+    std::copy(g, g + 2, cs.record.g);
+    std::copy(b, b + 2, cs.record.b);
+    std::copy(whitepointxy, whitepointxy + 2, cs.record.whitepointxy);
+    std::copy(whitepointxyz, whitepointxyz + 3, cs.record.whitepointxyz);
+    std::copy(rgbxyz, rgbxyz + 9, cs.record.rgbxyz);
+    std::copy(xyzrgb, xyzrgb + 9, cs.record.xyzrgb);
+    colorspaces.push_back(cs);
+}
+
+void
+TransformCacheBuilder::add_illuminant(const std::string& name, const std::string& description,
+                                      const double* whitepointxy, const double* whitepointxyz)
+{
+    Illuminant im;
+    im.name = name;
+    im.description = description;
+    std::memset(&im.record, 0, sizeof(im.record));
+    std::copy(whitepointxy, whitepointxy + 2, im.record.whitepointxy);
+    std::copy(whitepointxyz, whitepointxyz + 3, im.record.whitepointxyz);
+    illuminants.push_back(im);
+}
+
+std::vector<char>
+TransformCacheBuilder::build(uint64_t hash, size_t methods, const AdaptationFunction& adaptation) const
+{
+    std::vector<Colorspace> css = colorspaces;
+    std::vector<Illuminant> ims = illuminants;
+    std::sort(css.begin(), css.end(), [](const Colorspace& a, const Colorspace& b) { return a.name < b.name; });
+    std::sort(ims.begin(), ims.end(), [](const Illuminant& a, const Illuminant& b) { return a.name < b.name; });
+
+    // strings
+    std::string strings(1, '\0');
+    auto add_string = [&](const std::string& str) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(str.c_str(), str.size() + 1);
+        return offset;
+    };
+
+    // unique whitepoints, shared by colorspaces and illuminants
+    std::vector<const double*> whitepoints;
+    auto add_whitepoint = [&](const double* xyz) {
+        for (size_t i = 0; i < whitepoints.size(); ++i) {
+            if (std::equal(xyz, xyz + 3, whitepoints[i])) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        whitepoints.push_back(xyz);
+        return static_cast<uint32_t>(whitepoints.size() - 1);
+    };
+    for (Colorspace& cs : css) {
+        cs.record.name = add_string(cs.name);
+        cs.record.description = add_string(cs.description);
+        cs.record.trc = add_string(cs.trc);
+        cs.record.whitepoint = add_whitepoint(cs.record.whitepointxyz);
+    }
+    for (Illuminant& im : ims) {
+        im.record.name = add_string(im.name);
+        im.record.description = add_string(im.description);
+        im.record.whitepoint = add_whitepoint(im.record.whitepointxyz);
+    }
+
+    // buckets, at most half full
+    uint32_t buckets = 8;
+    while (buckets < 2 * (css.size() + ims.size())) {
+        buckets *= 2;
+    }
+
+    // layout
+    const size_t n = css.size(), k = ims.size(), w = whitepoints.size();
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, cache_magic, sizeof(cache_magic));
+    h.version = cache_version;
+    h.endian = cache_endian;
+    h.hash = hash;
+    h.colorspaces = static_cast<uint32_t>(n);
+    h.illuminants = static_cast<uint32_t>(k);
+    h.whitepoints = static_cast<uint32_t>(w);
+    h.methods = static_cast<uint32_t>(methods);
+    h.buckets = buckets;
+    h.colorspaceoffset = align(sizeof(Header));
+    h.illuminantoffset = align(h.colorspaceoffset + n * sizeof(CacheColorspace));
+    h.adaptationoffset = align(h.illuminantoffset + k * sizeof(CacheIlluminant));
+    h.transformoffset = align(h.adaptationoffset + w * w * methods * 9 * sizeof(double));
+    h.bucketoffset = align(h.transformoffset + n * n * methods * 9 * sizeof(double));
+    h.stringoffset = align(h.bucketoffset + buckets * sizeof(Bucket));
+    h.stringsize = strings.size();
+    h.size = h.stringoffset + h.stringsize;
+
+    std::vector<char> data(h.size, 0);
+    std::memcpy(data.data(), &h, sizeof(h));
+    CacheColorspace* csrecords = reinterpret_cast<CacheColorspace*>(data.data() + h.colorspaceoffset);
+    for (size_t i = 0; i < n; ++i) {
+        csrecords[i] = css[i].record;
+    }
+    CacheIlluminant* imrecords = reinterpret_cast<CacheIlluminant*>(data.data() + h.illuminantoffset);
+    for (size_t i = 0; i < k; ++i) {
+        imrecords[i] = ims[i].record;
+    }
+    double* adaptations = reinterpret_cast<double*>(data.data() + h.adaptationoffset);
+    for (size_t i = 0; i < w; ++i) {
+        for (size_t o = 0; o < w; ++o) {
+            for (size_t m = 0; m < methods; ++m) {
+                adaptation(whitepoints[i], whitepoints[o], m, adaptations + ((i * w + o) * methods + m) * 9);
+            }
+        }
+    }
+    double* transforms = reinterpret_cast<double*>(data.data() + h.transformoffset);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t o = 0; o < n; ++o) {
+            for (size_t m = 0; m < methods; ++m) {
+                const double* a = adaptations + ((css[i].record.whitepoint * w + css[o].record.whitepoint) * methods + m) * 9;
+                double am[9];
+                multiply(a, css[i].record.rgbxyz, am);
+                multiply(css[o].record.xyzrgb, am, transforms + ((i * n + o) * methods + m) * 9);
+            }
+        }
+    }
+    Bucket* table = reinterpret_cast<Bucket*>(data.data() + h.bucketoffset);
+    for (uint32_t i = 0; i < buckets; ++i) {
+        table[i].hash = 0;
+        table[i].kind = 0;
+        table[i].index = cache_empty;
+    }
+    auto add_bucket = [&](uint32_t kind, const std::string& name, size_t index) {
+        uint64_t hash = name_hash(kind, name);
+        for (uint32_t i = 0;; ++i) {
+            Bucket& bucket = table[(hash + i) & (buckets - 1)];
+            if (bucket.index == cache_empty) {
+                bucket.hash = hash;
+                bucket.kind = kind;
+                bucket.index = static_cast<uint32_t>(index);
+                break;
+            }
+        }
+    };
+    for (size_t i = 0; i < n; ++i) {
+        add_bucket(ColorspaceKind, css[i].name, i);
+    }
+    for (size_t i = 0; i < k; ++i) {
+        add_bucket(IlluminantKind, ims[i].name, i);
+    }
+    std::memcpy(data.data() + h.stringoffset, strings.data(), strings.size());
+    return data;
+}
+
+bool
+TransformCacheBuilder::write(const std::string& filename, const std::vector<char>& data)
+{
+    std::random_device random;
+    std::string tempname = filename + "." + std::to_string(random()) + ".tmp";
+    {
+        std::ofstream file(tempname, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size())) {
+            file.close();
+            std::remove(tempname.c_str());
+            return false;
+        }
+    }
+#if defined(_WIN32)
+    if (!MoveFileExA(tempname.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (std::rename(tempname.c_str(), filename.c_str()) != 0) {
+#endif
+        std::remove(tempname.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
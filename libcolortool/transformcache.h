@@ -0,0 +1,134 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace colortool {
+
+// transform cache
+// binary file with colorspaces, illuminants, adaptation matrices for every pair of
+// whitepoints and transforms for every pair of colorspaces, for each adaptation
+// method. the file is memory mapped and validated against a content hash of the
+// json files it was built from, matrices are 3x3 row major doubles.
+
+// colorspace record
+struct CacheColorspace
+{
+    uint32_t name;
+    uint32_t description;
+    uint32_t trc;
+    uint32_t whitepoint; // whitepoint index
+    double r[2];
+    double g[2];
+    double b[2];
+    double whitepointxy[2];
+    double whitepointxyz[3];
+    double rgbxyz[9];
+    double xyzrgb[9];
+};
+
+// illuminant record
+struct CacheIlluminant
+{
+    uint32_t name;
+    uint32_t description;
+    uint32_t whitepoint; // whitepoint index
+    uint32_t reserved;
+    double whitepointxy[2];
+    double whitepointxyz[3];
+};
+
+class TransformCache
+{
+public:
+    TransformCache();
+    ~TransformCache();
+    TransformCache(const TransformCache&) = delete;
+    TransformCache& operator=(const TransformCache&) = delete;
+
+    // memory map cache file, false if missing, corrupt or built from other content
+    bool open(const std::string& filename, uint64_t hash);
+
+    // use a cache built in memory
+    bool open(std::vector<char>&& data, uint64_t hash);
+
+    void close();
+    bool is_open() const;
+
+    size_t colorspaces() const;
+    size_t illuminants() const;
+    size_t methods() const;
+    const CacheColorspace& colorspace(size_t index) const;
+    const CacheIlluminant& illuminant(size_t index) const;
+    const char* string(uint32_t offset) const;
+
+    // index of name, -1 if not found
+    int find_colorspace(const std::string& name) const;
+    int find_illuminant(const std::string& name) const;
+
+    // transform from input to output colorspace index
+    const double* transform(size_t input, size_t output, size_t method) const;
+
+    // adaptation from input to output whitepoint index
+    const double* adaptation(size_t input, size_t output, size_t method) const;
+
+    // fnv-1a content hash
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+private:
+    int find(uint32_t kind, const std::string& name) const;
+    bool validate(uint64_t hash);
+
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> buffer;
+    void* mapping = nullptr;
+};
+
+// transform cache builder
+class TransformCacheBuilder
+{
+public:
+    // adaptation matrix from source to target whitepoint xyz for a method index
+    typedef std::function<void(const double* source, const double* target, size_t method, double* matrix)> AdaptationFunction;
+
+    void add_colorspace(const std::string& name, const std::string& description, const std::string& trc,
+                        const double* r, const double* g, const double* b, const double* whitepointxy,
+                        const double* whitepointxyz, const double* rgbxyz, const double* xyzrgb);
+
+    void add_illuminant(const std::string& name, const std::string& description,
+                        const double* whitepointxy, const double* whitepointxyz);
+
+    // build cache data, names must be unique per kind
+    std::vector<char> build(uint64_t hash, size_t methods, const AdaptationFunction& adaptation) const;
+
+    // write cache data, written to a temporary file and renamed in place
+    static bool write(const std::string& filename, const std::vector<char>& data);
+
+private:
+    struct Colorspace
+    {
+        std::string name;
+        std::string description;
+        std::string trc;
+        CacheColorspace record;
+    };
+    struct Illuminant
+    {
+        std::string name;
+        std::string description;
+        CacheIlluminant record;
+    };
+    std::vector<Colorspace> colorspaces;
+    std::vector<Illuminant> illuminants;
+};
+
+}
@@ -0,0 +1,282 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#include "whitebalance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "jsonreader.h"
+
+namespace colortool {
+
+namespace {
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
+
+// samples of a block of sampled rows, decoded rgb and the partial sum of finite samples
+struct WhiteBalanceBlock
+{
+    std::vector<float> samples;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    size_t count = 0;
+};
+
+bool finite_sample(const float* rgb)
+{
+    return std::isfinite(rgb[0]) && std::isfinite(rgb[1]) && std::isfinite(rgb[2]);
+}
+
+template <typename T>
+bool estimate(const T* pixels, int width, int height, int nchannels, const WhiteBalanceSettings& settings, double* white, int threads)
+{
+    const int step = std::max(settings.step, 1);
+    const int rows = (height + step - 1) / step;
+    if (width <= 0 || rows <= 0) {
+        return false;
+    }
+    // sampled rows are split in contiguous blocks, one per thread
+    int count = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    count = std::min(count, rows);
+    std::vector<WhiteBalanceBlock> blocks(count);
+    auto gather = [&](int index) {
+        WhiteBalanceBlock& block = blocks[index];
+        const int begin = int(int64_t(rows) * index / count), end = int(int64_t(rows) * (index + 1) / count);
+        block.samples.reserve(size_t(end - begin) * ((width + step - 1) / step) * 3);
+        for (int r = begin; r < end; ++r) {
+            const T* row = pixels + size_t(r) * step * width * nchannels;
+            const size_t first = block.samples.size();
+            for (int x = 0; x < width; x += step) {
+                const T* p = row + size_t(x) * nchannels;
+                block.samples.push_back(static_cast<float>(p[0]));
+                block.samples.push_back(static_cast<float>(p[1]));
+                block.samples.push_back(static_cast<float>(p[2]));
+            }
+            pixel_kernel()->decode_f32(block.samples.data() + first, block.samples.size() - first, settings.transfer);
+        }
+        for (size_t i = 0; i < block.samples.size(); i += 3) {
+            const float* rgb = block.samples.data() + i;
+            if (finite_sample(rgb)) {
+                block.sum[0] += rgb[0];
+                block.sum[1] += rgb[1];
+                block.sum[2] += rgb[2];
+                block.count++;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; ++i) {
+        pool.emplace_back(gather, i);
+    }
+    gather(0);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    size_t samples = 0;
+    if (settings.method == WhiteBalanceMethod::GrayWorld) {
+        for (const WhiteBalanceBlock& block : blocks) {
+            sum[0] += block.sum[0];
+            sum[1] += block.sum[1];
+            sum[2] += block.sum[2];
+            samples += block.count;
+        }
+    } else {
+        // luminance threshold at percentile, then the mean of samples at or above it
+        const double* w = settings.luminance;
+        std::vector<float> luminances;
+        for (const WhiteBalanceBlock& block : blocks) {
+            for (size_t i = 0; i < block.samples.size(); i += 3) {
+                const float* rgb = block.samples.data() + i;
+                if (finite_sample(rgb)) {
+                    luminances.push_back(float(w[0] * rgb[0] + w[1] * rgb[1] + w[2] * rgb[2]));
+                }
+            }
+        }
+        if (luminances.empty()) {
+            return false;
+        }
+        const float percentile = std::min(std::max(settings.percentile, 0.0f), 1.0f);
+        auto nth = luminances.begin() + std::min(size_t(percentile * luminances.size()), luminances.size() - 1);
+        std::nth_element(luminances.begin(), nth, luminances.end());
+        const float threshold = *nth;
+        for (const WhiteBalanceBlock& block : blocks) {
+            for (size_t i = 0; i < block.samples.size(); i += 3) {
+                const float* rgb = block.samples.data() + i;
+                if (finite_sample(rgb) && float(w[0] * rgb[0] + w[1] * rgb[1] + w[2] * rgb[2]) >= threshold) {
+                    sum[0] += rgb[0];
+                    sum[1] += rgb[1];
+                    sum[2] += rgb[2];
+                    samples++;
+                }
+            }
+        }
+    }
+    if (!samples || sum[0] <= 0.0 || sum[1] <= 0.0 || sum[2] <= 0.0) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        white[i] = sum[i] / samples;
+    }
+    return true;
+}
+
+}
+
+bool
+parse_whitebalance(const std::string& name, WhiteBalanceMethod& method)
+{
+    if (name == "grayworld") {
+        method = WhiteBalanceMethod::GrayWorld;
+    } else if (name == "brightest") {
+        method = WhiteBalanceMethod::BrightestPatch;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char*
+whitebalance_name(WhiteBalanceMethod method)
+{
+    return method == WhiteBalanceMethod::GrayWorld ? "grayworld" : "brightest";
+}
+
+bool
+estimate_white(const float* pixels, int width, int height, int nchannels, const WhiteBalanceSettings& settings, double* white, int threads)
+{
+    return estimate(pixels, width, height, nchannels, settings, white, threads);
+}
+
+bool
+estimate_white(const half* pixels, int width, int height, int nchannels, const WhiteBalanceSettings& settings, double* white, int threads)
+{
+    return estimate(pixels, width, height, nchannels, settings, white, threads);
+}
+
+void
+whitebalance_matrix(const double* white, const double* rgbxyz, const double* xyzrgb, const double* target, const AdaptationTransform& transform, double degree, double* matrix)
+{
+    Eigen::Map<const RowMatrix3d> inputxyz(rgbxyz);
+    Eigen::Map<const RowMatrix3d> outputrgb(xyzrgb);
+    Eigen::Vector3d source = inputxyz * Eigen::Vector3d(white[0], white[1], white[2]);
+    source /= source.y();
+    const Eigen::Vector3d targetxyz = xy_to_xyz(Eigen::Vector2d(target));
+    double adaptation[9];
+    adaptation_matrix(transform, source.data(), targetxyz.data(), degree, adaptation);
+    Eigen::Map<RowMatrix3d> balanced(matrix);
+    balanced = outputrgb * Eigen::Map<const RowMatrix3d>(adaptation) * inputxyz;
+}
+
+bool
+WhiteBalanceSmoothing::add(const double* frame, double* smoothed)
+{
+    if (frame) {
+        const double sum = frame[0] + frame[1] + frame[2];
+        const double alpha = 1.0 / (1.0 + std::max(frames, 0.0f));
+        for (int i = 0; i < 3; ++i) {
+            white[i] = valid ? white[i] + (frame[i] / sum - white[i]) * alpha : frame[i] / sum;
+        }
+        valid = true;
+    }
+    if (valid) {
+        std::copy(white, white + 3, smoothed);
+    }
+    return valid;
+}
+
+bool
+read_whitebalance_cache(const std::string& filename, WhiteBalanceCache& cache, std::string& error)
+{
+    std::ifstream stream(filename);
+    if (!stream) {
+        error = "could not open white balance sidecar: " + filename;
+        return false;
+    }
+    std::stringstream content;
+    content << stream.rdbuf();
+    const std::string data = content.str();
+    JsonReader reader(data.data(), data.size());
+    bool valid = reader.read_object([&](const std::string& key) {
+        if (key == "key") {
+            return reader.read_scalar(cache.key);
+        } else if (key == "whites") {
+            return reader.read_array([&]() {
+                int frame = 0;
+                std::array<double, 3> white = { 0.0, 0.0, 0.0 };
+                bool hasframe = false, haswhite = false;
+                bool entry = reader.read_object([&](const std::string& member) {
+                    std::string text;
+                    if (member == "frame") {
+                        hasframe = reader.read_scalar(text);
+                        frame = std::atoi(text.c_str());
+                        return hasframe;
+                    } else if (member == "white") {
+                        int index = 0;
+                        haswhite = reader.read_array([&]() {
+                            if (index == 3 || !reader.read_scalar(text)) {
+                                return reader.fail("expected rgb white");
+                            }
+                            white[index++] = std::strtod(text.c_str(), nullptr);
+                            return true;
+                        }) && index == 3;
+                        return haswhite;
+                    }
+                    return reader.skip_value();
+                });
+                if (!entry || !hasframe || !haswhite) {
+                    return reader.fail("expected frame and white");
+                }
+                cache.whites[frame] = white;
+                return true;
+            });
+        }
+        return reader.skip_value();
+    });
+    if (!valid) {
+        error = "could not parse white balance sidecar: " + filename + ", " + reader.error;
+        return false;
+    }
+    return true;
+}
+
+bool
+write_whitebalance_cache(const std::string& filename, const WhiteBalanceCache& cache, std::string& error)
+{
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        error = "could not open white balance sidecar for writing: " + filename;
+        return false;
+    }
+    std::string key;
+    for (char c : cache.key) {
+        if (c == '"' || c == '\\') {
+            key += '\\';
+        }
+        key += c;
+    }
+    std::fprintf(file, "{\n    \"key\": \"%s\",\n    \"whites\": [", key.c_str());
+    size_t index = 0;
+    for (const auto& entry : cache.whites) {
+        std::fprintf(file, "%s\n        {\"frame\": %d, \"white\": [%.17g, %.17g, %.17g]}", index++ ? "," : "",
+                     entry.first, entry.second[0], entry.second[1], entry.second[2]);
+    }
+    std::fprintf(file, "\n    ]\n}\n");
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        error = "could not write white balance sidecar: " + filename;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,83 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2022 - present Mikael Sundell.
+//
+
+#pragma once
+
+#include <array>
+#include <map>
+#include <string>
+
+#include "adaptation.h"
+#include "colormath.h"
+#include "pixelkernel.h"
+#include "transfer.h"
+
+namespace colortool {
+
+// white balance
+// scene white estimated from image statistics on a decimated grid of pixels, reduced
+// in parallel over rows. whites are linear rgb of the input colorspace.
+
+// estimation methods, gray world is the mean of all samples and brightest patch the
+// mean of samples at or above a luminance percentile
+enum class WhiteBalanceMethod {
+    GrayWorld,
+    BrightestPatch
+};
+
+// parse method name, grayworld or brightest, false if unknown
+bool parse_whitebalance(const std::string& name, WhiteBalanceMethod& method);
+
+// method name
+const char* whitebalance_name(WhiteBalanceMethod method);
+
+// estimation settings
+struct WhiteBalanceSettings
+{
+    WhiteBalanceMethod method = WhiteBalanceMethod::GrayWorld;
+    float percentile = 0.95f; // brightest patch
+    int step = 8; // every step-th row and column is sampled
+    double luminance[3] = { 1.0 / 3.0, 1.0 / 3.0, 1.0 / 3.0 }; // rgb Y luminance coeff
+    Transfer transfer; // decoded to linear before estimation
+};
+
+// estimate white of interleaved pixels, height rows of width pixels with nchannels >= 3.
+// sampled rows are spread across threads, 0 for all cores, and partial results are
+// combined in row order so the estimate does not depend on the thread count. false if
+// there are no finite samples.
+bool estimate_white(const float* pixels, int width, int height, int nchannels, const WhiteBalanceSettings& settings, double* white, int threads = 0);
+bool estimate_white(const half* pixels, int width, int height, int nchannels, const WhiteBalanceSettings& settings, double* white, int threads = 0);
+
+// rgb of input to rgb of output with white adapted to target whitepoint xy, matrices are
+// 3x3 row major, partially adapted by degree. the white is normalized to Y = 1 so
+// exposure is kept.
+void whitebalance_matrix(const double* white, const double* rgbxyz, const double* xyzrgb, const double* target, const AdaptationTransform& transform, double degree, double* matrix);
+
+// temporal smoothing
+// exponential moving average of white chromaticity in frame order, with a time constant
+// in frames, 0 for none. frames without a white keep the smoothed white.
+struct WhiteBalanceSmoothing
+{
+    float frames = 0.0f;
+    bool valid = false;
+    double white[3] = { 0.0, 0.0, 0.0 };
+
+    // add white of next frame, nullptr if none, false if no white is known yet
+    bool add(const double* frame, double* smoothed);
+};
+
+// white balance cache
+// estimates per frame in a json sidecar, valid for the settings and input in key
+struct WhiteBalanceCache
+{
+    std::string key;
+    std::map<int, std::array<double, 3>> whites;
+};
+
+// read and write sidecar, false and error if missing or malformed
+bool read_whitebalance_cache(const std::string& filename, WhiteBalanceCache& cache, std::string& error);
+bool write_whitebalance_cache(const std::string& filename, const WhiteBalanceCache& cache, std::string& error);
+
+}